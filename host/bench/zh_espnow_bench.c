@@ -0,0 +1,311 @@
+#include "zh_espnow.h"
+#include "zh_espnow_shim.h"
+#include "zh_espnow_sim.h"
+#include "esp_timer.h"
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define LIST_MAX 8
+#define DRAIN_TIMEOUT_MS 5000
+
+typedef struct
+{
+    uint32_t messages;             /*!< Number of messages offered per run. */
+    uint16_t payload;              /*!< Payload length of a message in bytes. */
+    uint8_t loss_percent;          /*!< Loss probability of every link. */
+    uint8_t burst;                 /*!< Number of messages offered back to back. */
+    uint16_t period_ms;            /*!< Time between the starts of two bursts. */
+    uint32_t seed;                 /*!< Seed of the simulated medium. */
+    bool is_csv;                   /*!< Print comma separated values instead of a table. */
+    uint8_t queue_sizes[LIST_MAX]; /*!< Transmit queue sizes to run. */
+    uint8_t queue_sizes_num;       /*!< Number of transmit queue sizes. */
+    uint8_t windows[LIST_MAX];     /*!< Transmission windows to run. */
+    uint8_t windows_num;           /*!< Number of transmission windows. */
+    uint8_t attempts[LIST_MAX];    /*!< Attempt counts to run. */
+    uint8_t attempts_num;          /*!< Number of attempt counts. */
+    uint8_t nodes[LIST_MAX];       /*!< Node counts to run. */
+    uint8_t nodes_num;             /*!< Number of node counts. */
+} _options_t;
+
+typedef struct
+{
+    bool is_active;          /*!< Send events belong to the current run. */
+    uint32_t confirmed;      /*!< Number of send events. */
+    uint32_t failed;         /*!< Number of send events with ZH_ESPNOW_SEND_FAIL. */
+    uint32_t *latency_us;    /*!< Latency of every send event. */
+    uint32_t capacity;       /*!< Number of entries of `latency_us`. */
+    int64_t last_confirm_us; /*!< Time of the last send event. */
+} _run_t;
+
+typedef struct
+{
+    uint32_t accepted;          /*!< Number of messages accepted by zh_espnow_send(). */
+    uint32_t dropped;           /*!< Number of messages rejected by zh_espnow_send(). */
+    uint32_t confirmed;         /*!< Number of send events. */
+    uint32_t failed;            /*!< Number of send events with ZH_ESPNOW_SEND_FAIL. */
+    uint32_t messages_per_s;    /*!< Successfully sent messages per second of the run. */
+    uint32_t p50_us;            /*!< Median send-to-confirm latency. */
+    uint32_t p99_us;            /*!< 99th percentile of the send-to-confirm latency. */
+    float heap_ops_per_message; /*!< Heap allocations and frees per offered message. */
+    uint32_t retries;           /*!< Number of retries, from the retry histogram. */
+} _result_t;
+
+static bool _bench_parse_list(const char *text, uint8_t *list, uint8_t *num);
+static void _bench_usage(const char *name);
+static esp_err_t _bench_run(const _options_t *options, uint8_t queue_size, uint8_t tx_window, uint8_t attempts, uint8_t nodes, _result_t *result);
+static void _bench_event_handler(void *arg, esp_event_base_t event_base, int32_t event_id, void *event_data);
+static int _bench_compare(const void *a, const void *b);
+
+static _run_t _run = {0};
+
+int main(int argc, char **argv)
+{
+    _options_t options = {.messages = 1000, .payload = 32, .loss_percent = 5, .burst = 16, .period_ms = 20, .seed = 1};
+    _bench_parse_list("8,32", options.queue_sizes, &options.queue_sizes_num);
+    _bench_parse_list("1,4", options.windows, &options.windows_num);
+    _bench_parse_list("1,3", options.attempts, &options.attempts_num);
+    _bench_parse_list("1,4,16", options.nodes, &options.nodes_num);
+    static const struct option long_options[] = {
+        {"messages", required_argument, NULL, 'm'},
+        {"payload", required_argument, NULL, 'p'},
+        {"loss", required_argument, NULL, 'l'},
+        {"burst", required_argument, NULL, 'b'},
+        {"period", required_argument, NULL, 't'},
+        {"seed", required_argument, NULL, 's'},
+        {"queue-sizes", required_argument, NULL, 'q'},
+        {"windows", required_argument, NULL, 'w'},
+        {"attempts", required_argument, NULL, 'a'},
+        {"nodes", required_argument, NULL, 'n'},
+        {"csv", no_argument, NULL, 'c'},
+        {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0}};
+    int option = 0;
+    bool is_valid = true;
+    while ((option = getopt_long(argc, argv, "m:p:l:b:t:s:q:w:a:n:ch", long_options, NULL)) != -1)
+    {
+        switch (option)
+        {
+        case 'm':
+            options.messages = strtoul(optarg, NULL, 10);
+            break;
+        case 'p':
+            options.payload = strtoul(optarg, NULL, 10);
+            break;
+        case 'l':
+            options.loss_percent = strtoul(optarg, NULL, 10);
+            break;
+        case 'b':
+            options.burst = strtoul(optarg, NULL, 10);
+            break;
+        case 't':
+            options.period_ms = strtoul(optarg, NULL, 10);
+            break;
+        case 's':
+            options.seed = strtoul(optarg, NULL, 10);
+            break;
+        case 'q':
+            is_valid = _bench_parse_list(optarg, options.queue_sizes, &options.queue_sizes_num) && is_valid;
+            break;
+        case 'w':
+            is_valid = _bench_parse_list(optarg, options.windows, &options.windows_num) && is_valid;
+            break;
+        case 'a':
+            is_valid = _bench_parse_list(optarg, options.attempts, &options.attempts_num) && is_valid;
+            break;
+        case 'n':
+            is_valid = _bench_parse_list(optarg, options.nodes, &options.nodes_num) && is_valid;
+            break;
+        case 'c':
+            options.is_csv = true;
+            break;
+        default:
+            _bench_usage(argv[0]);
+            return (option == 'h') ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+    if (is_valid == false || options.messages == 0 || options.payload == 0 || options.payload > ESP_NOW_MAX_DATA_LEN || options.loss_percent > 100 || options.burst == 0)
+    {
+        _bench_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    zh_espnow_shim_start();
+    esp_log_level_set("*", ESP_LOG_ERROR);
+    esp_event_loop_create_default();
+    printf(options.is_csv == true ? "queue_size,tx_window,attempts,nodes,offered,accepted,dropped,failed,messages_per_s,p50_us,p99_us,heap_ops_per_message,retries\n"
+                                  : "queue window attempts nodes offered accepted dropped failed   msg/s  p50_us  p99_us heap/msg retries\n");
+    int exit_code = EXIT_SUCCESS;
+    for (uint8_t q = 0; q < options.queue_sizes_num; ++q)
+    {
+        for (uint8_t w = 0; w < options.windows_num; ++w)
+        {
+            for (uint8_t a = 0; a < options.attempts_num; ++a)
+            {
+                for (uint8_t n = 0; n < options.nodes_num; ++n)
+                {
+                    _result_t result = {0};
+                    esp_err_t err = _bench_run(&options, options.queue_sizes[q], options.windows[w], options.attempts[a], options.nodes[n], &result);
+                    if (err != ESP_OK)
+                    {
+                        fprintf(stderr, "Run with queue size %u, window %u, %u attempts and %u nodes failed: %s.\n", options.queue_sizes[q], options.windows[w], options.attempts[a], options.nodes[n],
+                                esp_err_to_name(err));
+                        exit_code = EXIT_FAILURE;
+                        continue;
+                    }
+                    printf(options.is_csv == true ? "%u,%u,%u,%u,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%.2f,%lu\n" : "%5u %6u %8u %5u %7lu %8lu %7lu %6lu %7lu %7lu %7lu %8.2f %7lu\n",
+                           options.queue_sizes[q], options.windows[w], options.attempts[a], options.nodes[n], (unsigned long)options.messages, (unsigned long)result.accepted,
+                           (unsigned long)result.dropped, (unsigned long)result.failed, (unsigned long)result.messages_per_s, (unsigned long)result.p50_us, (unsigned long)result.p99_us,
+                           result.heap_ops_per_message, (unsigned long)result.retries);
+                    fflush(stdout);
+                }
+            }
+        }
+    }
+    return exit_code;
+}
+
+static bool _bench_parse_list(const char *text, uint8_t *list, uint8_t *num)
+{
+    char *end = NULL;
+    *num = 0;
+    do
+    {
+        unsigned long value = strtoul(text, &end, 10);
+        if (end == text || value == 0 || value > UINT8_MAX || *num == LIST_MAX)
+        {
+            return false;
+        }
+        list[(*num)++] = (uint8_t)value;
+        text = end + 1;
+    } while (*end == ',');
+    return *end == '\0';
+}
+
+static void _bench_usage(const char *name)
+{
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  -m, --messages N      messages offered per run (1000)\n"
+            "  -p, --payload BYTES   payload length (32)\n"
+            "  -l, --loss PERCENT    loss probability of every link (5)\n"
+            "  -b, --burst N         messages offered back to back (16)\n"
+            "  -t, --period MS       time between the starts of two bursts (20)\n"
+            "  -s, --seed N          seed of the simulated medium (1)\n"
+            "  -q, --queue-sizes L   comma separated transmit queue sizes (8,32)\n"
+            "  -w, --windows L       comma separated transmission windows (1,4)\n"
+            "  -a, --attempts L      comma separated attempt counts (1,3)\n"
+            "  -n, --nodes L         comma separated node counts (1,4,16)\n"
+            "  -c, --csv             print comma separated values\n",
+            name);
+}
+
+static esp_err_t _bench_run(const _options_t *options, uint8_t queue_size, uint8_t tx_window, uint8_t attempts, uint8_t nodes, _result_t *result)
+{
+    zh_espnow_sim_config_t sim_config = ZH_ESPNOW_SIM_CONFIG_DEFAULT();
+    sim_config.nodes = nodes;
+    sim_config.loss_percent = options->loss_percent;
+    sim_config.seed = options->seed;
+    esp_err_t err = zh_espnow_sim_init(&sim_config);
+    if (err != ESP_OK)
+    {
+        return err;
+    }
+    zh_espnow_init_config_t config = ZH_ESPNOW_INIT_CONFIG_DEFAULT();
+    config.queue_size = queue_size;
+    config.tx_window = tx_window;
+    config.attempts = attempts;
+    // Every queued message holds a pool block, a pool smaller than the queue would hide the queue size.
+    config.small_block_count = queue_size + config.tx_window;
+    err = zh_espnow_init(&config);
+    if (err != ESP_OK)
+    {
+        zh_espnow_sim_deinit();
+        return err;
+    }
+    // The counters of the default instance outlive zh_espnow_deinit().
+    zh_espnow_reset_stats();
+    uint8_t *payload = calloc(1, options->payload);
+    _run = (_run_t){.is_active = true, .latency_us = calloc(options->messages, sizeof(uint32_t)), .capacity = options->messages};
+    esp_event_handler_register(ZH_ESPNOW, ZH_ESPNOW_ON_SEND_EVENT, &_bench_event_handler, NULL);
+    zh_espnow_shim_heap_stats_t heap_before = {0};
+    zh_espnow_shim_get_heap_stats(&heap_before);
+    int64_t start_us = esp_timer_get_time();
+    uint32_t offered = 0;
+    while (offered < options->messages)
+    {
+        for (uint8_t i = 0; i < options->burst && offered < options->messages; ++i, ++offered)
+        {
+            uint8_t target[ESP_NOW_ETH_ALEN] = {0};
+            zh_espnow_sim_node_mac(offered % nodes + 1, target);
+            memcpy(payload, &offered, (options->payload < sizeof(offered)) ? options->payload : sizeof(offered));
+            if (zh_espnow_send(target, payload, options->payload) == ESP_OK)
+            {
+                ++result->accepted;
+            }
+            else
+            {
+                ++result->dropped;
+            }
+        }
+        int64_t next_us = start_us + (int64_t)(offered / options->burst) * options->period_ms * 1000;
+        int64_t now_us = esp_timer_get_time();
+        vTaskDelay((next_us > now_us) ? pdMS_TO_TICKS((next_us - now_us + 999) / 1000) : 0);
+    }
+    for (uint32_t waited = 0; _run.confirmed < result->accepted && waited < DRAIN_TIMEOUT_MS; waited += 10)
+    {
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+    zh_espnow_shim_heap_stats_t heap_after = {0};
+    zh_espnow_shim_get_heap_stats(&heap_after);
+    zh_espnow_stats_t stats = {0};
+    zh_espnow_get_stats_snapshot(&stats);
+    _run.is_active = false;
+    esp_event_handler_unregister(ZH_ESPNOW, ZH_ESPNOW_ON_SEND_EVENT, &_bench_event_handler);
+    zh_espnow_deinit();
+    zh_espnow_sim_deinit();
+    result->confirmed = _run.confirmed;
+    result->failed = _run.failed;
+    int64_t elapsed_us = _run.last_confirm_us - start_us;
+    result->messages_per_s = (elapsed_us > 0) ? (uint32_t)((int64_t)(_run.confirmed - _run.failed) * 1000000 / elapsed_us) : 0;
+    if (_run.confirmed > 0)
+    {
+        uint32_t count = (_run.confirmed < _run.capacity) ? _run.confirmed : _run.capacity;
+        qsort(_run.latency_us, count, sizeof(uint32_t), &_bench_compare);
+        result->p50_us = _run.latency_us[(count - 1) * 50 / 100];
+        result->p99_us = _run.latency_us[(count - 1) * 99 / 100];
+    }
+    result->heap_ops_per_message = (float)((heap_after.allocs - heap_before.allocs) + (heap_after.frees - heap_before.frees)) / options->messages;
+    for (uint8_t i = 0; i < ZH_ESPNOW_HISTOGRAM_SIZE; ++i)
+    {
+        result->retries += stats.send_retries_hist[i] * i;
+    }
+    free(_run.latency_us);
+    free(payload);
+    // Every accepted message must be confirmed exactly once.
+    return (result->confirmed == result->accepted) ? ESP_OK : ESP_ERR_INVALID_STATE;
+}
+
+static void _bench_event_handler(void *arg, esp_event_base_t event_base, int32_t event_id, void *event_data)
+{
+    const zh_espnow_event_on_send_t *on_send = event_data;
+    if (_run.is_active == false)
+    {
+        return;
+    }
+    // More confirmations than accepted messages are reported by the caller, only the first ones are kept.
+    if (_run.confirmed < _run.capacity)
+    {
+        _run.latency_us[_run.confirmed] = on_send->latency_us;
+    }
+    ++_run.confirmed;
+    _run.failed += (on_send->status == ZH_ESPNOW_SEND_FAIL) ? 1 : 0;
+    _run.last_confirm_us = esp_timer_get_time();
+}
+
+static int _bench_compare(const void *a, const void *b)
+{
+    uint32_t left = *(const uint32_t *)a;
+    uint32_t right = *(const uint32_t *)b;
+    return (left > right) - (left < right);
+}
@@ -0,0 +1,110 @@
+#include "zh_espnow.h"
+#include "zh_espnow_shim.h"
+#include "zh_espnow_sim.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define WAIT_TIMEOUT_MS 1000
+
+typedef struct
+{
+    const char *name;       /*!< Name printed with the result. */
+    esp_err_t (*run)(void); /*!< Check, ESP_OK if it passed. */
+} _check_t;
+
+typedef struct
+{
+    uint16_t on_air_len;                  /*!< Length of the last frame acknowledged by a simulated node. */
+    bool is_received;                     /*!< A message has been delivered to node 0. */
+    uint16_t data_len;                    /*!< Length of the delivered message. */
+    uint8_t data[ZH_ESPNOW_MAX_DATA_LEN]; /*!< Payload of the delivered message. */
+} _echo_t;
+
+static esp_err_t _check_compression_round_trip(void);
+static void _check_echo(uint8_t node, const uint8_t *data, uint16_t data_len, void *arg);
+static void _check_recv_handler(void *arg, esp_event_base_t event_base, int32_t event_id, void *event_data);
+
+static const _check_t _checks[] = {
+    {"compression round trip", &_check_compression_round_trip},
+};
+
+static _echo_t _echo = {0};
+
+int main(void)
+{
+    zh_espnow_shim_start();
+    esp_log_level_set("*", ESP_LOG_ERROR);
+    esp_event_loop_create_default();
+    int exit_code = EXIT_SUCCESS;
+    for (uint8_t i = 0; i < sizeof(_checks) / sizeof(_checks[0]); ++i)
+    {
+        esp_err_t err = _checks[i].run();
+        printf("%-32s %s\n", _checks[i].name, (err == ESP_OK) ? "passed" : esp_err_to_name(err));
+        exit_code = (err == ESP_OK) ? exit_code : EXIT_FAILURE;
+    }
+    return exit_code;
+}
+
+static esp_err_t _check_compression_round_trip(void)
+{
+    // Node 1 sends every frame it receives back, so node 0 encodes the payload and decodes it again.
+    static const char payload[] = "{\"temperature\":21.5,\"humidity\":40,\"status\":\"ok\",\"name\":\"sensor\",\"value\":true,\"id\":17}";
+    zh_espnow_sim_config_t sim_config = ZH_ESPNOW_SIM_CONFIG_DEFAULT();
+    esp_err_t err = zh_espnow_sim_init(&sim_config);
+    if (err != ESP_OK)
+    {
+        return err;
+    }
+    zh_espnow_sim_register_node_recv_cb(&_check_echo, NULL);
+    zh_espnow_init_config_t config = ZH_ESPNOW_INIT_CONFIG_DEFAULT();
+    config.frame_header = true;
+    config.compression = true;
+    err = zh_espnow_init(&config);
+    if (err != ESP_OK)
+    {
+        zh_espnow_sim_deinit();
+        return err;
+    }
+    zh_espnow_reset_stats();
+    _echo = (_echo_t){0};
+    esp_event_handler_register(ZH_ESPNOW, ZH_ESPNOW_ON_RECV_EVENT, &_check_recv_handler, NULL);
+    uint8_t target[ESP_NOW_ETH_ALEN] = {0};
+    zh_espnow_sim_node_mac(1, target);
+    err = zh_espnow_send(target, (const uint8_t *)payload, sizeof(payload) - 1);
+    for (uint32_t waited = 0; err == ESP_OK && _echo.is_received == false && waited < WAIT_TIMEOUT_MS; waited += 10)
+    {
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+    zh_espnow_stats_t stats = {0};
+    zh_espnow_get_stats_snapshot(&stats);
+    esp_event_handler_unregister(ZH_ESPNOW, ZH_ESPNOW_ON_RECV_EVENT, &_check_recv_handler);
+    zh_espnow_deinit();
+    zh_espnow_sim_register_node_recv_cb(NULL, NULL);
+    zh_espnow_sim_deinit();
+    if (err != ESP_OK)
+    {
+        return err;
+    }
+    if (_echo.is_received == false)
+    {
+        return ESP_ERR_TIMEOUT;
+    }
+    bool is_valid = (_echo.data_len == sizeof(payload) - 1 && memcmp(_echo.data, payload, _echo.data_len) == 0);
+    is_valid = is_valid && _echo.on_air_len < sizeof(payload) - 1 && stats.compressed_frames == 1 && stats.decompressed_frames == 1;
+    return (is_valid == true) ? ESP_OK : ESP_ERR_INVALID_RESPONSE;
+}
+
+static void _check_echo(uint8_t node, const uint8_t *data, uint16_t data_len, void *arg)
+{
+    _echo.on_air_len = data_len;
+    zh_espnow_sim_inject(node, NULL, data, data_len);
+}
+
+static void _check_recv_handler(void *arg, esp_event_base_t event_base, int32_t event_id, void *event_data)
+{
+    const zh_espnow_event_on_recv_t *on_recv = event_data;
+    _echo.data_len = (on_recv->data_len < sizeof(_echo.data)) ? on_recv->data_len : sizeof(_echo.data);
+    memcpy(_echo.data, on_recv->data, _echo.data_len);
+    _echo.is_received = true;
+}
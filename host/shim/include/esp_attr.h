@@ -0,0 +1,10 @@
+/**
+ * @file esp_attr.h
+ *
+ * @brief Host shim of the ESP-IDF placement attributes. There is no IRAM on the host.
+ */
+
+#pragma once
+
+#define IRAM_ATTR
+#define DRAM_ATTR
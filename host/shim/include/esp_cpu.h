@@ -0,0 +1,25 @@
+/**
+ * @file esp_cpu.h
+ *
+ * @brief Host shim of the ESP-IDF CPU cycle counter. A cycle is one nanosecond of the monotonic clock.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    typedef uint32_t esp_cpu_cycle_count_t;
+
+    /**
+     * @brief Get the current value of the cycle counter.
+     */
+    esp_cpu_cycle_count_t esp_cpu_get_cycle_count(void);
+
+#ifdef __cplusplus
+}
+#endif
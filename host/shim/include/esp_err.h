@@ -0,0 +1,44 @@
+/**
+ * @file esp_err.h
+ *
+ * @brief Host shim of the ESP-IDF error codes used by zh_espnow.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    typedef int esp_err_t;
+
+#define ESP_OK 0
+#define ESP_FAIL -1
+#define ESP_ERR_NO_MEM 0x101
+#define ESP_ERR_INVALID_ARG 0x102
+#define ESP_ERR_INVALID_STATE 0x103
+#define ESP_ERR_INVALID_SIZE 0x104
+#define ESP_ERR_NOT_FOUND 0x105
+#define ESP_ERR_NOT_SUPPORTED 0x106
+#define ESP_ERR_TIMEOUT 0x107
+#define ESP_ERR_INVALID_RESPONSE 0x108
+#define ESP_ERR_WIFI_BASE 0x3000
+#define ESP_ERR_WIFI_NOT_INIT (ESP_ERR_WIFI_BASE + 1)
+
+    /**
+     * @brief Return the name of an error code.
+     *
+     * @param[in] code Error code.
+     *
+     * @return Name of the code, or "UNKNOWN ERROR" for codes outside of the shim.
+     */
+    const char *esp_err_to_name(esp_err_t code);
+
+#ifdef __cplusplus
+}
+#endif
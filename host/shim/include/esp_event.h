@@ -0,0 +1,47 @@
+/**
+ * @file esp_event.h
+ *
+ * @brief Host shim of the ESP-IDF default event loop.
+ *
+ * Events are copied and dispatched by a task of the shim, like the default event loop of ESP-IDF does.
+ */
+
+#pragma once
+
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    typedef const char *esp_event_base_t;
+    typedef void (*esp_event_handler_t)(void *event_handler_arg, esp_event_base_t event_base, int32_t event_id, void *event_data);
+
+#define ESP_EVENT_DECLARE_BASE(id) extern esp_event_base_t const id
+#define ESP_EVENT_DEFINE_BASE(id) esp_event_base_t const id = #id
+#define ESP_EVENT_ANY_BASE NULL
+#define ESP_EVENT_ANY_ID -1
+
+    /**
+     * @brief Create the default event loop and its task.
+     *
+     * @return ESP_OK on success.
+     * @return ESP_ERR_INVALID_STATE if the loop already exists.
+     * @return ESP_ERR_NO_MEM if the task could not be created.
+     */
+    esp_err_t esp_event_loop_create_default(void);
+
+    /**
+     * @brief Delete the default event loop. Events not dispatched yet are dropped.
+     */
+    esp_err_t esp_event_loop_delete_default(void);
+
+    esp_err_t esp_event_handler_register(esp_event_base_t event_base, int32_t event_id, esp_event_handler_t event_handler, void *event_handler_arg);
+    esp_err_t esp_event_handler_unregister(esp_event_base_t event_base, int32_t event_id, esp_event_handler_t event_handler);
+    esp_err_t esp_event_post(esp_event_base_t event_base, int32_t event_id, const void *event_data, size_t event_data_size, TickType_t ticks_to_wait);
+
+#ifdef __cplusplus
+}
+#endif
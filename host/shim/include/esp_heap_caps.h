@@ -0,0 +1,26 @@
+/**
+ * @file esp_heap_caps.h
+ *
+ * @brief Host shim of the ESP-IDF capability based heap. Every call is counted, see zh_espnow_shim_get_heap_stats().
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define MALLOC_CAP_8BIT (1 << 2)
+#define MALLOC_CAP_INTERNAL (1 << 11)
+
+    void *heap_caps_malloc(size_t size, uint32_t caps);
+    void *heap_caps_calloc(size_t n, size_t size, uint32_t caps);
+    void heap_caps_free(void *ptr);
+
+#ifdef __cplusplus
+}
+#endif
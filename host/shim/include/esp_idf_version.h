@@ -0,0 +1,10 @@
+/**
+ * @file esp_idf_version.h
+ *
+ * @brief Host shim of the ESP-IDF version macros. The shim follows the ESP-IDF 5.5 API.
+ */
+
+#pragma once
+
+#define ESP_IDF_VERSION_VAL(major, minor, patch) (((major) << 16) | ((minor) << 8) | (patch))
+#define ESP_IDF_VERSION ESP_IDF_VERSION_VAL(5, 5, 0)
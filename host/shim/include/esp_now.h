@@ -0,0 +1,83 @@
+/**
+ * @file esp_now.h
+ *
+ * @brief Host shim of the ESP-NOW driver. Implemented by the simulated radio medium, see zh_espnow_sim.h.
+ */
+
+#pragma once
+
+#include "esp_err.h"
+#include "esp_wifi.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define ESP_ERR_ESPNOW_BASE (ESP_ERR_WIFI_BASE + 100)
+#define ESP_ERR_ESPNOW_NOT_INIT (ESP_ERR_ESPNOW_BASE + 1)
+#define ESP_ERR_ESPNOW_ARG (ESP_ERR_ESPNOW_BASE + 2)
+#define ESP_ERR_ESPNOW_NO_MEM (ESP_ERR_ESPNOW_BASE + 3)
+#define ESP_ERR_ESPNOW_FULL (ESP_ERR_ESPNOW_BASE + 4)
+#define ESP_ERR_ESPNOW_NOT_FOUND (ESP_ERR_ESPNOW_BASE + 5)
+#define ESP_ERR_ESPNOW_INTERNAL (ESP_ERR_ESPNOW_BASE + 6)
+#define ESP_ERR_ESPNOW_EXIST (ESP_ERR_ESPNOW_BASE + 7)
+#define ESP_ERR_ESPNOW_IF (ESP_ERR_ESPNOW_BASE + 8)
+#define ESP_ERR_ESPNOW_CHAN (ESP_ERR_ESPNOW_BASE + 9)
+
+#define ESP_NOW_ETH_ALEN 6
+#define ESP_NOW_KEY_LEN 16
+#define ESP_NOW_MAX_TOTAL_PEER_NUM 20
+#define ESP_NOW_MAX_ENCRYPT_PEER_NUM 6
+#define ESP_NOW_MAX_DATA_LEN 250
+#define ESP_NOW_MAX_DATA_LEN_V2 1470
+
+    typedef enum
+    {
+        ESP_NOW_SEND_SUCCESS,
+        ESP_NOW_SEND_FAIL
+    } esp_now_send_status_t;
+
+    typedef struct
+    {
+        uint8_t peer_addr[ESP_NOW_ETH_ALEN];
+        uint8_t lmk[ESP_NOW_KEY_LEN];
+        uint8_t channel;
+        wifi_interface_t ifidx;
+        bool encrypt;
+        void *priv;
+    } esp_now_peer_info_t;
+
+    typedef struct
+    {
+        uint8_t *src_addr;
+        uint8_t *des_addr;
+        wifi_pkt_rx_ctrl_t *rx_ctrl;
+    } esp_now_recv_info_t;
+
+    typedef struct
+    {
+        const uint8_t *src_addr;
+        const uint8_t *des_addr;
+        wifi_interface_t ifidx;
+    } esp_now_send_info_t;
+
+    typedef void (*esp_now_recv_cb_t)(const esp_now_recv_info_t *esp_now_info, const uint8_t *data, int data_len);
+    typedef void (*esp_now_send_cb_t)(const esp_now_send_info_t *tx_info, esp_now_send_status_t status);
+
+    esp_err_t esp_now_init(void);
+    esp_err_t esp_now_deinit(void);
+    esp_err_t esp_now_get_version(uint32_t *version);
+    esp_err_t esp_now_register_recv_cb(esp_now_recv_cb_t cb);
+    esp_err_t esp_now_unregister_recv_cb(void);
+    esp_err_t esp_now_register_send_cb(esp_now_send_cb_t cb);
+    esp_err_t esp_now_unregister_send_cb(void);
+    esp_err_t esp_now_send(const uint8_t *peer_addr, const uint8_t *data, size_t len);
+    esp_err_t esp_now_add_peer(const esp_now_peer_info_t *peer);
+    esp_err_t esp_now_del_peer(const uint8_t *peer_addr);
+    esp_err_t esp_now_mod_peer(const esp_now_peer_info_t *peer);
+    bool esp_now_is_peer_exist(const uint8_t *peer_addr);
+
+#ifdef __cplusplus
+}
+#endif
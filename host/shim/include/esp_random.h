@@ -0,0 +1,23 @@
+/**
+ * @file esp_random.h
+ *
+ * @brief Host shim of the ESP-IDF random number generator.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    /**
+     * @brief Get a pseudo random number. The sequence is reproducible, see zh_espnow_shim_set_seed().
+     */
+    uint32_t esp_random(void);
+
+#ifdef __cplusplus
+}
+#endif
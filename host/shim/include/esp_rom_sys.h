@@ -0,0 +1,23 @@
+/**
+ * @file esp_rom_sys.h
+ *
+ * @brief Host shim of the ESP-IDF ROM system functions.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    /**
+     * @brief Get the number of cycle counter ticks per microsecond, see esp_cpu_get_cycle_count().
+     */
+    uint32_t esp_rom_get_cpu_ticks_per_us(void);
+
+#ifdef __cplusplus
+}
+#endif
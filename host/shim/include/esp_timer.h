@@ -0,0 +1,23 @@
+/**
+ * @file esp_timer.h
+ *
+ * @brief Host shim of the ESP-IDF high resolution timer.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    /**
+     * @brief Get the time since the start of the shim in microseconds (monotonic clock).
+     */
+    int64_t esp_timer_get_time(void);
+
+#ifdef __cplusplus
+}
+#endif
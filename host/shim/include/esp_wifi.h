@@ -0,0 +1,51 @@
+/**
+ * @file esp_wifi.h
+ *
+ * @brief Host shim of the ESP-IDF Wi-Fi driver. Implemented by the simulated radio medium, see zh_espnow_sim.h.
+ */
+
+#pragma once
+
+#include "esp_err.h"
+#include "esp_event.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    typedef enum
+    {
+        WIFI_IF_STA,
+        WIFI_IF_AP,
+        WIFI_IF_NAN,
+        WIFI_IF_MAX
+    } wifi_interface_t;
+
+    typedef enum
+    {
+        WIFI_SECOND_CHAN_NONE,
+        WIFI_SECOND_CHAN_ABOVE,
+        WIFI_SECOND_CHAN_BELOW
+    } wifi_second_chan_t;
+
+#define WIFI_PROTOCOL_11B 0x1
+#define WIFI_PROTOCOL_11G 0x2
+#define WIFI_PROTOCOL_11N 0x4
+#define WIFI_PROTOCOL_LR 0x8
+
+    typedef struct
+    {
+        signed rssi : 8;      /*!< Received signal strength in dBm. */
+        unsigned rate : 5;    /*!< PHY rate index. */
+        unsigned channel : 4; /*!< Primary channel. */
+    } wifi_pkt_rx_ctrl_t;
+
+    esp_err_t esp_wifi_get_mac(wifi_interface_t ifx, uint8_t mac[6]);
+    esp_err_t esp_wifi_set_channel(uint8_t primary, wifi_second_chan_t second);
+    esp_err_t esp_wifi_get_channel(uint8_t *primary, wifi_second_chan_t *second);
+    esp_err_t esp_wifi_set_protocol(wifi_interface_t ifx, uint8_t protocol_bitmap);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,66 @@
+/**
+ * @file FreeRTOS.h
+ *
+ * @brief Host shim of the FreeRTOS kernel used by zh_espnow.
+ *
+ * Every task is a POSIX thread. Only one task runs at a time: a task holds the scheduler lock while it runs and gives
+ * it up only while blocked in a kernel call, like tasks on a single core without time slicing. Critical sections have
+ * nothing left to do.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_attr.h"
+#include "esp_idf_version.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    typedef int BaseType_t;
+    typedef unsigned int UBaseType_t;
+    typedef uint32_t TickType_t;
+    typedef uint32_t StackType_t;
+
+#define pdTRUE ((BaseType_t)1)
+#define pdFALSE ((BaseType_t)0)
+#define pdPASS pdTRUE
+#define pdFAIL pdFALSE
+
+#define configTICK_RATE_HZ 1000
+#define configMINIMAL_STACK_SIZE 768
+#define portMAX_DELAY ((TickType_t)0xffffffffUL)
+#define portTICK_PERIOD_MS ((TickType_t)1000 / configTICK_RATE_HZ)
+#define portNUM_PROCESSORS 1
+#define pdMS_TO_TICKS(ms) ((TickType_t)(((uint64_t)(ms) * configTICK_RATE_HZ) / 1000))
+#define pdTICKS_TO_MS(ticks) ((uint32_t)(((uint64_t)(ticks) * 1000) / configTICK_RATE_HZ))
+
+    typedef struct
+    {
+        uint32_t owner;
+        uint32_t count;
+    } portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED {.owner = 0, .count = 0}
+#define portMUX_INITIALIZE(mux) ((void)(mux))
+#define portENTER_CRITICAL(mux) ((void)(mux))
+#define portEXIT_CRITICAL(mux) ((void)(mux))
+#define portENTER_CRITICAL_ISR(mux) ((void)(mux))
+#define portEXIT_CRITICAL_ISR(mux) ((void)(mux))
+#define portENTER_CRITICAL_SAFE(mux) ((void)(mux))
+#define portEXIT_CRITICAL_SAFE(mux) ((void)(mux))
+#define portYIELD_FROM_ISR() ((void)0)
+
+    BaseType_t xPortGetCoreID(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
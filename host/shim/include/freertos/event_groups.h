@@ -0,0 +1,37 @@
+/**
+ * @file event_groups.h
+ *
+ * @brief Host shim of the FreeRTOS event group API, see FreeRTOS.h.
+ */
+
+#pragma once
+
+#include "freertos/FreeRTOS.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    typedef struct zh_espnow_shim_event_group *EventGroupHandle_t;
+    typedef uint32_t EventBits_t;
+
+#define BIT0 0x00000001
+#define BIT1 0x00000002
+#define BIT2 0x00000004
+#define BIT3 0x00000008
+#define BIT4 0x00000010
+#define BIT5 0x00000020
+#define BIT6 0x00000040
+#define BIT7 0x00000080
+
+    EventGroupHandle_t xEventGroupCreate(void);
+    void vEventGroupDelete(EventGroupHandle_t event_group);
+    EventBits_t xEventGroupSetBits(EventGroupHandle_t event_group, EventBits_t bits);
+    EventBits_t xEventGroupClearBits(EventGroupHandle_t event_group, EventBits_t bits);
+    EventBits_t xEventGroupGetBits(EventGroupHandle_t event_group);
+    EventBits_t xEventGroupWaitBits(EventGroupHandle_t event_group, EventBits_t bits, BaseType_t clear_on_exit, BaseType_t wait_for_all, TickType_t ticks);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,33 @@
+/**
+ * @file queue.h
+ *
+ * @brief Host shim of the FreeRTOS queue API, see FreeRTOS.h.
+ */
+
+#pragma once
+
+#include "freertos/FreeRTOS.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    typedef struct zh_espnow_shim_queue *QueueHandle_t;
+
+    QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size);
+    void vQueueDelete(QueueHandle_t queue);
+    BaseType_t xQueueSendToBack(QueueHandle_t queue, const void *item, TickType_t ticks);
+    BaseType_t xQueueSendToFront(QueueHandle_t queue, const void *item, TickType_t ticks);
+    BaseType_t xQueueSendFromISR(QueueHandle_t queue, const void *item, BaseType_t *higher_priority_task_woken);
+    BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t ticks);
+    BaseType_t xQueuePeek(QueueHandle_t queue, void *item, TickType_t ticks);
+    UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue);
+    UBaseType_t uxQueueSpacesAvailable(QueueHandle_t queue);
+
+#define xQueueSend(queue, item, ticks) xQueueSendToBack((queue), (item), (ticks))
+#define uxQueueMessagesWaitingFromISR(queue) uxQueueMessagesWaiting(queue)
+
+#ifdef __cplusplus
+}
+#endif
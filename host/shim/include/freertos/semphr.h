@@ -0,0 +1,26 @@
+/**
+ * @file semphr.h
+ *
+ * @brief Host shim of the FreeRTOS semaphore API, see FreeRTOS.h. Mutexes are not recursive.
+ */
+
+#pragma once
+
+#include "freertos/FreeRTOS.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    typedef struct zh_espnow_shim_semaphore *SemaphoreHandle_t;
+
+    SemaphoreHandle_t xSemaphoreCreateMutex(void);
+    SemaphoreHandle_t xSemaphoreCreateBinary(void);
+    void vSemaphoreDelete(SemaphoreHandle_t semaphore);
+    BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks);
+    BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,49 @@
+/**
+ * @file task.h
+ *
+ * @brief Host shim of the FreeRTOS task API, see FreeRTOS.h.
+ */
+
+#pragma once
+
+#include "freertos/FreeRTOS.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    typedef struct zh_espnow_shim_task *TaskHandle_t;
+    typedef void (*TaskFunction_t)(void *);
+
+#define tskNO_AFFINITY ((BaseType_t)0x7FFFFFFF)
+
+    /**
+     * @brief Create a task running on its own thread. Stack size, priority and core are ignored.
+     */
+    BaseType_t xTaskCreatePinnedToCore(TaskFunction_t task_code, const char *name, uint32_t stack_depth, void *parameters, UBaseType_t priority, TaskHandle_t *created_task, BaseType_t core_id);
+
+#define xTaskCreate(task_code, name, stack_depth, parameters, priority, created_task) \
+    xTaskCreatePinnedToCore((task_code), (name), (stack_depth), (parameters), (priority), (created_task), tskNO_AFFINITY)
+
+    /**
+     * @brief Delete a task. Another task is deleted the next time it is woken.
+     */
+    void vTaskDelete(TaskHandle_t task);
+    void vTaskDelay(TickType_t ticks);
+    void taskYIELD(void);
+    TickType_t xTaskGetTickCount(void);
+    TaskHandle_t xTaskGetCurrentTaskHandle(void);
+
+    /**
+     * @brief Get the stack high water mark. The host does not measure it and returns the requested stack depth.
+     */
+    UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task);
+
+    BaseType_t xTaskNotifyGive(TaskHandle_t task);
+    void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *higher_priority_task_woken);
+    uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,73 @@
+/**
+ * @file zh_espnow_shim.h
+ *
+ * @brief Host side controls of the platform shim that runs zh_espnow on Linux.
+ *
+ * The shim provides the parts of FreeRTOS, esp_event, esp_timer, the heap and the log that zh_espnow.c uses. The Wi-Fi
+ * and ESP-NOW drivers are provided by the simulated radio medium, see zh_espnow_sim.h.
+ */
+
+#pragma once
+
+#include <pthread.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    /**
+     * @brief Heap counters of the shim.
+     */
+    typedef struct
+    {
+        uint32_t allocs; /*!< Number of successful heap_caps_malloc() and heap_caps_calloc() calls. */
+        uint32_t frees;  /*!< Number of heap_caps_free() calls with a non NULL pointer. */
+        uint32_t in_use; /*!< Number of blocks allocated and not freed yet. */
+    } zh_espnow_shim_heap_stats_t;
+
+    /**
+     * @brief Turn the calling thread into the first task and take the scheduler lock.
+     *
+     * @note Must be called once before any other function of the shim or of zh_espnow.
+     */
+    void zh_espnow_shim_start(void);
+
+    /**
+     * @brief Set the seed of esp_random().
+     *
+     * @param[in] seed Seed, 0 is replaced by 1.
+     */
+    void zh_espnow_shim_set_seed(uint32_t seed);
+
+    /**
+     * @brief Get a copy of the heap counters.
+     *
+     * @param[out] stats Pointer to a structure receiving the counters.
+     */
+    void zh_espnow_shim_get_heap_stats(zh_espnow_shim_heap_stats_t *stats);
+
+    /**
+     * @brief Initialise a condition variable for zh_espnow_shim_wait_until().
+     *
+     * @param[out] cond Condition variable.
+     */
+    void zh_espnow_shim_cond_init(pthread_cond_t *cond);
+
+    /**
+     * @brief Block the calling task on a condition variable and let the other tasks run.
+     *
+     * Used by the parts of the shim and the simulator that run their own tasks.
+     *
+     * @param[in] cond Condition variable initialised with zh_espnow_shim_cond_init().
+     * @param[in] deadline_us Time in the scale of esp_timer_get_time() to give up waiting at, or -1 to wait forever.
+     *
+     * @return false if the deadline passed, true if the task was woken.
+     */
+    bool zh_espnow_shim_wait_until(pthread_cond_t *cond, int64_t deadline_us);
+
+#ifdef __cplusplus
+}
+#endif
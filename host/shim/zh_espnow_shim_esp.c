@@ -0,0 +1,291 @@
+#include "zh_espnow_shim.h"
+#include "esp_event.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_random.h"
+#include "esp_cpu.h"
+#include "esp_rom_sys.h"
+#include "esp_heap_caps.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define EVENT_QUEUE_SIZE 32
+#define EVENT_HANDLERS_MAX 16
+
+typedef struct _event_t
+{
+    struct _event_t *next; /*!< Next event in posting order. */
+    esp_event_base_t base; /*!< Event base. */
+    int32_t id;            /*!< Event identifier. */
+    size_t data_size;      /*!< Size of the copied event data. */
+    uint8_t data[];        /*!< Copy of the event data. */
+} _event_t;
+
+typedef struct
+{
+    esp_event_base_t base;       /*!< Event base or ESP_EVENT_ANY_BASE. */
+    int32_t id;                  /*!< Event identifier or ESP_EVENT_ANY_ID. */
+    esp_event_handler_t handler; /*!< Handler, NULL if the slot is free. */
+    void *arg;                   /*!< Argument of the handler. */
+} _handler_t;
+
+static void _zh_espnow_shim_event_task(void *pvParameter);
+
+static esp_log_level_t _log_level = ESP_LOG_INFO;
+static uint32_t _random_state = 1;
+static zh_espnow_shim_heap_stats_t _heap_stats = {0};
+static TaskHandle_t _event_task = NULL;
+static pthread_cond_t _event_cond;
+static _event_t *_event_head = NULL;
+static _event_t *_event_tail = NULL;
+static uint16_t _event_count = 0;
+static _handler_t _handlers[EVENT_HANDLERS_MAX] = {0};
+
+void zh_espnow_shim_set_seed(uint32_t seed)
+{
+    _random_state = (seed != 0) ? seed : 1;
+}
+
+void zh_espnow_shim_get_heap_stats(zh_espnow_shim_heap_stats_t *stats)
+{
+    *stats = _heap_stats;
+}
+
+const char *esp_err_to_name(esp_err_t code)
+{
+    switch (code)
+    {
+    case ESP_OK:
+        return "ESP_OK";
+    case ESP_FAIL:
+        return "ESP_FAIL";
+    case ESP_ERR_NO_MEM:
+        return "ESP_ERR_NO_MEM";
+    case ESP_ERR_INVALID_ARG:
+        return "ESP_ERR_INVALID_ARG";
+    case ESP_ERR_INVALID_STATE:
+        return "ESP_ERR_INVALID_STATE";
+    case ESP_ERR_INVALID_SIZE:
+        return "ESP_ERR_INVALID_SIZE";
+    case ESP_ERR_NOT_FOUND:
+        return "ESP_ERR_NOT_FOUND";
+    case ESP_ERR_NOT_SUPPORTED:
+        return "ESP_ERR_NOT_SUPPORTED";
+    case ESP_ERR_TIMEOUT:
+        return "ESP_ERR_TIMEOUT";
+    case ESP_ERR_INVALID_RESPONSE:
+        return "ESP_ERR_INVALID_RESPONSE";
+    case ESP_ERR_WIFI_NOT_INIT:
+        return "ESP_ERR_WIFI_NOT_INIT";
+    default:
+        return "UNKNOWN ERROR";
+    }
+}
+
+void esp_log_level_set(const char *tag, esp_log_level_t level)
+{
+    _log_level = level;
+}
+
+void esp_log_write(esp_log_level_t level, const char *tag, const char *format, ...)
+{
+    if (level > _log_level)
+    {
+        return;
+    }
+    static const char letters[] = {'N', 'E', 'W', 'I', 'D', 'V'};
+    fprintf(stderr, "%c (%lld) %s: ", letters[level], (long long)(esp_timer_get_time() / 1000), tag);
+    va_list args;
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+    fputc('\n', stderr);
+}
+
+uint32_t esp_random(void)
+{
+    // xorshift32, reproducible for a given seed.
+    _random_state ^= _random_state << 13;
+    _random_state ^= _random_state >> 17;
+    _random_state ^= _random_state << 5;
+    return _random_state;
+}
+
+esp_cpu_cycle_count_t esp_cpu_get_cycle_count(void)
+{
+    return (esp_cpu_cycle_count_t)(esp_timer_get_time() * 1000);
+}
+
+uint32_t esp_rom_get_cpu_ticks_per_us(void)
+{
+    return 1000;
+}
+
+void *heap_caps_malloc(size_t size, uint32_t caps)
+{
+    void *ptr = malloc(size);
+    if (ptr != NULL)
+    {
+        ++_heap_stats.allocs;
+        ++_heap_stats.in_use;
+    }
+    return ptr;
+}
+
+void *heap_caps_calloc(size_t n, size_t size, uint32_t caps)
+{
+    void *ptr = calloc(n, size);
+    if (ptr != NULL)
+    {
+        ++_heap_stats.allocs;
+        ++_heap_stats.in_use;
+    }
+    return ptr;
+}
+
+void heap_caps_free(void *ptr)
+{
+    if (ptr != NULL)
+    {
+        ++_heap_stats.frees;
+        --_heap_stats.in_use;
+    }
+    free(ptr);
+}
+
+esp_err_t esp_event_loop_create_default(void)
+{
+    if (_event_task != NULL)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    zh_espnow_shim_cond_init(&_event_cond);
+    if (xTaskCreatePinnedToCore(&_zh_espnow_shim_event_task, "sys_evt", 2304, NULL, 20, &_event_task, tskNO_AFFINITY) != pdPASS)
+    {
+        pthread_cond_destroy(&_event_cond);
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_event_loop_delete_default(void)
+{
+    if (_event_task == NULL)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    vTaskDelete(_event_task);
+    _event_task = NULL;
+    while (_event_head != NULL)
+    {
+        _event_t *event = _event_head;
+        _event_head = event->next;
+        free(event);
+    }
+    _event_tail = NULL;
+    _event_count = 0;
+    memset(_handlers, 0, sizeof(_handlers));
+    return ESP_OK;
+}
+
+esp_err_t esp_event_handler_register(esp_event_base_t event_base, int32_t event_id, esp_event_handler_t event_handler, void *event_handler_arg)
+{
+    if (event_handler == NULL)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    for (uint8_t i = 0; i < EVENT_HANDLERS_MAX; ++i)
+    {
+        if (_handlers[i].handler == NULL)
+        {
+            _handlers[i] = (_handler_t){.base = event_base, .id = event_id, .handler = event_handler, .arg = event_handler_arg};
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NO_MEM;
+}
+
+esp_err_t esp_event_handler_unregister(esp_event_base_t event_base, int32_t event_id, esp_event_handler_t event_handler)
+{
+    for (uint8_t i = 0; i < EVENT_HANDLERS_MAX; ++i)
+    {
+        if (_handlers[i].handler == event_handler && _handlers[i].base == event_base && _handlers[i].id == event_id)
+        {
+            _handlers[i] = (_handler_t){0};
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NOT_FOUND;
+}
+
+esp_err_t esp_event_post(esp_event_base_t event_base, int32_t event_id, const void *event_data, size_t event_data_size, TickType_t ticks_to_wait)
+{
+    if (_event_task == NULL)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    int64_t deadline = (ticks_to_wait == portMAX_DELAY) ? -1 : esp_timer_get_time() + (int64_t)ticks_to_wait * (1000000 / configTICK_RATE_HZ);
+    while (_event_count >= EVENT_QUEUE_SIZE)
+    {
+        if (ticks_to_wait == 0 || zh_espnow_shim_wait_until(&_event_cond, deadline) == false)
+        {
+            if (_event_count >= EVENT_QUEUE_SIZE)
+            {
+                return ESP_ERR_TIMEOUT;
+            }
+        }
+    }
+    // The copy is made by the event loop and not counted by the heap counters, like the allocations inside ESP-IDF.
+    _event_t *event = malloc(sizeof(_event_t) + event_data_size);
+    if (event == NULL)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    *event = (_event_t){.base = event_base, .id = event_id, .data_size = event_data_size};
+    if (event_data_size > 0)
+    {
+        memcpy(event->data, event_data, event_data_size);
+    }
+    if (_event_tail != NULL)
+    {
+        _event_tail->next = event;
+    }
+    else
+    {
+        _event_head = event;
+    }
+    _event_tail = event;
+    ++_event_count;
+    pthread_cond_broadcast(&_event_cond);
+    return ESP_OK;
+}
+
+static void _zh_espnow_shim_event_task(void *pvParameter)
+{
+    for (;;)
+    {
+        while (_event_head == NULL)
+        {
+            zh_espnow_shim_wait_until(&_event_cond, -1);
+        }
+        _event_t *event = _event_head;
+        _event_head = event->next;
+        if (_event_head == NULL)
+        {
+            _event_tail = NULL;
+        }
+        --_event_count;
+        pthread_cond_broadcast(&_event_cond);
+        for (uint8_t i = 0; i < EVENT_HANDLERS_MAX; ++i)
+        {
+            const _handler_t handler = _handlers[i];
+            if (handler.handler != NULL && (handler.base == ESP_EVENT_ANY_BASE || handler.base == event->base) && (handler.id == ESP_EVENT_ANY_ID || handler.id == event->id))
+            {
+                handler.handler(handler.arg, event->base, event->id, (event->data_size > 0) ? event->data : NULL);
+            }
+        }
+        free(event);
+    }
+}
@@ -0,0 +1,468 @@
+#include "zh_espnow_shim.h"
+#include "freertos/event_groups.h"
+#include "esp_timer.h"
+#include <errno.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+struct zh_espnow_shim_task
+{
+    pthread_t thread;           /*!< Thread running the task. */
+    TaskFunction_t function;    /*!< Task function. */
+    void *parameters;           /*!< Argument of the task function. */
+    uint32_t stack_depth;       /*!< Requested stack depth, reported as the stack high water mark. */
+    uint32_t notify;            /*!< Notification value. */
+    pthread_cond_t cond;        /*!< Condition variable for notifications and delays. */
+    pthread_cond_t *waiting_on; /*!< Condition variable the task is blocked on, NULL if running or ready. */
+    bool is_deleted;            /*!< The task was deleted by another task and exits when it is woken. */
+};
+
+struct zh_espnow_shim_queue
+{
+    uint8_t *items;        /*!< Storage of the items. */
+    UBaseType_t length;    /*!< Maximum number of items. */
+    UBaseType_t item_size; /*!< Size of an item in bytes. */
+    UBaseType_t head;      /*!< Index of the oldest item. */
+    UBaseType_t count;     /*!< Number of items in the queue. */
+    pthread_cond_t cond;   /*!< Signalled on every change of `count`. */
+};
+
+struct zh_espnow_shim_semaphore
+{
+    UBaseType_t count;   /*!< Number of available tokens. */
+    pthread_cond_t cond; /*!< Signalled when a token is given. */
+};
+
+struct zh_espnow_shim_event_group
+{
+    EventBits_t bits;    /*!< Current bits. */
+    pthread_cond_t cond; /*!< Signalled when bits are set. */
+};
+
+static void *_zh_espnow_shim_task_entry(void *arg);
+static struct zh_espnow_shim_task *_zh_espnow_shim_task_create(void);
+static void _zh_espnow_shim_task_exit(struct zh_espnow_shim_task *task);
+static int64_t _zh_espnow_shim_deadline(TickType_t ticks);
+static bool _zh_espnow_shim_queue_put(QueueHandle_t queue, const void *item, bool to_front, TickType_t ticks);
+static bool _zh_espnow_shim_queue_get(QueueHandle_t queue, void *item, bool is_peek, TickType_t ticks);
+
+static pthread_mutex_t _scheduler_lock = PTHREAD_MUTEX_INITIALIZER;
+static __thread struct zh_espnow_shim_task *_current_task = NULL;
+static struct timespec _epoch = {0};
+
+void zh_espnow_shim_start(void)
+{
+    clock_gettime(CLOCK_MONOTONIC, &_epoch);
+    pthread_mutex_lock(&_scheduler_lock);
+    _current_task = _zh_espnow_shim_task_create();
+    _current_task->thread = pthread_self();
+}
+
+void zh_espnow_shim_cond_init(pthread_cond_t *cond)
+{
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(cond, &attr);
+    pthread_condattr_destroy(&attr);
+}
+
+bool zh_espnow_shim_wait_until(pthread_cond_t *cond, int64_t deadline_us)
+{
+    struct zh_espnow_shim_task *self = _current_task;
+    int err = 0;
+    self->waiting_on = cond;
+    if (deadline_us < 0)
+    {
+        err = pthread_cond_wait(cond, &_scheduler_lock);
+    }
+    else
+    {
+        int64_t absolute_us = (int64_t)_epoch.tv_sec * 1000000 + _epoch.tv_nsec / 1000 + deadline_us;
+        struct timespec deadline = {.tv_sec = absolute_us / 1000000, .tv_nsec = (absolute_us % 1000000) * 1000};
+        err = pthread_cond_timedwait(cond, &_scheduler_lock, &deadline);
+    }
+    self->waiting_on = NULL;
+    if (self->is_deleted == true)
+    {
+        _zh_espnow_shim_task_exit(self);
+    }
+    return err != ETIMEDOUT;
+}
+
+int64_t esp_timer_get_time(void)
+{
+    struct timespec now = {0};
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)(now.tv_sec - _epoch.tv_sec) * 1000000 + (now.tv_nsec - _epoch.tv_nsec) / 1000;
+}
+
+BaseType_t xPortGetCoreID(void)
+{
+    return 0;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t task_code, const char *name, uint32_t stack_depth, void *parameters, UBaseType_t priority, TaskHandle_t *created_task, BaseType_t core_id)
+{
+    struct zh_espnow_shim_task *task = _zh_espnow_shim_task_create();
+    if (task == NULL)
+    {
+        return pdFAIL;
+    }
+    task->function = task_code;
+    task->parameters = parameters;
+    task->stack_depth = stack_depth;
+    if (pthread_create(&task->thread, NULL, &_zh_espnow_shim_task_entry, task) != 0)
+    {
+        pthread_cond_destroy(&task->cond);
+        free(task);
+        return pdFAIL;
+    }
+    pthread_detach(task->thread);
+    if (created_task != NULL)
+    {
+        *created_task = task;
+    }
+    return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t task)
+{
+    if (task == NULL || task == _current_task)
+    {
+        _zh_espnow_shim_task_exit(_current_task);
+    }
+    // The task is blocked or waits for the scheduler lock, it exits as soon as it runs again.
+    task->is_deleted = true;
+    if (task->waiting_on != NULL)
+    {
+        pthread_cond_broadcast(task->waiting_on);
+    }
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    int64_t deadline = _zh_espnow_shim_deadline(ticks);
+    while (zh_espnow_shim_wait_until(&_current_task->cond, deadline) == true)
+    {
+        // Woken by a notification, keep sleeping.
+    }
+}
+
+void taskYIELD(void)
+{
+    pthread_mutex_unlock(&_scheduler_lock);
+    sched_yield();
+    pthread_mutex_lock(&_scheduler_lock);
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    return (TickType_t)(esp_timer_get_time() / (1000000 / configTICK_RATE_HZ));
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    return _current_task;
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task)
+{
+    return (task != NULL) ? task->stack_depth : _current_task->stack_depth;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+    ++task->notify;
+    pthread_cond_broadcast(&task->cond);
+    return pdPASS;
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *higher_priority_task_woken)
+{
+    xTaskNotifyGive(task);
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks)
+{
+    struct zh_espnow_shim_task *self = _current_task;
+    int64_t deadline = _zh_espnow_shim_deadline(ticks);
+    while (self->notify == 0 && ticks != 0)
+    {
+        if (zh_espnow_shim_wait_until(&self->cond, deadline) == false)
+        {
+            break;
+        }
+    }
+    uint32_t value = self->notify;
+    if (value != 0)
+    {
+        self->notify = (clear_on_exit == pdTRUE) ? 0 : value - 1;
+    }
+    return value;
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size)
+{
+    QueueHandle_t queue = calloc(1, sizeof(struct zh_espnow_shim_queue));
+    if (queue == NULL)
+    {
+        return NULL;
+    }
+    queue->items = calloc(length, (item_size > 0) ? item_size : 1);
+    if (queue->items == NULL)
+    {
+        free(queue);
+        return NULL;
+    }
+    queue->length = length;
+    queue->item_size = item_size;
+    zh_espnow_shim_cond_init(&queue->cond);
+    return queue;
+}
+
+void vQueueDelete(QueueHandle_t queue)
+{
+    pthread_cond_destroy(&queue->cond);
+    free(queue->items);
+    free(queue);
+}
+
+BaseType_t xQueueSendToBack(QueueHandle_t queue, const void *item, TickType_t ticks)
+{
+    return (_zh_espnow_shim_queue_put(queue, item, false, ticks) == true) ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xQueueSendToFront(QueueHandle_t queue, const void *item, TickType_t ticks)
+{
+    return (_zh_espnow_shim_queue_put(queue, item, true, ticks) == true) ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xQueueSendFromISR(QueueHandle_t queue, const void *item, BaseType_t *higher_priority_task_woken)
+{
+    return (_zh_espnow_shim_queue_put(queue, item, false, 0) == true) ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t ticks)
+{
+    return (_zh_espnow_shim_queue_get(queue, item, false, ticks) == true) ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xQueuePeek(QueueHandle_t queue, void *item, TickType_t ticks)
+{
+    return (_zh_espnow_shim_queue_get(queue, item, true, ticks) == true) ? pdTRUE : pdFALSE;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue)
+{
+    return queue->count;
+}
+
+UBaseType_t uxQueueSpacesAvailable(QueueHandle_t queue)
+{
+    return queue->length - queue->count;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+    SemaphoreHandle_t semaphore = xSemaphoreCreateBinary();
+    if (semaphore != NULL)
+    {
+        semaphore->count = 1;
+    }
+    return semaphore;
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void)
+{
+    SemaphoreHandle_t semaphore = calloc(1, sizeof(struct zh_espnow_shim_semaphore));
+    if (semaphore != NULL)
+    {
+        zh_espnow_shim_cond_init(&semaphore->cond);
+    }
+    return semaphore;
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t semaphore)
+{
+    pthread_cond_destroy(&semaphore->cond);
+    free(semaphore);
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks)
+{
+    int64_t deadline = _zh_espnow_shim_deadline(ticks);
+    while (semaphore->count == 0)
+    {
+        if (ticks == 0 || zh_espnow_shim_wait_until(&semaphore->cond, deadline) == false)
+        {
+            if (semaphore->count == 0)
+            {
+                return pdFALSE;
+            }
+        }
+    }
+    --semaphore->count;
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore)
+{
+    if (semaphore->count != 0)
+    {
+        return pdFALSE;
+    }
+    semaphore->count = 1;
+    pthread_cond_broadcast(&semaphore->cond);
+    return pdTRUE;
+}
+
+EventGroupHandle_t xEventGroupCreate(void)
+{
+    EventGroupHandle_t event_group = calloc(1, sizeof(struct zh_espnow_shim_event_group));
+    if (event_group != NULL)
+    {
+        zh_espnow_shim_cond_init(&event_group->cond);
+    }
+    return event_group;
+}
+
+void vEventGroupDelete(EventGroupHandle_t event_group)
+{
+    pthread_cond_destroy(&event_group->cond);
+    free(event_group);
+}
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t event_group, EventBits_t bits)
+{
+    event_group->bits |= bits;
+    pthread_cond_broadcast(&event_group->cond);
+    return event_group->bits;
+}
+
+EventBits_t xEventGroupClearBits(EventGroupHandle_t event_group, EventBits_t bits)
+{
+    EventBits_t previous = event_group->bits;
+    event_group->bits &= ~bits;
+    return previous;
+}
+
+EventBits_t xEventGroupGetBits(EventGroupHandle_t event_group)
+{
+    return event_group->bits;
+}
+
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t event_group, EventBits_t bits, BaseType_t clear_on_exit, BaseType_t wait_for_all, TickType_t ticks)
+{
+    int64_t deadline = _zh_espnow_shim_deadline(ticks);
+    for (;;)
+    {
+        EventBits_t current = event_group->bits;
+        bool is_set = (wait_for_all == pdTRUE) ? ((current & bits) == bits) : ((current & bits) != 0);
+        if (is_set == true)
+        {
+            if (clear_on_exit == pdTRUE)
+            {
+                event_group->bits &= ~bits;
+            }
+            return current;
+        }
+        if (ticks == 0 || zh_espnow_shim_wait_until(&event_group->cond, deadline) == false)
+        {
+            // One more look, the bits may have been set together with the timeout.
+            ticks = 0;
+        }
+    }
+}
+
+static void *_zh_espnow_shim_task_entry(void *arg)
+{
+    struct zh_espnow_shim_task *task = arg;
+    pthread_mutex_lock(&_scheduler_lock);
+    _current_task = task;
+    if (task->is_deleted == false)
+    {
+        task->function(task->parameters);
+    }
+    _zh_espnow_shim_task_exit(task);
+    return NULL;
+}
+
+static struct zh_espnow_shim_task *_zh_espnow_shim_task_create(void)
+{
+    struct zh_espnow_shim_task *task = calloc(1, sizeof(struct zh_espnow_shim_task));
+    if (task != NULL)
+    {
+        zh_espnow_shim_cond_init(&task->cond);
+    }
+    return task;
+}
+
+static void _zh_espnow_shim_task_exit(struct zh_espnow_shim_task *task)
+{
+    // Nothing refers to the task any more once it runs again, the handle is invalid after vTaskDelete() like on FreeRTOS.
+    pthread_cond_destroy(&task->cond);
+    free(task);
+    _current_task = NULL;
+    pthread_mutex_unlock(&_scheduler_lock);
+    pthread_exit(NULL);
+}
+
+static int64_t _zh_espnow_shim_deadline(TickType_t ticks)
+{
+    return (ticks == portMAX_DELAY) ? -1 : esp_timer_get_time() + (int64_t)ticks * (1000000 / configTICK_RATE_HZ);
+}
+
+static bool _zh_espnow_shim_queue_put(QueueHandle_t queue, const void *item, bool to_front, TickType_t ticks)
+{
+    int64_t deadline = _zh_espnow_shim_deadline(ticks);
+    while (queue->count == queue->length)
+    {
+        if (ticks == 0 || zh_espnow_shim_wait_until(&queue->cond, deadline) == false)
+        {
+            if (queue->count == queue->length)
+            {
+                return false;
+            }
+        }
+    }
+    UBaseType_t index = 0;
+    if (to_front == true)
+    {
+        queue->head = (queue->head + queue->length - 1) % queue->length;
+        index = queue->head;
+    }
+    else
+    {
+        index = (queue->head + queue->count) % queue->length;
+    }
+    memcpy(queue->items + index * queue->item_size, item, queue->item_size);
+    ++queue->count;
+    pthread_cond_broadcast(&queue->cond);
+    return true;
+}
+
+static bool _zh_espnow_shim_queue_get(QueueHandle_t queue, void *item, bool is_peek, TickType_t ticks)
+{
+    int64_t deadline = _zh_espnow_shim_deadline(ticks);
+    while (queue->count == 0)
+    {
+        if (ticks == 0 || zh_espnow_shim_wait_until(&queue->cond, deadline) == false)
+        {
+            if (queue->count == 0)
+            {
+                return false;
+            }
+        }
+    }
+    memcpy(item, queue->items + queue->head * queue->item_size, queue->item_size);
+    if (is_peek == false)
+    {
+        queue->head = (queue->head + 1) % queue->length;
+        --queue->count;
+        pthread_cond_broadcast(&queue->cond);
+    }
+    return true;
+}
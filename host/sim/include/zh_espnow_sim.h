@@ -0,0 +1,172 @@
+/**
+ * @file zh_espnow_sim.h
+ *
+ * @brief Simulated radio medium for the host build of zh_espnow.
+ *
+ * The medium implements the ESP-NOW and Wi-Fi driver calls of the host shim. Node 0 is the node running zh_espnow,
+ * nodes 1 to `nodes` are simulated peers that acknowledge unicast frames addressed to them and can send frames to
+ * node 0 through zh_espnow_sim_inject().
+ *
+ * All frames share one channel: a frame starts when the previous one and its acknowledgement are over. A unicast frame
+ * is lost with the loss probability of the link of its peer; the driver then reports ESP_NOW_SEND_FAIL after
+ * `ack_timeout_us`. Frames to addresses that are not a simulated node are never acknowledged. The send callback runs
+ * on the task of the medium, like on the Wi-Fi task of ESP-IDF.
+ */
+
+#pragma once
+
+#include "esp_err.h"
+#include "esp_now.h"
+
+/**
+ * @brief Maximum number of simulated peer nodes.
+ */
+#define ZH_ESPNOW_SIM_NODES_MAX 32
+
+/**
+ * @brief Default configuration of the simulated medium: 1 Mbps, no loss.
+ *
+ * @code
+ * zh_espnow_sim_config_t config = ZH_ESPNOW_SIM_CONFIG_DEFAULT();
+ * @endcode
+ */
+#define ZH_ESPNOW_SIM_CONFIG_DEFAULT() \
+    {                                  \
+        .nodes = 1,                    \
+        .loss_percent = 0,             \
+        .bitrate_kbps = 1000,          \
+        .frame_overhead_us = 300,      \
+        .ack_delay_us = 314,           \
+        .ack_timeout_us = 1000,        \
+        .driver_queue_size = 8,        \
+        .version = 2,                  \
+        .seed = 1}
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    /**
+     * @brief Configuration of the simulated medium.
+     */
+    typedef struct
+    {
+        uint8_t nodes;              /*!< Number of simulated peer nodes besides node 0. @note Values from 1 to ZH_ESPNOW_SIM_NODES_MAX. */
+        uint8_t loss_percent;       /*!< Probability (in percent) that a frame or its acknowledgement is lost, for every link. See zh_espnow_sim_set_loss(). */
+        uint32_t bitrate_kbps;      /*!< PHY rate used for the airtime of a frame. */
+        uint32_t frame_overhead_us; /*!< Airtime of a frame besides its bytes: preamble, interframe space and average backoff. */
+        uint32_t ack_delay_us;      /*!< Time from the end of a received unicast frame until its acknowledgement has been sent. */
+        uint32_t ack_timeout_us;    /*!< Time from the end of an unacknowledged unicast frame until the driver reports the failure. */
+        uint8_t driver_queue_size;  /*!< Number of frames the driver holds before esp_now_send() returns ESP_ERR_ESPNOW_NO_MEM. */
+        uint8_t version;            /*!< Version returned by esp_now_get_version(). Version 2 allows frames of ESP_NOW_MAX_DATA_LEN_V2 bytes. */
+        uint32_t seed;              /*!< Seed of the loss decisions. The same seed gives the same sequence of losses. */
+    } zh_espnow_sim_config_t;
+
+    /**
+     * @brief Counters of the simulated medium.
+     */
+    typedef struct
+    {
+        uint32_t tx_frames;                              /*!< Number of frames of node 0 put on the air. */
+        uint32_t tx_lost;                                /*!< Number of unicast frames of node 0 not acknowledged. */
+        uint32_t tx_rejected;                            /*!< Number of esp_now_send() calls rejected because the driver queue was full. */
+        uint32_t rx_frames;                              /*!< Number of frames of the simulated nodes delivered to node 0. */
+        uint32_t rx_lost;                                /*!< Number of frames of the simulated nodes lost on the air. */
+        uint64_t airtime_us;                             /*!< Total time the channel was busy. */
+        uint32_t node_received[ZH_ESPNOW_SIM_NODES_MAX]; /*!< Number of frames received by every simulated node, index 0 is node 1. */
+    } zh_espnow_sim_stats_t;
+
+    /**
+     * @brief Callback receiving a unicast frame of node 0 acknowledged by a simulated node.
+     *
+     * Runs on the task of the medium after the send callback of the frame. It may call zh_espnow_sim_inject(), for
+     * example to send the frame back to node 0.
+     *
+     * @param[in] node Simulated node number.
+     * @param[in] data Frame payload as passed to esp_now_send().
+     * @param[in] data_len Length of the payload.
+     * @param[in] arg Argument passed to zh_espnow_sim_register_node_recv_cb().
+     */
+    typedef void (*zh_espnow_sim_node_recv_cb_t)(uint8_t node, const uint8_t *data, uint16_t data_len, void *arg);
+
+    /**
+     * @brief Start the simulated medium and its task.
+     *
+     * @note Call after zh_espnow_shim_start() and before zh_espnow_init().
+     *
+     * @param[in] config Pointer to the configuration.
+     *
+     * @return ESP_OK on success.
+     * @return ESP_ERR_INVALID_ARG if the configuration is invalid.
+     * @return ESP_ERR_INVALID_STATE if the medium is already running.
+     * @return ESP_ERR_NO_MEM if the task could not be created.
+     */
+    esp_err_t zh_espnow_sim_init(const zh_espnow_sim_config_t *config);
+
+    /**
+     * @brief Stop the simulated medium. Frames still on the air are dropped without a send callback.
+     *
+     * @note Call after zh_espnow_deinit().
+     */
+    void zh_espnow_sim_deinit(void);
+
+    /**
+     * @brief Get the MAC address of a node.
+     *
+     * @param[in] node Node number, 0 for the node running zh_espnow.
+     * @param[out] mac_addr Buffer of ESP_NOW_ETH_ALEN bytes.
+     */
+    void zh_espnow_sim_node_mac(uint8_t node, uint8_t *mac_addr);
+
+    /**
+     * @brief Set the loss probability of the link between node 0 and a simulated node.
+     *
+     * @param[in] node Simulated node number.
+     * @param[in] loss_percent Probability (in percent) that a frame or its acknowledgement is lost.
+     *
+     * @return ESP_OK on success.
+     * @return ESP_ERR_INVALID_ARG if the node or the probability is invalid.
+     */
+    esp_err_t zh_espnow_sim_set_loss(uint8_t node, uint8_t loss_percent);
+
+    /**
+     * @brief Send a frame from a simulated node to node 0.
+     *
+     * The frame is put on the channel behind the frames already on it and passed to the receive callback of the driver
+     * when it is over.
+     *
+     * @param[in] node Simulated node number.
+     * @param[in] des_addr Destination address, NULL for the station address of node 0.
+     * @param[in] data Frame payload.
+     * @param[in] data_len Length of the payload.
+     *
+     * @return ESP_OK on success.
+     * @return ESP_ERR_INVALID_ARG if an argument is invalid.
+     * @return ESP_ERR_INVALID_STATE if the medium is not running.
+     */
+    esp_err_t zh_espnow_sim_inject(uint8_t node, const uint8_t *des_addr, const uint8_t *data, uint16_t data_len);
+
+    /**
+     * @brief Register the callback receiving the frames acknowledged by the simulated nodes.
+     *
+     * @param[in] cb Callback, NULL to remove it.
+     * @param[in] arg Argument passed to the callback.
+     */
+    void zh_espnow_sim_register_node_recv_cb(zh_espnow_sim_node_recv_cb_t cb, void *arg);
+
+    /**
+     * @brief Get a copy of the counters.
+     *
+     * @param[out] stats Pointer to a structure receiving the counters.
+     */
+    void zh_espnow_sim_get_stats(zh_espnow_sim_stats_t *stats);
+
+    /**
+     * @brief Reset the counters.
+     */
+    void zh_espnow_sim_reset_stats(void);
+
+#ifdef __cplusplus
+}
+#endif
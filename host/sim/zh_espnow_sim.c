@@ -0,0 +1,520 @@
+#include "zh_espnow_sim.h"
+#include "zh_espnow_shim.h"
+#include "esp_timer.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define FRAME_HEADER_SIZE 43 // MAC header, vendor specific action header and FCS of an ESP-NOW frame.
+#define RSSI_BASE -40
+
+typedef enum
+{
+    FRAME_TX, // Frame of node 0, completed by the send callback.
+    FRAME_RX  // Frame of a simulated node, completed by the receive callback.
+} _frame_kind_t;
+
+typedef struct _frame_t
+{
+    struct _frame_t *next;              /*!< Next frame on the channel. */
+    int64_t done_at;                    /*!< Time the frame is completed at. */
+    _frame_kind_t kind;                 /*!< Direction of the frame. */
+    uint8_t node;                       /*!< Simulated node the frame is from or for, 0 for a broadcast of node 0 or an unknown address. */
+    uint8_t src_addr[ESP_NOW_ETH_ALEN]; /*!< Source address. */
+    uint8_t des_addr[ESP_NOW_ETH_ALEN]; /*!< Destination address. */
+    wifi_interface_t ifidx;             /*!< Interface of node 0 the frame belongs to. */
+    esp_now_send_status_t status;       /*!< Outcome of a frame of node 0. */
+    bool is_lost;                       /*!< A frame of a simulated node is lost. */
+    uint16_t data_len;                  /*!< Length of the payload. */
+    uint8_t data[];                     /*!< Payload of the frame. */
+} _frame_t;
+
+static void _zh_espnow_sim_task(void *pvParameter);
+static int64_t _zh_espnow_sim_airtime(uint16_t data_len);
+static bool _zh_espnow_sim_is_lost(uint8_t node);
+static uint8_t _zh_espnow_sim_node_find(const uint8_t *mac_addr);
+static esp_now_peer_info_t *_zh_espnow_sim_peer_find(const uint8_t *mac_addr);
+static void _zh_espnow_sim_frame_put(_frame_t *frame);
+static void _zh_espnow_sim_frames_drop(void);
+
+static const uint8_t _broadcast_mac[ESP_NOW_ETH_ALEN] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+
+static zh_espnow_sim_config_t _config = {0};
+static bool _is_running = false;
+static TaskHandle_t _task = NULL;
+static pthread_cond_t _cond;
+static uint32_t _random_state = 1;
+static uint8_t _loss_percent[ZH_ESPNOW_SIM_NODES_MAX + 1] = {0};
+static uint8_t _channel = 1;
+static int64_t _channel_free_at = 0;
+static _frame_t *_frames_head = NULL;
+static _frame_t *_frames_tail = NULL;
+static uint8_t _frames_tx_num = 0;
+static zh_espnow_sim_stats_t _stats = {0};
+static zh_espnow_sim_node_recv_cb_t _node_recv_cb = NULL;
+static void *_node_recv_cb_arg = NULL;
+
+static bool _is_espnow_init = false;
+static esp_now_send_cb_t _send_cb = NULL;
+static esp_now_recv_cb_t _recv_cb = NULL;
+static esp_now_peer_info_t _peers[ESP_NOW_MAX_TOTAL_PEER_NUM] = {0};
+static bool _peers_used[ESP_NOW_MAX_TOTAL_PEER_NUM] = {0};
+
+esp_err_t zh_espnow_sim_init(const zh_espnow_sim_config_t *config)
+{
+    if (config == NULL || config->nodes == 0 || config->nodes > ZH_ESPNOW_SIM_NODES_MAX || config->loss_percent > 100 || config->bitrate_kbps == 0 ||
+        config->driver_queue_size == 0 || config->version == 0)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (_is_running == true)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    _config = *config;
+    _random_state = (config->seed != 0) ? config->seed : 1;
+    memset(_loss_percent, config->loss_percent, sizeof(_loss_percent));
+    _channel_free_at = 0;
+    _stats = (zh_espnow_sim_stats_t){0};
+    zh_espnow_shim_cond_init(&_cond);
+    if (xTaskCreatePinnedToCore(&_zh_espnow_sim_task, "wifi", 3584, NULL, 23, &_task, tskNO_AFFINITY) != pdPASS)
+    {
+        pthread_cond_destroy(&_cond);
+        return ESP_ERR_NO_MEM;
+    }
+    _is_running = true;
+    return ESP_OK;
+}
+
+void zh_espnow_sim_deinit(void)
+{
+    if (_is_running == false)
+    {
+        return;
+    }
+    vTaskDelete(_task);
+    _task = NULL;
+    _zh_espnow_sim_frames_drop();
+    pthread_cond_destroy(&_cond);
+    _is_running = false;
+}
+
+void zh_espnow_sim_node_mac(uint8_t node, uint8_t *mac_addr)
+{
+    const uint8_t mac[ESP_NOW_ETH_ALEN] = {0x02, 0x5A, 0x48, 0x00, 0x00, node};
+    memcpy(mac_addr, mac, ESP_NOW_ETH_ALEN);
+}
+
+esp_err_t zh_espnow_sim_set_loss(uint8_t node, uint8_t loss_percent)
+{
+    if (node == 0 || node > _config.nodes || loss_percent > 100)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    _loss_percent[node] = loss_percent;
+    return ESP_OK;
+}
+
+esp_err_t zh_espnow_sim_inject(uint8_t node, const uint8_t *des_addr, const uint8_t *data, uint16_t data_len)
+{
+    if (_is_running == false)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (node == 0 || node > _config.nodes || data == NULL || data_len == 0 || data_len > ((_config.version >= 2) ? ESP_NOW_MAX_DATA_LEN_V2 : ESP_NOW_MAX_DATA_LEN))
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    _frame_t *frame = calloc(1, sizeof(_frame_t) + data_len);
+    if (frame == NULL)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    frame->kind = FRAME_RX;
+    frame->node = node;
+    zh_espnow_sim_node_mac(node, frame->src_addr);
+    if (des_addr != NULL)
+    {
+        memcpy(frame->des_addr, des_addr, ESP_NOW_ETH_ALEN);
+    }
+    else
+    {
+        esp_wifi_get_mac(WIFI_IF_STA, frame->des_addr);
+    }
+    frame->is_lost = _zh_espnow_sim_is_lost(node);
+    frame->data_len = data_len;
+    memcpy(frame->data, data, data_len);
+    int64_t start = (_channel_free_at > esp_timer_get_time()) ? _channel_free_at : esp_timer_get_time();
+    frame->done_at = start + _zh_espnow_sim_airtime(data_len);
+    bool is_acked = (frame->is_lost == false && memcmp(frame->des_addr, _broadcast_mac, ESP_NOW_ETH_ALEN) != 0);
+    _channel_free_at = frame->done_at + ((is_acked == true) ? _config.ack_delay_us : 0);
+    _stats.airtime_us += _channel_free_at - start;
+    _zh_espnow_sim_frame_put(frame);
+    return ESP_OK;
+}
+
+void zh_espnow_sim_register_node_recv_cb(zh_espnow_sim_node_recv_cb_t cb, void *arg)
+{
+    _node_recv_cb = cb;
+    _node_recv_cb_arg = arg;
+}
+
+void zh_espnow_sim_get_stats(zh_espnow_sim_stats_t *stats)
+{
+    *stats = _stats;
+}
+
+void zh_espnow_sim_reset_stats(void)
+{
+    _stats = (zh_espnow_sim_stats_t){0};
+}
+
+esp_err_t esp_wifi_get_mac(wifi_interface_t ifx, uint8_t mac[6])
+{
+    if (_is_running == false)
+    {
+        return ESP_ERR_WIFI_NOT_INIT;
+    }
+    if (ifx != WIFI_IF_STA && ifx != WIFI_IF_AP)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    zh_espnow_sim_node_mac(0, mac);
+    // Like on the chip, the soft-AP address follows the station address.
+    mac[ESP_NOW_ETH_ALEN - 1] += (ifx == WIFI_IF_AP) ? 0x80 : 0;
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_set_channel(uint8_t primary, wifi_second_chan_t second)
+{
+    if (_is_running == false)
+    {
+        return ESP_ERR_WIFI_NOT_INIT;
+    }
+    if (primary == 0 || primary > 14)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    _channel = primary;
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_get_channel(uint8_t *primary, wifi_second_chan_t *second)
+{
+    if (_is_running == false)
+    {
+        return ESP_ERR_WIFI_NOT_INIT;
+    }
+    *primary = _channel;
+    *second = WIFI_SECOND_CHAN_NONE;
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_set_protocol(wifi_interface_t ifx, uint8_t protocol_bitmap)
+{
+    return (_is_running == true) ? ESP_OK : ESP_ERR_WIFI_NOT_INIT;
+}
+
+esp_err_t esp_now_init(void)
+{
+    if (_is_running == false)
+    {
+        return ESP_ERR_ESPNOW_INTERNAL;
+    }
+    _is_espnow_init = true;
+    return ESP_OK;
+}
+
+esp_err_t esp_now_deinit(void)
+{
+    _is_espnow_init = false;
+    _send_cb = NULL;
+    _recv_cb = NULL;
+    memset(_peers_used, 0, sizeof(_peers_used));
+    _zh_espnow_sim_frames_drop();
+    return ESP_OK;
+}
+
+esp_err_t esp_now_get_version(uint32_t *version)
+{
+    if (_is_espnow_init == false)
+    {
+        return ESP_ERR_ESPNOW_NOT_INIT;
+    }
+    if (version == NULL)
+    {
+        return ESP_ERR_ESPNOW_ARG;
+    }
+    *version = _config.version;
+    return ESP_OK;
+}
+
+esp_err_t esp_now_register_recv_cb(esp_now_recv_cb_t cb)
+{
+    if (_is_espnow_init == false)
+    {
+        return ESP_ERR_ESPNOW_NOT_INIT;
+    }
+    _recv_cb = cb;
+    return ESP_OK;
+}
+
+esp_err_t esp_now_unregister_recv_cb(void)
+{
+    _recv_cb = NULL;
+    return (_is_espnow_init == true) ? ESP_OK : ESP_ERR_ESPNOW_NOT_INIT;
+}
+
+esp_err_t esp_now_register_send_cb(esp_now_send_cb_t cb)
+{
+    if (_is_espnow_init == false)
+    {
+        return ESP_ERR_ESPNOW_NOT_INIT;
+    }
+    _send_cb = cb;
+    return ESP_OK;
+}
+
+esp_err_t esp_now_unregister_send_cb(void)
+{
+    _send_cb = NULL;
+    return (_is_espnow_init == true) ? ESP_OK : ESP_ERR_ESPNOW_NOT_INIT;
+}
+
+esp_err_t esp_now_send(const uint8_t *peer_addr, const uint8_t *data, size_t len)
+{
+    if (_is_espnow_init == false)
+    {
+        return ESP_ERR_ESPNOW_NOT_INIT;
+    }
+    if (peer_addr == NULL || data == NULL || len == 0 || len > ((_config.version >= 2) ? ESP_NOW_MAX_DATA_LEN_V2 : ESP_NOW_MAX_DATA_LEN))
+    {
+        return ESP_ERR_ESPNOW_ARG;
+    }
+    const esp_now_peer_info_t *peer = _zh_espnow_sim_peer_find(peer_addr);
+    if (peer == NULL)
+    {
+        return ESP_ERR_ESPNOW_NOT_FOUND;
+    }
+    if (peer->channel != 0 && peer->channel != _channel)
+    {
+        return ESP_ERR_ESPNOW_CHAN;
+    }
+    if (_frames_tx_num >= _config.driver_queue_size)
+    {
+        ++_stats.tx_rejected;
+        return ESP_ERR_ESPNOW_NO_MEM;
+    }
+    _frame_t *frame = calloc(1, sizeof(_frame_t) + len);
+    if (frame == NULL)
+    {
+        return ESP_ERR_ESPNOW_NO_MEM;
+    }
+    frame->kind = FRAME_TX;
+    frame->data_len = len;
+    memcpy(frame->data, data, len);
+    frame->ifidx = peer->ifidx;
+    esp_wifi_get_mac(peer->ifidx, frame->src_addr);
+    memcpy(frame->des_addr, peer_addr, ESP_NOW_ETH_ALEN);
+    bool is_broadcast = (memcmp(peer_addr, _broadcast_mac, ESP_NOW_ETH_ALEN) == 0);
+    frame->node = (is_broadcast == true) ? 0 : _zh_espnow_sim_node_find(peer_addr);
+    int64_t start = (_channel_free_at > esp_timer_get_time()) ? _channel_free_at : esp_timer_get_time();
+    int64_t end = start + _zh_espnow_sim_airtime(len);
+    if (is_broadcast == true)
+    {
+        // Broadcasts are not acknowledged and always reported as sent.
+        frame->status = ESP_NOW_SEND_SUCCESS;
+        frame->done_at = end;
+        for (uint8_t node = 1; node <= _config.nodes; ++node)
+        {
+            _stats.node_received[node - 1] += (_zh_espnow_sim_is_lost(node) == false) ? 1 : 0;
+        }
+    }
+    else if (frame->node != 0 && _zh_espnow_sim_is_lost(frame->node) == false)
+    {
+        frame->status = ESP_NOW_SEND_SUCCESS;
+        frame->done_at = end + _config.ack_delay_us;
+        ++_stats.node_received[frame->node - 1];
+    }
+    else
+    {
+        frame->status = ESP_NOW_SEND_FAIL;
+        frame->done_at = end + _config.ack_timeout_us;
+        ++_stats.tx_lost;
+    }
+    _channel_free_at = frame->done_at;
+    _stats.airtime_us += _channel_free_at - start;
+    ++_stats.tx_frames;
+    ++_frames_tx_num;
+    _zh_espnow_sim_frame_put(frame);
+    return ESP_OK;
+}
+
+esp_err_t esp_now_add_peer(const esp_now_peer_info_t *peer)
+{
+    if (_is_espnow_init == false)
+    {
+        return ESP_ERR_ESPNOW_NOT_INIT;
+    }
+    if (peer == NULL || peer->ifidx >= WIFI_IF_NAN)
+    {
+        return ESP_ERR_ESPNOW_ARG;
+    }
+    if (_zh_espnow_sim_peer_find(peer->peer_addr) != NULL)
+    {
+        return ESP_ERR_ESPNOW_EXIST;
+    }
+    for (uint8_t i = 0; i < ESP_NOW_MAX_TOTAL_PEER_NUM; ++i)
+    {
+        if (_peers_used[i] == false)
+        {
+            _peers[i] = *peer;
+            _peers_used[i] = true;
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_ESPNOW_FULL;
+}
+
+esp_err_t esp_now_del_peer(const uint8_t *peer_addr)
+{
+    if (_is_espnow_init == false)
+    {
+        return ESP_ERR_ESPNOW_NOT_INIT;
+    }
+    esp_now_peer_info_t *peer = (peer_addr != NULL) ? _zh_espnow_sim_peer_find(peer_addr) : NULL;
+    if (peer == NULL)
+    {
+        return ESP_ERR_ESPNOW_NOT_FOUND;
+    }
+    _peers_used[peer - _peers] = false;
+    return ESP_OK;
+}
+
+esp_err_t esp_now_mod_peer(const esp_now_peer_info_t *peer)
+{
+    if (_is_espnow_init == false)
+    {
+        return ESP_ERR_ESPNOW_NOT_INIT;
+    }
+    esp_now_peer_info_t *entry = (peer != NULL) ? _zh_espnow_sim_peer_find(peer->peer_addr) : NULL;
+    if (entry == NULL)
+    {
+        return ESP_ERR_ESPNOW_NOT_FOUND;
+    }
+    *entry = *peer;
+    return ESP_OK;
+}
+
+bool esp_now_is_peer_exist(const uint8_t *peer_addr)
+{
+    return _zh_espnow_sim_peer_find(peer_addr) != NULL;
+}
+
+static void _zh_espnow_sim_task(void *pvParameter)
+{
+    for (;;)
+    {
+        while (_frames_head == NULL || _frames_head->done_at > esp_timer_get_time())
+        {
+            zh_espnow_shim_wait_until(&_cond, (_frames_head != NULL) ? _frames_head->done_at : -1);
+        }
+        _frame_t *frame = _frames_head;
+        _frames_head = frame->next;
+        if (_frames_head == NULL)
+        {
+            _frames_tail = NULL;
+        }
+        if (frame->kind == FRAME_TX)
+        {
+            --_frames_tx_num;
+            const esp_now_send_info_t info = {.src_addr = frame->src_addr, .des_addr = frame->des_addr, .ifidx = frame->ifidx};
+            if (_send_cb != NULL)
+            {
+                _send_cb(&info, frame->status);
+            }
+            if (_node_recv_cb != NULL && frame->node != 0 && frame->status == ESP_NOW_SEND_SUCCESS)
+            {
+                _node_recv_cb(frame->node, frame->data, frame->data_len, _node_recv_cb_arg);
+            }
+        }
+        else if (frame->is_lost == true)
+        {
+            ++_stats.rx_lost;
+        }
+        else
+        {
+            ++_stats.rx_frames;
+            wifi_pkt_rx_ctrl_t rx_ctrl = {.rssi = RSSI_BASE - frame->node, .channel = _channel};
+            const esp_now_recv_info_t info = {.src_addr = frame->src_addr, .des_addr = frame->des_addr, .rx_ctrl = &rx_ctrl};
+            if (_recv_cb != NULL)
+            {
+                _recv_cb(&info, frame->data, frame->data_len);
+            }
+        }
+        free(frame);
+    }
+}
+
+static int64_t _zh_espnow_sim_airtime(uint16_t data_len)
+{
+    return _config.frame_overhead_us + ((int64_t)(FRAME_HEADER_SIZE + data_len) * 8 * 1000) / _config.bitrate_kbps;
+}
+
+static bool _zh_espnow_sim_is_lost(uint8_t node)
+{
+    // xorshift32, separate from esp_random() so the losses do not depend on the component.
+    _random_state ^= _random_state << 13;
+    _random_state ^= _random_state >> 17;
+    _random_state ^= _random_state << 5;
+    return (_random_state % 100) < _loss_percent[node];
+}
+
+static uint8_t _zh_espnow_sim_node_find(const uint8_t *mac_addr)
+{
+    uint8_t mac[ESP_NOW_ETH_ALEN] = {0};
+    zh_espnow_sim_node_mac(0, mac);
+    if (memcmp(mac, mac_addr, ESP_NOW_ETH_ALEN - 1) != 0 || mac_addr[ESP_NOW_ETH_ALEN - 1] == 0 || mac_addr[ESP_NOW_ETH_ALEN - 1] > _config.nodes)
+    {
+        return 0;
+    }
+    return mac_addr[ESP_NOW_ETH_ALEN - 1];
+}
+
+static esp_now_peer_info_t *_zh_espnow_sim_peer_find(const uint8_t *mac_addr)
+{
+    for (uint8_t i = 0; i < ESP_NOW_MAX_TOTAL_PEER_NUM; ++i)
+    {
+        if (_peers_used[i] == true && memcmp(_peers[i].peer_addr, mac_addr, ESP_NOW_ETH_ALEN) == 0)
+        {
+            return &_peers[i];
+        }
+    }
+    return NULL;
+}
+
+static void _zh_espnow_sim_frame_put(_frame_t *frame)
+{
+    // Frames share the channel one after the other, so the list stays ordered by completion time.
+    if (_frames_tail != NULL)
+    {
+        _frames_tail->next = frame;
+    }
+    else
+    {
+        _frames_head = frame;
+    }
+    _frames_tail = frame;
+    pthread_cond_broadcast(&_cond);
+}
+
+static void _zh_espnow_sim_frames_drop(void)
+{
+    while (_frames_head != NULL)
+    {
+        _frame_t *frame = _frames_head;
+        _frames_head = frame->next;
+        free(frame);
+    }
+    _frames_tail = NULL;
+    _frames_tx_num = 0;
+}
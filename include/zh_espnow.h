@@ -4,24 +4,47 @@
  * @brief Thread-safe ESP-NOW communication interface for ESP-IDF.
  *
  * This module provides a high-level API for ESP-NOW with asynchronous message processing.
- * It includes a dedicated task that handles sending and receiving ESP-NOW messages,
- * using a FreeRTOS queue to decouple the ISRs/callbacks from the application logic.
+ * It includes dedicated transmit and receive tasks that handle sending and receiving ESP-NOW messages,
+ * using separate FreeRTOS queues to decouple the ISRs/callbacks from the application logic, so receive latency
+ * does not depend on transmit retries.
  * Received messages are posted as ESP events (using the ESP event loop library),
  * and send confirmations are also posted as events.
  *
  * The module supports:
  * - Configurable Wi-Fi channel, interface (STA/AP), and message retry attempts.
  * - Battery mode: when enabled, the node does not receive messages (receive callback is not registered).
- * - Statistics tracking for sent/received messages, errors, and stack usage.
+ * - Optional direct receive handler that gets a borrowed view of the internal buffer instead of an ESP event.
+ * - Statistics tracking for sent/received messages, errors, and stack usage, with latency and retry histograms,
+ *   per-peer counters, coherent snapshots and a compact binary export.
  * - Broadcasting and unicast transmission.
+ * - Message identifiers reported in send events and a blocking send that waits for the confirmation without the event loop.
+ * - Priority classes (control, normal, bulk) with separate transmit queues and a reserved window slot for control messages.
+ * - Optional per-destination fairness: deficit round-robin across destinations and token bucket rate limits per
+ *   destination and in total, with per-peer throttle counts and queueing delay.
+ * - Pipelined transmission with a configurable window of frames awaiting confirmation, each with its own retry timer.
+ * - Fixed-block message pool allocated once at initialization (no heap operations per message).
+ * - Peer cache that keeps peers registered in the ESP-NOW driver with LRU eviction and pinning.
+ * - Adaptive per-peer retry policy: confirmation timeout from the measured latency, exponential backoff with jitter
+ *   and fast failure of unreachable peers until a probe succeeds.
+ * - Receive filter evaluated in the Wi-Fi callback: MAC allowlist/denylist and payload prefix rules with hit counters.
+ * - Optional coalescing of small messages to the same target into one frame, bounded by a maximum delay.
+ * - Optional duplicate suppression with per-sender sequence numbers and a sliding window per source.
+ * - Optional multi-hop relay layer with flooding, a seen-message cache and learned next hops.
+ * - Bulk transfers of arbitrary size with fragmentation, a sliding window with selective acknowledgements and reassembly.
+ * - Optional binary trace ring of the message path (enqueue, send, confirmation, drops) with CPU cycle timestamps.
+ * - Request/response RPC with call identifiers, a bounded table of pending calls, per-call deadlines and replies
+ *   routed straight to the waiting task or a completion callback.
+ * - Handle-based instances, e.g. one on the STA and one on the AP interface of an APSTA gateway.
  *
- * @note The module internally creates a FreeRTOS task and a queue. The queue size,
- *       task stack size, and priority are configurable via zh_espnow_init_config_t.
+ * @note The module internally creates FreeRTOS tasks and queues for transmit and receive. The queue sizes,
+ *       task stack sizes, priorities and core affinity are configurable via zh_espnow_init_config_t.
  * @note All public functions are thread-safe with respect to the module's internal state,
  *       except for zh_espnow_deinit() which must not be called concurrently with any other
  *       operation (the caller must ensure all other accesses have completed).
+ * @note Functions without a `zh_espnow_instance_` variant work on the instance of zh_espnow_init(). The peer cache and
+ *       the per-peer counters are shared by all instances.
  * @warning Do not call zh_espnow_init() twice without an intervening zh_espnow_deinit().
- * @warning Memory allocated for message payloads is freed internally; the user does not need
+ * @warning Message payloads are stored in a fixed-block pool allocated once in zh_espnow_init(); the user does not need
  *          to manage it. However, the user must provide valid data buffers during zh_espnow_send()
  *          and the data is copied into internal buffers.
  */
@@ -37,6 +60,87 @@
 #include "esp_log.h"
 #include "esp_heap_caps.h"
 
+/**
+ * @brief Maximum payload length supported by the ESP-NOW driver version in use (250 or 1490 bytes).
+ */
+#if defined ESP_NOW_MAX_DATA_LEN_V2
+#define ZH_ESPNOW_MAX_DATA_LEN ESP_NOW_MAX_DATA_LEN_V2
+#else
+#define ZH_ESPNOW_MAX_DATA_LEN ESP_NOW_MAX_DATA_LEN
+#endif
+
+/**
+ * @brief Number of buckets of the statistics histograms.
+ */
+#define ZH_ESPNOW_HISTOGRAM_SIZE 8
+
+/**
+ * @brief Upper bound (in microseconds) of the first bucket of the latency histograms.
+ *
+ * Bucket `i` counts values below `ZH_ESPNOW_HISTOGRAM_BASE_US << i`, the last bucket counts everything above.
+ */
+#define ZH_ESPNOW_HISTOGRAM_BASE_US 500
+
+/**
+ * @brief Maximum length (in bytes) of the buffer written by zh_espnow_export_stats().
+ */
+#define ZH_ESPNOW_STATS_EXPORT_MAX_SIZE (3 + (sizeof(zh_espnow_stats_t) / sizeof(uint32_t)) * 5 + ESP_NOW_MAX_TOTAL_PEER_NUM * (ESP_NOW_ETH_ALEN + 1 + 7 * 5))
+
+/**
+ * @brief If 1, the per-message paths (zh_espnow_send() and the Wi-Fi callbacks) also log through ESP_LOG.
+ *
+ * Disabled by default: logging there costs far more than sending the message. Use the trace ring (`trace_size`) to
+ * follow individual messages instead.
+ */
+#ifndef ZH_ESPNOW_HOT_PATH_LOG
+#define ZH_ESPNOW_HOT_PATH_LOG 0
+#endif
+
+/**
+ * @brief Length (in bytes) of the header written by zh_espnow_trace_export() before the records.
+ */
+#define ZH_ESPNOW_TRACE_EXPORT_HEADER_SIZE 10
+
+/**
+ * @brief Bit of `zh_espnow_trace_record_t::event` set if the record was written on core 1.
+ */
+#define ZH_ESPNOW_TRACE_CORE_BIT 0x80
+
+/**
+ * @brief Maximum number of ESP-NOW instances (zh_espnow_init() and zh_espnow_instance_init()) running at the same time.
+ */
+#define ZH_ESPNOW_INSTANCES_MAX 2
+
+/**
+ * @brief Maximum length (in bytes) of a payload prefix matched by the receive filter.
+ */
+#define ZH_ESPNOW_FILTER_PREFIX_MAX 8
+
+/**
+ * @brief Number of payload prefix rules of the receive filter.
+ */
+#define ZH_ESPNOW_FILTER_PREFIX_RULES 4
+
+/**
+ * @brief Length (in bytes) of the internal headers carried by every bulk transfer fragment.
+ */
+#define ZH_ESPNOW_BULK_OVERHEAD 12
+
+/**
+ * @brief Layout version of `zh_espnow_init_config_t` set by ZH_ESPNOW_INIT_CONFIG_DEFAULT().
+ */
+#define ZH_ESPNOW_INIT_CONFIG_VERSION 1
+
+/**
+ * @brief Length (in bytes) of the routing header carried by every relay message in addition to the frame header.
+ */
+#define ZH_ESPNOW_RELAY_OVERHEAD 16
+
+/**
+ * @brief Length (in bytes) of the call header carried by every RPC request and reply in addition to the frame header.
+ */
+#define ZH_ESPNOW_RPC_OVERHEAD 2
+
 /**
  * @brief Default initialization configuration for ESP-NOW interface.
  *
@@ -46,22 +150,78 @@
  * zh_espnow_init_config_t config = ZH_ESPNOW_INIT_CONFIG_DEFAULT();
  * @endcode
  */
-#define ZH_ESPNOW_INIT_CONFIG_DEFAULT()         \
-    {                                           \
-        .task_priority = 1,                     \
-        .stack_size = configMINIMAL_STACK_SIZE, \
-        .queue_size = 1,                        \
-        .wifi_interface = WIFI_IF_STA,          \
-        .wifi_channel = 1,                      \
-        .attempts = 1,                          \
-        .battery_mode = false}
+#define ZH_ESPNOW_INIT_CONFIG_DEFAULT()                                       \
+    {                                                                         \
+        .task_priority = 1,                                                   \
+        .stack_size = configMINIMAL_STACK_SIZE,                               \
+        .queue_size = 1,                                                      \
+        .task_core_id = tskNO_AFFINITY,                                       \
+        .rx_task_priority = 1,                                                \
+        .rx_stack_size = configMINIMAL_STACK_SIZE,                            \
+        .rx_queue_size = 1,                                                   \
+        .rx_task_core_id = tskNO_AFFINITY,                                    \
+        .wifi_interface = WIFI_IF_STA,                                        \
+        .wifi_channel = 1,                                                    \
+        .attempts = 1,                                                        \
+        .tx_window = 1,                                                       \
+        .battery_mode = false,                                                \
+        .small_block_size = ESP_NOW_MAX_DATA_LEN,                             \
+        .small_block_count = 4,                                               \
+        .large_block_size = ZH_ESPNOW_MAX_DATA_LEN,                           \
+        .large_block_count = 2,                                               \
+        .peer_cache_size = 8,                                                 \
+        .frame_header = false,                                                \
+        .bulk_window = 8,                                                     \
+        .bulk_fragment_size = ESP_NOW_MAX_DATA_LEN - ZH_ESPNOW_BULK_OVERHEAD, \
+        .bulk_rx_buffer_size = 0,                                             \
+        .dedup = false,                                                       \
+        .filter_size = 0,                                                     \
+        .coalesce_delay_ms = 0,                                               \
+        .relay_ttl = 0,                                                       \
+        .control_queue_size = 0,                                              \
+        .bulk_queue_size = 0,                                                 \
+        .queue_reserve_percent = 10,                                          \
+        .queue_writable_percent = 50,                                         \
+        .burst_size = 0,                                                      \
+        .burst_delay_ms = 0,                                                  \
+        .compression = false,                                                 \
+        .trace_size = 0,                                                      \
+        .event_base = NULL,                                                   \
+        .rpc_pending_size = 0,                                                \
+        .fair_queue_size = 0,                                                 \
+        .peer_rate = 0,                                                       \
+        .peer_burst = 0,                                                      \
+        .global_rate = 0,                                                     \
+        .global_burst = 0,                                                    \
+        .config_version = ZH_ESPNOW_INIT_CONFIG_VERSION}
+
+/**
+ * @brief Default options of zh_espnow_send_opt().
+ *
+ * @code
+ * zh_espnow_send_options_t options = ZH_ESPNOW_SEND_OPTIONS_DEFAULT();
+ * options.priority = ZH_ESPNOW_PRIORITY_CONTROL;
+ * @endcode
+ */
+#define ZH_ESPNOW_SEND_OPTIONS_DEFAULT()       \
+    {                                          \
+        .priority = ZH_ESPNOW_PRIORITY_NORMAL, \
+        .timeout = 0}
 
 #ifdef __cplusplus
 extern "C"
 {
 #endif
 
-    extern TaskHandle_t zh_espnow; /*!< Handle of the internal ESP-NOW processing task. */
+    extern TaskHandle_t zh_espnow;    /*!< Handle of the internal ESP-NOW transmit processing task. */
+    extern TaskHandle_t zh_espnow_rx; /*!< Handle of the internal ESP-NOW receive processing task (NULL in battery mode). */
+
+    /**
+     * @brief Handle of an ESP-NOW instance created by zh_espnow_instance_init().
+     *
+     * Every instance has its own Wi-Fi interface, queues, tasks, message pool, statistics and receive handler.
+     */
+    typedef struct zh_espnow_context *zh_espnow_handle_t;
 
     /**
      * @brief Initial configuration structure for the ESP-NOW interface.
@@ -71,13 +231,50 @@ extern "C"
      */
     typedef struct
     {
-        uint16_t stack_size;             /*!< Stack size (in bytes) for the internal processing task. @note Recommended value is 2048. */
-        uint8_t task_priority;           /*!< Priority of the processing task. @note Recommended value is 5. */
-        uint8_t queue_size;              /*!< Size of the internal FreeRTOS queue (number of items). @note Recommended value is 10. */
+        uint16_t stack_size;             /*!< Stack size (in bytes) for the internal transmit processing task. @note Recommended value is 2048. */
+        uint8_t task_priority;           /*!< Priority of the transmit processing task. @note Recommended value is 5. */
+        uint8_t queue_size;              /*!< Size of the internal FreeRTOS transmit queue (number of items). @note Recommended value is 10. */
+        BaseType_t task_core_id;         /*!< Core the transmit processing task is pinned to, or tskNO_AFFINITY. 0 means tskNO_AFFINITY if `config_version` is 0. */
+        uint16_t rx_stack_size;          /*!< Stack size (in bytes) for the internal receive processing task. Ignored in battery mode. 0 selects the default. @note Recommended value is 2048. */
+        uint8_t rx_task_priority;        /*!< Priority of the receive processing task. Ignored in battery mode. 0 selects the default. @note Recommended value is 5. */
+        uint8_t rx_queue_size;           /*!< Size of the internal FreeRTOS receive queue (number of items). Ignored in battery mode. 0 selects the default. @note Recommended value is 10. */
+        BaseType_t rx_task_core_id;      /*!< Core the receive processing task is pinned to, or tskNO_AFFINITY. Ignored in battery mode. 0 means tskNO_AFFINITY if `config_version` is 0. */
         uint8_t wifi_channel;            /*!< Wi-Fi channel used for ESP-NOW communication (1-13). */
-        uint8_t attempts;                /*!< Maximum number of retry attempts for sending a message. @note It is not recommended to set a value greater than 10. */
+        uint8_t attempts;                /*!< Maximum number of retry attempts for sending a message. Retries are spaced by an exponential backoff. @note It is not recommended to set a value greater than 10. */
+        uint8_t tx_window;               /*!< Maximum number of frames awaiting a send confirmation at the same time (1-16). 1 gives strict stop-and-wait transmission. 0 selects the default. @note Should not exceed `peer_cache_size`. */
         bool battery_mode;               /*!< If true, the node does not register a receive callback (receive is disabled). */
         wifi_interface_t wifi_interface; /*!< Wi-Fi interface (STA or AP) to use for ESP-NOW. */
+        uint16_t small_block_size;       /*!< Payload capacity (in bytes) of a block of the small class of the message pool. 0 selects the default. @note Recommended value is 250. */
+        uint16_t small_block_count;      /*!< Number of blocks of the small class. Set to 0 to disable the class. If both counts are 0, the default pool is used. */
+        uint16_t large_block_size;       /*!< Payload capacity (in bytes) of a block of the large class of the message pool. Defines the maximum message size. 0 selects the default. @note Recommended value is 250 or 1490. */
+        uint16_t large_block_count;      /*!< Number of blocks of the large class. Set to 0 to disable the class. */
+        uint8_t peer_cache_size;         /*!< Maximum number of peers kept registered in the ESP-NOW driver (1-ESP_NOW_MAX_TOTAL_PEER_NUM). 0 selects the default. @note Least recently used unpinned peers are evicted when the cache is full. */
+        const uint8_t *pinned_peers;     /*!< Optional array of `pinned_peers_num` 6-byte MAC addresses (stored back to back) registered and pinned during initialization. @note Only needs to be valid during zh_espnow_init(). */
+        uint8_t pinned_peers_num;        /*!< Number of entries in `pinned_peers`. Must not exceed `peer_cache_size`. */
+        bool frame_header;               /*!< If true, every frame starts with an internal header (frame type and flags). Required for bulk transfers. @note All nodes of the network must use the same setting. */
+        uint8_t bulk_window;             /*!< Maximum number of unacknowledged fragments of an outgoing bulk transfer (1-32). 0 selects the default. */
+        uint16_t bulk_fragment_size;     /*!< Payload length (in bytes) of an outgoing bulk transfer fragment. 0 selects the default, reduced to fit the message pool. @note Together with `ZH_ESPNOW_BULK_OVERHEAD` must fit into the largest message pool block. */
+        uint32_t bulk_rx_buffer_size;    /*!< Size (in bytes) of the reassembly buffer for incoming bulk transfers allocated at initialization. 0 to accept incoming transfers only through a streaming sink. */
+        bool dedup;                      /*!< If true, data frames carry a sequence number and duplicates (retransmissions after a lost confirmation, repeated broadcasts) are dropped in the receive callback. Requires `frame_header`. */
+        uint8_t filter_size;             /*!< Maximum number of MAC addresses in the receive filter, allocated at initialization. 0 disables MAC filtering. */
+        uint16_t coalesce_delay_ms;      /*!< Maximum time (in milliseconds) a small message waits to be packed with further messages to the same target into one frame. 0 disables coalescing. Requires `frame_header`. @note Receivers split such frames back into individual messages, so all nodes must support it. */
+        uint8_t relay_ttl;               /*!< Maximum number of hops of relay messages sent by zh_espnow_relay_send(). 0 disables the relay layer (relay messages are neither sent, forwarded nor delivered). Requires `frame_header`. */
+        uint8_t control_queue_size;      /*!< Size of the transmit queue of ZH_ESPNOW_PRIORITY_CONTROL messages. 0 disables the class, its messages use the normal queue. @note If enabled and `tx_window` > 1, one window slot is reserved for the class. */
+        uint8_t bulk_queue_size;         /*!< Size of the transmit queue of ZH_ESPNOW_PRIORITY_BULK messages. 0 disables the class, its messages use the normal queue. */
+        uint8_t queue_reserve_percent;   /*!< Part (in percent) of every transmit queue kept free. A message is rejected (or waits, see `zh_espnow_send_options_t::timeout`) if no more space is left. 0 selects the default if `config_version` is 0. @note Recommended value is 10. */
+        uint8_t queue_writable_percent;  /*!< Free part (in percent) of a transmit queue at which `ZH_ESPNOW_ON_QUEUE_WRITABLE_EVENT` is posted after a message was rejected. Must be greater than `queue_reserve_percent`. 0 selects the default. @note Recommended value is 50. */
+        uint8_t burst_size;              /*!< Battery scheduling mode (requires `battery_mode`). If > 0, outgoing messages are buffered in the transmit queues and flushed in one burst once this many are waiting. 0 sends every message right away. */
+        uint16_t burst_delay_ms;         /*!< Maximum time (in milliseconds) a message is buffered before the burst is flushed anyway. 0 flushes only on `burst_size` or zh_espnow_flush(). Ignored if `burst_size` is 0. */
+        bool compression;                /*!< If true, data payloads of 16 bytes and more are compressed when this makes them shorter. Compressed and plain frames interoperate. Requires `frame_header`. */
+        uint16_t trace_size;             /*!< Number of records of the trace ring, rounded up to a power of two. 0 disables tracing. @note Every record takes 12 bytes. */
+        esp_event_base_t event_base;     /*!< Event base the events of the instance are posted with. NULL posts with ZH_ESPNOW. @note Give every instance of zh_espnow_instance_init() its own base to tell the interfaces apart. */
+        uint8_t rpc_pending_size;        /*!< Maximum number of RPC calls awaiting a reply at the same time, allocated at initialization. 0 disables zh_espnow_rpc_call() and zh_espnow_rpc_call_async(). Requires `frame_header` and no `battery_mode`. @note Incoming requests are served regardless of this setting. */
+        uint8_t fair_queue_size;         /*!< Number of normal and bulk messages taken from the transmit queues into per-destination queues, allocated at initialization. Destinations are then served in deficit round-robin and rate limited by their token buckets. 0 sends in queue order. @note Control messages and bulk transfers bypass the fair scheduler. */
+        uint16_t peer_rate;              /*!< Token bucket rate (in messages per second) of every destination, retransmissions included. 0 disables the limit. Requires `fair_queue_size`. */
+        uint8_t peer_burst;              /*!< Token bucket depth (in messages) of every destination, i.e. how many messages may go out back to back after an idle period. 0 is treated as 1. */
+        uint16_t global_rate;            /*!< Token bucket rate (in messages per second) of all destinations together, retransmissions included. 0 disables the limit. Requires `fair_queue_size`. */
+        uint8_t global_burst;            /*!< Token bucket depth (in messages) of all destinations together. 0 is treated as 1. */
+        uint8_t config_version;          /*!< Set to ZH_ESPNOW_INIT_CONFIG_VERSION by ZH_ESPNOW_INIT_CONFIG_DEFAULT(). 0 marks a zero-initialised configuration of version 3.3.0: fields where 0 is a valid value then keep the behaviour of that version. */
     } zh_espnow_init_config_t;
 
     ESP_EVENT_DECLARE_BASE(ZH_ESPNOW);
@@ -87,8 +284,13 @@ extern "C"
      */
     typedef enum
     {
-        ZH_ESPNOW_ON_RECV_EVENT, /*!< A message has been received. The event data is a `zh_espnow_event_on_recv_t` structure. */
-        ZH_ESPNOW_ON_SEND_EVENT  /*!< A transmission attempt has completed (success or failure). The event data is a `zh_espnow_event_on_send_t` structure. */
+        ZH_ESPNOW_ON_RECV_EVENT,           /*!< A message has been received. The event data is a `zh_espnow_event_on_recv_t` structure. */
+        ZH_ESPNOW_ON_SEND_EVENT,           /*!< A transmission attempt has completed (success or failure). The event data is a `zh_espnow_event_on_send_t` structure. */
+        ZH_ESPNOW_ON_BULK_PROGRESS_EVENT,  /*!< A bulk transfer has made progress. The event data is a `zh_espnow_event_on_bulk_t` structure. */
+        ZH_ESPNOW_ON_BULK_COMPLETE_EVENT,  /*!< A bulk transfer has finished (success or failure). The event data is a `zh_espnow_event_on_bulk_t` structure. */
+        ZH_ESPNOW_ON_QUEUE_WRITABLE_EVENT, /*!< A transmit queue that rejected a message has room again. The event data is a `zh_espnow_event_on_queue_t` structure. */
+        ZH_ESPNOW_ON_BURST_COMPLETE_EVENT, /*!< A flushed burst has been fully sent and the transmitter is idle. The event data is a `zh_espnow_event_on_burst_t` structure. */
+        ZH_ESPNOW_ON_RPC_REQUEST_EVENT     /*!< An RPC request has been received. The event data is a `zh_espnow_event_on_rpc_request_t` structure. */
     } zh_espnow_event_type_t;
 
     /**
@@ -111,8 +313,20 @@ extern "C"
     {
         uint8_t mac_addr[ESP_NOW_ETH_ALEN];    /*!< MAC address of the target device. */
         zh_espnow_on_send_event_type_t status; /*!< Status of the send operation. */
+        uint32_t msg_id;                       /*!< Identifier of the message returned by zh_espnow_send_ex(). */
+        uint32_t latency_us;                   /*!< Time from queueing the message until its final send confirmation in microseconds. */
     } zh_espnow_event_on_send_t;
 
+    /**
+     * @brief Result of a message, returned by zh_espnow_send_sync() and zh_espnow_wait_for().
+     */
+    typedef struct
+    {
+        uint32_t msg_id;                       /*!< Identifier of the message. */
+        zh_espnow_on_send_event_type_t status; /*!< Status of the send operation. */
+        uint32_t latency_us;                   /*!< Time from queueing the message until its final send confirmation in microseconds. */
+    } zh_espnow_send_result_t;
+
     /**
      * @brief Event data structure for a received message event.
      *
@@ -128,22 +342,361 @@ extern "C"
         uint8_t data[];                     /*!< Flexible array member holding the received payload. */
     } zh_espnow_event_on_recv_t;
 
+    /**
+     * @brief Borrowed view of a received frame passed to a direct receive handler.
+     *
+     * All pointers refer to the internal buffer of the frame. They stay valid until the handler returns or,
+     * if the handler took a lease on the buffer, until zh_espnow_recv_release() is called for `data`.
+     */
+    typedef struct
+    {
+        const uint8_t *mac_addr; /*!< MAC address of the sender. */
+        const uint8_t *data;     /*!< Pointer to the received payload. */
+        uint16_t data_len;       /*!< Length of the received payload in bytes. */
+        int8_t rssi;             /*!< RSSI of the frame in dBm. */
+    } zh_espnow_recv_view_t;
+
+    /**
+     * @brief Direct receive handler.
+     *
+     * Called from the internal receive task for every received frame instead of posting `ZH_ESPNOW_ON_RECV_EVENT`.
+     *
+     * @param[in] view Borrowed view of the frame. The structure itself is only valid during the call.
+     * @param[in] arg User argument passed to zh_espnow_register_recv_handler().
+     *
+     * @return false to release the buffer when the handler returns.
+     * @return true to keep a lease on the buffer. The application must then call zh_espnow_recv_release() with `view->data`.
+     */
+    typedef bool (*zh_espnow_recv_handler_t)(const zh_espnow_recv_view_t *view, void *arg);
+
+    /**
+     * @brief Fragment of a message payload for scatter-gather sending.
+     */
+    typedef struct
+    {
+        const void *data;  /*!< Pointer to the fragment data. May be NULL only if `data_len` is 0. */
+        uint16_t data_len; /*!< Length of the fragment in bytes. */
+    } zh_espnow_iovec_t;
+
+    /**
+     * @brief Descriptor of a single message for zh_espnow_send_batch().
+     *
+     * The payload of the message is the concatenation of all fragments in `iov`.
+     */
+    typedef struct
+    {
+        const uint8_t *target;        /*!< Pointer to a 6-byte MAC address. If NULL, broadcast is used. */
+        const zh_espnow_iovec_t *iov; /*!< Array of payload fragments. */
+        uint8_t iov_count;            /*!< Number of fragments in `iov`. */
+    } zh_espnow_batch_entry_t;
+
+    /**
+     * @brief Priority class of an outgoing message.
+     *
+     * Every class has its own transmit queue. Control messages are always sent first, normal and bulk messages share the
+     * rest of the transmission window with a fixed weight.
+     */
+    typedef enum
+    {
+        ZH_ESPNOW_PRIORITY_CONTROL, /*!< Urgent messages (alarms, commands). Never coalesced. */
+        ZH_ESPNOW_PRIORITY_NORMAL,  /*!< Default class, served by the `queue_size` queue. */
+        ZH_ESPNOW_PRIORITY_BULK,    /*!< Background traffic (telemetry, logs). */
+        ZH_ESPNOW_PRIORITY_NUM
+    } zh_espnow_priority_t;
+
+    /**
+     * @brief Options of an outgoing message, see zh_espnow_send_opt().
+     */
+    typedef struct
+    {
+        zh_espnow_priority_t priority; /*!< Priority class of the message. */
+        TickType_t timeout;            /*!< Maximum time (in ticks) to wait for room in the transmit queue. 0 fails immediately, portMAX_DELAY waits forever. */
+    } zh_espnow_send_options_t;
+
+    /**
+     * @brief Event data structure for the queue writable event.
+     *
+     * Posted by the transmit task once the free part of a transmit queue that rejected (or delayed) a message reaches
+     * `queue_writable_percent`. The gap to `queue_reserve_percent` keeps the event from being posted for every message.
+     */
+    typedef struct
+    {
+        zh_espnow_priority_t priority; /*!< Priority class of the queue. */
+        uint8_t free;                  /*!< Number of free items in the queue. */
+    } zh_espnow_event_on_queue_t;
+
+    /**
+     * @brief Event data structure for the burst complete event.
+     *
+     * Posted once every message of a flushed burst has got its final send confirmation. From this point the node may
+     * enter light or deep sleep.
+     */
+    typedef struct
+    {
+        uint32_t sent_success; /*!< Number of messages of the burst delivered. */
+        uint32_t sent_fail;    /*!< Number of messages of the burst that failed. */
+        uint32_t duration_us;  /*!< Time (in microseconds) from the start of the flush until the last confirmation. */
+    } zh_espnow_event_on_burst_t;
+
+    /**
+     * @brief Event data structure for a received RPC request.
+     *
+     * Answer it with zh_espnow_rpc_reply() using `mac_addr` and `call_id`, from the event handler or later from any task.
+     */
+    typedef struct
+    {
+        uint16_t data_len;                  /*!< Length of the request payload in bytes. */
+        uint8_t mac_addr[ESP_NOW_ETH_ALEN]; /*!< MAC address of the caller. */
+        uint16_t call_id;                   /*!< Identifier of the call, unique per caller. */
+        uint8_t data[];                     /*!< Flexible array member holding the request payload. */
+    } zh_espnow_event_on_rpc_request_t;
+
+    /**
+     * @brief Result of an RPC call passed to a zh_espnow_rpc_callback_t.
+     */
+    typedef struct
+    {
+        uint16_t call_id;                   /*!< Identifier of the call returned by zh_espnow_rpc_call_async(). */
+        esp_err_t status;                   /*!< ESP_OK if a reply arrived, ESP_ERR_TIMEOUT if the deadline passed, ESP_FAIL if the request could not be delivered. */
+        uint8_t mac_addr[ESP_NOW_ETH_ALEN]; /*!< MAC address of the replying node. The target of the call if there is no reply. */
+        const uint8_t *data;                /*!< Reply payload. Only valid during the callback. NULL if there is no reply. */
+        uint16_t data_len;                  /*!< Length of the reply payload in bytes. */
+        uint32_t latency_us;                /*!< Time (in microseconds) from the call until the reply or the failure. */
+    } zh_espnow_rpc_result_t;
+
+    /**
+     * @brief Completion callback of zh_espnow_rpc_call_async().
+     *
+     * Called exactly once per call from an internal task: the receive task for a reply or a timeout, the transmit task
+     * if the request could not be delivered. It must not block.
+     *
+     * @param[in] result Result of the call. Only valid during the callback.
+     * @param[in] arg User argument passed to zh_espnow_rpc_call_async().
+     */
+    typedef void (*zh_espnow_rpc_callback_t)(const zh_espnow_rpc_result_t *result, void *arg);
+
+    /**
+     * @brief Result of zh_espnow_codec_benchmark().
+     */
+    typedef struct
+    {
+        uint16_t compressed_len; /*!< Size of the compressed sample in bytes (0 if compression does not make it shorter). */
+        uint32_t encode_cycles;  /*!< CPU cycles spent on compressing the sample. */
+        uint32_t decode_cycles;  /*!< CPU cycles spent on decompressing the sample. */
+    } zh_espnow_codec_benchmark_t;
+
+    /**
+     * @brief Event of a trace record.
+     */
+    typedef enum
+    {
+        ZH_ESPNOW_TRACE_ENQUEUE, /*!< Message added to a transmit queue. `arg` is the priority class, `value` the payload length. */
+        ZH_ESPNOW_TRACE_DEQUEUE, /*!< Message taken from a transmit queue. `arg` is the priority class, `value` the number of frames in flight. */
+        ZH_ESPNOW_TRACE_SEND,    /*!< Frame handed to the ESP-NOW driver. `arg` is the attempt, `value` the frame payload length. */
+        ZH_ESPNOW_TRACE_CONFIRM, /*!< Send confirmation processed. `arg` is the zh_espnow_on_send_event_type_t, `value` the attempt. */
+        ZH_ESPNOW_TRACE_DROP,    /*!< Message dropped. `arg` is the zh_espnow_trace_drop_t, `value` the payload length. */
+        ZH_ESPNOW_TRACE_POST,    /*!< Event posted to the event loop. `arg` is the zh_espnow_event_type_t, `value` the status (send) or the length (receive). */
+        ZH_ESPNOW_TRACE_RECV     /*!< Frame accepted by the receive callback. `arg` is the frame type, `value` the frame length, `msg_id` the sequence number. */
+    } zh_espnow_trace_event_t;
+
+    /**
+     * @brief Reason of a ZH_ESPNOW_TRACE_DROP record.
+     */
+    typedef enum
+    {
+        ZH_ESPNOW_TRACE_DROP_QUEUE_FULL, /*!< The transmit or receive queue had no room left. */
+        ZH_ESPNOW_TRACE_DROP_NO_MEMORY,  /*!< No free block in the message pool. */
+        ZH_ESPNOW_TRACE_DROP_FILTER,     /*!< Rejected by the receive filter. */
+        ZH_ESPNOW_TRACE_DROP_DEDUP,      /*!< Duplicate frame. */
+        ZH_ESPNOW_TRACE_DROP_FRAME_ERROR /*!< Invalid frame header. */
+    } zh_espnow_trace_drop_t;
+
+    /**
+     * @brief Record of the trace ring.
+     *
+     * @note `cycles` is the CPU cycle counter of the core that wrote the record. The counters of both cores are not
+     *       synchronised, so compare timestamps only within one core and use the record order across cores.
+     */
+    typedef struct
+    {
+        uint32_t cycles; /*!< CPU cycle counter when the record was written. */
+        uint32_t msg_id; /*!< Message identifier (0 if unknown). */
+        uint16_t value;  /*!< Event specific value, see zh_espnow_trace_event_t. */
+        uint8_t event;   /*!< zh_espnow_trace_event_t, ZH_ESPNOW_TRACE_CORE_BIT set if written on core 1. */
+        uint8_t arg;     /*!< Event specific argument, see zh_espnow_trace_event_t. */
+    } zh_espnow_trace_record_t;
+
+    /**
+     * @brief Mode of the MAC address part of the receive filter.
+     */
+    typedef enum
+    {
+        ZH_ESPNOW_FILTER_OFF,   /*!< Frames from every sender are accepted. */
+        ZH_ESPNOW_FILTER_ALLOW, /*!< Only frames from the addresses in the filter are accepted. */
+        ZH_ESPNOW_FILTER_DENY   /*!< Frames from the addresses in the filter are dropped. */
+    } zh_espnow_filter_mode_t;
+
+    /**
+     * @brief Direction of a bulk transfer.
+     */
+    typedef enum
+    {
+        ZH_ESPNOW_BULK_TX, /*!< Outgoing transfer. */
+        ZH_ESPNOW_BULK_RX  /*!< Incoming transfer. */
+    } zh_espnow_bulk_direction_t;
+
+    /**
+     * @brief Status of a bulk transfer, reported in the bulk events.
+     */
+    typedef enum
+    {
+        ZH_ESPNOW_BULK_IN_PROGRESS, /*!< The transfer is running. */
+        ZH_ESPNOW_BULK_SUCCESS,     /*!< All data was delivered. */
+        ZH_ESPNOW_BULK_FAIL         /*!< The transfer was aborted (peer unreachable, rejected by the peer or by the data source/sink). */
+    } zh_espnow_bulk_status_t;
+
+    /**
+     * @brief Event data structure for the bulk transfer events.
+     */
+    typedef struct
+    {
+        uint8_t mac_addr[ESP_NOW_ETH_ALEN];   /*!< MAC address of the peer. */
+        uint16_t transfer_id;                 /*!< Identifier of the transfer, unique per sender. */
+        zh_espnow_bulk_direction_t direction; /*!< Direction of the transfer. */
+        zh_espnow_bulk_status_t status;       /*!< Status of the transfer. */
+        uint32_t total_len;                   /*!< Total length of the transfer in bytes. */
+        uint32_t done_len;                    /*!< Number of bytes acknowledged by the peer (outgoing) or delivered in order (incoming). */
+        const uint8_t *data;                  /*!< Reassembly buffer of a successful incoming transfer without a sink, valid until zh_espnow_bulk_release(). NULL otherwise. */
+    } zh_espnow_event_on_bulk_t;
+
+    /**
+     * @brief Data source of an outgoing bulk transfer.
+     *
+     * Called from the internal transmit task for every fragment, including retransmissions.
+     *
+     * @param[in] offset Offset of the fragment within the transfer.
+     * @param[out] buffer Buffer to fill with `length` bytes of data.
+     * @param[in] length Length of the fragment in bytes.
+     * @param[in] arg User argument passed to zh_espnow_bulk_send_from().
+     *
+     * @return ESP_OK on success, any other value aborts the transfer.
+     */
+    typedef esp_err_t (*zh_espnow_bulk_source_t)(uint32_t offset, uint8_t *buffer, uint16_t length, void *arg);
+
+    /**
+     * @brief Streaming sink of incoming bulk transfers.
+     *
+     * Called from the internal receive task with consecutive chunks of data in order of offset.
+     *
+     * @param[in] mac_addr MAC address of the sender.
+     * @param[in] transfer_id Identifier of the transfer.
+     * @param[in] offset Offset of the chunk within the transfer. 0 marks the start of a new transfer.
+     * @param[in] data Pointer to the chunk data, valid only during the call.
+     * @param[in] length Length of the chunk in bytes.
+     * @param[in] total_len Total length of the transfer in bytes.
+     * @param[in] arg User argument passed to zh_espnow_bulk_register_sink().
+     *
+     * @return ESP_OK on success, any other value aborts the transfer.
+     */
+    typedef esp_err_t (*zh_espnow_bulk_sink_t)(const uint8_t *mac_addr, uint16_t transfer_id, uint32_t offset, const uint8_t *data, uint16_t length, uint32_t total_len, void *arg);
+
     /**
      * @brief Statistics structure for the ESP-NOW interface.
      *
      * Contains counters for various events and errors, as well as the minimum free stack size of the processing task.
+     *
+     * @note All fields are `uint32_t`; zh_espnow_export_stats() encodes them in declaration order.
      */
     typedef struct
     {
-        uint32_t sent_success;         /*!< Number of successfully sent messages. */
-        uint32_t sent_fail;            /*!< Number of failed sent messages. */
-        uint32_t received;             /*!< Number of received messages (only if receive is enabled). */
-        uint32_t espnow_driver_error;  /*!< Number of errors returned by the ESP-NOW driver. */
-        uint32_t event_post_error;     /*!< Number of failures when posting events to the event loop. */
-        uint32_t queue_overflow_error; /*!< Number of times the internal queue overflowed (dropped messages). */
-        uint32_t min_stack_size;       /*!< Minimum free stack size (in bytes) of the processing task. */
+        uint32_t sent_success;                                    /*!< Number of successfully sent messages. */
+        uint32_t sent_fail;                                       /*!< Number of failed sent messages. */
+        uint32_t received;                                        /*!< Number of received messages (only if receive is enabled). */
+        uint32_t espnow_driver_error;                             /*!< Number of errors returned by the ESP-NOW driver. */
+        uint32_t event_post_error;                                /*!< Number of failures when posting events to the event loop. */
+        uint32_t queue_overflow_error;                            /*!< Number of times the internal queue overflowed (dropped messages). */
+        uint32_t min_stack_size;                                  /*!< Minimum free stack size (in bytes) of the transmit processing task. */
+        uint32_t rx_min_stack_size;                               /*!< Minimum free stack size (in bytes) of the receive processing task. */
+        uint32_t tx_queue_high_water;                             /*!< Maximum number of items observed in a transmit queue. */
+        uint32_t rx_queue_high_water;                             /*!< Maximum number of items observed in the receive queue. */
+        uint32_t rx_latency_avg_us;                               /*!< Moving average of the time (in microseconds) from the receive callback until the frame is delivered to the receive handler or the event loop. */
+        uint32_t rx_latency_max_us;                               /*!< Maximum of the same receive delivery time in microseconds. */
+        uint32_t pool_small_exhausted;                            /*!< Number of messages fitting the small class of the message pool dropped because no block of any class was free. */
+        uint32_t pool_large_exhausted;                            /*!< Number of messages fitting only the large class of the message pool dropped because no large block was free. */
+        uint32_t peer_cache_hit;                                  /*!< Number of transmissions to a peer already registered in the peer cache. */
+        uint32_t peer_cache_miss;                                 /*!< Number of transmissions that required registering the peer in the ESP-NOW driver. */
+        uint32_t peer_cache_eviction;                             /*!< Number of peers removed from the ESP-NOW driver to make room for another peer. */
+        uint32_t send_latency_avg_us;                             /*!< Moving average of the time from queueing a message until its final send confirmation in microseconds. */
+        uint32_t send_latency_max_us;                             /*!< Maximum of the same send latency in microseconds. */
+        uint32_t peer_fast_fail;                                  /*!< Number of messages failed without transmission because the peer is marked unreachable. */
+        uint32_t frame_error;                                     /*!< Number of received frames dropped because of an invalid internal header. */
+        uint32_t bulk_tx_bytes;                                   /*!< Number of bytes of successfully completed outgoing bulk transfers. */
+        uint32_t bulk_rx_bytes;                                   /*!< Number of bytes of successfully completed incoming bulk transfers. */
+        uint32_t bulk_retransmits;                                /*!< Number of retransmitted bulk transfer fragments. */
+        uint32_t bulk_tx_throughput;                              /*!< Throughput (in bytes per second) of the last successfully completed outgoing bulk transfer. */
+        uint32_t bulk_rx_throughput;                              /*!< Throughput (in bytes per second) of the last successfully completed incoming bulk transfer. */
+        uint32_t tx_queue_depth;                                  /*!< Number of items in the transmit queues. Filled only by zh_espnow_get_stats_snapshot(). */
+        uint32_t rx_queue_depth;                                  /*!< Number of items in the receive queue. Filled only by zh_espnow_get_stats_snapshot(). */
+        uint32_t queue_wait_hist[ZH_ESPNOW_HISTOGRAM_SIZE];       /*!< Histogram of the time messages spent in the transmit queue, see ZH_ESPNOW_HISTOGRAM_BASE_US. */
+        uint32_t send_latency_hist[ZH_ESPNOW_HISTOGRAM_SIZE];     /*!< Histogram of the time from queueing a message until its final send confirmation, see ZH_ESPNOW_HISTOGRAM_BASE_US. */
+        uint32_t send_retries_hist[ZH_ESPNOW_HISTOGRAM_SIZE];     /*!< Histogram of the number of retries per message. Bucket `i` counts messages with `i` retries, the last bucket also more. */
+        uint32_t dedup_dropped;                                   /*!< Number of received duplicate frames dropped by `dedup`. */
+        uint32_t filter_dropped;                                  /*!< Number of received frames dropped by the receive filter. */
+        uint32_t coalesced_frames;                                /*!< Number of sent frames carrying coalesced messages. */
+        uint32_t coalesced_messages;                              /*!< Number of messages sent inside coalesced frames. */
+        uint32_t relay_forwarded;                                 /*!< Number of relay messages forwarded to another node. */
+        uint32_t relay_seen_dropped;                              /*!< Number of received relay messages dropped because they were already seen. */
+        uint32_t relay_ttl_expired;                               /*!< Number of relay messages for other nodes dropped because their hop limit was reached. */
+        uint32_t relay_hops_hist[ZH_ESPNOW_HISTOGRAM_SIZE];       /*!< Histogram of the number of hops of delivered relay messages. Bucket `i` counts messages that took `i + 1` hops, the last bucket also more. */
+        uint32_t dispatch_latency_avg_us[ZH_ESPNOW_PRIORITY_NUM]; /*!< Average time (in microseconds) from queueing a message until it is taken for transmission, per priority class. */
+        uint32_t dispatch_latency_max_us[ZH_ESPNOW_PRIORITY_NUM]; /*!< Maximum time (in microseconds) from queueing a message until it is taken for transmission, per priority class. */
+        uint32_t priority_dropped[ZH_ESPNOW_PRIORITY_NUM];        /*!< Number of messages rejected because the queue of their priority class was full, per class. */
+        uint32_t radio_on_time_ms;                                /*!< Total time (in milliseconds) with at least one frame awaiting its send confirmation. */
+        uint32_t bursts;                                          /*!< Number of completed bursts, see zh_espnow_flush(). */
+        uint32_t burst_messages;                                  /*!< Number of messages sent in completed bursts. */
+        uint32_t burst_duration_avg_us;                           /*!< Average time (in microseconds) from the start of a flush until the last confirmation. */
+        uint32_t burst_duration_max_us;                           /*!< Maximum time (in microseconds) from the start of a flush until the last confirmation. */
+        uint32_t compressed_frames;                               /*!< Number of sent frames with a compressed payload. */
+        uint32_t compress_bytes_in;                               /*!< Total payload size (in bytes) of the compressed frames before compression. */
+        uint32_t compress_bytes_out;                              /*!< Total payload size (in bytes) of the compressed frames after compression. The ratio to `compress_bytes_in` is the compression ratio. */
+        uint32_t compress_skipped;                                /*!< Number of payloads sent plain because compression did not make them shorter. */
+        uint32_t decompressed_frames;                             /*!< Number of received frames with a compressed payload. */
+        uint32_t encode_cycles_per_byte_avg;                      /*!< Average number of CPU cycles per payload byte spent on compression. */
+        uint32_t encode_cycles_per_byte_max;                      /*!< Maximum number of CPU cycles per payload byte spent on compression. */
+        uint32_t decode_cycles_per_byte_avg;                      /*!< Average number of CPU cycles per payload byte spent on decompression. */
+        uint32_t decode_cycles_per_byte_max;                      /*!< Maximum number of CPU cycles per payload byte spent on decompression. */
+        uint32_t rpc_calls;                                       /*!< Number of RPC requests sent by zh_espnow_rpc_call() and zh_espnow_rpc_call_async(). */
+        uint32_t rpc_replies;                                     /*!< Number of RPC calls completed by a reply. */
+        uint32_t rpc_timeouts;                                    /*!< Number of RPC calls without a reply before their deadline. */
+        uint32_t rpc_failed;                                      /*!< Number of RPC calls whose request could not be delivered. */
+        uint32_t rpc_duplicate_replies;                           /*!< Number of RPC replies dropped because the call was already answered. */
+        uint32_t rpc_late_replies;                                /*!< Number of RPC replies dropped because the call had already timed out or is unknown. */
+        uint32_t rpc_requests;                                    /*!< Number of received RPC requests. */
+        uint32_t rpc_latency_hist[ZH_ESPNOW_HISTOGRAM_SIZE];      /*!< Histogram of the round-trip time of RPC calls completed by a reply, see ZH_ESPNOW_HISTOGRAM_BASE_US. */
+        uint32_t throttled_peer;                                  /*!< Number of messages held back by the token bucket of their destination. */
+        uint32_t throttled_global;                                /*!< Number of messages held back by the global token bucket. */
     } zh_espnow_stats_t;
 
+    /**
+     * @brief Counters and link quality estimates of a peer, see zh_espnow_get_peer_stats().
+     */
+    typedef struct
+    {
+        uint8_t mac_addr[ESP_NOW_ETH_ALEN]; /*!< MAC address of the peer. */
+        uint32_t sent_success;              /*!< Number of frames to the peer that were confirmed. */
+        uint32_t sent_fail;                 /*!< Number of frames to the peer that failed after all attempts. */
+        uint32_t received;                  /*!< Number of frames received from the peer while it is in the cache. */
+        uint16_t delivery_ratio;            /*!< Moving average of the share of successful transmission attempts in per mille. */
+        uint32_t confirm_latency_us;        /*!< Moving average of the time from transmission to a successful send confirmation in microseconds. 0 if unknown. */
+        uint32_t confirm_timeout_ms;        /*!< Confirmation timeout currently applied to frames to the peer in milliseconds. */
+        int8_t rssi;                        /*!< Moving average of the RSSI of frames received from the peer in dBm. 0 if unknown. */
+        uint8_t consecutive_failures;       /*!< Number of consecutive messages that failed after all attempts. */
+        bool is_unreachable;                /*!< True if messages to the peer fail immediately, except for one probe per second. */
+        uint32_t throttled;                 /*!< Number of messages to the peer held back by its token bucket while it is in the cache. */
+        uint32_t queue_wait_us;             /*!< Moving average of the time data messages to the peer spent queued before their first transmission in microseconds. 0 if unknown. */
+        uint32_t queue_wait_max_us;         /*!< Maximum time a data message to the peer spent queued before its first transmission in microseconds. */
+    } zh_espnow_peer_stats_t;
+
     /**
      * @brief Initialise the ESP-NOW interface.
      *
@@ -159,7 +712,7 @@ extern "C"
      * @return ESP_OK on success.
      * @return ESP_ERR_INVALID_ARG if config is NULL or contains invalid values.
      * @return ESP_ERR_INVALID_STATE if the module is already initialised.
-     * @return ESP_ERR_NO_MEM if memory allocation fails (queue, event group, etc.).
+     * @return ESP_ERR_NO_MEM if memory allocation fails (queue, event group, message pool, etc.).
      * @return ESP_FAIL if any internal initialization step fails.
      */
     esp_err_t zh_espnow_init(const zh_espnow_init_config_t *config);
@@ -179,6 +732,42 @@ extern "C"
      */
     esp_err_t zh_espnow_deinit(void);
 
+    /**
+     * @brief Initialise an additional ESP-NOW instance.
+     *
+     * Same as zh_espnow_init(), but creates a separate instance with its own queues, tasks, message pool, statistics
+     * and receive handler. The ESP-NOW driver is shared: it is initialised by the first instance and deinitialised with
+     * the last one. Received frames are delivered to the instance of the interface they were addressed to, broadcast
+     * frames to every receiving instance. Send confirmations are routed by interface.
+     *
+     * @note Every instance needs its own `wifi_interface`. All instances use the same Wi-Fi channel.
+     * @note zh_espnow_init() creates the default instance that all functions without a handle work on. It counts
+     *       towards `ZH_ESPNOW_INSTANCES_MAX` like any other.
+     *
+     * @param[in] config Pointer to the initialization configuration. Must not be NULL.
+     * @param[out] handle Pointer receiving the handle of the new instance. Must not be NULL.
+     *
+     * @return ESP_OK on success.
+     * @return ESP_ERR_INVALID_ARG if an argument is NULL or the configuration contains invalid values.
+     * @return ESP_ERR_INVALID_STATE if an instance already uses the interface or the Wi-Fi channel differs.
+     * @return ESP_ERR_NO_MEM if `ZH_ESPNOW_INSTANCES_MAX` instances are running or memory allocation fails.
+     * @return ESP_FAIL if any internal initialization step fails.
+     */
+    esp_err_t zh_espnow_instance_init(const zh_espnow_init_config_t *config, zh_espnow_handle_t *handle);
+
+    /**
+     * @brief Deinitialise an instance created by zh_espnow_instance_init() and free its handle.
+     *
+     * @warning Same restrictions as zh_espnow_deinit(). The handle must not be used afterwards.
+     *
+     * @param[in] handle Instance handle.
+     *
+     * @return ESP_OK on success.
+     * @return ESP_ERR_INVALID_ARG if the handle is NULL or the default instance.
+     * @return ESP_ERR_NOT_FOUND if the instance is not initialised.
+     */
+    esp_err_t zh_espnow_instance_deinit(zh_espnow_handle_t handle);
+
     /**
      * @brief Send an ESP-NOW message to a specified target.
      *
@@ -186,55 +775,808 @@ extern "C"
      * The function returns immediately after placing the message in the queue.
      *
      * @note The message payload is copied into an internal buffer; the caller does not need to keep the data buffer valid after the call returns.
-     * @note The queue size is limited; if the queue is almost full (less than 10% of its capacity is free), the function returns ESP_ERR_INVALID_STATE to prevent overflow.
+     * @note The queue size is limited; if the queue is almost full (less than `queue_reserve_percent` of its capacity is free), the function returns ESP_ERR_INVALID_STATE without waiting. Use zh_espnow_send_opt() with a timeout to wait for room, or wait for `ZH_ESPNOW_ON_QUEUE_WRITABLE_EVENT`.
      * @note The target MAC address can be the broadcast address (all 0xFF) for sending to all peers. If `target` is NULL, the broadcast address is used.
      *
      * @param[in] target Pointer to a 6-byte MAC address. If NULL, broadcast is used.
      * @param[in] data Pointer to the payload data to be sent. Must not be NULL.
-     * @param[in] data_len Length of the payload in bytes. Must be > 0 and <= the maximum ESP-NOW data length (250 or 1490 bytes).
+     * @param[in] data_len Length of the payload in bytes. Must be > 0 and <= the block size of the largest message pool class (at most 250 or 1490 bytes), minus 2 bytes if `frame_header` is enabled and another 2 bytes if `dedup` is enabled.
      *
      * @return ESP_OK on success.
      * @return ESP_ERR_INVALID_ARG if data is NULL, data_len is zero or exceeds the limit.
      * @return ESP_ERR_INVALID_STATE if the module is not initialised or the queue is almost full.
-     * @return ESP_ERR_NO_MEM if memory allocation for the internal copy fails.
+     * @return ESP_ERR_NO_MEM if there is no free block in the message pool for the internal copy.
      * @return ESP_FAIL if sending to the queue fails (e.g., timeout).
      */
     esp_err_t zh_espnow_send(const uint8_t *target, const uint8_t *data, const uint16_t data_len);
 
     /**
-     * @brief Get the ESP-NOW version.
+     * @brief Same as zh_espnow_send() for the instance `handle`.
      *
-     * @return The version number as an unsigned 8-bit integer, or 0 on failure.
+     * @param[in] handle Instance handle returned by zh_espnow_instance_init().
      */
-    uint8_t zh_espnow_get_version(void);
+    esp_err_t zh_espnow_instance_send(zh_espnow_handle_t handle, const uint8_t *target, const uint8_t *data, const uint16_t data_len);
 
     /**
-     * @brief Get a pointer to the current statistics structure.
+     * @brief Send an ESP-NOW message and get its identifier.
      *
-     * The returned pointer is valid as long as the module is initialised.
-     * The statistics are updated internally in real time.
+     * Same as zh_espnow_send(). Every queued message gets a non-zero identifier that increases monotonically (wrapping
+     * around after 2^32 - 1 messages) and is reported in `zh_espnow_event_on_send_t::msg_id`.
      *
-     * @return Pointer to the statistics structure (const).
+     * @param[in] target Pointer to a 6-byte MAC address. If NULL, broadcast is used.
+     * @param[in] data Pointer to the payload data to be sent. Must not be NULL.
+     * @param[in] data_len Length of the payload in bytes. Same limit as zh_espnow_send().
+     * @param[out] msg_id Optional pointer receiving the message identifier. May be NULL.
+     *
+     * @return Same as zh_espnow_send().
      */
-    const zh_espnow_stats_t *zh_espnow_get_stats(void);
+    esp_err_t zh_espnow_send_ex(const uint8_t *target, const uint8_t *data, uint16_t data_len, uint32_t *msg_id);
 
     /**
-     * @brief Reset all statistics counters to zero.
+     * @brief Same as zh_espnow_send_ex() for the instance `handle`.
      *
-     * This function resets all fields of the internal statistics structure.
+     * @param[in] handle Instance handle returned by zh_espnow_instance_init().
      */
-    void zh_espnow_reset_stats(void);
+    esp_err_t zh_espnow_instance_send_ex(zh_espnow_handle_t handle, const uint8_t *target, const uint8_t *data, uint16_t data_len, uint32_t *msg_id);
 
     /**
-     * @brief Retrieve the MAC address of the Wi-Fi interface used by ESP-NOW.
+     * @brief Send an ESP-NOW message with options.
      *
-     * @param[out] mac_addr Pointer to a 6-byte buffer where the MAC address will be stored.
+     * Same as zh_espnow_send_ex(), but the message is queued in the transmit queue of `options->priority`. A class whose
+     * queue size is 0 falls back to the normal queue. If the queue is almost full, the caller is blocked for up to
+     * `options->timeout` until the transmit task makes room. A timeout of 0 gives a non-blocking try-send.
      *
-     * @return ESP_OK on success.
-     * @return ESP_ERR_INVALID_ARG if mac_addr is NULL.
-     * @return Other errors from esp_wifi_get_mac().
+     * Control messages are taken before any other message and are never held for coalescing. If `control_queue_size` > 0
+     * and `tx_window` > 1, one window slot is kept free for them, so a control message waits at most for other control
+     * messages, not for the retries of normal or bulk frames.
+     *
+     * @param[in] target Pointer to a 6-byte MAC address. If NULL, broadcast is used.
+     * @param[in] data Pointer to the payload data to be sent. Must not be NULL.
+     * @param[in] data_len Length of the payload in bytes. Same limit as zh_espnow_send().
+     * @param[in] options Pointer to the options. If NULL, ZH_ESPNOW_SEND_OPTIONS_DEFAULT() is used.
+     * @param[out] msg_id Optional pointer receiving the message identifier. May be NULL.
+     *
+     * @return Same as zh_espnow_send(). ESP_ERR_INVALID_ARG also if the priority is invalid, ESP_ERR_INVALID_STATE if there is no room in the queue within the timeout.
      */
-    esp_err_t zh_espnow_get_mac(uint8_t *mac_addr);
+    esp_err_t zh_espnow_send_opt(const uint8_t *target, const uint8_t *data, uint16_t data_len, const zh_espnow_send_options_t *options, uint32_t *msg_id);
+
+    /**
+     * @brief Same as zh_espnow_send_opt() for the instance `handle`.
+     *
+     * @param[in] handle Instance handle returned by zh_espnow_instance_init().
+     */
+    esp_err_t zh_espnow_instance_send_opt(zh_espnow_handle_t handle, const uint8_t *target, const uint8_t *data, uint16_t data_len, const zh_espnow_send_options_t *options, uint32_t *msg_id);
+
+    /**
+     * @brief Send an ESP-NOW message and wait for its send confirmation.
+     *
+     * Equivalent to zh_espnow_send_ex() followed by zh_espnow_wait_for(). `ZH_ESPNOW_ON_SEND_EVENT` is still posted.
+     *
+     * @param[in] target Pointer to a 6-byte MAC address. If NULL, broadcast is used.
+     * @param[in] data Pointer to the payload data to be sent. Must not be NULL.
+     * @param[in] data_len Length of the payload in bytes. Same limit as zh_espnow_send().
+     * @param[in] timeout Maximum time to wait for the confirmation in ticks, or portMAX_DELAY.
+     * @param[out] result Optional pointer receiving the result of the message. May be NULL.
+     *
+     * @return ESP_OK if the message was delivered.
+     * @return ESP_FAIL if the message could not be delivered.
+     * @return ESP_ERR_TIMEOUT if the confirmation did not arrive in time.
+     * @return Otherwise the same errors as zh_espnow_send().
+     */
+    esp_err_t zh_espnow_send_sync(const uint8_t *target, const uint8_t *data, uint16_t data_len, TickType_t timeout, zh_espnow_send_result_t *result);
+
+    /**
+     * @brief Same as zh_espnow_send_sync() for the instance `handle`.
+     *
+     * @param[in] handle Instance handle returned by zh_espnow_instance_init().
+     */
+    esp_err_t zh_espnow_instance_send_sync(zh_espnow_handle_t handle, const uint8_t *target, const uint8_t *data, uint16_t data_len, TickType_t timeout, zh_espnow_send_result_t *result);
+
+    /**
+     * @brief Wait for the send confirmation of a message.
+     *
+     * The calling task blocks on an internal semaphore until the transmit task reports the final result of the message,
+     * without a round trip through the event loop. The task notifications of the caller are left untouched. Results of
+     * the last 16 messages are kept, so the function may also be called after the message has completed.
+     *
+     * @note Up to 8 tasks can wait at the same time.
+     *
+     * @param[in] msg_id Identifier returned by zh_espnow_send_ex(). Must not be 0.
+     * @param[in] timeout Maximum time to wait in ticks, or portMAX_DELAY.
+     * @param[out] result Optional pointer receiving the result of the message. May be NULL.
+     *
+     * @return ESP_OK if the message was delivered.
+     * @return ESP_FAIL if the message could not be delivered.
+     * @return ESP_ERR_TIMEOUT if the result did not arrive in time (or was pushed out of the kept results).
+     * @return ESP_ERR_NO_MEM if too many tasks are waiting.
+     * @return ESP_ERR_INVALID_ARG if msg_id is 0.
+     * @return ESP_ERR_NOT_FOUND if the module is not initialised.
+     */
+    esp_err_t zh_espnow_wait_for(uint32_t msg_id, TickType_t timeout, zh_espnow_send_result_t *result);
+
+    /**
+     * @brief Same as zh_espnow_wait_for() for the instance `handle`.
+     *
+     * @param[in] handle Instance handle returned by zh_espnow_instance_init().
+     */
+    esp_err_t zh_espnow_instance_wait_for(zh_espnow_handle_t handle, uint32_t msg_id, TickType_t timeout, zh_espnow_send_result_t *result);
+
+    /**
+     * @brief Send a batch of ESP-NOW messages.
+     *
+     * Queue space is reserved once for the whole batch and the fragments of every entry are gathered directly into internal buffers.
+     * Entries that do not fit into the queue are rejected without blocking; the remaining entries are still processed.
+     *
+     * @param[in] entries Array of message descriptors. Must not be NULL.
+     * @param[in] entries_num Number of entries. Must be > 0.
+     * @param[out] results Optional array of `entries_num` elements receiving the result of every entry (same codes as zh_espnow_send()). May be NULL.
+     *
+     * @return ESP_OK if all entries were accepted.
+     * @return ESP_ERR_INVALID_ARG if entries is NULL or entries_num is zero.
+     * @return ESP_ERR_NOT_FOUND if the module is not initialised.
+     * @return Otherwise the error of the first rejected entry.
+     */
+    esp_err_t zh_espnow_send_batch(const zh_espnow_batch_entry_t *entries, uint16_t entries_num, esp_err_t *results);
+
+    /**
+     * @brief Same as zh_espnow_send_batch() for the instance `handle`.
+     *
+     * @param[in] handle Instance handle returned by zh_espnow_instance_init().
+     */
+    esp_err_t zh_espnow_instance_send_batch(zh_espnow_handle_t handle, const zh_espnow_batch_entry_t *entries, uint16_t entries_num, esp_err_t *results);
+
+    /**
+     * @brief Flush the buffered outgoing messages and wait until they are sent.
+     *
+     * In battery scheduling mode (`burst_size` > 0) the buffered messages are sent in one burst right away. In normal
+     * mode the function waits until the messages already queued have been sent. `ZH_ESPNOW_ON_BURST_COMPLETE_EVENT` is
+     * posted (if anything was sent) before the function returns, after that the node may go to sleep.
+     *
+     * @param[in] timeout Maximum time to wait for the burst to complete in ticks, or portMAX_DELAY. 0 only starts the flush.
+     *
+     * @return ESP_OK if the burst has completed (or was started, if timeout is 0).
+     * @return ESP_ERR_TIMEOUT if the burst did not complete in time.
+     * @return ESP_ERR_NOT_FOUND if the module is not initialised.
+     */
+    esp_err_t zh_espnow_flush(TickType_t timeout);
+
+    /**
+     * @brief Same as zh_espnow_flush() for the instance `handle`.
+     *
+     * @param[in] handle Instance handle returned by zh_espnow_instance_init().
+     */
+    esp_err_t zh_espnow_instance_flush(zh_espnow_handle_t handle, TickType_t timeout);
+
+    /**
+     * @brief Get the ESP-NOW version.
+     *
+     * @return The version number as an unsigned 8-bit integer, or 0 on failure.
+     */
+    uint8_t zh_espnow_get_version(void);
+
+    /**
+     * @brief Get a pointer to the current statistics structure.
+     *
+     * The returned pointer is valid as long as the module is initialised.
+     * The statistics are updated internally in real time.
+     *
+     * @note The fields may change while they are read. Use zh_espnow_get_stats_snapshot() for a coherent copy.
+     *
+     * @return Pointer to the statistics structure (const).
+     */
+    const zh_espnow_stats_t *zh_espnow_get_stats(void);
+
+    /**
+     * @brief Same as zh_espnow_get_stats() for the instance `handle`.
+     *
+     * @param[in] handle Instance handle returned by zh_espnow_instance_init().
+     * @return NULL if the handle is NULL.
+     */
+    const zh_espnow_stats_t *zh_espnow_instance_get_stats(zh_espnow_handle_t handle);
+
+    /**
+     * @brief Copy the statistics atomically.
+     *
+     * All counters are updated under a common lock, so the copy is coherent (e.g. a sent message is reflected in
+     * `sent_success` and the histograms together). The current queue depths are filled in as well.
+     *
+     * @param[out] stats Pointer to a structure receiving the copy. Must not be NULL.
+     *
+     * @return ESP_OK on success.
+     * @return ESP_ERR_INVALID_ARG if stats is NULL.
+     */
+    esp_err_t zh_espnow_get_stats_snapshot(zh_espnow_stats_t *stats);
+
+    /**
+     * @brief Same as zh_espnow_get_stats_snapshot() for the instance `handle`.
+     *
+     * @param[in] handle Instance handle returned by zh_espnow_instance_init().
+     */
+    esp_err_t zh_espnow_instance_get_stats_snapshot(zh_espnow_handle_t handle, zh_espnow_stats_t *stats);
+
+    /**
+     * @brief Encode a snapshot of the statistics and of all cached peers into a compact binary record.
+     *
+     * The record is intended to be shipped upstream as is. Layout (integers are unsigned LEB128 varints):
+     * - 1 byte format version (2), 1 byte number of statistics counters `N`.
+     * - `N` varints: the fields of zh_espnow_stats_t in declaration order, histograms expanded.
+     * - 1 byte number of peers, then per peer: 6 bytes MAC address, varints `sent_success`, `sent_fail`, `received`,
+     *   `delivery_ratio`, `confirm_latency_us`, `throttled` and `queue_wait_us`, 1 byte RSSI (signed).
+     *
+     * @param[out] buffer Pointer to the output buffer. Must not be NULL. ZH_ESPNOW_STATS_EXPORT_MAX_SIZE bytes are always enough.
+     * @param[in] size Size of the buffer in bytes.
+     * @param[out] length Pointer receiving the length of the record in bytes. Must not be NULL.
+     *
+     * @return ESP_OK on success.
+     * @return ESP_ERR_INVALID_ARG if an argument is NULL.
+     * @return ESP_ERR_INVALID_SIZE if the buffer is too small.
+     */
+    esp_err_t zh_espnow_export_stats(uint8_t *buffer, uint16_t size, uint16_t *length);
+
+    /**
+     * @brief Same as zh_espnow_export_stats() for the instance `handle`.
+     *
+     * @param[in] handle Instance handle returned by zh_espnow_instance_init().
+     */
+    esp_err_t zh_espnow_instance_export_stats(zh_espnow_handle_t handle, uint8_t *buffer, uint16_t size, uint16_t *length);
+
+    /**
+     * @brief Find the histogram bucket holding a percentile.
+     *
+     * For the latency histograms bucket `i` covers values below `ZH_ESPNOW_HISTOGRAM_BASE_US << i`, so e.g. the p99 send
+     * latency is below `ZH_ESPNOW_HISTOGRAM_BASE_US << zh_espnow_hist_percentile(stats.send_latency_hist, 99)` microseconds
+     * unless the last bucket is returned.
+     *
+     * @param[in] hist Histogram of zh_espnow_stats_t. Must not be NULL.
+     * @param[in] percent Percentile in the range 1..100.
+     *
+     * @return Index of the bucket, or 0 if the histogram is empty.
+     */
+    uint8_t zh_espnow_hist_percentile(const uint32_t *hist, uint8_t percent);
+
+    /**
+     * @brief Reset all statistics counters to zero.
+     *
+     * This function resets all fields of the internal statistics structure and the counters of the cached peers.
+     */
+    void zh_espnow_reset_stats(void);
+
+    /**
+     * @brief Same as zh_espnow_reset_stats() for the instance `handle`.
+     *
+     * @param[in] handle Instance handle returned by zh_espnow_instance_init().
+     */
+    void zh_espnow_instance_reset_stats(zh_espnow_handle_t handle);
+
+    /**
+     * @brief Measure the payload codec on a sample payload.
+     *
+     * The sample is compressed and decompressed once with the codec used for `compression`, and the CPU cycles of both
+     * steps are returned. Dividing them by `data_len` gives the cost per byte for payloads of this kind.
+     *
+     * @param[in] data Pointer to the sample payload. Must not be NULL.
+     * @param[in] data_len Length of the sample in bytes. Must be > 0 and not exceed the maximum payload size.
+     * @param[out] result Pointer receiving the compressed size and the cycle counts. Must not be NULL.
+     *
+     * @return ESP_OK on success.
+     * @return ESP_ERR_INVALID_ARG if an argument is invalid.
+     * @return ESP_ERR_NOT_SUPPORTED if `compression` is disabled.
+     * @return ESP_ERR_NO_MEM if the buffers could not be allocated.
+     * @return ESP_FAIL if the decompressed sample differs from the original.
+     * @return ESP_ERR_NOT_FOUND if the module is not initialised.
+     */
+    esp_err_t zh_espnow_codec_benchmark(const uint8_t *data, uint16_t data_len, zh_espnow_codec_benchmark_t *result);
+
+    /**
+     * @brief Same as zh_espnow_codec_benchmark() for the instance `handle`.
+     *
+     * @param[in] handle Instance handle returned by zh_espnow_instance_init().
+     */
+    esp_err_t zh_espnow_instance_codec_benchmark(zh_espnow_handle_t handle, const uint8_t *data, uint16_t data_len, zh_espnow_codec_benchmark_t *result);
+
+    /**
+     * @brief Copy the records of the trace ring, oldest first.
+     *
+     * If the ring holds more records than fit, the newest ones are copied.
+     *
+     * @param[out] records Pointer to the output array. Must not be NULL.
+     * @param[in,out] count On input the size of `records`, on output the number of records copied. Must not be NULL.
+     *
+     * @return ESP_OK on success.
+     * @return ESP_ERR_INVALID_ARG if an argument is invalid.
+     * @return ESP_ERR_NOT_SUPPORTED if `trace_size` is 0.
+     */
+    esp_err_t zh_espnow_trace_dump(zh_espnow_trace_record_t *records, uint16_t *count);
+
+    /**
+     * @brief Same as zh_espnow_trace_dump() for the instance `handle`.
+     *
+     * @param[in] handle Instance handle returned by zh_espnow_instance_init().
+     */
+    esp_err_t zh_espnow_instance_trace_dump(zh_espnow_handle_t handle, zh_espnow_trace_record_t *records, uint16_t *count);
+
+    /**
+     * @brief Export the trace ring in binary form for the host decoder (tools/zh_espnow_trace.py).
+     *
+     * The buffer starts with a ZH_ESPNOW_TRACE_EXPORT_HEADER_SIZE byte header (format version, record size, CPU
+     * frequency in MHz, number of records and number of records lost since the last clear, little-endian), followed by
+     * the records as in zh_espnow_trace_dump().
+     *
+     * @param[out] buffer Pointer to the output buffer. Must not be NULL.
+     * @param[in] size Size of the buffer in bytes. Records that do not fit are left out (newest kept).
+     * @param[out] length Pointer receiving the number of bytes written. Must not be NULL.
+     *
+     * @return ESP_OK on success.
+     * @return ESP_ERR_INVALID_ARG if an argument is invalid.
+     * @return ESP_ERR_INVALID_SIZE if the buffer cannot hold the header.
+     * @return ESP_ERR_NOT_SUPPORTED if `trace_size` is 0.
+     */
+    esp_err_t zh_espnow_trace_export(uint8_t *buffer, uint32_t size, uint32_t *length);
+
+    /**
+     * @brief Same as zh_espnow_trace_export() for the instance `handle`.
+     *
+     * @param[in] handle Instance handle returned by zh_espnow_instance_init().
+     */
+    esp_err_t zh_espnow_instance_trace_export(zh_espnow_handle_t handle, uint8_t *buffer, uint32_t size, uint32_t *length);
+
+    /**
+     * @brief Discard all records of the trace ring.
+     */
+    void zh_espnow_trace_clear(void);
+
+    /**
+     * @brief Same as zh_espnow_trace_clear() for the instance `handle`.
+     *
+     * @param[in] handle Instance handle returned by zh_espnow_instance_init().
+     */
+    void zh_espnow_instance_trace_clear(zh_espnow_handle_t handle);
+
+    /**
+     * @brief Retrieve the MAC address of the Wi-Fi interface used by ESP-NOW.
+     *
+     * @param[out] mac_addr Pointer to a 6-byte buffer where the MAC address will be stored.
+     *
+     * @return ESP_OK on success.
+     * @return ESP_ERR_INVALID_ARG if mac_addr is NULL.
+     * @return Other errors from esp_wifi_get_mac().
+     */
+    esp_err_t zh_espnow_get_mac(uint8_t *mac_addr);
+
+    /**
+     * @brief Same as zh_espnow_get_mac() for the instance `handle`.
+     *
+     * @param[in] handle Instance handle returned by zh_espnow_instance_init().
+     */
+    esp_err_t zh_espnow_instance_get_mac(zh_espnow_handle_t handle, uint8_t *mac_addr);
+
+    /**
+     * @brief Register a direct receive handler.
+     *
+     * While a handler is registered, received frames are delivered straight from the internal buffer to the handler
+     * and `ZH_ESPNOW_ON_RECV_EVENT` is not posted. This avoids copying every frame into the event loop.
+     *
+     * @note The handler runs in the receive task and should return quickly. Leased buffers are taken from the message pool,
+     *       so holding many of them starves reception.
+     *
+     * @param[in] handler Handler to register, or NULL to return to event based delivery.
+     * @param[in] arg User argument passed to the handler.
+     *
+     * @return ESP_OK on success.
+     * @return ESP_ERR_NOT_FOUND if the module is not initialised.
+     * @return ESP_ERR_INVALID_STATE if the module is in battery mode.
+     */
+    esp_err_t zh_espnow_register_recv_handler(zh_espnow_recv_handler_t handler, void *arg);
+
+    /**
+     * @brief Same as zh_espnow_register_recv_handler() for the instance `handle`.
+     *
+     * @param[in] handle Instance handle returned by zh_espnow_instance_init().
+     */
+    esp_err_t zh_espnow_instance_register_recv_handler(zh_espnow_handle_t handle, zh_espnow_recv_handler_t handler, void *arg);
+
+    /**
+     * @brief Release a received buffer leased by a direct receive handler.
+     *
+     * @param[in] data The `data` pointer of the view the lease was taken on. NULL is ignored.
+     */
+    void zh_espnow_recv_release(const uint8_t *data);
+
+    /**
+     * @brief Register a peer in the peer cache and protect it from eviction.
+     *
+     * Pinned peers stay registered in the ESP-NOW driver until they are unpinned or the module is deinitialised.
+     *
+     * @param[in] mac_addr Pointer to a 6-byte MAC address of the peer. Must not be NULL.
+     *
+     * @return ESP_OK on success.
+     * @return ESP_ERR_INVALID_ARG if mac_addr is NULL.
+     * @return ESP_ERR_NOT_FOUND if the module is not initialised.
+     * @return ESP_ERR_NO_MEM if all cache entries are pinned.
+     * @return Other errors from esp_now_add_peer().
+     */
+    esp_err_t zh_espnow_peer_pin(const uint8_t *mac_addr);
+
+    /**
+     * @brief Same as zh_espnow_peer_pin() for the instance `handle`.
+     *
+     * @param[in] handle Instance handle returned by zh_espnow_instance_init().
+     */
+    esp_err_t zh_espnow_instance_peer_pin(zh_espnow_handle_t handle, const uint8_t *mac_addr);
+
+    /**
+     * @brief Allow a pinned peer to be evicted from the peer cache again.
+     *
+     * @param[in] mac_addr Pointer to a 6-byte MAC address of the peer. Must not be NULL.
+     *
+     * @return ESP_OK on success.
+     * @return ESP_ERR_INVALID_ARG if mac_addr is NULL.
+     * @return ESP_ERR_NOT_FOUND if no instance is initialised or the peer is not in the cache.
+     */
+    esp_err_t zh_espnow_peer_unpin(const uint8_t *mac_addr);
+
+    /**
+     * @brief Get the link quality estimates of a peer.
+     *
+     * The estimates are kept in the peer cache and drive the retry policy: the confirmation timeout follows the measured
+     * confirmation latency, failed attempts are retried after an exponential backoff with jitter, and after 3 consecutive
+     * failed messages the peer is marked unreachable, so further messages fail immediately until a probe succeeds.
+     *
+     * @note The estimates of a peer are reset when it is evicted from the peer cache.
+     *
+     * @param[in] mac_addr Pointer to a 6-byte MAC address of the peer. Must not be NULL.
+     * @param[out] peer_stats Pointer to a structure receiving the estimates. Must not be NULL.
+     *
+     * @return ESP_OK on success.
+     * @return ESP_ERR_INVALID_ARG if an argument is NULL.
+     * @return ESP_ERR_NOT_FOUND if no instance is initialised or the peer is not in the cache.
+     */
+    esp_err_t zh_espnow_get_peer_stats(const uint8_t *mac_addr, zh_espnow_peer_stats_t *peer_stats);
+
+    /**
+     * @brief Get the statistics of all peers in the peer cache.
+     *
+     * The table is bounded by `peer_cache_size`; the counters of a peer are lost when it is evicted.
+     *
+     * @param[out] table Pointer to an array receiving the statistics. Must not be NULL.
+     * @param[in,out] count On input, capacity of the array in entries. On output, number of entries filled. Must not be NULL.
+     *
+     * @return ESP_OK on success.
+     * @return ESP_ERR_INVALID_ARG if an argument is NULL.
+     * @return ESP_ERR_NOT_FOUND if no instance is initialised.
+     */
+    esp_err_t zh_espnow_get_peer_stats_table(zh_espnow_peer_stats_t *table, uint8_t *count);
+
+    /**
+     * @brief Set the mode of the MAC address part of the receive filter.
+     *
+     * The receive filter is evaluated in the Wi-Fi receive callback before any allocation or queueing. Filter updates
+     * never block the callback: it reads the rules optimistically and lets a frame through if they changed meanwhile.
+     *
+     * @param[in] mode Filter mode.
+     *
+     * @return ESP_OK on success.
+     * @return ESP_ERR_INVALID_ARG if the mode is invalid.
+     * @return ESP_ERR_NOT_FOUND if the module is not initialised.
+     * @return ESP_ERR_NOT_SUPPORTED if `filter_size` is 0 and a mode other than ZH_ESPNOW_FILTER_OFF is requested.
+     */
+    esp_err_t zh_espnow_filter_set_mode(zh_espnow_filter_mode_t mode);
+
+    /**
+     * @brief Same as zh_espnow_filter_set_mode() for the instance `handle`.
+     *
+     * @param[in] handle Instance handle returned by zh_espnow_instance_init().
+     */
+    esp_err_t zh_espnow_instance_filter_set_mode(zh_espnow_handle_t handle, zh_espnow_filter_mode_t mode);
+
+    /**
+     * @brief Add a MAC address to the receive filter and reset its hit counter.
+     *
+     * @param[in] mac_addr Pointer to a 6-byte MAC address. Must not be NULL.
+     *
+     * @return ESP_OK on success (also if the address is already present).
+     * @return ESP_ERR_INVALID_ARG if mac_addr is NULL.
+     * @return ESP_ERR_NOT_FOUND if the module is not initialised.
+     * @return ESP_ERR_NOT_SUPPORTED if `filter_size` is 0.
+     * @return ESP_ERR_NO_MEM if the filter already holds `filter_size` addresses.
+     */
+    esp_err_t zh_espnow_filter_add(const uint8_t *mac_addr);
+
+    /**
+     * @brief Same as zh_espnow_filter_add() for the instance `handle`.
+     *
+     * @param[in] handle Instance handle returned by zh_espnow_instance_init().
+     */
+    esp_err_t zh_espnow_instance_filter_add(zh_espnow_handle_t handle, const uint8_t *mac_addr);
+
+    /**
+     * @brief Remove a MAC address from the receive filter.
+     *
+     * @param[in] mac_addr Pointer to a 6-byte MAC address. Must not be NULL.
+     *
+     * @return ESP_OK on success.
+     * @return ESP_ERR_INVALID_ARG if mac_addr is NULL.
+     * @return ESP_ERR_NOT_FOUND if the module is not initialised or the address is not in the filter.
+     */
+    esp_err_t zh_espnow_filter_remove(const uint8_t *mac_addr);
+
+    /**
+     * @brief Same as zh_espnow_filter_remove() for the instance `handle`.
+     *
+     * @param[in] handle Instance handle returned by zh_espnow_instance_init().
+     */
+    esp_err_t zh_espnow_instance_filter_remove(zh_espnow_handle_t handle, const uint8_t *mac_addr);
+
+    /**
+     * @brief Set a payload prefix rule of the receive filter.
+     *
+     * While at least one rule is set, data frames are accepted only if their payload starts with the prefix of one of
+     * the rules (e.g. a message type or magic). Internal frames (bulk transfers) are not affected.
+     *
+     * @param[in] index Index of the rule (0 to ZH_ESPNOW_FILTER_PREFIX_RULES - 1).
+     * @param[in] prefix Pointer to the prefix. May be NULL only if `prefix_len` is 0.
+     * @param[in] prefix_len Length of the prefix in bytes (up to ZH_ESPNOW_FILTER_PREFIX_MAX). 0 removes the rule.
+     *
+     * @return ESP_OK on success.
+     * @return ESP_ERR_INVALID_ARG if an argument is invalid.
+     * @return ESP_ERR_NOT_FOUND if the module is not initialised.
+     */
+    esp_err_t zh_espnow_filter_set_prefix(uint8_t index, const uint8_t *prefix, uint8_t prefix_len);
+
+    /**
+     * @brief Same as zh_espnow_filter_set_prefix() for the instance `handle`.
+     *
+     * @param[in] handle Instance handle returned by zh_espnow_instance_init().
+     */
+    esp_err_t zh_espnow_instance_filter_set_prefix(zh_espnow_handle_t handle, uint8_t index, const uint8_t *prefix, uint8_t prefix_len);
+
+    /**
+     * @brief Get the hit counter of a MAC address of the receive filter.
+     *
+     * The counter is incremented for every frame from the address, whether the mode accepts or drops it.
+     *
+     * @param[in] mac_addr Pointer to a 6-byte MAC address. Must not be NULL.
+     * @param[out] hits Pointer receiving the counter. Must not be NULL.
+     *
+     * @return ESP_OK on success.
+     * @return ESP_ERR_INVALID_ARG if an argument is NULL.
+     * @return ESP_ERR_NOT_FOUND if the module is not initialised or the address is not in the filter.
+     */
+    esp_err_t zh_espnow_filter_get_hits(const uint8_t *mac_addr, uint32_t *hits);
+
+    /**
+     * @brief Same as zh_espnow_filter_get_hits() for the instance `handle`.
+     *
+     * @param[in] handle Instance handle returned by zh_espnow_instance_init().
+     */
+    esp_err_t zh_espnow_instance_filter_get_hits(zh_espnow_handle_t handle, const uint8_t *mac_addr, uint32_t *hits);
+
+    /**
+     * @brief Get the hit counter of a payload prefix rule of the receive filter.
+     *
+     * @param[in] index Index of the rule.
+     * @param[out] hits Pointer receiving the number of data frames accepted by the rule. Must not be NULL.
+     *
+     * @return ESP_OK on success.
+     * @return ESP_ERR_INVALID_ARG if an argument is invalid.
+     * @return ESP_ERR_NOT_FOUND if the module is not initialised.
+     */
+    esp_err_t zh_espnow_filter_get_prefix_hits(uint8_t index, uint32_t *hits);
+
+    /**
+     * @brief Same as zh_espnow_filter_get_prefix_hits() for the instance `handle`.
+     *
+     * @param[in] handle Instance handle returned by zh_espnow_instance_init().
+     */
+    esp_err_t zh_espnow_instance_filter_get_prefix_hits(zh_espnow_handle_t handle, uint8_t index, uint32_t *hits);
+
+    /**
+     * @brief Send a message through the relay layer.
+     *
+     * The message carries a routing header (origin, destination, hop limit, sequence number) and is forwarded by every
+     * node with `relay_ttl` > 0 until it reaches its destination or the hop limit. Every node drops messages it has
+     * already seen. Routes are learned from the relay messages passing by: a message for a destination heard before
+     * is sent to the neighbour it came from, otherwise it is flooded with a broadcast.
+     *
+     * `ZH_ESPNOW_ON_SEND_EVENT` reports the transmission to the first hop only. The receiving node gets the message with
+     * `ZH_ESPNOW_ON_RECV_EVENT` (or the receive handler) with the MAC address of the origin.
+     *
+     * @param[in] target Pointer to a 6-byte MAC address of the destination. If NULL, the message is delivered to every node.
+     * @param[in] data Pointer to the payload data to be sent. Must not be NULL.
+     * @param[in] data_len Length of the payload in bytes. Must be > 0 and <= the limit of zh_espnow_send() minus `ZH_ESPNOW_RELAY_OVERHEAD`.
+     * @param[out] msg_id Optional pointer receiving the message identifier. May be NULL.
+     *
+     * @return ESP_OK on success.
+     * @return ESP_ERR_INVALID_ARG if an argument is invalid.
+     * @return ESP_ERR_NOT_FOUND if the module is not initialised.
+     * @return ESP_ERR_NOT_SUPPORTED if `relay_ttl` is 0.
+     * @return ESP_ERR_INVALID_STATE if the queue is almost full.
+     */
+    esp_err_t zh_espnow_relay_send(const uint8_t *target, const uint8_t *data, uint16_t data_len, uint32_t *msg_id);
+
+    /**
+     * @brief Same as zh_espnow_relay_send() for the instance `handle`.
+     *
+     * @param[in] handle Instance handle returned by zh_espnow_instance_init().
+     */
+    esp_err_t zh_espnow_instance_relay_send(zh_espnow_handle_t handle, const uint8_t *target, const uint8_t *data, uint16_t data_len, uint32_t *msg_id);
+
+    /**
+     * @brief Send an RPC request and wait for the reply.
+     *
+     * The request gets a call identifier and an entry in the table of pending calls (`rpc_pending_size` entries).
+     * The reply is matched by identifier and sender in the receive task and handed to the caller directly, without the
+     * event loop. The calling task blocks on an internal semaphore of the call (its task notifications are left untouched)
+     * until the reply arrives, the request fails or the deadline passes. Replies to a call that was already answered
+     * or has timed out are dropped and counted in the statistics.
+     *
+     * @note If `target` is the broadcast address, the first reply completes the call.
+     *
+     * @param[in] target Pointer to a 6-byte MAC address. If NULL, broadcast is used.
+     * @param[in] data Pointer to the request payload. Must not be NULL.
+     * @param[in] data_len Length of the request payload in bytes. Must be > 0 and <= the limit of zh_espnow_send() minus `ZH_ESPNOW_RPC_OVERHEAD`.
+     * @param[in] timeout Deadline of the call in ticks from now. Must be > 0 and not portMAX_DELAY.
+     * @param[out] reply Buffer receiving the reply payload. Must not be NULL.
+     * @param[in,out] reply_len Size of `reply` on input, length of the reply payload on output. Must not be NULL.
+     *
+     * @return ESP_OK if a reply arrived.
+     * @return ESP_ERR_TIMEOUT if no reply arrived before the deadline.
+     * @return ESP_FAIL if the request could not be delivered.
+     * @return ESP_ERR_INVALID_SIZE if the reply is larger than `reply`. `reply_len` is set to the reply length.
+     * @return ESP_ERR_INVALID_ARG if an argument is invalid.
+     * @return ESP_ERR_NOT_FOUND if the module is not initialised.
+     * @return ESP_ERR_NOT_SUPPORTED if `rpc_pending_size` is 0.
+     * @return ESP_ERR_NO_MEM if all entries of the table of pending calls are taken.
+     * @return ESP_ERR_INVALID_STATE if the queue is almost full.
+     */
+    esp_err_t zh_espnow_rpc_call(const uint8_t *target, const uint8_t *data, uint16_t data_len, TickType_t timeout, uint8_t *reply, uint16_t *reply_len);
+
+    /**
+     * @brief Same as zh_espnow_rpc_call() for the instance `handle`.
+     *
+     * @param[in] handle Instance handle returned by zh_espnow_instance_init().
+     */
+    esp_err_t zh_espnow_instance_rpc_call(zh_espnow_handle_t handle, const uint8_t *target, const uint8_t *data, uint16_t data_len, TickType_t timeout, uint8_t *reply, uint16_t *reply_len);
+
+    /**
+     * @brief Send an RPC request and get the result through a callback.
+     *
+     * Same as zh_espnow_rpc_call(), but returns right after queueing the request. `callback` is called exactly once with
+     * the reply, a timeout or a delivery failure.
+     *
+     * @param[in] target Pointer to a 6-byte MAC address. If NULL, broadcast is used.
+     * @param[in] data Pointer to the request payload. Must not be NULL.
+     * @param[in] data_len Length of the request payload in bytes. Same limit as zh_espnow_rpc_call().
+     * @param[in] timeout Deadline of the call in ticks from now. Must be > 0 and not portMAX_DELAY.
+     * @param[in] callback Completion callback. Must not be NULL.
+     * @param[in] arg User argument passed to `callback`. May be NULL.
+     * @param[out] call_id Optional pointer receiving the call identifier. May be NULL.
+     *
+     * @return ESP_OK if the request was queued.
+     * @return Otherwise the same errors as zh_espnow_rpc_call() before waiting.
+     */
+    esp_err_t zh_espnow_rpc_call_async(const uint8_t *target, const uint8_t *data, uint16_t data_len, TickType_t timeout, zh_espnow_rpc_callback_t callback, void *arg, uint16_t *call_id);
+
+    /**
+     * @brief Same as zh_espnow_rpc_call_async() for the instance `handle`.
+     *
+     * @param[in] handle Instance handle returned by zh_espnow_instance_init().
+     */
+    esp_err_t zh_espnow_instance_rpc_call_async(zh_espnow_handle_t handle, const uint8_t *target, const uint8_t *data, uint16_t data_len, TickType_t timeout, zh_espnow_rpc_callback_t callback, void *arg, uint16_t *call_id);
+
+    /**
+     * @brief Send the reply to a received RPC request.
+     *
+     * @param[in] target Pointer to the 6-byte MAC address of the caller (`zh_espnow_event_on_rpc_request_t::mac_addr`). Must not be NULL.
+     * @param[in] call_id Identifier of the call (`zh_espnow_event_on_rpc_request_t::call_id`).
+     * @param[in] data Pointer to the reply payload. May be NULL if `data_len` is 0.
+     * @param[in] data_len Length of the reply payload in bytes. Same limit as zh_espnow_rpc_call().
+     *
+     * @return ESP_OK on success.
+     * @return ESP_ERR_INVALID_ARG if an argument is invalid.
+     * @return ESP_ERR_NOT_FOUND if the module is not initialised.
+     * @return ESP_ERR_NOT_SUPPORTED if `frame_header` is disabled.
+     * @return ESP_ERR_INVALID_STATE if the queue is almost full.
+     */
+    esp_err_t zh_espnow_rpc_reply(const uint8_t *target, uint16_t call_id, const uint8_t *data, uint16_t data_len);
+
+    /**
+     * @brief Same as zh_espnow_rpc_reply() for the instance `handle`.
+     *
+     * @param[in] handle Instance handle returned by zh_espnow_instance_init().
+     */
+    esp_err_t zh_espnow_instance_rpc_reply(zh_espnow_handle_t handle, const uint8_t *target, uint16_t call_id, const uint8_t *data, uint16_t data_len);
+
+    /**
+     * @brief Start an outgoing bulk transfer of a buffer.
+     *
+     * The buffer is split into fragments of `bulk_fragment_size` bytes which are sent with a sliding window and acknowledged
+     * selectively by the receiver. Progress and completion are reported with `ZH_ESPNOW_ON_BULK_PROGRESS_EVENT` and
+     * `ZH_ESPNOW_ON_BULK_COMPLETE_EVENT`. Only one outgoing transfer can run at a time.
+     *
+     * @warning The data is not copied. The buffer must stay valid until `ZH_ESPNOW_ON_BULK_COMPLETE_EVENT` is posted.
+     * @note Requires `frame_header` on both nodes.
+     *
+     * @param[in] target Pointer to a 6-byte unicast MAC address. Must not be NULL or the broadcast address.
+     * @param[in] data Pointer to the data. Must not be NULL.
+     * @param[in] data_len Length of the data in bytes. Must be > 0 and fit into 65535 fragments.
+     * @param[out] transfer_id Optional pointer receiving the identifier of the transfer. May be NULL.
+     *
+     * @return ESP_OK on success.
+     * @return ESP_ERR_INVALID_ARG if an argument is invalid.
+     * @return ESP_ERR_NOT_FOUND if the module is not initialised.
+     * @return ESP_ERR_NOT_SUPPORTED if `frame_header` is disabled or the module is in battery mode (acknowledgements cannot be received).
+     * @return ESP_ERR_INVALID_STATE if another outgoing transfer is running.
+     */
+    esp_err_t zh_espnow_bulk_send(const uint8_t *target, const uint8_t *data, uint32_t data_len, uint16_t *transfer_id);
+
+    /**
+     * @brief Same as zh_espnow_bulk_send() for the instance `handle`.
+     *
+     * @param[in] handle Instance handle returned by zh_espnow_instance_init().
+     */
+    esp_err_t zh_espnow_instance_bulk_send(zh_espnow_handle_t handle, const uint8_t *target, const uint8_t *data, uint32_t data_len, uint16_t *transfer_id);
+
+    /**
+     * @brief Start an outgoing bulk transfer pulling the data from a source callback.
+     *
+     * Same as zh_espnow_bulk_send(), but every fragment is read with `source` right before it is sent, so the data does not
+     * have to be kept in memory.
+     *
+     * @param[in] target Pointer to a 6-byte unicast MAC address. Must not be NULL or the broadcast address.
+     * @param[in] data_len Length of the data in bytes. Must be > 0 and fit into 65535 fragments.
+     * @param[in] source Data source. Must not be NULL.
+     * @param[in] arg User argument passed to the source.
+     * @param[out] transfer_id Optional pointer receiving the identifier of the transfer. May be NULL.
+     *
+     * @return Same as zh_espnow_bulk_send().
+     */
+    esp_err_t zh_espnow_bulk_send_from(const uint8_t *target, uint32_t data_len, zh_espnow_bulk_source_t source, void *arg, uint16_t *transfer_id);
+
+    /**
+     * @brief Same as zh_espnow_bulk_send_from() for the instance `handle`.
+     *
+     * @param[in] handle Instance handle returned by zh_espnow_instance_init().
+     */
+    esp_err_t zh_espnow_instance_bulk_send_from(zh_espnow_handle_t handle, const uint8_t *target, uint32_t data_len, zh_espnow_bulk_source_t source, void *arg, uint16_t *transfer_id);
+
+    /**
+     * @brief Register a streaming sink for incoming bulk transfers.
+     *
+     * While a sink is registered, incoming transfers of any size are delivered to the sink instead of the reassembly buffer.
+     * Fragments received out of order are held in the message pool until the gap is filled, so the pool should have at
+     * least `bulk_window` blocks of the sender available.
+     *
+     * @param[in] sink Sink to register, or NULL to use the reassembly buffer.
+     * @param[in] arg User argument passed to the sink.
+     *
+     * @return ESP_OK on success.
+     * @return ESP_ERR_NOT_FOUND if the module is not initialised.
+     * @return ESP_ERR_INVALID_STATE if the module is in battery mode.
+     */
+    esp_err_t zh_espnow_bulk_register_sink(zh_espnow_bulk_sink_t sink, void *arg);
+
+    /**
+     * @brief Same as zh_espnow_bulk_register_sink() for the instance `handle`.
+     *
+     * @param[in] handle Instance handle returned by zh_espnow_instance_init().
+     */
+    esp_err_t zh_espnow_instance_bulk_register_sink(zh_espnow_handle_t handle, zh_espnow_bulk_sink_t sink, void *arg);
+
+    /**
+     * @brief Release the reassembly buffer after a successful incoming bulk transfer.
+     *
+     * The buffer passed in `zh_espnow_event_on_bulk_t::data` is locked until this function is called. Incoming transfers
+     * are refused in the meantime.
+     */
+    void zh_espnow_bulk_release(void);
+
+    /**
+     * @brief Same as zh_espnow_bulk_release() for the instance `handle`.
+     *
+     * @param[in] handle Instance handle returned by zh_espnow_instance_init().
+     */
+    void zh_espnow_instance_bulk_release(zh_espnow_handle_t handle);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,91 @@
+#!/usr/bin/env python3
+"""Decode a zh_espnow trace export (zh_espnow_trace_export()) into readable text.
+
+The input is the exported buffer, either raw binary or as a hex string (whitespace is ignored):
+
+    python3 zh_espnow_trace.py trace.bin
+    python3 zh_espnow_trace.py --hex trace.txt
+
+Timestamps are printed per core in microseconds since the first record of that core, together with the delta to the
+previous record of the same core. The cycle counters of both cores are not synchronised, the record order is global.
+"""
+
+import argparse
+import struct
+import sys
+
+HEADER = struct.Struct("<BBHHI")
+RECORD = struct.Struct("<IIHBB")
+CORE_BIT = 0x80
+
+EVENTS = ["ENQUEUE", "DEQUEUE", "SEND", "CONFIRM", "DROP", "POST", "RECV"]
+DROPS = ["QUEUE_FULL", "NO_MEMORY", "FILTER", "DEDUP", "FRAME_ERROR"]
+PRIORITIES = ["CONTROL", "NORMAL", "BULK"]
+POSTS = ["RECV", "SEND", "BULK_PROGRESS", "BULK_COMPLETE", "QUEUE_WRITABLE", "BURST_COMPLETE", "RPC_REQUEST"]
+STATUSES = ["SUCCESS", "FAIL"]
+
+
+def name(table, index):
+    return table[index] if index < len(table) else str(index)
+
+
+def describe(event, arg, value):
+    if event in (0, 1):
+        extra = "len" if event == 0 else "in_flight"
+        return "priority=%s %s=%u" % (name(PRIORITIES, arg), extra, value)
+    if event == 2:
+        return "attempt=%u len=%u" % (arg, value)
+    if event == 3:
+        return "status=%s attempt=%u" % (name(STATUSES, arg), value)
+    if event == 4:
+        return "reason=%s len=%u" % (name(DROPS, arg), value)
+    if event == 5:
+        return "event=%s value=%u" % (name(POSTS, arg), value)
+    if event == 6:
+        return "frame_type=%u len=%u" % (arg, value)
+    return "arg=%u value=%u" % (arg, value)
+
+
+def decode(data, out):
+    if len(data) < HEADER.size:
+        raise ValueError("buffer is shorter than the header")
+    version, record_size, cpu_mhz, count, lost = HEADER.unpack_from(data)
+    if version != 1 or record_size != RECORD.size:
+        raise ValueError("unsupported export (version %u, record size %u)" % (version, record_size))
+    if len(data) < HEADER.size + count * RECORD.size:
+        raise ValueError("buffer is shorter than %u records" % count)
+    out.write("# %u records, %u lost, %u MHz\n" % (count, lost, cpu_mhz))
+    first = {}
+    last = {}
+    for i in range(count):
+        cycles, msg_id, value, event, arg = RECORD.unpack_from(data, HEADER.size + i * RECORD.size)
+        core = 1 if event & CORE_BIT else 0
+        event &= ~CORE_BIT
+        first.setdefault(core, cycles)
+        delta = ((cycles - last[core]) & 0xFFFFFFFF) if core in last else 0
+        last[core] = cycles
+        time_us = ((cycles - first[core]) & 0xFFFFFFFF) / cpu_mhz
+        out.write(
+            "%5u core%u %12.2f +%10.2f %-8s id=%-10u %s\n"
+            % (i, core, time_us, delta / cpu_mhz, name(EVENTS, event), msg_id, describe(event, arg, value))
+        )
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Decode a zh_espnow trace export.")
+    parser.add_argument("file", help="exported buffer, '-' reads stdin")
+    parser.add_argument("--hex", action="store_true", help="input is a hex string instead of raw binary")
+    args = parser.parse_args()
+    stream = sys.stdin.buffer if args.file == "-" else open(args.file, "rb")
+    with stream:
+        data = stream.read()
+    if args.hex:
+        data = bytes.fromhex("".join(data.decode("ascii").split()))
+    try:
+        decode(data, sys.stdout)
+    except ValueError as err:
+        sys.exit("zh_espnow_trace: %s" % err)
+
+
+if __name__ == "__main__":
+    main()
@@ -1,4 +1,8 @@
 #include "zh_espnow.h"
+#include "esp_timer.h"
+#include "esp_random.h"
+#include "esp_cpu.h"
+#include "esp_rom_sys.h"
 
 static const char *TAG = "zh_espnow";
 
@@ -29,9 +33,260 @@ static const char *TAG = "zh_espnow";
         continue;                                    \
     }
 
-#define DATA_SEND_SUCCESS BIT0
-#define DATA_SEND_FAIL BIT1
+// Per-message paths (zh_espnow_send() and the Wi-Fi callbacks) log only if ZH_ESPNOW_HOT_PATH_LOG is set, see the trace ring.
+#if ZH_ESPNOW_HOT_PATH_LOG
+#define ZH_LOGI_HOT(msg, ...) ZH_LOGI(msg, ##__VA_ARGS__)
+#define ZH_LOGE_HOT(msg, err, ...) ZH_LOGE(msg, err, ##__VA_ARGS__)
+#else
+#define ZH_LOGI_HOT(msg, ...)
+#define ZH_LOGE_HOT(msg, err, ...)
+#endif
+
+#define ZH_ERROR_CHECK_HOT(cond, err, cleanup, msg, ...) \
+    if (!(cond))                                         \
+    {                                                    \
+        ZH_LOGE_HOT(msg, err, ##__VA_ARGS__);            \
+        cleanup;                                         \
+        return err;                                      \
+    }
+
+#define ZH_ERROR_CHECK_VOID_HOT(cond, cleanup, msg, ...) \
+    if (!(cond))                                         \
+    {                                                    \
+        ZH_LOGE_HOT(msg, ESP_FAIL, ##__VA_ARGS__);       \
+        cleanup;                                         \
+        return;                                          \
+    }
+
 #define WAIT_CONFIRM_MAX_TIME 50
+#define WAIT_CONFIRM_MIN_TIME 10
+#define RETRY_BACKOFF_BASE 10
+#define RETRY_BACKOFF_MAX 200
+#define PEER_UNREACHABLE_FAILURES 3
+#define PEER_PROBE_INTERVAL 1000
+#define PEER_DELIVERY_SCALE 1000
+#define TX_WINDOW_MAX 16
+#define BULK_WINDOW_MAX 32
+#define BULK_ACK_TIMEOUT 200
+#define BULK_ACK_INTERVAL 4
+#define BULK_MAX_TIMEOUTS 10
+#define BULK_RX_IDLE_TIMEOUT 2000
+#define FRAME_FLAG_ACK_REQUEST BIT0
+#define FRAME_FLAG_SEQUENCE BIT1
+#define FRAME_FLAG_COMPRESSED BIT2
+#define COMPLETION_RING_SIZE 16
+#define SEND_WAITERS_MAX 8
+#define STATS_EXPORT_VERSION 2
+#define TRACE_EXPORT_VERSION 1
+#define DEDUP_SOURCES_MAX 16
+#define DEDUP_WINDOW 32
+#define FILTER_READ_ATTEMPTS 3
+#define COALESCE_SLOTS 4
+#define COALESCE_MESSAGES_MAX 16
+#define COALESCE_NONE 0xFF
+#define RELAY_SEEN_SIZE 32
+#define RELAY_ROUTES_MAX 16
+#define RELAY_ROUTE_TIMEOUT 60000
+#define RPC_RECENT_SIZE 16
+#define FAIR_NONE 0xFF
+#define PRIORITY_BULK_SHARE 4
+#define TX_EVENT_BURST_DONE (BIT0 << ZH_ESPNOW_PRIORITY_NUM)
+#define CODEC_MIN_SIZE 16
+#define CODEC_HASH_BITS 8
+#define CODEC_WINDOW 4096
+#define CODEC_LITERALS_MAX 128
+#define CODEC_MATCH_MIN 3
+#define CODEC_MATCH_MAX (CODEC_MATCH_MIN + 7 + UINT8_MAX)
+
+/**
+ * @brief Task blocked in zh_espnow_wait_for() until a message completes.
+ */
+typedef struct
+{
+    bool is_used;                   /*!< True if the entry is taken by a waiting task. */
+    bool is_done;                   /*!< True once the message has completed and `result` is valid. */
+    uint32_t msg_id;                /*!< Identifier of the awaited message. */
+    SemaphoreHandle_t wake;         /*!< Binary semaphore given on completion. Created at initialization and kept across uses of the entry. */
+    zh_espnow_send_result_t result; /*!< Result of the message. */
+} _send_waiter_t;
+
+/**
+ * @brief States of an entry of the table of pending RPC calls.
+ */
+enum
+{
+    RPC_FREE,    /*!< Entry not used. */
+    RPC_PENDING, /*!< Request sent, waiting for the reply. */
+    RPC_DONE     /*!< Blocking call completed, the result is not yet taken by the caller. */
+};
+
+/**
+ * @brief Entry of the table of pending RPC calls.
+ */
+typedef struct
+{
+    uint8_t state;                      /*!< RPC_FREE, RPC_PENDING or RPC_DONE. */
+    uint16_t call_id;                   /*!< Identifier of the call. */
+    uint8_t mac_addr[ESP_NOW_ETH_ALEN]; /*!< Target of the request. The broadcast address accepts a reply from any node. */
+    uint32_t msg_id;                    /*!< Identifier of the request message, to fail the call if it cannot be delivered. */
+    TickType_t deadline;                /*!< Tick count at which the call times out. */
+    int64_t sent_at;                    /*!< Time (in microseconds since boot) of the call. */
+    bool is_blocking;                   /*!< True for zh_espnow_rpc_call(), whose task waits on the semaphore of the entry in `rpc_wake`. */
+    zh_espnow_rpc_callback_t callback;  /*!< Completion callback of zh_espnow_rpc_call_async(). */
+    void *arg;                          /*!< Argument of `callback`. */
+    esp_err_t status;                   /*!< Result of a completed blocking call. */
+    zh_espnow_event_on_recv_t *reply;   /*!< Reply of a completed blocking call, handed over to the caller. NULL if none. */
+    uint32_t latency_us;                /*!< Round-trip time of a completed blocking call. */
+} _rpc_call_t;
+
+/**
+ * @brief Recently finished RPC call, to tell duplicate replies from late ones.
+ */
+typedef struct
+{
+    uint16_t call_id; /*!< Identifier of the call. 0 if the entry is empty. */
+    bool is_replied;  /*!< True if the call was completed by a reply. */
+} _rpc_recent_t;
+
+/**
+ * @brief Type of a frame, stored in the frame header.
+ */
+typedef enum
+{
+    FRAME_DATA,        /*!< Application message. */
+    FRAME_BULK_DATA,   /*!< Fragment of a bulk transfer. */
+    FRAME_BULK_ACK,    /*!< Selective acknowledgement of a bulk transfer. */
+    FRAME_COALESCED,   /*!< Several application messages, each preceded by a 1-byte length. */
+    FRAME_RELAY,       /*!< Application message routed over several hops. */
+    FRAME_RPC_REQUEST, /*!< RPC request, preceded by the call header. */
+    FRAME_RPC_REPLY,   /*!< RPC reply, preceded by the call header. */
+    FRAME_TYPE_NUM
+} _frame_type_t;
+
+/**
+ * @brief Header placed in front of every frame if `frame_header` is enabled.
+ */
+typedef struct __attribute__((packed))
+{
+    uint8_t type;  /*!< Frame type, see _frame_type_t. */
+    uint8_t flags; /*!< Frame flags, see FRAME_FLAG_*. */
+} _frame_header_t;
+
+/**
+ * @brief Header of a bulk transfer fragment. Follows the frame header and precedes the fragment data.
+ */
+typedef struct __attribute__((packed))
+{
+    uint16_t transfer_id;   /*!< Identifier of the transfer, unique per sender. */
+    uint16_t index;         /*!< Index of the fragment. */
+    uint16_t fragment_size; /*!< Length of every fragment except the last one. */
+    uint32_t total_len;     /*!< Total length of the transfer. */
+} _bulk_data_t;
+
+/**
+ * @brief Routing header of a relay message. Follows the frame header and precedes the payload.
+ */
+typedef struct __attribute__((packed))
+{
+    uint8_t origin[ESP_NOW_ETH_ALEN];      /*!< MAC address of the node that sent the message. */
+    uint8_t destination[ESP_NOW_ETH_ALEN]; /*!< MAC address of the final receiver. Broadcast address for every node. */
+    uint16_t seq;                          /*!< Sequence number of the message, unique per origin. */
+    uint8_t ttl;                           /*!< Number of hops the message may still take. */
+    uint8_t hops;                          /*!< Number of hops taken so far, not counting the current one. */
+} _relay_header_t;
+
+/**
+ * @brief Header of an RPC request or reply. Follows the frame header and precedes the payload.
+ */
+typedef struct __attribute__((packed))
+{
+    uint16_t call_id; /*!< Identifier of the call, unique per caller. */
+} _rpc_header_t;
+
+_Static_assert(sizeof(_frame_header_t) + sizeof(_bulk_data_t) == ZH_ESPNOW_BULK_OVERHEAD, "Bulk fragment overhead mismatch.");
+_Static_assert(sizeof(_relay_header_t) == ZH_ESPNOW_RELAY_OVERHEAD, "Relay overhead mismatch.");
+_Static_assert(sizeof(_rpc_header_t) == ZH_ESPNOW_RPC_OVERHEAD, "RPC overhead mismatch.");
+_Static_assert(offsetof(zh_espnow_event_on_rpc_request_t, call_id) == offsetof(zh_espnow_event_on_recv_t, data) && offsetof(zh_espnow_event_on_rpc_request_t, data) == offsetof(zh_espnow_event_on_recv_t, data) + sizeof(_rpc_header_t),
+               "A received RPC request must be usable as event data in place.");
+_Static_assert(sizeof(zh_espnow_stats_t) % sizeof(uint32_t) == 0 && sizeof(zh_espnow_stats_t) / sizeof(uint32_t) <= UINT8_MAX, "Statistics must consist of uint32_t counters.");
+
+/**
+ * @brief Status of a bulk transfer acknowledgement.
+ */
+enum
+{
+    BULK_ACK_OK,     /*!< Fragments received, continue. */
+    BULK_ACK_BUSY,   /*!< Receiver is busy with another transfer. */
+    BULK_ACK_REJECT, /*!< Transfer refused (too large, no reassembly buffer or sink error). */
+};
+
+/**
+ * @brief Payload of a bulk transfer acknowledgement frame.
+ */
+typedef struct __attribute__((packed))
+{
+    uint16_t transfer_id; /*!< Identifier of the acknowledged transfer. */
+    uint16_t base;        /*!< Index of the first fragment not yet received in order. */
+    uint32_t bitmap;      /*!< Bit i is set if fragment base + i was received out of order. */
+    uint8_t status;       /*!< Acknowledgement status. */
+} _bulk_ack_t;
+
+/**
+ * @brief State of the outgoing bulk transfer, owned by the transmit task.
+ *
+ * Bit i of the window bitmaps refers to fragment base + i.
+ */
+typedef struct
+{
+    bool is_active;                     /*!< True while the transfer is running. */
+    uint8_t mac_addr[ESP_NOW_ETH_ALEN]; /*!< MAC address of the receiver. */
+    uint16_t transfer_id;               /*!< Identifier of the transfer. */
+    uint32_t total_len;                 /*!< Total length of the transfer. */
+    uint16_t fragment_num;              /*!< Number of fragments. */
+    zh_espnow_bulk_source_t source;     /*!< Data source. */
+    void *arg;                          /*!< User argument of the data source. */
+    uint16_t base;                      /*!< Index of the first fragment not yet acknowledged in order. */
+    uint16_t next;                      /*!< Index of the first fragment never sent. */
+    uint32_t acked;                     /*!< Window bitmap of acknowledged fragments. */
+    uint32_t sent;                      /*!< Window bitmap of fragments sent and not considered lost. */
+    TickType_t deadline;                /*!< Tick count at which unacknowledged fragments are retransmitted. */
+    uint8_t timeouts;                   /*!< Number of consecutive acknowledgement timeouts. */
+    int64_t start_time;                 /*!< Time (in microseconds since boot) the transfer was started. */
+} _bulk_tx_t;
+
+/**
+ * @brief State of the incoming bulk transfer, owned by the receive task.
+ *
+ * Bit i of `received` refers to fragment base + i.
+ */
+typedef struct
+{
+    bool is_active;                                      /*!< True while the transfer is running. */
+    uint8_t mac_addr[ESP_NOW_ETH_ALEN];                  /*!< MAC address of the sender. */
+    uint16_t transfer_id;                                /*!< Identifier of the transfer. */
+    uint32_t total_len;                                  /*!< Total length of the transfer. */
+    uint16_t fragment_size;                              /*!< Length of every fragment except the last one. */
+    uint16_t fragment_num;                               /*!< Number of fragments. */
+    uint16_t base;                                       /*!< Index of the first fragment not yet received in order. */
+    uint32_t received;                                   /*!< Window bitmap of fragments received out of order. */
+    zh_espnow_event_on_recv_t *pending[BULK_WINDOW_MAX]; /*!< Fragments held until delivery to the sink, indexed by fragment index modulo the window. */
+    zh_espnow_bulk_sink_t sink;                          /*!< Streaming sink, or NULL if the reassembly buffer is used. */
+    void *sink_arg;                                      /*!< User argument of the sink. */
+    uint8_t unacked;                                     /*!< Number of fragments received since the last acknowledgement. */
+    int64_t start_time;                                  /*!< Time (in microseconds since boot) the first fragment was received. */
+    int64_t last_activity;                               /*!< Time (in microseconds since boot) the last fragment was received. */
+} _bulk_rx_t;
+
+/**
+ * @brief Last completed incoming bulk transfer, re-acknowledged if the sender missed the final acknowledgement.
+ */
+typedef struct
+{
+    bool is_valid;                      /*!< True if a transfer was completed. */
+    uint8_t mac_addr[ESP_NOW_ETH_ALEN]; /*!< MAC address of the sender. */
+    uint16_t transfer_id;               /*!< Identifier of the transfer. */
+    uint16_t fragment_num;              /*!< Number of fragments. */
+} _bulk_done_t;
 
 /**
  * @brief Internal queue item structure.
@@ -43,23 +298,336 @@ typedef struct
 {
     enum
     {
-        ON_RECV, /*!< Item is a received message to be processed. */
-        TO_SEND, /*!< Item is a send request. */
+        ON_RECV,  /*!< Item is a received message to be processed. */
+        TO_SEND,  /*!< Item is a send request. */
+        RPC_WAKE, /*!< Item only wakes the receive task to recompute the RPC deadlines. */
     } id;
-    struct
-    {
-        uint16_t payload_len;               /*!< Length of the payload. */
-        uint8_t mac_addr[ESP_NOW_ETH_ALEN]; /*!< MAC address (source for receive, destination for send). */
-        uint8_t *payload;                   /*!< Pointer to the payload data (heap-allocated). */
-    } data;
+    zh_espnow_event_on_recv_t *message; /*!< Pool block holding the MAC address (source for receive, destination for send), the payload length and the payload. */
+    int64_t timestamp;                  /*!< Time (in microseconds since boot) the item was created. */
+    int8_t rssi;                        /*!< RSSI of the received frame in dBm. Not used for send requests. */
+    uint8_t frame_type;                 /*!< Frame type, see _frame_type_t. Always FRAME_DATA if the frame header is disabled. */
+    uint8_t frame_flags;                /*!< Frame flags of a received frame. */
+    uint32_t msg_id;                    /*!< Identifier of an application message to send. 0 for internal frames. */
+    uint8_t priority;                   /*!< Priority class of a send request, see zh_espnow_priority_t. */
 } _queue_t;
 
+/**
+ * @brief Size class of the message pool.
+ *
+ * Every block starts with a `zh_espnow_event_on_recv_t` header followed by the payload, so a received block can be posted
+ * to the event loop as is. Free blocks are chained into an intrusive list through their first bytes.
+ */
+typedef struct
+{
+    uint8_t *memory;      /*!< Contiguous memory area holding all blocks of the class. */
+    void *free_list;      /*!< Head of the list of free blocks. */
+    uint16_t block_size;  /*!< Payload capacity of a block in bytes. */
+    uint16_t block_count; /*!< Number of blocks in the class. */
+    uint16_t stride;      /*!< Distance between two adjacent blocks in bytes. */
+} _pool_class_t;
+
+/**
+ * @brief Entry of the peer cache.
+ *
+ * Mirrors a peer registered in the ESP-NOW driver together with its link quality estimates, which drive the retry policy.
+ * Unpinned entries are evicted in LRU order when the cache is full.
+ */
+typedef struct
+{
+    uint8_t mac_addr[ESP_NOW_ETH_ALEN]; /*!< MAC address of the peer. */
+    wifi_interface_t ifidx;             /*!< Wi-Fi interface the peer is registered on in the ESP-NOW driver. */
+    bool is_used;                       /*!< True if the entry holds a registered peer. */
+    bool is_pinned;                     /*!< True if the peer must not be evicted. */
+    uint32_t last_used;                 /*!< Value of the LRU clock at the last use of the peer. */
+    uint8_t in_flight;                  /*!< Number of frames to the peer currently being transmitted. Such peers are never evicted. */
+    uint16_t delivery_ratio;            /*!< Moving average of successful transmission attempts in units of 1/PEER_DELIVERY_SCALE. */
+    uint32_t confirm_latency_us;        /*!< Moving average of the time from transmission to a successful confirmation. 0 if unknown. */
+    int8_t rssi;                        /*!< Moving average of the RSSI of frames received from the peer. 0 if unknown. */
+    uint8_t consecutive_failures;       /*!< Number of consecutive messages that failed after all attempts. */
+    bool is_unreachable;                /*!< True if messages to the peer fail immediately, except for periodic probes. */
+    TickType_t probe_at;                /*!< Tick count at which the next probe to an unreachable peer is allowed. */
+    uint32_t sent_success;              /*!< Number of confirmed frames to the peer. */
+    uint32_t sent_fail;                 /*!< Number of frames to the peer that failed after all attempts. */
+    uint32_t received;                  /*!< Number of frames received from the peer. */
+    uint32_t throttled;                 /*!< Number of messages to the peer held back by its token bucket. */
+    uint32_t queue_wait_us;             /*!< Moving average of the time data messages to the peer spent queued. 0 if unknown. */
+    uint32_t queue_wait_max_us;         /*!< Maximum time a data message to the peer spent queued. */
+} _peer_t;
+
+/**
+ * @brief Entry of the duplicate suppression table.
+ *
+ * Tracks the sequence numbers recently received from one sender. Entries are replaced in LRU order.
+ */
+typedef struct
+{
+    uint8_t mac_addr[ESP_NOW_ETH_ALEN]; /*!< MAC address of the sender. */
+    bool is_used;                       /*!< True if the entry tracks a sender. */
+    uint16_t last_seq;                  /*!< Highest sequence number received. */
+    uint32_t window;                    /*!< Bit `i` is set if sequence number `last_seq - i` was received. */
+    uint32_t last_used;                 /*!< Value of the LRU clock at the last frame from the sender. */
+} _dedup_entry_t;
+
+/**
+ * @brief States of a slot of the receive filter hash set.
+ */
+enum
+{
+    FILTER_SLOT_EMPTY,  /*!< Never used, ends a probe sequence. */
+    FILTER_SLOT_USED,   /*!< Holds an address. */
+    FILTER_SLOT_DELETED /*!< Address removed, probing continues past it. */
+};
+
+/**
+ * @brief Slot of the MAC address hash set of the receive filter (open addressing with linear probing).
+ */
+typedef struct
+{
+    uint8_t mac_addr[ESP_NOW_ETH_ALEN]; /*!< MAC address. */
+    uint8_t state;                      /*!< Slot state, see FILTER_SLOT_*. */
+    uint32_t hits;                      /*!< Number of received frames from the address. */
+} _filter_entry_t;
+
+/**
+ * @brief Payload prefix rule of the receive filter.
+ */
+typedef struct
+{
+    uint8_t len;                                /*!< Length of the prefix. 0 if the rule is unused. */
+    uint8_t value[ZH_ESPNOW_FILTER_PREFIX_MAX]; /*!< Prefix bytes. */
+    uint32_t hits;                              /*!< Number of data frames accepted by the rule. */
+} _filter_prefix_t;
+
+/**
+ * @brief Messages packed into a coalesced frame, reported individually once the frame completes.
+ */
+typedef struct
+{
+    bool is_used;                               /*!< True if the entry belongs to an open or transmitted frame. */
+    uint8_t count;                              /*!< Number of packed messages. */
+    uint32_t msg_id[COALESCE_MESSAGES_MAX];     /*!< Identifiers of the packed messages. */
+    int64_t enqueued_at[COALESCE_MESSAGES_MAX]; /*!< Time (in microseconds since boot) each packed message was queued. */
+} _coalesce_t;
+
+/**
+ * @brief Burst of buffered messages being flushed in battery scheduling mode (or drained by zh_espnow_flush()).
+ */
+typedef struct
+{
+    bool is_active;        /*!< True from the start of the flush until the transmitter is idle again. */
+    int64_t started_at;    /*!< Time (in microseconds since boot) the flush started. */
+    uint32_t sent_success; /*!< Number of messages of the burst delivered so far. */
+    uint32_t sent_fail;    /*!< Number of messages of the burst failed so far. */
+} _burst_t;
+
+/**
+ * @brief Entry of the seen-message cache of the relay layer. Entries are replaced in FIFO order.
+ */
+typedef struct
+{
+    uint8_t origin[ESP_NOW_ETH_ALEN]; /*!< MAC address of the origin of the message. */
+    uint16_t seq;                     /*!< Sequence number of the message. */
+    bool is_used;                     /*!< True if the entry holds a message. */
+} _relay_seen_t;
+
+/**
+ * @brief Next hop towards a node, learned from the relay messages it sent.
+ */
+typedef struct
+{
+    uint8_t destination[ESP_NOW_ETH_ALEN]; /*!< MAC address of the node. */
+    uint8_t next_hop[ESP_NOW_ETH_ALEN];    /*!< MAC address of the neighbour the last message from the node came from. */
+    uint8_t hops;                          /*!< Number of hops to the node. */
+    bool is_used;                          /*!< True if the entry holds a route. */
+    TickType_t updated_at;                 /*!< Tick count of the last message confirming the route. */
+} _relay_route_t;
+
+/**
+ * @brief Send confirmation passed from the send callback to the processing task.
+ */
+typedef struct
+{
+    uint8_t mac_addr[ESP_NOW_ETH_ALEN]; /*!< MAC address of the target device. */
+    esp_now_send_status_t status;       /*!< Status reported by the ESP-NOW driver. */
+} _confirm_t;
+
+/**
+ * @brief Slot of the transmission window.
+ *
+ * Confirmations are matched to slots by MAC address in transmission order, because the ESP-NOW driver reports them
+ * in the order the frames were passed to it.
+ */
+typedef struct
+{
+    zh_espnow_event_on_recv_t *message; /*!< Pool block of the frame. NULL if the slot is free. */
+    uint32_t order;                     /*!< Sequence number of the last transmission of the frame. */
+    TickType_t deadline;                /*!< Tick count at which the next retry is due. */
+    uint8_t attempt;                    /*!< Number of transmissions made so far. */
+    bool is_waiting;                    /*!< True if the frame was passed to the driver and its confirmation is pending. Otherwise `deadline` ends a retry backoff. */
+    uint8_t max_attempts;               /*!< Maximum number of transmissions of the frame. */
+    TickType_t timeout;                 /*!< Confirmation timeout of the frame in ticks. */
+    int64_t sent_at;                    /*!< Time (in microseconds since boot) of the last transmission. */
+    int64_t enqueued_at;                /*!< Time (in microseconds since boot) the frame was queued. */
+    uint32_t msg_id;                    /*!< Identifier of the application message. 0 for internal frames. */
+    uint8_t frame_type;                 /*!< Frame type. Only frames with a message identifier and FRAME_COALESCED frames are reported with send events. */
+    uint8_t coalesce;                   /*!< Index of the packed messages entry of a FRAME_COALESCED frame. COALESCE_NONE otherwise. */
+} _tx_slot_t;
+
+/**
+ * @brief Message staged by the fair scheduler, chained into the queue of its destination.
+ */
+typedef struct
+{
+    _queue_t queue; /*!< Message taken from a transmit queue. */
+    uint8_t next;   /*!< Next item of the same destination or of the free list. FAIR_NONE ends the chain. */
+} _fair_item_t;
+
+/**
+ * @brief Destination of the fair scheduler.
+ *
+ * The token bucket is kept as a theoretical arrival time (GCRA form), so it needs no periodic refill: a message conforms
+ * once the current time reaches `tat_us` minus the burst tolerance. Entries without staged messages keep their bucket
+ * until they are reused in LRU order.
+ */
+typedef struct
+{
+    uint8_t mac_addr[ESP_NOW_ETH_ALEN]; /*!< MAC address of the destination. */
+    bool is_used;                       /*!< True if the entry is bound to a destination. */
+    bool is_throttled;                  /*!< True if the first staged message was already counted as held back by the bucket. */
+    uint8_t head;                       /*!< First staged item. FAIR_NONE if none. */
+    uint8_t tail;                       /*!< Last staged item. */
+    uint8_t count;                      /*!< Number of staged items. */
+    uint16_t deficit;                   /*!< Bytes the destination may still send in the current round. */
+    int64_t tat_us;                     /*!< Theoretical arrival time (in microseconds since boot) of the token bucket. */
+    uint32_t last_used;                 /*!< Value of `fair_clock` at the last message staged for the destination. */
+} _fair_flow_t;
+
+enum
+{
+    POOL_SMALL, /*!< Small block class. */
+    POOL_LARGE, /*!< Large block class. */
+    POOL_CLASS_NUM
+};
+
+/**
+ * @brief State of one ESP-NOW instance.
+ *
+ * Every instance is bound to one Wi-Fi interface and has its own tasks, queues, message pool and statistics. The peer
+ * cache is shared, because the ESP-NOW driver keeps a single peer table for all interfaces.
+ */
+typedef struct zh_espnow_context
+{
+    zh_espnow_init_config_t init_config;                             /*!< Configuration the instance was initialised with. */
+    esp_event_base_t event_base;                                     /*!< Event base of the events posted by the instance. */
+    TaskHandle_t task;                                               /*!< Transmit processing task. */
+    TaskHandle_t rx_task;                                            /*!< Receive processing task. NULL in battery mode. */
+    QueueHandle_t tx_queues[ZH_ESPNOW_PRIORITY_NUM];                 /*!< Transmit queues of the priority classes. NULL if the class is disabled. */
+    uint8_t tx_normal_streak;                                        /*!< Number of normal messages sent in a row while bulk messages were waiting. */
+    EventGroupHandle_t tx_event_group;                               /*!< Queue space bits of the priority classes and TX_EVENT_BURST_DONE. */
+    volatile bool tx_blocked[ZH_ESPNOW_PRIORITY_NUM];                /*!< True if a message of the class was rejected or is waiting for queue space. */
+    QueueHandle_t rx_queue_handle;                                   /*!< Receive queue. NULL in battery mode. */
+    QueueHandle_t confirm_queue_handle;                              /*!< Queue of the send confirmations. */
+    zh_espnow_stats_t stats;                                         /*!< Statistics. */
+    portMUX_TYPE stats_lock;                                         /*!< Lock of `stats`. */
+    _pool_class_t pool[POOL_CLASS_NUM];                              /*!< Block classes of the message pool. */
+    portMUX_TYPE pool_lock;                                          /*!< Lock of the message pool free lists. */
+    SemaphoreHandle_t tx_mutex;                                      /*!< Mutex serialising the producers of the transmit queues. */
+    _tx_slot_t tx_slots[TX_WINDOW_MAX];                              /*!< Slots of the transmission window. */
+    uint8_t tx_in_flight;                                            /*!< Number of used slots of the transmission window. */
+    uint32_t tx_order;                                               /*!< Transmission counter used to match confirmations to slots. */
+    zh_espnow_recv_handler_t recv_handler;                           /*!< Direct receive handler. NULL posts receive events. */
+    void *recv_handler_arg;                                          /*!< Argument of `recv_handler`. */
+    portMUX_TYPE recv_handler_lock;                                  /*!< Lock of `recv_handler` and `recv_handler_arg`. */
+    _bulk_tx_t bulk_tx;                                              /*!< Outgoing bulk transfer. */
+    _bulk_ack_t bulk_tx_ack;                                         /*!< Latest acknowledgement of the outgoing bulk transfer. */
+    bool bulk_tx_has_ack;                                            /*!< True if `bulk_tx_ack` was not processed yet. */
+    uint16_t bulk_tx_id;                                             /*!< Identifier of the last outgoing bulk transfer. */
+    _bulk_rx_t bulk_rx;                                              /*!< Incoming bulk transfer. */
+    _bulk_done_t bulk_rx_done;                                       /*!< Last completed incoming bulk transfer. */
+    uint8_t *bulk_rx_buffer;                                         /*!< Reassembly buffer of incoming bulk transfers. */
+    bool bulk_rx_buffer_locked;                                      /*!< True until the application releases the reassembly buffer. */
+    zh_espnow_bulk_sink_t bulk_sink;                                 /*!< Streaming sink of incoming bulk transfers. */
+    void *bulk_sink_arg;                                             /*!< Argument of `bulk_sink`. */
+    portMUX_TYPE bulk_lock;                                          /*!< Lock of the bulk transfer state shared with the application. */
+    uint16_t *codec_table;                                           /*!< Hash table of the payload codec. NULL if compression is disabled. */
+    uint8_t *codec_scratch;                                          /*!< Encoder output of the largest pool block. Guarded by `tx_mutex`. */
+    zh_espnow_trace_record_t *trace_ring;                            /*!< Trace ring. NULL if tracing is disabled. */
+    uint32_t trace_mask;                                             /*!< Capacity of the trace ring minus one. */
+    volatile uint32_t trace_head;                                    /*!< Number of trace records written. */
+    volatile uint32_t trace_start;                                   /*!< Value of `trace_head` at the last zh_espnow_trace_clear(). */
+    uint32_t msg_id;                                                 /*!< Last message identifier. */
+    zh_espnow_send_result_t completions[COMPLETION_RING_SIZE];       /*!< Results of the last completed messages. */
+    uint8_t completion_head;                                         /*!< Next entry of `completions` to overwrite. */
+    _send_waiter_t send_waiters[SEND_WAITERS_MAX];                   /*!< Tasks waiting in zh_espnow_wait_for(). */
+    portMUX_TYPE completion_lock;                                    /*!< Lock of `completions` and `send_waiters`. */
+    uint16_t tx_seq;                                                 /*!< Last sequence number of outgoing frames. */
+    _dedup_entry_t dedup[DEDUP_SOURCES_MAX];                         /*!< Duplicate suppression windows of the senders. */
+    uint32_t dedup_clock;                                            /*!< LRU clock of `dedup`. */
+    _filter_entry_t *filter_table;                                   /*!< Hash table of the MAC filter. NULL if MAC filtering is disabled. */
+    uint16_t filter_capacity;                                        /*!< Number of entries of `filter_table`. */
+    uint8_t filter_count;                                            /*!< Number of MAC addresses in the filter. */
+    _filter_prefix_t filter_prefixes[ZH_ESPNOW_FILTER_PREFIX_RULES]; /*!< Payload prefix rules. */
+    volatile uint8_t filter_prefixes_num;                            /*!< Number of active payload prefix rules. */
+    volatile zh_espnow_filter_mode_t filter_mode;                    /*!< Mode of the MAC filter. */
+    volatile uint32_t filter_seq;                                    /*!< Sequence counter of filter updates, odd while an update is in progress. */
+    portMUX_TYPE filter_lock;                                        /*!< Lock serialising filter updates. */
+    _coalesce_t coalesce[COALESCE_SLOTS];                            /*!< Packed messages of the coalesced frames in flight. */
+    zh_espnow_event_on_recv_t *coalesce_frame;                       /*!< Coalesced frame being filled. NULL if none. */
+    uint8_t coalesce_open;                                           /*!< Entry of `coalesce` of the frame being filled. COALESCE_NONE if none. */
+    TickType_t coalesce_deadline;                                    /*!< Tick count at which the frame being filled is sent. */
+    _queue_t tx_pending;                                             /*!< Message taken from a transmit queue that did not fit into the window. */
+    bool tx_has_pending;                                             /*!< True if `tx_pending` holds a message. */
+    _fair_item_t *fair_items;                                        /*!< Staged messages of the fair scheduler. NULL if `fair_queue_size` is 0. */
+    _fair_flow_t *fair_flows;                                        /*!< Destinations of the fair scheduler, as many as `fair_items`. */
+    uint8_t fair_free;                                               /*!< First free entry of `fair_items`. FAIR_NONE if none. */
+    uint8_t fair_count;                                              /*!< Number of staged messages. */
+    uint8_t fair_current;                                            /*!< Entry of `fair_flows` the round-robin pointer is at. */
+    bool fair_is_new_visit;                                          /*!< True if the current destination has not received its quantum for this round yet. */
+    uint32_t fair_clock;                                             /*!< LRU clock of `fair_flows`. */
+    int64_t fair_tat_us;                                             /*!< Theoretical arrival time (in microseconds since boot) of the global token bucket. */
+    bool fair_is_throttled;                                          /*!< True if the next message was already counted as held back by the global bucket. */
+    TickType_t fair_wait;                                            /*!< Ticks until a held back message conforms to its token buckets. portMAX_DELAY if none. */
+    _burst_t burst;                                                  /*!< State of the current burst. */
+    volatile bool burst_flush_requested;                             /*!< True if zh_espnow_flush() requested a burst. */
+    int64_t radio_on_at;                                             /*!< Time (in microseconds since boot) the radio was last needed. 0 if idle. */
+    uint32_t radio_on_rest_us;                                       /*!< Radio-on time below one millisecond not yet added to the statistics. */
+    uint8_t own_mac[ESP_NOW_ETH_ALEN];                               /*!< MAC address of the Wi-Fi interface of the instance. */
+    uint16_t relay_seq;                                              /*!< Last sequence number of relay messages originated here. */
+    _relay_seen_t relay_seen[RELAY_SEEN_SIZE];                       /*!< Cache of recently seen relay messages. */
+    uint8_t relay_seen_head;                                         /*!< Next entry of `relay_seen` to overwrite. */
+    _relay_route_t relay_routes[RELAY_ROUTES_MAX];                   /*!< Learned next hops. */
+    portMUX_TYPE relay_lock;                                         /*!< Lock of the relay state. */
+    _rpc_call_t *rpc_calls;                                          /*!< Table of pending RPC calls. NULL if `rpc_pending_size` is 0. */
+    SemaphoreHandle_t *rpc_wake;                                     /*!< Binary semaphores of the entries of `rpc_calls`, given when a blocking call completes. */
+    uint16_t rpc_id;                                                 /*!< Last RPC call identifier. */
+    _rpc_recent_t rpc_recent[RPC_RECENT_SIZE];                       /*!< Recently finished RPC calls. */
+    uint8_t rpc_recent_head;                                         /*!< Next entry of `rpc_recent` to overwrite. */
+    portMUX_TYPE rpc_lock;                                           /*!< Lock of the RPC state. */
+    volatile bool is_initialized;                                    /*!< True between the initialization and deinitialization of the instance. */
+} _context_t;
+
 TaskHandle_t zh_espnow = NULL;
-static EventGroupHandle_t _event_group_handle = NULL;
-static QueueHandle_t _queue_handle = NULL;
-static zh_espnow_init_config_t _init_config = {0};
-static zh_espnow_stats_t _stats = {0};
-volatile static bool _is_initialized = false;
+TaskHandle_t zh_espnow_rx = NULL;
+// The default instance used by the functions without a handle. Static, so its statistics stay readable after deinitialization.
+static _context_t _default_context = {
+    .stats_lock = portMUX_INITIALIZER_UNLOCKED,
+    .pool_lock = portMUX_INITIALIZER_UNLOCKED,
+    .recv_handler_lock = portMUX_INITIALIZER_UNLOCKED,
+    .bulk_lock = portMUX_INITIALIZER_UNLOCKED,
+    .completion_lock = portMUX_INITIALIZER_UNLOCKED,
+    .filter_lock = portMUX_INITIALIZER_UNLOCKED,
+    .coalesce_open = COALESCE_NONE,
+    .relay_lock = portMUX_INITIALIZER_UNLOCKED,
+    .rpc_lock = portMUX_INITIALIZER_UNLOCKED};
+static _context_t *_contexts[ZH_ESPNOW_INSTANCES_MAX] = {0};
+static uint32_t _callbacks_active = 0;
+static bool _recv_cb_registered = false;
+static _peer_t _peer_cache[ESP_NOW_MAX_TOTAL_PEER_NUM] = {0};
+static uint8_t _peer_cache_size = 0;
+static uint32_t _peer_clock = 0;
+static SemaphoreHandle_t _peer_mutex = NULL;
+// Shared history placed in front of every payload, so even the first bytes of a short frame can be matched.
+static const uint8_t _codec_dict[] = "null,false,true,\"id\":\"status\":\"state\":\"value\":\"battery\":\"voltage\":\"pressure\":\"humidity\":\"temperature\":0.000000,\"}";
 static const uint8_t _broadcast_mac[ESP_NOW_ETH_ALEN] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
 #if defined ESP_NOW_MAX_DATA_LEN_V2
 volatile static uint16_t _max_message_size = ESP_NOW_MAX_DATA_LEN_V2;
@@ -67,11 +635,47 @@ volatile static uint16_t _max_message_size = ESP_NOW_MAX_DATA_LEN_V2;
 volatile static uint16_t _max_message_size = ESP_NOW_MAX_DATA_LEN;
 #endif
 
+static esp_err_t _zh_espnow_context_init(_context_t *ctx, const zh_espnow_init_config_t *user_config);
+static void _zh_espnow_context_deinit(_context_t *ctx);
+static void _zh_espnow_context_remove(_context_t *ctx);
+static _context_t *_zh_espnow_context_find(wifi_interface_t ifidx);
+static uint8_t _zh_espnow_contexts_num(void);
+static void _zh_espnow_config_defaults(zh_espnow_init_config_t *config);
 static esp_err_t _zh_espnow_validate_config(const zh_espnow_init_config_t *config);
-static esp_err_t _zh_espnow_wifi_init(const zh_espnow_init_config_t *config);
-static esp_err_t _zh_espnow_resources_init(const zh_espnow_init_config_t *config);
-static esp_err_t _zh_espnow_task_init(const zh_espnow_init_config_t *config);
+static esp_err_t _zh_espnow_wifi_init(const zh_espnow_init_config_t *config, bool is_first);
+static void _zh_espnow_wifi_deinit(void);
+static esp_err_t _zh_espnow_resources_init(_context_t *ctx, const zh_espnow_init_config_t *config);
+static void _zh_espnow_resources_deinit(_context_t *ctx);
+static esp_err_t _zh_espnow_task_init(_context_t *ctx, const zh_espnow_init_config_t *config);
+static void _zh_espnow_task_deinit(_context_t *ctx);
 static esp_err_t _zh_espnow_callbacks_register(bool battery_mode);
+static esp_err_t _zh_espnow_pool_init(_context_t *ctx, const zh_espnow_init_config_t *config);
+static void _zh_espnow_pool_deinit(_context_t *ctx);
+static uint16_t _zh_espnow_pool_max_size(_context_t *ctx);
+static uint16_t _zh_espnow_max_payload(_context_t *ctx);
+static zh_espnow_event_on_recv_t *_zh_espnow_pool_alloc(_context_t *ctx, uint16_t size);
+static void _zh_espnow_pool_free(_context_t *ctx, zh_espnow_event_on_recv_t *block);
+static esp_err_t _zh_espnow_peer_cache_init(_context_t *ctx, const zh_espnow_init_config_t *config);
+static esp_err_t _zh_espnow_peer_acquire(_context_t *ctx, const uint8_t *mac_addr, bool pin);
+static esp_err_t _zh_espnow_peer_register(_context_t *ctx, _peer_t *entry, const uint8_t *mac_addr);
+static esp_err_t _zh_espnow_peer_rebind(_context_t *ctx, _peer_t *entry);
+static void _zh_espnow_peer_release(const uint8_t *mac_addr, bool is_failed);
+static void _zh_espnow_peer_cache_release(_context_t *ctx);
+static _peer_t *_zh_espnow_peer_find(const uint8_t *mac_addr);
+static esp_err_t _zh_espnow_peer_admit(_context_t *ctx, const uint8_t *mac_addr, TickType_t *timeout, uint8_t *attempts);
+static void _zh_espnow_peer_report(const uint8_t *mac_addr, bool is_success, uint32_t latency_us);
+static void _zh_espnow_peer_update_recv(const uint8_t *mac_addr, int8_t rssi);
+static void _zh_espnow_peer_report_wait(const uint8_t *mac_addr, uint32_t wait_us);
+static void _zh_espnow_peer_report_throttled(const uint8_t *mac_addr);
+static TickType_t _zh_espnow_peer_timeout(const _peer_t *peer);
+static void _zh_espnow_peer_stats_fill(const _peer_t *peer, zh_espnow_peer_stats_t *peer_stats);
+static void _zh_espnow_stats_add(_context_t *ctx, uint32_t *counter, uint32_t value);
+static void _zh_espnow_stats_max(_context_t *ctx, uint32_t *counter, uint32_t value);
+static void _zh_espnow_stats_latency(_context_t *ctx, uint32_t *avg, uint32_t *max, uint32_t value);
+static uint8_t _zh_espnow_stats_bucket(uint32_t value_us);
+static void _zh_espnow_stats_dispatch(_context_t *ctx, const _queue_t *queue);
+static bool _zh_espnow_export_put(uint8_t *buffer, uint16_t size, uint16_t *offset, const void *data, uint16_t data_len);
+static bool _zh_espnow_export_varint(uint8_t *buffer, uint16_t size, uint16_t *offset, uint32_t value);
 
 #if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 5, 0)
 static void _zh_espnow_send_cb(const esp_now_send_info_t *esp_now_info, esp_now_send_status_t status);
@@ -79,9 +683,102 @@ static void _zh_espnow_send_cb(const esp_now_send_info_t *esp_now_info, esp_now_
 static void _zh_espnow_send_cb(const uint8_t *mac_addr, esp_now_send_status_t status);
 #endif
 static void _zh_espnow_recv_cb(const esp_now_recv_info_t *esp_now_info, const uint8_t *data, int data_len);
-static void _zh_espnow_process_send(_queue_t *queue);
-static void _zh_espnow_process_recv(_queue_t *queue);
+static void _zh_espnow_send_confirm(_context_t *ctx, const uint8_t *mac_addr, esp_now_send_status_t status);
+static void _zh_espnow_recv_frame(_context_t *ctx, const esp_now_recv_info_t *esp_now_info, const uint8_t *data, int data_len);
+static _dedup_entry_t *_zh_espnow_dedup_find(_context_t *ctx, const uint8_t *mac_addr);
+static bool _zh_espnow_dedup_check(_context_t *ctx, const uint8_t *mac_addr, uint16_t seq);
+static void _zh_espnow_dedup_record(_context_t *ctx, const uint8_t *mac_addr, uint16_t seq);
+static bool _zh_espnow_filter_mac(_context_t *ctx, const uint8_t *mac_addr);
+static bool _zh_espnow_filter_payload(_context_t *ctx, const uint8_t *data, int data_len);
+static _filter_entry_t *_zh_espnow_filter_find(_context_t *ctx, const uint8_t *mac_addr, bool for_insert);
+static void _zh_espnow_filter_write_begin(_context_t *ctx);
+static void _zh_espnow_filter_write_end(_context_t *ctx);
+static uint32_t _zh_espnow_iov_len(const zh_espnow_iovec_t *iov, uint8_t iov_count);
+static esp_err_t _zh_espnow_send(_context_t *ctx, const uint8_t *target, const uint8_t *data, uint16_t data_len, const zh_espnow_send_options_t *options, uint32_t *msg_id);
+static esp_err_t _zh_espnow_tx_enqueue(_context_t *ctx, const uint8_t *target, uint8_t frame_type, uint8_t frame_flags, uint8_t priority, const zh_espnow_iovec_t *iov, uint8_t iov_count, TickType_t timeout, uint32_t *msg_id);
+static uint8_t _zh_espnow_tx_class(_context_t *ctx, uint8_t priority);
+static uint8_t _zh_espnow_tx_queue_size(_context_t *ctx, uint8_t priority);
+static UBaseType_t _zh_espnow_tx_reserve(_context_t *ctx, uint8_t priority);
+static bool _zh_espnow_tx_has_space(_context_t *ctx, uint8_t priority);
+static bool _zh_espnow_tx_wait_space(_context_t *ctx, uint8_t priority, TickType_t timeout);
+static void _zh_espnow_tx_space_notify(_context_t *ctx);
+static bool _zh_espnow_tx_is_idle(_context_t *ctx);
+static TickType_t _zh_espnow_burst_check(_context_t *ctx);
+static void _zh_espnow_burst_finish(_context_t *ctx);
+static void _zh_espnow_radio_off(_context_t *ctx);
+static uint8_t _zh_espnow_tx_limit(_context_t *ctx, uint8_t priority);
+static bool _zh_espnow_tx_next(_context_t *ctx, _queue_t *queue);
+static bool _zh_espnow_tx_dequeue(_context_t *ctx, _queue_t *queue);
+static void _zh_espnow_fair_fill(_context_t *ctx);
+static _fair_flow_t *_zh_espnow_fair_flow(_context_t *ctx, const uint8_t *mac_addr);
+static bool _zh_espnow_fair_next(_context_t *ctx, _queue_t *queue);
+static int64_t _zh_espnow_fair_bucket_wait(uint16_t rate, uint8_t burst, int64_t tat_us, int64_t now);
+static void _zh_espnow_fair_bucket_take(uint16_t rate, int64_t *tat_us, int64_t now);
+static uint8_t _zh_espnow_fair_in_flight(_context_t *ctx, const uint8_t *mac_addr);
+static void _zh_espnow_fair_charge(_context_t *ctx, const uint8_t *mac_addr);
+static void _zh_espnow_process_send(_context_t *ctx, _queue_t *queue);
+static esp_err_t _zh_espnow_tx_start(_context_t *ctx, zh_espnow_event_on_recv_t *message, uint8_t frame_type, uint32_t msg_id, int64_t enqueued_at, uint8_t coalesce);
+static bool _zh_espnow_coalesce_add(_context_t *ctx, const _queue_t *queue);
+static bool _zh_espnow_coalesce_begin(_context_t *ctx, const zh_espnow_event_on_recv_t *first);
+static void _zh_espnow_coalesce_flush(_context_t *ctx);
+static void _zh_espnow_coalesce_release(_context_t *ctx, uint8_t coalesce);
+static TickType_t _zh_espnow_coalesce_process(_context_t *ctx);
+static void _zh_espnow_process_recv(_context_t *ctx, _queue_t *queue);
+static void _zh_espnow_recv_split(_context_t *ctx, const _queue_t *queue);
+static void _zh_espnow_recv_deliver(_context_t *ctx, zh_espnow_event_on_recv_t *message, int8_t rssi, int64_t timestamp);
+static void _zh_espnow_relay_rx(_context_t *ctx, const _queue_t *queue);
+static void _zh_espnow_relay_forward(_context_t *ctx, const _relay_header_t *header, const uint8_t *neighbour, const uint8_t *data, uint16_t data_len);
+static bool _zh_espnow_relay_seen(_context_t *ctx, const uint8_t *origin, uint16_t seq);
+static void _zh_espnow_relay_learn(_context_t *ctx, const uint8_t *destination, const uint8_t *neighbour, uint8_t hops);
+static void _zh_espnow_relay_forget(_context_t *ctx, const uint8_t *next_hop);
+static void _zh_espnow_relay_next_hop(_context_t *ctx, const uint8_t *destination, uint8_t *next_hop);
+static esp_err_t _zh_espnow_rpc_start(_context_t *ctx, const uint8_t *target, const uint8_t *data, uint16_t data_len, TickType_t timeout, zh_espnow_rpc_callback_t callback, void *arg, _rpc_call_t **call, uint16_t *call_id);
+static esp_err_t _zh_espnow_rpc_send(_context_t *ctx, const uint8_t *target, uint8_t frame_type, uint16_t call_id, const uint8_t *data, uint16_t data_len, uint32_t *msg_id);
+static _rpc_call_t *_zh_espnow_rpc_find(_context_t *ctx, uint16_t call_id, const uint8_t *mac_addr, uint32_t msg_id);
+static void _zh_espnow_rpc_recent_add(_context_t *ctx, uint16_t call_id, bool is_replied);
+static bool _zh_espnow_rpc_recent_replied(_context_t *ctx, uint16_t call_id);
+static void _zh_espnow_rpc_rx_request(_context_t *ctx, zh_espnow_event_on_recv_t *message);
+static void _zh_espnow_rpc_rx_reply(_context_t *ctx, zh_espnow_event_on_recv_t *message);
+static void _zh_espnow_rpc_fail(_context_t *ctx, uint32_t msg_id);
+static TickType_t _zh_espnow_rpc_expire(_context_t *ctx);
+static void _zh_espnow_update_rx_latency(_context_t *ctx, int64_t timestamp);
+static void _zh_espnow_process_confirm(_context_t *ctx, const _confirm_t *confirm);
+static TickType_t _zh_espnow_process_timeouts(_context_t *ctx);
+static void _zh_espnow_tx_transmit(_context_t *ctx, _tx_slot_t *slot);
+static void _zh_espnow_tx_complete(_context_t *ctx, _tx_slot_t *slot, zh_espnow_on_send_event_type_t status);
+static void _zh_espnow_tx_drop(_context_t *ctx, zh_espnow_event_on_recv_t *message, uint8_t frame_type, uint32_t msg_id, int64_t enqueued_at, uint8_t coalesce);
+static void _zh_espnow_tx_finish(_context_t *ctx, const uint8_t *mac_addr, zh_espnow_on_send_event_type_t status, uint8_t frame_type, uint32_t msg_id, int64_t enqueued_at, uint8_t coalesce, uint8_t retries);
+static void _zh_espnow_tx_report(_context_t *ctx, const uint8_t *mac_addr, zh_espnow_on_send_event_type_t status, uint32_t msg_id, int64_t enqueued_at, uint8_t retries);
+static void _zh_espnow_tx_retry(_context_t *ctx, _tx_slot_t *slot);
+static void _zh_espnow_completion_record(_context_t *ctx, const zh_espnow_send_result_t *result);
+static esp_err_t _zh_espnow_bulk_start(_context_t *ctx, const uint8_t *target, uint32_t data_len, zh_espnow_bulk_source_t source, void *arg, uint16_t *transfer_id);
+static esp_err_t _zh_espnow_bulk_buffer_source(uint32_t offset, uint8_t *buffer, uint16_t length, void *arg);
+static TickType_t _zh_espnow_bulk_tx_process(_context_t *ctx);
+static esp_err_t _zh_espnow_bulk_tx_fragment(_context_t *ctx, uint16_t index);
+static void _zh_espnow_bulk_tx_apply_ack(_context_t *ctx, const _bulk_ack_t *ack);
+static void _zh_espnow_bulk_tx_complete(_context_t *ctx, zh_espnow_bulk_status_t status);
+static void _zh_espnow_bulk_tx_event(_context_t *ctx, zh_espnow_bulk_status_t status);
+static void _zh_espnow_bulk_rx_ack(_context_t *ctx, zh_espnow_event_on_recv_t *message);
+static void _zh_espnow_bulk_rx_data(_context_t *ctx, zh_espnow_event_on_recv_t *message, uint8_t flags);
+static bool _zh_espnow_bulk_rx_start(_context_t *ctx, const uint8_t *mac_addr, const _bulk_data_t *fragment);
+static esp_err_t _zh_espnow_bulk_rx_advance(_context_t *ctx);
+static void _zh_espnow_bulk_rx_complete(_context_t *ctx);
+static void _zh_espnow_bulk_rx_abort(_context_t *ctx);
+static void _zh_espnow_bulk_rx_event(_context_t *ctx, zh_espnow_bulk_status_t status, const uint8_t *data);
+static void _zh_espnow_bulk_reply(_context_t *ctx, const uint8_t *mac_addr, uint16_t transfer_id, uint16_t base, uint32_t bitmap, uint8_t status);
+static TickType_t _zh_espnow_bulk_deadline(_context_t *ctx);
+static uint32_t _zh_espnow_bulk_throughput(uint32_t total_len, int64_t start_time);
+static uint16_t _zh_espnow_codec_encode(_context_t *ctx, const uint8_t *src, uint16_t src_len, uint8_t *dst, uint16_t dst_size);
+static uint16_t _zh_espnow_codec_decode(const uint8_t *src, uint16_t src_len, uint8_t *dst, uint16_t dst_size);
+static bool _zh_espnow_codec_emit(const uint8_t *src, uint16_t from, uint16_t to, uint8_t *dst, uint16_t dst_size, uint16_t *out);
+static uint8_t _zh_espnow_codec_byte(const uint8_t *data, uint16_t pos);
+static uint8_t _zh_espnow_codec_hash(const uint8_t *data, uint16_t pos);
+static void _zh_espnow_compress(_context_t *ctx, zh_espnow_event_on_recv_t *message, uint16_t offset);
+static zh_espnow_event_on_recv_t *_zh_espnow_decompress(_context_t *ctx, zh_espnow_event_on_recv_t *message);
+static void _zh_espnow_trace(_context_t *ctx, uint8_t event, uint8_t arg, uint32_t msg_id, uint16_t value);
+static uint16_t _zh_espnow_trace_collect(_context_t *ctx, zh_espnow_trace_record_t *records, uint16_t count);
 static void _zh_espnow_processing(void *pvParameter);
+static void _zh_espnow_rx_processing(void *pvParameter);
 
 ESP_EVENT_DEFINE_BASE(ZH_ESPNOW);
 
@@ -89,252 +786,4282 @@ esp_err_t zh_espnow_init(const zh_espnow_init_config_t *config) // -V2008
 {
     ZH_LOGI("ESP-NOW initialization started.");
     ZH_ERROR_CHECK(config != NULL, ESP_ERR_INVALID_ARG, NULL, "ESP-NOW initialization failed. Invalid argument.");
-    ZH_ERROR_CHECK(_is_initialized == false, ESP_ERR_INVALID_STATE, NULL, "ESP-NOW initialization failed. ESP-NOW is already initialized.");
-    ZH_ERROR_CHECK(_zh_espnow_validate_config(config) == ESP_OK, ESP_FAIL, NULL, "ESP-NOW initialization failed. Initial configuration check failed.");
-    ZH_ERROR_CHECK(_zh_espnow_wifi_init(config) == ESP_OK, ESP_FAIL, NULL, "ESP-NOW initialization failed. WiFi initialization failed.");
-    ZH_ERROR_CHECK(_zh_espnow_resources_init(config) == ESP_OK, ESP_FAIL,
-                   {ZH_ERROR_CHECK(esp_now_deinit() == ESP_OK, ESP_FAIL, NULL, "ESP-NOW driver remove failed.")}, "ESP-NOW initialization failed. Resources initialization failed.");
-    ZH_ERROR_CHECK(_zh_espnow_task_init(config) == ESP_OK, ESP_FAIL,
-                   {ZH_ERROR_CHECK(esp_now_deinit() == ESP_OK, ESP_FAIL, NULL, "ESP-NOW driver remove failed.")};
-                   vEventGroupDelete(_event_group_handle); vQueueDelete(_queue_handle), "ESP-NOW initialization failed. Processing task initialization failed.");
-    _init_config = *config;
-    ZH_ERROR_CHECK(_zh_espnow_callbacks_register(config->battery_mode) == ESP_OK, ESP_FAIL,
-                   {ZH_ERROR_CHECK(esp_now_deinit() == ESP_OK, ESP_FAIL, NULL, "ESP-NOW driver remove failed.")};
-                   vEventGroupDelete(_event_group_handle); vQueueDelete(_queue_handle); vTaskDelete(zh_espnow), "ESP-NOW initialization failed. ESP-NOW callbacks registration failed.");
-    _stats.min_stack_size = config->stack_size;
-    _is_initialized = true;
+    ZH_ERROR_CHECK(_default_context.is_initialized == false, ESP_ERR_INVALID_STATE, NULL, "ESP-NOW initialization failed. ESP-NOW is already initialized.");
+    esp_err_t err = _zh_espnow_context_init(&_default_context, config);
+    ZH_ERROR_CHECK(err == ESP_OK, err, NULL, "ESP-NOW initialization failed.");
+    zh_espnow = _default_context.task;
+    zh_espnow_rx = _default_context.rx_task;
     ZH_LOGI("ESP-NOW initialization completed successfully.");
     return ESP_OK;
 }
 
-esp_err_t zh_espnow_deinit(void) // -V2008
+esp_err_t zh_espnow_instance_init(const zh_espnow_init_config_t *config, zh_espnow_handle_t *handle)
 {
-    ZH_LOGI("ESP-NOW deinitialization started.");
-    ZH_ERROR_CHECK(_is_initialized == true, ESP_ERR_NOT_FOUND, NULL, "ESP-NOW deinitialization failed. ESP-NOW not initialized.");
-    ZH_ERROR_CHECK(esp_now_unregister_send_cb() == ESP_OK, ESP_FAIL, NULL, "ESP-NOW deinitialization failed. ESP-NOW callbacks unregistration failed.");
-    if (_init_config.battery_mode == false)
-    {
-        ZH_ERROR_CHECK(esp_now_unregister_recv_cb() == ESP_OK, ESP_FAIL, NULL, "ESP-NOW deinitialization failed. ESP-NOW callbacks unregistration failed.");
-    }
-    ZH_ERROR_CHECK(esp_now_deinit() == ESP_OK, ESP_FAIL, NULL, "ESP-NOW deinitialization failed. ESP-NOW driver remove failed.");
-    vEventGroupDelete(_event_group_handle);
-    vQueueDelete(_queue_handle);
-    vTaskDelete(zh_espnow);
-    _is_initialized = false;
-    ZH_LOGI("ESP-NOW deinitialization completed successfully.");
+    ZH_LOGI("ESP-NOW instance initialization started.");
+    ZH_ERROR_CHECK(config != NULL && handle != NULL, ESP_ERR_INVALID_ARG, NULL, "ESP-NOW instance initialization failed. Invalid argument.");
+    _context_t *ctx = heap_caps_calloc(1, sizeof(_context_t), MALLOC_CAP_8BIT);
+    ZH_ERROR_CHECK(ctx != NULL, ESP_ERR_NO_MEM, NULL, "ESP-NOW instance initialization failed. Memory allocation failed.");
+    portMUX_INITIALIZE(&ctx->stats_lock);
+    portMUX_INITIALIZE(&ctx->pool_lock);
+    portMUX_INITIALIZE(&ctx->recv_handler_lock);
+    portMUX_INITIALIZE(&ctx->bulk_lock);
+    portMUX_INITIALIZE(&ctx->completion_lock);
+    portMUX_INITIALIZE(&ctx->filter_lock);
+    portMUX_INITIALIZE(&ctx->relay_lock);
+    portMUX_INITIALIZE(&ctx->rpc_lock);
+    ctx->coalesce_open = COALESCE_NONE;
+    esp_err_t err = _zh_espnow_context_init(ctx, config);
+    ZH_ERROR_CHECK(err == ESP_OK, err, heap_caps_free(ctx), "ESP-NOW instance initialization failed.");
+    *handle = ctx;
+    ZH_LOGI("ESP-NOW instance initialization completed successfully.");
     return ESP_OK;
 }
 
-esp_err_t zh_espnow_send(const uint8_t *target, const uint8_t *data, const uint16_t data_len) // -V2008
+esp_err_t zh_espnow_deinit(void) // -V2008
 {
-    ZH_LOGI("Adding to queue outgoing ESP-NOW data started.");
-    ZH_ERROR_CHECK(_is_initialized == true, ESP_ERR_NOT_FOUND, NULL, "Adding to queue outgoing ESP-NOW data failed. ESP-NOW is not initialized.");
-    ZH_ERROR_CHECK(data != NULL && data_len > 0 && data_len <= _max_message_size, ESP_ERR_INVALID_ARG, NULL, "Adding to queue outgoing ESP-NOW data failed. Invalid argument.");
-    ZH_ERROR_CHECK(uxQueueSpacesAvailable(_queue_handle) > _init_config.queue_size / 10, ESP_ERR_INVALID_STATE, ++_stats.queue_overflow_error, "Adding to queue outgoing ESP-NOW data failed. Queue is almost full.");
-    _queue_t queue = {0};
-    queue.id = TO_SEND;
-    memcpy(queue.data.mac_addr, (target == NULL) ? _broadcast_mac : target, ESP_NOW_ETH_ALEN);
-    queue.data.payload = heap_caps_calloc(1, data_len, MALLOC_CAP_8BIT);
-    ZH_ERROR_CHECK(queue.data.payload != NULL, ESP_ERR_NO_MEM, NULL, "Adding to queue outgoing ESP-NOW data failed. Memory allocation fail or no free memory in the heap.");
-    memcpy(queue.data.payload, data, data_len);
-    queue.data.payload_len = data_len;
-    ZH_ERROR_CHECK(xQueueSend(_queue_handle, &queue, 1000 / portTICK_PERIOD_MS) == pdTRUE, ESP_FAIL, ++_stats.queue_overflow_error; heap_caps_free(queue.data.payload); queue.data.payload = NULL, "Adding to queue outgoing ESP-NOW data failed. Failed to add data to queue.");
-    ZH_LOGI("Adding to queue outgoing ESP-NOW data completed successfully.");
+    ZH_LOGI("ESP-NOW deinitialization started.");
+    ZH_ERROR_CHECK(_default_context.is_initialized == true, ESP_ERR_NOT_FOUND, NULL, "ESP-NOW deinitialization failed. ESP-NOW not initialized.");
+    _zh_espnow_context_deinit(&_default_context);
+    zh_espnow = NULL;
+    zh_espnow_rx = NULL;
+    ZH_LOGI("ESP-NOW deinitialization completed successfully.");
     return ESP_OK;
 }
 
-uint8_t zh_espnow_get_version(void)
+esp_err_t zh_espnow_instance_deinit(zh_espnow_handle_t handle)
 {
-    ZH_LOGI("ESP-NOW version receipt started.");
-    uint32_t version = 0;
-    ZH_ERROR_CHECK(esp_now_get_version(&version) == ESP_OK, 0, NULL, "ESP-NOW version receiption failed.");
-    ZH_LOGI("ESP-NOW version receiption successfully.");
-    return (uint8_t)version;
+    ZH_LOGI("ESP-NOW instance deinitialization started.");
+    ZH_ERROR_CHECK(handle != NULL && handle != &_default_context, ESP_ERR_INVALID_ARG, NULL, "ESP-NOW instance deinitialization failed. Invalid argument.");
+    ZH_ERROR_CHECK(handle->is_initialized == true, ESP_ERR_NOT_FOUND, NULL, "ESP-NOW instance deinitialization failed. ESP-NOW not initialized.");
+    _zh_espnow_context_deinit(handle);
+    heap_caps_free(handle);
+    ZH_LOGI("ESP-NOW instance deinitialization completed successfully.");
+    return ESP_OK;
 }
 
-const zh_espnow_stats_t *zh_espnow_get_stats(void)
+esp_err_t zh_espnow_send(const uint8_t *target, const uint8_t *data, const uint16_t data_len) // -V2008
 {
-    return &_stats;
+    return zh_espnow_instance_send(&_default_context, target, data, data_len);
 }
 
-void zh_espnow_reset_stats(void)
+esp_err_t zh_espnow_instance_send(zh_espnow_handle_t handle, const uint8_t *target, const uint8_t *data, const uint16_t data_len)
 {
-    ZH_LOGI("Error statistic reset started.");
-    _stats.sent_success = 0;
-    _stats.sent_fail = 0;
-    _stats.received = 0;
-    _stats.espnow_driver_error = 0;
-    _stats.event_post_error = 0;
-    _stats.queue_overflow_error = 0;
-    _stats.min_stack_size = 0;
-    ZH_LOGI("ESP-NOW statistic reset successfully.");
+    _context_t *ctx = handle;
+    return _zh_espnow_send(ctx, target, data, data_len, NULL, NULL);
 }
 
-esp_err_t zh_espnow_get_mac(uint8_t *mac_addr)
+esp_err_t zh_espnow_send_ex(const uint8_t *target, const uint8_t *data, uint16_t data_len, uint32_t *msg_id)
 {
-    return esp_wifi_get_mac(_init_config.wifi_interface, mac_addr);
+    return zh_espnow_instance_send_ex(&_default_context, target, data, data_len, msg_id);
 }
 
-static esp_err_t _zh_espnow_validate_config(const zh_espnow_init_config_t *config)
+esp_err_t zh_espnow_instance_send_ex(zh_espnow_handle_t handle, const uint8_t *target, const uint8_t *data, uint16_t data_len, uint32_t *msg_id)
 {
-    ZH_ERROR_CHECK(config->wifi_channel > 0 && config->wifi_channel < 15, ESP_ERR_INVALID_ARG, NULL, "Invalid WiFi channel.");
-    ZH_ERROR_CHECK(config->task_priority >= 1 && config->stack_size >= configMINIMAL_STACK_SIZE, ESP_ERR_INVALID_ARG, NULL, "Invalid task settings.");
-    ZH_ERROR_CHECK(config->queue_size >= 1, ESP_ERR_INVALID_ARG, NULL, "Invalid queue size.");
-    ZH_ERROR_CHECK(config->attempts > 0, ESP_ERR_INVALID_ARG, NULL, "Invalid number of attempts.");
-    return ESP_OK;
+    _context_t *ctx = handle;
+    return _zh_espnow_send(ctx, target, data, data_len, NULL, msg_id);
 }
 
-static esp_err_t _zh_espnow_wifi_init(const zh_espnow_init_config_t *config)
+esp_err_t zh_espnow_send_opt(const uint8_t *target, const uint8_t *data, uint16_t data_len, const zh_espnow_send_options_t *options, uint32_t *msg_id)
 {
-    ZH_ERROR_CHECK(esp_wifi_set_channel(config->wifi_channel, WIFI_SECOND_CHAN_NONE) == ESP_OK, ESP_FAIL, NULL, "WiFi channel setup failed.");
-#if defined CONFIG_IDF_TARGET_ESP32C2
-    ZH_ERROR_CHECK(esp_wifi_set_protocol(config->wifi_interface, WIFI_PROTOCOL_11B | WIFI_PROTOCOL_11G | WIFI_PROTOCOL_11N) == ESP_OK, ESP_FAIL, NULL, "WiFi protocol setup failed.");
-#else
-    ZH_ERROR_CHECK(esp_wifi_set_protocol(config->wifi_interface, WIFI_PROTOCOL_11B | WIFI_PROTOCOL_11G | WIFI_PROTOCOL_11N | WIFI_PROTOCOL_LR) == ESP_OK, ESP_FAIL, NULL, "WiFi protocol setup failed.");
-#endif
-    ZH_ERROR_CHECK(esp_now_init() == ESP_OK, ESP_FAIL, NULL, "ESP-NOW driver initialization failed.");
-    return ESP_OK;
+    return zh_espnow_instance_send_opt(&_default_context, target, data, data_len, options, msg_id);
 }
 
-static esp_err_t _zh_espnow_resources_init(const zh_espnow_init_config_t *config)
+esp_err_t zh_espnow_instance_send_opt(zh_espnow_handle_t handle, const uint8_t *target, const uint8_t *data, uint16_t data_len, const zh_espnow_send_options_t *options, uint32_t *msg_id)
 {
-    _event_group_handle = xEventGroupCreate();
-    ZH_ERROR_CHECK(_event_group_handle != NULL, ESP_FAIL, NULL, "Event group creation failed.");
-    _queue_handle = xQueueCreate(config->queue_size, sizeof(_queue_t));
-    ZH_ERROR_CHECK(_queue_handle != NULL, ESP_FAIL, NULL, "Queue creation failed.");
-    return ESP_OK;
+    _context_t *ctx = handle;
+    const zh_espnow_send_options_t defaults = ZH_ESPNOW_SEND_OPTIONS_DEFAULT();
+    options = (options != NULL) ? options : &defaults;
+    ZH_ERROR_CHECK(options->priority < ZH_ESPNOW_PRIORITY_NUM, ESP_ERR_INVALID_ARG, NULL, "Adding to queue outgoing ESP-NOW data failed. Invalid priority.");
+    return _zh_espnow_send(ctx, target, data, data_len, options, msg_id);
 }
 
-static esp_err_t _zh_espnow_task_init(const zh_espnow_init_config_t *config)
+esp_err_t zh_espnow_send_sync(const uint8_t *target, const uint8_t *data, uint16_t data_len, TickType_t timeout, zh_espnow_send_result_t *result)
 {
-    ZH_ERROR_CHECK(xTaskCreatePinnedToCore(&_zh_espnow_processing, "zh_espnow_processing", config->stack_size, NULL, config->task_priority, &zh_espnow, tskNO_AFFINITY) == pdPASS, ESP_FAIL, NULL, "Task creation failed.");
-    return ESP_OK;
+    return zh_espnow_instance_send_sync(&_default_context, target, data, data_len, timeout, result);
 }
 
-static esp_err_t _zh_espnow_callbacks_register(bool battery_mode)
+esp_err_t zh_espnow_instance_send_sync(zh_espnow_handle_t handle, const uint8_t *target, const uint8_t *data, uint16_t data_len, TickType_t timeout, zh_espnow_send_result_t *result)
 {
-    ZH_ERROR_CHECK(esp_now_register_send_cb(_zh_espnow_send_cb) == ESP_OK, ESP_FAIL, NULL, "Send callback registration failed.");
-    if (battery_mode == false)
+    _context_t *ctx = handle;
+    uint32_t msg_id = 0;
+    esp_err_t err = _zh_espnow_send(ctx, target, data, data_len, NULL, &msg_id);
+    if (err != ESP_OK)
     {
-        ZH_ERROR_CHECK(esp_now_register_recv_cb(_zh_espnow_recv_cb) == ESP_OK, ESP_FAIL, NULL, "Receive callback registration failed.");
+        return err;
     }
-    return ESP_OK;
+    return zh_espnow_instance_wait_for(handle, msg_id, timeout, result);
 }
 
-#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 5, 0)
-static void IRAM_ATTR _zh_espnow_send_cb(const esp_now_send_info_t *esp_now_info, esp_now_send_status_t status)
-{
-    ZH_ERROR_CHECK_VOID(esp_now_info != NULL, NULL, "Send callback received NULL MAC address.");
-#else
-static void IRAM_ATTR _zh_espnow_send_cb(const uint8_t *mac_addr, esp_now_send_status_t status)
+esp_err_t zh_espnow_wait_for(uint32_t msg_id, TickType_t timeout, zh_espnow_send_result_t *result)
 {
-    ZH_ERROR_CHECK_VOID(mac_addr != NULL, NULL, "Send callback received NULL MAC address.");
-#endif
-    BaseType_t xHigherPriorityTaskWoken = pdFALSE;
-    xEventGroupSetBitsFromISR(_event_group_handle, (status == ESP_NOW_SEND_SUCCESS) ? DATA_SEND_SUCCESS : DATA_SEND_FAIL, &xHigherPriorityTaskWoken);
-    if (xHigherPriorityTaskWoken == pdTRUE)
-    {
-        portYIELD_FROM_ISR();
-    };
+    return zh_espnow_instance_wait_for(&_default_context, msg_id, timeout, result);
 }
 
-static void IRAM_ATTR _zh_espnow_recv_cb(const esp_now_recv_info_t *esp_now_info, const uint8_t *data, int data_len)
+esp_err_t zh_espnow_instance_wait_for(zh_espnow_handle_t handle, uint32_t msg_id, TickType_t timeout, zh_espnow_send_result_t *result)
 {
-    ZH_ERROR_CHECK_VOID(esp_now_info != NULL && data != NULL && data_len > 0, NULL, "Receive callback received invalid arguments.");
-    ZH_ERROR_CHECK_VOID(uxQueueSpacesAvailable(_queue_handle) > _init_config.queue_size / 10, ++_stats.queue_overflow_error, "Queue is almost full. Dropping incoming ESP-NOW data.");
-    _queue_t queue = {0};
-    queue.id = ON_RECV;
-    memcpy(queue.data.mac_addr, esp_now_info->src_addr, ESP_NOW_ETH_ALEN);
-    queue.data.payload = heap_caps_calloc(1, data_len, MALLOC_CAP_8BIT);
-    ZH_ERROR_CHECK_VOID(queue.data.payload != NULL, NULL, "Memory allocation failed for incoming ESP-NOW data.");
-    memcpy(queue.data.payload, data, data_len);
-    queue.data.payload_len = data_len;
-    BaseType_t xHigherPriorityTaskWoken = pdFALSE;
-    ZH_ERROR_CHECK_VOID(xQueueSendFromISR(_queue_handle, &queue, &xHigherPriorityTaskWoken) == pdTRUE, ++_stats.queue_overflow_error;
-                        heap_caps_free(queue.data.payload); queue.data.payload = NULL, "Failed to add incoming ESP-NOW data to queue.");
-    if (xHigherPriorityTaskWoken == pdTRUE)
+    _context_t *ctx = handle;
+    ZH_ERROR_CHECK(ctx != NULL && ctx->is_initialized == true, ESP_ERR_NOT_FOUND, NULL, "Waiting for ESP-NOW message failed. ESP-NOW is not initialized.");
+    ZH_ERROR_CHECK(msg_id != 0, ESP_ERR_INVALID_ARG, NULL, "Waiting for ESP-NOW message failed. Invalid argument.");
+    zh_espnow_send_result_t found = {0};
+    bool is_done = false;
+    _send_waiter_t *waiter = NULL;
+    portENTER_CRITICAL(&ctx->completion_lock);
+    for (uint8_t i = 0; i < COMPLETION_RING_SIZE && is_done == false; ++i)
     {
-        portYIELD_FROM_ISR();
-    };
-}
-
-static void _zh_espnow_process_send(_queue_t *queue)
-{
-    esp_now_peer_info_t *peer = heap_caps_calloc(1, sizeof(esp_now_peer_info_t), MALLOC_CAP_8BIT);
-    ZH_ERROR_CHECK_VOID(peer != NULL, heap_caps_free(queue->data.payload); queue->data.payload = NULL, "Outgoing ESP-NOW data processed failed. Failed to allocate memory.");
-    peer->ifidx = _init_config.wifi_interface;
-    memcpy(peer->peer_addr, queue->data.mac_addr, ESP_NOW_ETH_ALEN);
-    ZH_ERROR_CHECK_VOID(esp_now_add_peer(peer) == ESP_OK, ++_stats.espnow_driver_error; heap_caps_free(queue->data.payload); queue->data.payload = NULL;
-                        heap_caps_free(peer); peer = NULL, "Outgoing ESP-NOW data processed failed. Failed to add peer.");
-    zh_espnow_event_on_send_t *on_send = heap_caps_calloc(1, sizeof(zh_espnow_event_on_send_t), MALLOC_CAP_8BIT);
-    ZH_ERROR_CHECK_VOID(on_send != NULL, heap_caps_free(queue->data.payload); queue->data.payload = NULL; esp_now_del_peer(peer->peer_addr);
-                        heap_caps_free(peer); peer = NULL, "Outgoing ESP-NOW data processed failed. Failed to allocate memory.");
-    memcpy(on_send->mac_addr, queue->data.mac_addr, ESP_NOW_ETH_ALEN);
-    on_send->status = ZH_ESPNOW_SEND_FAIL;
-    for (uint8_t attempt = 0; attempt < _init_config.attempts; ++attempt)
+        if (ctx->completions[i].msg_id == msg_id)
+        {
+            found = ctx->completions[i];
+            is_done = true;
+        }
+    }
+    for (uint8_t i = 0; i < SEND_WAITERS_MAX && is_done == false && waiter == NULL; ++i)
+    {
+        if (ctx->send_waiters[i].is_used == false)
+        {
+            waiter = &ctx->send_waiters[i];
+            waiter->is_used = true;
+            waiter->is_done = false;
+            waiter->msg_id = msg_id;
+        }
+    }
+    portEXIT_CRITICAL(&ctx->completion_lock);
+    ZH_ERROR_CHECK(is_done == true || waiter != NULL, ESP_ERR_NO_MEM, NULL, "Waiting for ESP-NOW message failed. Too many waiting tasks.");
+    if (waiter != NULL)
+    {
+        // A late completion of the previous user of the entry may have left the semaphore given. The state is checked
+        // before every wait, so a completion taken here is not lost.
+        xSemaphoreTake(waiter->wake, 0);
+    }
+    TickType_t start = xTaskGetTickCount();
+    while (is_done == false)
     {
-        ZH_ERROR_CHECK_CONT(esp_now_send(queue->data.mac_addr, queue->data.payload, queue->data.payload_len) == ESP_OK, ++_stats.espnow_driver_error, "Outgoing ESP-NOW data processed failed. ESP-NOW driver error.");
-        EventBits_t bits = xEventGroupWaitBits(_event_group_handle, DATA_SEND_SUCCESS | DATA_SEND_FAIL, pdTRUE, pdFALSE, WAIT_CONFIRM_MAX_TIME / portTICK_PERIOD_MS);
-        if (bits & DATA_SEND_SUCCESS)
+        TickType_t elapsed = xTaskGetTickCount() - start;
+        bool is_expired = (timeout != portMAX_DELAY && elapsed >= timeout);
+        portENTER_CRITICAL(&ctx->completion_lock);
+        is_done = waiter->is_done;
+        found = waiter->result;
+        if (is_done == true || is_expired == true)
+        {
+            waiter->is_used = false;
+        }
+        portEXIT_CRITICAL(&ctx->completion_lock);
+        if (is_done == true || is_expired == true)
         {
-            on_send->status = ZH_ESPNOW_SEND_SUCCESS;
-            ++_stats.sent_success;
             break;
         }
+        xSemaphoreTake(waiter->wake, (timeout == portMAX_DELAY) ? portMAX_DELAY : timeout - elapsed);
     }
-    if (on_send->status == ZH_ESPNOW_SEND_FAIL)
+    ZH_ERROR_CHECK(is_done == true, ESP_ERR_TIMEOUT, NULL, "Waiting for ESP-NOW message failed. Timeout.");
+    if (result != NULL)
     {
-        ++_stats.sent_fail;
+        *result = found;
     }
-    // clang-format off
-    ZH_ERROR_CHECK_VOID(esp_event_post(ZH_ESPNOW, ZH_ESPNOW_ON_SEND_EVENT, on_send, sizeof(zh_espnow_event_on_send_t), 1000 / portTICK_PERIOD_MS) == ESP_OK,
-                        ++_stats.event_post_error; heap_caps_free(queue->data.payload); queue->data.payload = NULL; esp_now_del_peer(peer->peer_addr);
-                        heap_caps_free(peer); peer = NULL; heap_caps_free(on_send); on_send = NULL, "Outgoing ESP-NOW data processed failed. Failed to post send event.");
-    // clang-format on
-    heap_caps_free(queue->data.payload);
-    queue->data.payload = NULL;
-    esp_now_del_peer(peer->peer_addr);
-    heap_caps_free(peer);
-    peer = NULL;
-    heap_caps_free(on_send);
-    on_send = NULL;
-}
-
-static void _zh_espnow_process_recv(_queue_t *queue)
-{
-    zh_espnow_event_on_recv_t *recv_data = heap_caps_calloc(1, (sizeof(zh_espnow_event_on_recv_t) + queue->data.payload_len), MALLOC_CAP_8BIT);
-    ZH_ERROR_CHECK_VOID(recv_data != NULL, heap_caps_free(queue->data.payload); queue->data.payload = NULL, "Incoming ESP-NOW data processing failed. Memory allocation failed.");
-    memcpy(recv_data->mac_addr, queue->data.mac_addr, ESP_NOW_ETH_ALEN);
-    recv_data->data_len = queue->data.payload_len;
-    memcpy(recv_data->data, queue->data.payload, queue->data.payload_len);
-    ++_stats.received;
-    // clang-format off
-    ZH_ERROR_CHECK_VOID(esp_event_post(ZH_ESPNOW, ZH_ESPNOW_ON_RECV_EVENT, recv_data, (sizeof(zh_espnow_event_on_recv_t) + queue->data.payload_len), 1000 / portTICK_PERIOD_MS) == ESP_OK,
-                        ++_stats.event_post_error; heap_caps_free(recv_data); recv_data = NULL; heap_caps_free(queue->data.payload); queue->data.payload = NULL, "Incoming ESP-NOW data processing failed. Failed to post event.");
-    // clang-format on
-    heap_caps_free(recv_data);
-    recv_data = NULL;
-    heap_caps_free(queue->data.payload);
-    queue->data.payload = NULL;
+    return (found.status == ZH_ESPNOW_SEND_SUCCESS) ? ESP_OK : ESP_FAIL;
 }
 
-static void IRAM_ATTR _zh_espnow_processing(void *pvParameter)
+esp_err_t zh_espnow_send_batch(const zh_espnow_batch_entry_t *entries, uint16_t entries_num, esp_err_t *results)
 {
-    _queue_t queue = {0};
-    while (xQueueReceive(_queue_handle, &queue, portMAX_DELAY) == pdTRUE)
+    return zh_espnow_instance_send_batch(&_default_context, entries, entries_num, results);
+}
+
+esp_err_t zh_espnow_instance_send_batch(zh_espnow_handle_t handle, const zh_espnow_batch_entry_t *entries, uint16_t entries_num, esp_err_t *results)
+{
+    _context_t *ctx = handle;
+    ZH_LOGI_HOT("Adding to queue outgoing ESP-NOW batch started.");
+    ZH_ERROR_CHECK(ctx != NULL && ctx->is_initialized == true, ESP_ERR_NOT_FOUND, NULL, "Adding to queue outgoing ESP-NOW batch failed. ESP-NOW is not initialized.");
+    ZH_ERROR_CHECK(entries != NULL && entries_num > 0, ESP_ERR_INVALID_ARG, NULL, "Adding to queue outgoing ESP-NOW batch failed. Invalid argument.");
+    esp_err_t first_err = ESP_OK;
+    uint16_t accepted = 0;
+    xSemaphoreTake(ctx->tx_mutex, portMAX_DELAY);
+    UBaseType_t spaces = uxQueueSpacesAvailable(ctx->tx_queues[ZH_ESPNOW_PRIORITY_NORMAL]);
+    UBaseType_t reserve = _zh_espnow_tx_reserve(ctx, ZH_ESPNOW_PRIORITY_NORMAL);
+    UBaseType_t available = (spaces > reserve) ? spaces - reserve : 0;
+    for (uint16_t i = 0; i < entries_num; ++i)
     {
-        switch (queue.id)
+        const zh_espnow_batch_entry_t *entry = &entries[i];
+        uint32_t data_len = _zh_espnow_iov_len(entry->iov, entry->iov_count);
+        esp_err_t err = ESP_OK;
+        if (data_len == 0 || data_len > _zh_espnow_max_payload(ctx))
         {
-        case TO_SEND:
-            _zh_espnow_process_send(&queue);
-            break;
-        case ON_RECV:
-            _zh_espnow_process_recv(&queue);
-            break;
-        default:
-            break;
+            err = ESP_ERR_INVALID_ARG;
+        }
+        else if (accepted >= available)
+        {
+            err = ESP_ERR_INVALID_STATE;
+            ctx->tx_blocked[ZH_ESPNOW_PRIORITY_NORMAL] = true;
+            _zh_espnow_stats_add(ctx, &ctx->stats.queue_overflow_error, 1);
+            _zh_espnow_stats_add(ctx, &ctx->stats.priority_dropped[ZH_ESPNOW_PRIORITY_NORMAL], 1);
+        }
+        else
+        {
+            err = _zh_espnow_tx_enqueue(ctx, entry->target, FRAME_DATA, 0, ZH_ESPNOW_PRIORITY_NORMAL, entry->iov, entry->iov_count, 0, NULL);
+        }
+        if (err == ESP_OK)
+        {
+            ++accepted;
+        }
+        else if (first_err == ESP_OK)
+        {
+            first_err = err;
+        }
+        if (results != NULL)
+        {
+            results[i] = err;
         }
-        _stats.min_stack_size = (uint32_t)uxTaskGetStackHighWaterMark(NULL);
     }
-    vTaskDelete(NULL);
-}
\ No newline at end of file
+    xSemaphoreGive(ctx->tx_mutex);
+    if (accepted > 0)
+    {
+        xTaskNotifyGive(ctx->task);
+    }
+    ZH_ERROR_CHECK_HOT(first_err == ESP_OK, first_err, NULL, "Adding to queue outgoing ESP-NOW batch failed. Only %u of %u entries accepted.", accepted, entries_num);
+    ZH_LOGI_HOT("Adding to queue outgoing ESP-NOW batch completed successfully.");
+    return ESP_OK;
+}
+
+esp_err_t zh_espnow_flush(TickType_t timeout)
+{
+    return zh_espnow_instance_flush(&_default_context, timeout);
+}
+
+esp_err_t zh_espnow_instance_flush(zh_espnow_handle_t handle, TickType_t timeout)
+{
+    _context_t *ctx = handle;
+    ZH_LOGI("ESP-NOW flush started.");
+    ZH_ERROR_CHECK(ctx != NULL && ctx->is_initialized == true, ESP_ERR_NOT_FOUND, NULL, "ESP-NOW flush failed. ESP-NOW is not initialized.");
+    xEventGroupClearBits(ctx->tx_event_group, TX_EVENT_BURST_DONE);
+    ctx->burst_flush_requested = true;
+    xTaskNotifyGive(ctx->task);
+    if (timeout == 0)
+    {
+        ZH_LOGI("ESP-NOW flush requested successfully.");
+        return ESP_OK;
+    }
+    EventBits_t bits = xEventGroupWaitBits(ctx->tx_event_group, TX_EVENT_BURST_DONE, pdFALSE, pdTRUE, timeout);
+    ZH_ERROR_CHECK((bits & TX_EVENT_BURST_DONE) != 0, ESP_ERR_TIMEOUT, NULL, "ESP-NOW flush failed. Timeout.");
+    ZH_LOGI("ESP-NOW flush completed successfully.");
+    return ESP_OK;
+}
+
+uint8_t zh_espnow_get_version(void)
+{
+    ZH_LOGI("ESP-NOW version receipt started.");
+    uint32_t version = 0;
+    ZH_ERROR_CHECK(esp_now_get_version(&version) == ESP_OK, 0, NULL, "ESP-NOW version receiption failed.");
+    ZH_LOGI("ESP-NOW version receiption successfully.");
+    return (uint8_t)version;
+}
+
+const zh_espnow_stats_t *zh_espnow_get_stats(void)
+{
+    return zh_espnow_instance_get_stats(&_default_context);
+}
+
+const zh_espnow_stats_t *zh_espnow_instance_get_stats(zh_espnow_handle_t handle)
+{
+    _context_t *ctx = handle;
+    return (ctx != NULL) ? &ctx->stats : NULL;
+}
+
+esp_err_t zh_espnow_get_stats_snapshot(zh_espnow_stats_t *stats)
+{
+    return zh_espnow_instance_get_stats_snapshot(&_default_context, stats);
+}
+
+esp_err_t zh_espnow_instance_get_stats_snapshot(zh_espnow_handle_t handle, zh_espnow_stats_t *stats)
+{
+    _context_t *ctx = handle;
+    ZH_ERROR_CHECK(ctx != NULL && stats != NULL, ESP_ERR_INVALID_ARG, NULL, "ESP-NOW statistic snapshot failed. Invalid argument.");
+    portENTER_CRITICAL(&ctx->stats_lock);
+    *stats = ctx->stats;
+    portEXIT_CRITICAL(&ctx->stats_lock);
+    stats->tx_queue_depth = 0;
+    for (uint8_t i = 0; i < ZH_ESPNOW_PRIORITY_NUM; ++i)
+    {
+        stats->tx_queue_depth += (ctx->tx_queues[i] != NULL) ? uxQueueMessagesWaiting(ctx->tx_queues[i]) : 0;
+    }
+    stats->rx_queue_depth = (ctx->rx_queue_handle != NULL) ? uxQueueMessagesWaiting(ctx->rx_queue_handle) : 0;
+    return ESP_OK;
+}
+
+esp_err_t zh_espnow_export_stats(uint8_t *buffer, uint16_t size, uint16_t *length)
+{
+    return zh_espnow_instance_export_stats(&_default_context, buffer, size, length);
+}
+
+esp_err_t zh_espnow_instance_export_stats(zh_espnow_handle_t handle, uint8_t *buffer, uint16_t size, uint16_t *length)
+{
+    _context_t *ctx = handle;
+    ZH_LOGI("ESP-NOW statistic export started.");
+    ZH_ERROR_CHECK(ctx != NULL && buffer != NULL && length != NULL, ESP_ERR_INVALID_ARG, NULL, "ESP-NOW statistic export failed. Invalid argument.");
+    zh_espnow_stats_t stats = {0};
+    zh_espnow_instance_get_stats_snapshot(ctx, &stats);
+    const uint32_t *counters = (const uint32_t *)&stats;
+    const uint8_t header[] = {STATS_EXPORT_VERSION, sizeof(zh_espnow_stats_t) / sizeof(uint32_t)};
+    uint16_t offset = 0;
+    bool is_fit = _zh_espnow_export_put(buffer, size, &offset, header, sizeof(header));
+    for (uint8_t i = 0; i < header[1] && is_fit == true; ++i)
+    {
+        is_fit = _zh_espnow_export_varint(buffer, size, &offset, counters[i]);
+    }
+    uint16_t peers_offset = offset;
+    uint8_t peers_num = 0;
+    is_fit = is_fit && _zh_espnow_export_put(buffer, size, &offset, &peers_num, sizeof(peers_num));
+    if (ctx->is_initialized == true)
+    {
+        xSemaphoreTake(_peer_mutex, portMAX_DELAY);
+        for (uint8_t i = 0; i < _peer_cache_size && is_fit == true; ++i)
+        {
+            const _peer_t *peer = &_peer_cache[i];
+            if (peer->is_used == false)
+            {
+                continue;
+            }
+            is_fit = _zh_espnow_export_put(buffer, size, &offset, peer->mac_addr, ESP_NOW_ETH_ALEN) &&
+                     _zh_espnow_export_varint(buffer, size, &offset, peer->sent_success) &&
+                     _zh_espnow_export_varint(buffer, size, &offset, peer->sent_fail) &&
+                     _zh_espnow_export_varint(buffer, size, &offset, peer->received) &&
+                     _zh_espnow_export_varint(buffer, size, &offset, peer->delivery_ratio) &&
+                     _zh_espnow_export_varint(buffer, size, &offset, peer->confirm_latency_us) &&
+                     _zh_espnow_export_varint(buffer, size, &offset, peer->throttled) &&
+                     _zh_espnow_export_varint(buffer, size, &offset, peer->queue_wait_us) &&
+                     _zh_espnow_export_put(buffer, size, &offset, &peer->rssi, sizeof(peer->rssi));
+            ++peers_num;
+        }
+        xSemaphoreGive(_peer_mutex);
+    }
+    ZH_ERROR_CHECK(is_fit == true, ESP_ERR_INVALID_SIZE, NULL, "ESP-NOW statistic export failed. Buffer is too small.");
+    buffer[peers_offset] = peers_num;
+    *length = offset;
+    ZH_LOGI("ESP-NOW statistic export completed successfully.");
+    return ESP_OK;
+}
+
+uint8_t zh_espnow_hist_percentile(const uint32_t *hist, uint8_t percent)
+{
+    if (hist == NULL)
+    {
+        return 0;
+    }
+    uint64_t total = 0;
+    for (uint8_t i = 0; i < ZH_ESPNOW_HISTOGRAM_SIZE; ++i)
+    {
+        total += hist[i];
+    }
+    uint64_t rank = (total * percent + 99) / 100;
+    uint64_t count = 0;
+    for (uint8_t i = 0; i < ZH_ESPNOW_HISTOGRAM_SIZE; ++i)
+    {
+        count += hist[i];
+        if (count >= rank && count != 0)
+        {
+            return i;
+        }
+    }
+    return 0;
+}
+
+void zh_espnow_reset_stats(void)
+{
+    zh_espnow_instance_reset_stats(&_default_context);
+}
+
+void zh_espnow_instance_reset_stats(zh_espnow_handle_t handle)
+{
+    _context_t *ctx = handle;
+    ZH_LOGI("Error statistic reset started.");
+    ZH_ERROR_CHECK_VOID(ctx != NULL, NULL, "Error statistic reset failed. Invalid argument.");
+    portENTER_CRITICAL(&ctx->stats_lock);
+    ctx->stats = (zh_espnow_stats_t){0};
+    portEXIT_CRITICAL(&ctx->stats_lock);
+    if (ctx->is_initialized == true)
+    {
+        xSemaphoreTake(_peer_mutex, portMAX_DELAY);
+        for (uint8_t i = 0; i < _peer_cache_size; ++i)
+        {
+            _peer_cache[i].sent_success = 0;
+            _peer_cache[i].sent_fail = 0;
+            _peer_cache[i].received = 0;
+        }
+        xSemaphoreGive(_peer_mutex);
+    }
+    ZH_LOGI("ESP-NOW statistic reset successfully.");
+}
+
+esp_err_t zh_espnow_codec_benchmark(const uint8_t *data, uint16_t data_len, zh_espnow_codec_benchmark_t *result)
+{
+    return zh_espnow_instance_codec_benchmark(&_default_context, data, data_len, result);
+}
+
+esp_err_t zh_espnow_instance_codec_benchmark(zh_espnow_handle_t handle, const uint8_t *data, uint16_t data_len, zh_espnow_codec_benchmark_t *result)
+{
+    _context_t *ctx = handle;
+    ZH_LOGI("ESP-NOW codec benchmark started.");
+    ZH_ERROR_CHECK(ctx != NULL && ctx->is_initialized == true, ESP_ERR_NOT_FOUND, NULL, "ESP-NOW codec benchmark failed. ESP-NOW is not initialized.");
+    ZH_ERROR_CHECK(data != NULL && data_len > 0 && data_len <= _zh_espnow_max_payload(ctx) && result != NULL, ESP_ERR_INVALID_ARG, NULL, "ESP-NOW codec benchmark failed. Invalid argument.");
+    ZH_ERROR_CHECK(ctx->codec_table != NULL, ESP_ERR_NOT_SUPPORTED, NULL, "ESP-NOW codec benchmark failed. Compression is disabled.");
+    // Worst case of the encoder: a literal token for every 128 bytes plus the length prefix.
+    uint16_t packed_size = data_len + data_len / CODEC_LITERALS_MAX + 3;
+    uint8_t *packed = heap_caps_malloc(packed_size, MALLOC_CAP_8BIT);
+    uint8_t *unpacked = heap_caps_malloc(data_len, MALLOC_CAP_8BIT);
+    ZH_ERROR_CHECK(packed != NULL && unpacked != NULL, ESP_ERR_NO_MEM, heap_caps_free(packed); heap_caps_free(unpacked), "ESP-NOW codec benchmark failed. Memory allocation failed.");
+    xSemaphoreTake(ctx->tx_mutex, portMAX_DELAY);
+    esp_cpu_cycle_count_t start = esp_cpu_get_cycle_count();
+    uint16_t packed_len = _zh_espnow_codec_encode(ctx, data, data_len, packed, packed_size);
+    esp_cpu_cycle_count_t middle = esp_cpu_get_cycle_count();
+    uint16_t unpacked_len = (packed_len > 0) ? _zh_espnow_codec_decode(packed, packed_len, unpacked, data_len) : 0;
+    esp_cpu_cycle_count_t end = esp_cpu_get_cycle_count();
+    xSemaphoreGive(ctx->tx_mutex);
+    bool is_valid = (unpacked_len == data_len && memcmp(data, unpacked, data_len) == 0);
+    heap_caps_free(packed);
+    heap_caps_free(unpacked);
+    ZH_ERROR_CHECK(is_valid == true, ESP_FAIL, NULL, "ESP-NOW codec benchmark failed. Round trip mismatch.");
+    *result = (zh_espnow_codec_benchmark_t){.compressed_len = packed_len, .encode_cycles = middle - start, .decode_cycles = end - middle};
+    ZH_LOGI("ESP-NOW codec benchmark completed successfully.");
+    return ESP_OK;
+}
+
+esp_err_t zh_espnow_trace_dump(zh_espnow_trace_record_t *records, uint16_t *count)
+{
+    return zh_espnow_instance_trace_dump(&_default_context, records, count);
+}
+
+esp_err_t zh_espnow_instance_trace_dump(zh_espnow_handle_t handle, zh_espnow_trace_record_t *records, uint16_t *count)
+{
+    _context_t *ctx = handle;
+    ZH_LOGI("ESP-NOW trace dump started.");
+    ZH_ERROR_CHECK(ctx != NULL && records != NULL && count != NULL, ESP_ERR_INVALID_ARG, NULL, "ESP-NOW trace dump failed. Invalid argument.");
+    ZH_ERROR_CHECK(ctx->trace_ring != NULL, ESP_ERR_NOT_SUPPORTED, NULL, "ESP-NOW trace dump failed. Trace is disabled.");
+    *count = _zh_espnow_trace_collect(ctx, records, *count);
+    ZH_LOGI("ESP-NOW trace dump completed successfully.");
+    return ESP_OK;
+}
+
+esp_err_t zh_espnow_trace_export(uint8_t *buffer, uint32_t size, uint32_t *length)
+{
+    return zh_espnow_instance_trace_export(&_default_context, buffer, size, length);
+}
+
+esp_err_t zh_espnow_instance_trace_export(zh_espnow_handle_t handle, uint8_t *buffer, uint32_t size, uint32_t *length)
+{
+    _context_t *ctx = handle;
+    ZH_LOGI("ESP-NOW trace export started.");
+    ZH_ERROR_CHECK(ctx != NULL && buffer != NULL && length != NULL, ESP_ERR_INVALID_ARG, NULL, "ESP-NOW trace export failed. Invalid argument.");
+    ZH_ERROR_CHECK(ctx->trace_ring != NULL, ESP_ERR_NOT_SUPPORTED, NULL, "ESP-NOW trace export failed. Trace is disabled.");
+    ZH_ERROR_CHECK(size >= ZH_ESPNOW_TRACE_EXPORT_HEADER_SIZE, ESP_ERR_INVALID_SIZE, NULL, "ESP-NOW trace export failed. Buffer is too small.");
+    uint32_t capacity = (size - ZH_ESPNOW_TRACE_EXPORT_HEADER_SIZE) / sizeof(zh_espnow_trace_record_t);
+    uint32_t written = ctx->trace_head - ctx->trace_start;
+    uint16_t count = _zh_espnow_trace_collect(ctx, (zh_espnow_trace_record_t *)(buffer + ZH_ESPNOW_TRACE_EXPORT_HEADER_SIZE), (capacity > UINT16_MAX) ? UINT16_MAX : capacity);
+    uint32_t lost = (written > count) ? written - count : 0;
+    uint16_t cpu_mhz = esp_rom_get_cpu_ticks_per_us();
+    buffer[0] = TRACE_EXPORT_VERSION;
+    buffer[1] = sizeof(zh_espnow_trace_record_t);
+    memcpy(&buffer[2], &cpu_mhz, sizeof(cpu_mhz));
+    memcpy(&buffer[4], &count, sizeof(count));
+    memcpy(&buffer[6], &lost, sizeof(lost));
+    *length = ZH_ESPNOW_TRACE_EXPORT_HEADER_SIZE + count * sizeof(zh_espnow_trace_record_t);
+    ZH_LOGI("ESP-NOW trace export completed successfully.");
+    return ESP_OK;
+}
+
+void zh_espnow_trace_clear(void)
+{
+    zh_espnow_instance_trace_clear(&_default_context);
+}
+
+void zh_espnow_instance_trace_clear(zh_espnow_handle_t handle)
+{
+    _context_t *ctx = handle;
+    ZH_LOGI("ESP-NOW trace clear started.");
+    ZH_ERROR_CHECK_VOID(ctx != NULL, NULL, "ESP-NOW trace clear failed. Invalid argument.");
+    ctx->trace_start = ctx->trace_head;
+    ZH_LOGI("ESP-NOW trace clear completed successfully.");
+}
+
+esp_err_t zh_espnow_get_mac(uint8_t *mac_addr)
+{
+    return zh_espnow_instance_get_mac(&_default_context, mac_addr);
+}
+
+esp_err_t zh_espnow_instance_get_mac(zh_espnow_handle_t handle, uint8_t *mac_addr)
+{
+    _context_t *ctx = handle;
+    ZH_ERROR_CHECK(ctx != NULL, ESP_ERR_INVALID_ARG, NULL, "ESP-NOW MAC address request failed. Invalid argument.");
+    return esp_wifi_get_mac(ctx->init_config.wifi_interface, mac_addr);
+}
+
+esp_err_t zh_espnow_register_recv_handler(zh_espnow_recv_handler_t handler, void *arg)
+{
+    return zh_espnow_instance_register_recv_handler(&_default_context, handler, arg);
+}
+
+esp_err_t zh_espnow_instance_register_recv_handler(zh_espnow_handle_t handle, zh_espnow_recv_handler_t handler, void *arg)
+{
+    _context_t *ctx = handle;
+    ZH_LOGI("ESP-NOW receive handler registration started.");
+    ZH_ERROR_CHECK(ctx != NULL && ctx->is_initialized == true, ESP_ERR_NOT_FOUND, NULL, "ESP-NOW receive handler registration failed. ESP-NOW is not initialized.");
+    ZH_ERROR_CHECK(ctx->init_config.battery_mode == false, ESP_ERR_INVALID_STATE, NULL, "ESP-NOW receive handler registration failed. Receive is disabled in battery mode.");
+    portENTER_CRITICAL(&ctx->recv_handler_lock);
+    ctx->recv_handler = handler;
+    ctx->recv_handler_arg = arg;
+    portEXIT_CRITICAL(&ctx->recv_handler_lock);
+    ZH_LOGI("ESP-NOW receive handler registration completed successfully.");
+    return ESP_OK;
+}
+
+void zh_espnow_recv_release(const uint8_t *data)
+{
+    if (data == NULL)
+    {
+        return;
+    }
+    // Every instance has its own pool; a block outside of it is ignored by _zh_espnow_pool_free().
+    for (uint8_t i = 0; i < ZH_ESPNOW_INSTANCES_MAX; ++i)
+    {
+        if (_contexts[i] != NULL)
+        {
+            _zh_espnow_pool_free(_contexts[i], (zh_espnow_event_on_recv_t *)(data - offsetof(zh_espnow_event_on_recv_t, data)));
+        }
+    }
+}
+
+esp_err_t zh_espnow_peer_pin(const uint8_t *mac_addr)
+{
+    return zh_espnow_instance_peer_pin(&_default_context, mac_addr);
+}
+
+esp_err_t zh_espnow_instance_peer_pin(zh_espnow_handle_t handle, const uint8_t *mac_addr)
+{
+    _context_t *ctx = handle;
+    ZH_LOGI("ESP-NOW peer pinning started.");
+    ZH_ERROR_CHECK(ctx != NULL && ctx->is_initialized == true, ESP_ERR_NOT_FOUND, NULL, "ESP-NOW peer pinning failed. ESP-NOW is not initialized.");
+    ZH_ERROR_CHECK(mac_addr != NULL, ESP_ERR_INVALID_ARG, NULL, "ESP-NOW peer pinning failed. Invalid argument.");
+    esp_err_t err = _zh_espnow_peer_acquire(ctx, mac_addr, true);
+    ZH_ERROR_CHECK(err == ESP_OK, err, NULL, "ESP-NOW peer pinning failed.");
+    ZH_LOGI("ESP-NOW peer pinning completed successfully.");
+    return ESP_OK;
+}
+
+esp_err_t zh_espnow_peer_unpin(const uint8_t *mac_addr)
+{
+    ZH_LOGI("ESP-NOW peer unpinning started.");
+    ZH_ERROR_CHECK(_peer_mutex != NULL, ESP_ERR_NOT_FOUND, NULL, "ESP-NOW peer unpinning failed. ESP-NOW is not initialized.");
+    ZH_ERROR_CHECK(mac_addr != NULL, ESP_ERR_INVALID_ARG, NULL, "ESP-NOW peer unpinning failed. Invalid argument.");
+    xSemaphoreTake(_peer_mutex, portMAX_DELAY);
+    _peer_t *peer = _zh_espnow_peer_find(mac_addr);
+    if (peer != NULL)
+    {
+        peer->is_pinned = false;
+    }
+    xSemaphoreGive(_peer_mutex);
+    esp_err_t err = (peer != NULL) ? ESP_OK : ESP_ERR_NOT_FOUND;
+    ZH_ERROR_CHECK(err == ESP_OK, err, NULL, "ESP-NOW peer unpinning failed. Peer is not in the cache.");
+    ZH_LOGI("ESP-NOW peer unpinning completed successfully.");
+    return ESP_OK;
+}
+
+esp_err_t zh_espnow_get_peer_stats(const uint8_t *mac_addr, zh_espnow_peer_stats_t *peer_stats)
+{
+    ZH_ERROR_CHECK(_peer_mutex != NULL, ESP_ERR_NOT_FOUND, NULL, "ESP-NOW peer statistic receipt failed. ESP-NOW is not initialized.");
+    ZH_ERROR_CHECK(mac_addr != NULL && peer_stats != NULL, ESP_ERR_INVALID_ARG, NULL, "ESP-NOW peer statistic receipt failed. Invalid argument.");
+    xSemaphoreTake(_peer_mutex, portMAX_DELAY);
+    const _peer_t *peer = _zh_espnow_peer_find(mac_addr);
+    if (peer != NULL)
+    {
+        _zh_espnow_peer_stats_fill(peer, peer_stats);
+    }
+    xSemaphoreGive(_peer_mutex);
+    ZH_ERROR_CHECK(peer != NULL, ESP_ERR_NOT_FOUND, NULL, "ESP-NOW peer statistic receipt failed. Peer is not in the cache.");
+    return ESP_OK;
+}
+
+esp_err_t zh_espnow_get_peer_stats_table(zh_espnow_peer_stats_t *table, uint8_t *count)
+{
+    ZH_ERROR_CHECK(_peer_mutex != NULL, ESP_ERR_NOT_FOUND, NULL, "ESP-NOW peer statistic table receipt failed. ESP-NOW is not initialized.");
+    ZH_ERROR_CHECK(table != NULL && count != NULL, ESP_ERR_INVALID_ARG, NULL, "ESP-NOW peer statistic table receipt failed. Invalid argument.");
+    uint8_t filled = 0;
+    xSemaphoreTake(_peer_mutex, portMAX_DELAY);
+    for (uint8_t i = 0; i < _peer_cache_size && filled < *count; ++i)
+    {
+        if (_peer_cache[i].is_used == true)
+        {
+            _zh_espnow_peer_stats_fill(&_peer_cache[i], &table[filled++]);
+        }
+    }
+    xSemaphoreGive(_peer_mutex);
+    *count = filled;
+    return ESP_OK;
+}
+
+esp_err_t zh_espnow_filter_set_mode(zh_espnow_filter_mode_t mode)
+{
+    return zh_espnow_instance_filter_set_mode(&_default_context, mode);
+}
+
+esp_err_t zh_espnow_instance_filter_set_mode(zh_espnow_handle_t handle, zh_espnow_filter_mode_t mode)
+{
+    _context_t *ctx = handle;
+    ZH_LOGI("ESP-NOW receive filter mode setting started.");
+    ZH_ERROR_CHECK(ctx != NULL && ctx->is_initialized == true, ESP_ERR_NOT_FOUND, NULL, "ESP-NOW receive filter mode setting failed. ESP-NOW is not initialized.");
+    ZH_ERROR_CHECK(mode <= ZH_ESPNOW_FILTER_DENY, ESP_ERR_INVALID_ARG, NULL, "ESP-NOW receive filter mode setting failed. Invalid argument.");
+    ZH_ERROR_CHECK(mode == ZH_ESPNOW_FILTER_OFF || ctx->filter_table != NULL, ESP_ERR_NOT_SUPPORTED, NULL, "ESP-NOW receive filter mode setting failed. MAC filter is disabled.");
+    ctx->filter_mode = mode;
+    ZH_LOGI("ESP-NOW receive filter mode setting completed successfully.");
+    return ESP_OK;
+}
+
+esp_err_t zh_espnow_filter_add(const uint8_t *mac_addr)
+{
+    return zh_espnow_instance_filter_add(&_default_context, mac_addr);
+}
+
+esp_err_t zh_espnow_instance_filter_add(zh_espnow_handle_t handle, const uint8_t *mac_addr)
+{
+    _context_t *ctx = handle;
+    ZH_LOGI("ESP-NOW receive filter address adding started.");
+    ZH_ERROR_CHECK(ctx != NULL && ctx->is_initialized == true, ESP_ERR_NOT_FOUND, NULL, "ESP-NOW receive filter address adding failed. ESP-NOW is not initialized.");
+    ZH_ERROR_CHECK(mac_addr != NULL, ESP_ERR_INVALID_ARG, NULL, "ESP-NOW receive filter address adding failed. Invalid argument.");
+    ZH_ERROR_CHECK(ctx->filter_table != NULL, ESP_ERR_NOT_SUPPORTED, NULL, "ESP-NOW receive filter address adding failed. MAC filter is disabled.");
+    esp_err_t err = ESP_OK;
+    _zh_espnow_filter_write_begin(ctx);
+    _filter_entry_t *entry = _zh_espnow_filter_find(ctx, mac_addr, false);
+    if (entry == NULL && ctx->filter_count < ctx->init_config.filter_size)
+    {
+        entry = _zh_espnow_filter_find(ctx, mac_addr, true);
+        memcpy(entry->mac_addr, mac_addr, ESP_NOW_ETH_ALEN);
+        entry->state = FILTER_SLOT_USED;
+        ++ctx->filter_count;
+    }
+    if (entry != NULL)
+    {
+        entry->hits = 0;
+    }
+    else
+    {
+        err = ESP_ERR_NO_MEM;
+    }
+    _zh_espnow_filter_write_end(ctx);
+    ZH_ERROR_CHECK(err == ESP_OK, err, NULL, "ESP-NOW receive filter address adding failed. Filter is full.");
+    ZH_LOGI("ESP-NOW receive filter address adding completed successfully.");
+    return ESP_OK;
+}
+
+esp_err_t zh_espnow_filter_remove(const uint8_t *mac_addr)
+{
+    return zh_espnow_instance_filter_remove(&_default_context, mac_addr);
+}
+
+esp_err_t zh_espnow_instance_filter_remove(zh_espnow_handle_t handle, const uint8_t *mac_addr)
+{
+    _context_t *ctx = handle;
+    ZH_LOGI("ESP-NOW receive filter address removing started.");
+    ZH_ERROR_CHECK(ctx != NULL && ctx->is_initialized == true, ESP_ERR_NOT_FOUND, NULL, "ESP-NOW receive filter address removing failed. ESP-NOW is not initialized.");
+    ZH_ERROR_CHECK(mac_addr != NULL, ESP_ERR_INVALID_ARG, NULL, "ESP-NOW receive filter address removing failed. Invalid argument.");
+    _zh_espnow_filter_write_begin(ctx);
+    _filter_entry_t *entry = _zh_espnow_filter_find(ctx, mac_addr, false);
+    if (entry != NULL)
+    {
+        entry->state = FILTER_SLOT_DELETED;
+        --ctx->filter_count;
+    }
+    _zh_espnow_filter_write_end(ctx);
+    ZH_ERROR_CHECK(entry != NULL, ESP_ERR_NOT_FOUND, NULL, "ESP-NOW receive filter address removing failed. Address is not in the filter.");
+    ZH_LOGI("ESP-NOW receive filter address removing completed successfully.");
+    return ESP_OK;
+}
+
+esp_err_t zh_espnow_filter_set_prefix(uint8_t index, const uint8_t *prefix, uint8_t prefix_len)
+{
+    return zh_espnow_instance_filter_set_prefix(&_default_context, index, prefix, prefix_len);
+}
+
+esp_err_t zh_espnow_instance_filter_set_prefix(zh_espnow_handle_t handle, uint8_t index, const uint8_t *prefix, uint8_t prefix_len)
+{
+    _context_t *ctx = handle;
+    ZH_LOGI("ESP-NOW receive filter prefix setting started.");
+    ZH_ERROR_CHECK(ctx != NULL && ctx->is_initialized == true, ESP_ERR_NOT_FOUND, NULL, "ESP-NOW receive filter prefix setting failed. ESP-NOW is not initialized.");
+    ZH_ERROR_CHECK(index < ZH_ESPNOW_FILTER_PREFIX_RULES && prefix_len <= ZH_ESPNOW_FILTER_PREFIX_MAX && (prefix != NULL || prefix_len == 0), ESP_ERR_INVALID_ARG, NULL,
+                   "ESP-NOW receive filter prefix setting failed. Invalid argument.");
+    _zh_espnow_filter_write_begin(ctx);
+    _filter_prefix_t *rule = &ctx->filter_prefixes[index];
+    ctx->filter_prefixes_num = ctx->filter_prefixes_num - ((rule->len != 0) ? 1 : 0) + ((prefix_len != 0) ? 1 : 0);
+    rule->len = prefix_len;
+    if (prefix_len != 0)
+    {
+        memcpy(rule->value, prefix, prefix_len);
+    }
+    rule->hits = 0;
+    _zh_espnow_filter_write_end(ctx);
+    ZH_LOGI("ESP-NOW receive filter prefix setting completed successfully.");
+    return ESP_OK;
+}
+
+esp_err_t zh_espnow_filter_get_hits(const uint8_t *mac_addr, uint32_t *hits)
+{
+    return zh_espnow_instance_filter_get_hits(&_default_context, mac_addr, hits);
+}
+
+esp_err_t zh_espnow_instance_filter_get_hits(zh_espnow_handle_t handle, const uint8_t *mac_addr, uint32_t *hits)
+{
+    _context_t *ctx = handle;
+    ZH_ERROR_CHECK(ctx != NULL && ctx->is_initialized == true, ESP_ERR_NOT_FOUND, NULL, "ESP-NOW receive filter hits receipt failed. ESP-NOW is not initialized.");
+    ZH_ERROR_CHECK(mac_addr != NULL && hits != NULL, ESP_ERR_INVALID_ARG, NULL, "ESP-NOW receive filter hits receipt failed. Invalid argument.");
+    portENTER_CRITICAL(&ctx->filter_lock);
+    const _filter_entry_t *entry = _zh_espnow_filter_find(ctx, mac_addr, false);
+    if (entry != NULL)
+    {
+        *hits = entry->hits;
+    }
+    portEXIT_CRITICAL(&ctx->filter_lock);
+    ZH_ERROR_CHECK(entry != NULL, ESP_ERR_NOT_FOUND, NULL, "ESP-NOW receive filter hits receipt failed. Address is not in the filter.");
+    return ESP_OK;
+}
+
+esp_err_t zh_espnow_filter_get_prefix_hits(uint8_t index, uint32_t *hits)
+{
+    return zh_espnow_instance_filter_get_prefix_hits(&_default_context, index, hits);
+}
+
+esp_err_t zh_espnow_instance_filter_get_prefix_hits(zh_espnow_handle_t handle, uint8_t index, uint32_t *hits)
+{
+    _context_t *ctx = handle;
+    ZH_ERROR_CHECK(ctx != NULL && ctx->is_initialized == true, ESP_ERR_NOT_FOUND, NULL, "ESP-NOW receive filter hits receipt failed. ESP-NOW is not initialized.");
+    ZH_ERROR_CHECK(index < ZH_ESPNOW_FILTER_PREFIX_RULES && hits != NULL, ESP_ERR_INVALID_ARG, NULL, "ESP-NOW receive filter hits receipt failed. Invalid argument.");
+    *hits = ctx->filter_prefixes[index].hits;
+    return ESP_OK;
+}
+
+esp_err_t zh_espnow_relay_send(const uint8_t *target, const uint8_t *data, uint16_t data_len, uint32_t *msg_id)
+{
+    return zh_espnow_instance_relay_send(&_default_context, target, data, data_len, msg_id);
+}
+
+esp_err_t zh_espnow_instance_relay_send(zh_espnow_handle_t handle, const uint8_t *target, const uint8_t *data, uint16_t data_len, uint32_t *msg_id)
+{
+    _context_t *ctx = handle;
+    ZH_LOGI_HOT("Adding to queue outgoing ESP-NOW relay message started.");
+    ZH_ERROR_CHECK(ctx != NULL && ctx->is_initialized == true, ESP_ERR_NOT_FOUND, NULL, "Adding to queue outgoing ESP-NOW relay message failed. ESP-NOW is not initialized.");
+    ZH_ERROR_CHECK(ctx->init_config.relay_ttl > 0, ESP_ERR_NOT_SUPPORTED, NULL, "Adding to queue outgoing ESP-NOW relay message failed. Relay is disabled.");
+    ZH_ERROR_CHECK(data != NULL && data_len > 0 && data_len + sizeof(_relay_header_t) <= _zh_espnow_max_payload(ctx), ESP_ERR_INVALID_ARG, NULL, "Adding to queue outgoing ESP-NOW relay message failed. Invalid argument.");
+    _relay_header_t header = {.ttl = ctx->init_config.relay_ttl};
+    memcpy(header.origin, ctx->own_mac, ESP_NOW_ETH_ALEN);
+    memcpy(header.destination, (target == NULL) ? _broadcast_mac : target, ESP_NOW_ETH_ALEN);
+    uint8_t next_hop[ESP_NOW_ETH_ALEN] = {0};
+    _zh_espnow_relay_next_hop(ctx, header.destination, next_hop);
+    const zh_espnow_iovec_t iov[] = {{.data = &header, .data_len = sizeof(_relay_header_t)}, {.data = data, .data_len = data_len}};
+    uint32_t id = 0;
+    // Returns with the transmit mutex taken, which also serialises the relay sequence numbers.
+    bool has_space = _zh_espnow_tx_wait_space(ctx, ZH_ESPNOW_PRIORITY_NORMAL, 0);
+    header.seq = ctx->relay_seq + 1;
+    esp_err_t err = (has_space == true) ? _zh_espnow_tx_enqueue(ctx, next_hop, FRAME_RELAY, 0, ZH_ESPNOW_PRIORITY_NORMAL, iov, 2, 0, &id) : ESP_ERR_INVALID_STATE;
+    // A rejected message must not leave a gap in the seen caches of the other nodes.
+    ctx->relay_seq = (err == ESP_OK) ? header.seq : ctx->relay_seq;
+    xSemaphoreGive(ctx->tx_mutex);
+    ZH_ERROR_CHECK(has_space == true, ESP_ERR_INVALID_STATE, _zh_espnow_stats_add(ctx, &ctx->stats.queue_overflow_error, 1), "Adding to queue outgoing ESP-NOW relay message failed. Queue is almost full.");
+    ZH_ERROR_CHECK(err == ESP_OK, err, NULL, "Adding to queue outgoing ESP-NOW relay message failed.");
+    xTaskNotifyGive(ctx->task);
+    if (msg_id != NULL)
+    {
+        *msg_id = id;
+    }
+    ZH_LOGI_HOT("Adding to queue outgoing ESP-NOW relay message completed successfully.");
+    return ESP_OK;
+}
+
+esp_err_t zh_espnow_rpc_call(const uint8_t *target, const uint8_t *data, uint16_t data_len, TickType_t timeout, uint8_t *reply, uint16_t *reply_len)
+{
+    return zh_espnow_instance_rpc_call(&_default_context, target, data, data_len, timeout, reply, reply_len);
+}
+
+esp_err_t zh_espnow_instance_rpc_call(zh_espnow_handle_t handle, const uint8_t *target, const uint8_t *data, uint16_t data_len, TickType_t timeout, uint8_t *reply, uint16_t *reply_len)
+{
+    _context_t *ctx = handle;
+    ZH_LOGI_HOT("ESP-NOW RPC call started.");
+    ZH_ERROR_CHECK(ctx != NULL && reply != NULL && reply_len != NULL, ESP_ERR_INVALID_ARG, NULL, "ESP-NOW RPC call failed. Invalid argument.");
+    _rpc_call_t *call = NULL;
+    esp_err_t err = _zh_espnow_rpc_start(ctx, target, data, data_len, timeout, NULL, NULL, &call, NULL);
+    ZH_ERROR_CHECK(err == ESP_OK, err, NULL, "ESP-NOW RPC call failed.");
+    SemaphoreHandle_t wake = ctx->rpc_wake[call - ctx->rpc_calls];
+    // May hold a stale give of an earlier call of the entry. The state is checked before every wait.
+    xSemaphoreTake(wake, 0);
+    zh_espnow_event_on_recv_t *message = NULL;
+    bool is_finished = false;
+    while (is_finished == false)
+    {
+        portENTER_CRITICAL(&ctx->rpc_lock);
+        int32_t remaining = (int32_t)(call->deadline - xTaskGetTickCount());
+        is_finished = (call->state == RPC_DONE || remaining <= 0);
+        if (is_finished == true)
+        {
+            // Only this task frees a blocking call, so the receive task cannot complete it from here on.
+            err = (call->state == RPC_DONE) ? call->status : ESP_ERR_TIMEOUT;
+            message = call->reply;
+            if (err == ESP_ERR_TIMEOUT)
+            {
+                _zh_espnow_rpc_recent_add(ctx, call->call_id, false);
+            }
+            *call = (_rpc_call_t){0};
+        }
+        portEXIT_CRITICAL(&ctx->rpc_lock);
+        if (is_finished == false)
+        {
+            xSemaphoreTake(wake, (TickType_t)remaining);
+        }
+    }
+    ZH_ERROR_CHECK(err != ESP_ERR_TIMEOUT, ESP_ERR_TIMEOUT, _zh_espnow_stats_add(ctx, &ctx->stats.rpc_timeouts, 1), "ESP-NOW RPC call failed. Timeout.");
+    ZH_ERROR_CHECK(err == ESP_OK, err, NULL, "ESP-NOW RPC call failed. Request could not be delivered.");
+    uint16_t size = *reply_len;
+    *reply_len = message->data_len;
+    if (message->data_len <= size)
+    {
+        memcpy(reply, message->data, message->data_len);
+    }
+    _zh_espnow_pool_free(ctx, message);
+    ZH_ERROR_CHECK(*reply_len <= size, ESP_ERR_INVALID_SIZE, NULL, "ESP-NOW RPC call failed. Reply buffer is too small.");
+    ZH_LOGI_HOT("ESP-NOW RPC call completed successfully.");
+    return ESP_OK;
+}
+
+esp_err_t zh_espnow_rpc_call_async(const uint8_t *target, const uint8_t *data, uint16_t data_len, TickType_t timeout, zh_espnow_rpc_callback_t callback, void *arg, uint16_t *call_id)
+{
+    return zh_espnow_instance_rpc_call_async(&_default_context, target, data, data_len, timeout, callback, arg, call_id);
+}
+
+esp_err_t zh_espnow_instance_rpc_call_async(zh_espnow_handle_t handle, const uint8_t *target, const uint8_t *data, uint16_t data_len, TickType_t timeout, zh_espnow_rpc_callback_t callback, void *arg, uint16_t *call_id)
+{
+    _context_t *ctx = handle;
+    ZH_LOGI_HOT("ESP-NOW asynchronous RPC call started.");
+    ZH_ERROR_CHECK(ctx != NULL && callback != NULL, ESP_ERR_INVALID_ARG, NULL, "ESP-NOW asynchronous RPC call failed. Invalid argument.");
+    esp_err_t err = _zh_espnow_rpc_start(ctx, target, data, data_len, timeout, callback, arg, NULL, call_id);
+    ZH_ERROR_CHECK(err == ESP_OK, err, NULL, "ESP-NOW asynchronous RPC call failed.");
+    // The receive task may sleep until an earlier deadline or forever, let it pick up the new one.
+    const _queue_t wake = {.id = RPC_WAKE};
+    xQueueSend(ctx->rx_queue_handle, &wake, 0);
+    ZH_LOGI_HOT("ESP-NOW asynchronous RPC call completed successfully.");
+    return ESP_OK;
+}
+
+esp_err_t zh_espnow_rpc_reply(const uint8_t *target, uint16_t call_id, const uint8_t *data, uint16_t data_len)
+{
+    return zh_espnow_instance_rpc_reply(&_default_context, target, call_id, data, data_len);
+}
+
+esp_err_t zh_espnow_instance_rpc_reply(zh_espnow_handle_t handle, const uint8_t *target, uint16_t call_id, const uint8_t *data, uint16_t data_len)
+{
+    _context_t *ctx = handle;
+    ZH_LOGI_HOT("Adding to queue outgoing ESP-NOW RPC reply started.");
+    ZH_ERROR_CHECK(ctx != NULL && ctx->is_initialized == true, ESP_ERR_NOT_FOUND, NULL, "Adding to queue outgoing ESP-NOW RPC reply failed. ESP-NOW is not initialized.");
+    ZH_ERROR_CHECK(ctx->init_config.frame_header == true, ESP_ERR_NOT_SUPPORTED, NULL, "Adding to queue outgoing ESP-NOW RPC reply failed. Frame header is disabled.");
+    ZH_ERROR_CHECK(target != NULL && (data != NULL || data_len == 0) && data_len + sizeof(_rpc_header_t) <= _zh_espnow_max_payload(ctx), ESP_ERR_INVALID_ARG, NULL, "Adding to queue outgoing ESP-NOW RPC reply failed. Invalid argument.");
+    esp_err_t err = _zh_espnow_rpc_send(ctx, target, FRAME_RPC_REPLY, call_id, data, data_len, NULL);
+    ZH_ERROR_CHECK(err == ESP_OK, err, NULL, "Adding to queue outgoing ESP-NOW RPC reply failed.");
+    ZH_LOGI_HOT("Adding to queue outgoing ESP-NOW RPC reply completed successfully.");
+    return ESP_OK;
+}
+
+esp_err_t zh_espnow_bulk_send(const uint8_t *target, const uint8_t *data, uint32_t data_len, uint16_t *transfer_id)
+{
+    return zh_espnow_instance_bulk_send(&_default_context, target, data, data_len, transfer_id);
+}
+
+esp_err_t zh_espnow_instance_bulk_send(zh_espnow_handle_t handle, const uint8_t *target, const uint8_t *data, uint32_t data_len, uint16_t *transfer_id)
+{
+    _context_t *ctx = handle;
+    ZH_LOGI("Adding outgoing ESP-NOW bulk transfer started.");
+    ZH_ERROR_CHECK(ctx != NULL && data != NULL, ESP_ERR_INVALID_ARG, NULL, "Adding outgoing ESP-NOW bulk transfer failed. Invalid argument.");
+    esp_err_t err = _zh_espnow_bulk_start(ctx, target, data_len, &_zh_espnow_bulk_buffer_source, (void *)data, transfer_id);
+    ZH_ERROR_CHECK(err == ESP_OK, err, NULL, "Adding outgoing ESP-NOW bulk transfer failed.");
+    ZH_LOGI("Adding outgoing ESP-NOW bulk transfer completed successfully.");
+    return ESP_OK;
+}
+
+esp_err_t zh_espnow_bulk_send_from(const uint8_t *target, uint32_t data_len, zh_espnow_bulk_source_t source, void *arg, uint16_t *transfer_id)
+{
+    return zh_espnow_instance_bulk_send_from(&_default_context, target, data_len, source, arg, transfer_id);
+}
+
+esp_err_t zh_espnow_instance_bulk_send_from(zh_espnow_handle_t handle, const uint8_t *target, uint32_t data_len, zh_espnow_bulk_source_t source, void *arg, uint16_t *transfer_id)
+{
+    _context_t *ctx = handle;
+    ZH_LOGI("Adding outgoing ESP-NOW bulk transfer started.");
+    ZH_ERROR_CHECK(ctx != NULL, ESP_ERR_INVALID_ARG, NULL, "Adding outgoing ESP-NOW bulk transfer failed. Invalid argument.");
+    esp_err_t err = _zh_espnow_bulk_start(ctx, target, data_len, source, arg, transfer_id);
+    ZH_ERROR_CHECK(err == ESP_OK, err, NULL, "Adding outgoing ESP-NOW bulk transfer failed.");
+    ZH_LOGI("Adding outgoing ESP-NOW bulk transfer completed successfully.");
+    return ESP_OK;
+}
+
+esp_err_t zh_espnow_bulk_register_sink(zh_espnow_bulk_sink_t sink, void *arg)
+{
+    return zh_espnow_instance_bulk_register_sink(&_default_context, sink, arg);
+}
+
+esp_err_t zh_espnow_instance_bulk_register_sink(zh_espnow_handle_t handle, zh_espnow_bulk_sink_t sink, void *arg)
+{
+    _context_t *ctx = handle;
+    ZH_LOGI("ESP-NOW bulk sink registration started.");
+    ZH_ERROR_CHECK(ctx != NULL && ctx->is_initialized == true, ESP_ERR_NOT_FOUND, NULL, "ESP-NOW bulk sink registration failed. ESP-NOW is not initialized.");
+    ZH_ERROR_CHECK(ctx->init_config.battery_mode == false, ESP_ERR_INVALID_STATE, NULL, "ESP-NOW bulk sink registration failed. Receive is disabled in battery mode.");
+    portENTER_CRITICAL(&ctx->bulk_lock);
+    ctx->bulk_sink = sink;
+    ctx->bulk_sink_arg = arg;
+    portEXIT_CRITICAL(&ctx->bulk_lock);
+    ZH_LOGI("ESP-NOW bulk sink registration completed successfully.");
+    return ESP_OK;
+}
+
+void zh_espnow_bulk_release(void)
+{
+    zh_espnow_instance_bulk_release(&_default_context);
+}
+
+void zh_espnow_instance_bulk_release(zh_espnow_handle_t handle)
+{
+    _context_t *ctx = handle;
+    ZH_ERROR_CHECK_VOID(ctx != NULL, NULL, "ESP-NOW bulk buffer release failed. Invalid argument.");
+    portENTER_CRITICAL(&ctx->bulk_lock);
+    ctx->bulk_rx_buffer_locked = false;
+    portEXIT_CRITICAL(&ctx->bulk_lock);
+}
+
+static esp_err_t _zh_espnow_context_init(_context_t *ctx, const zh_espnow_init_config_t *user_config)
+{
+    zh_espnow_init_config_t resolved_config = *user_config;
+    _zh_espnow_config_defaults(&resolved_config);
+    const zh_espnow_init_config_t *config = &resolved_config;
+    ZH_ERROR_CHECK(_zh_espnow_validate_config(config) == ESP_OK, ESP_FAIL, NULL, "Initial configuration check failed.");
+    uint8_t slot = ZH_ESPNOW_INSTANCES_MAX;
+    for (uint8_t i = ZH_ESPNOW_INSTANCES_MAX; i > 0; --i)
+    {
+        ZH_ERROR_CHECK(_contexts[i - 1] == NULL || _contexts[i - 1]->init_config.wifi_interface != config->wifi_interface, ESP_ERR_INVALID_STATE, NULL, "Another instance uses the Wi-Fi interface.");
+        slot = (_contexts[i - 1] == NULL) ? i - 1 : slot;
+    }
+    ZH_ERROR_CHECK(slot < ZH_ESPNOW_INSTANCES_MAX, ESP_ERR_NO_MEM, NULL, "Too many instances.");
+    bool is_first = (_zh_espnow_contexts_num() == 0);
+    esp_err_t err = _zh_espnow_wifi_init(config, is_first);
+    ZH_ERROR_CHECK(err == ESP_OK, err, NULL, "WiFi initialization failed.");
+    ctx->init_config = *config;
+    ctx->event_base = (config->event_base != NULL) ? config->event_base : ZH_ESPNOW;
+    ZH_ERROR_CHECK(_zh_espnow_resources_init(ctx, config) == ESP_OK, ESP_FAIL, _zh_espnow_wifi_deinit(), "Resources initialization failed.");
+    ZH_ERROR_CHECK(_zh_espnow_task_init(ctx, config) == ESP_OK, ESP_FAIL, _zh_espnow_resources_deinit(ctx); _zh_espnow_wifi_deinit(), "Processing task initialization failed.");
+    ZH_ERROR_CHECK(_zh_espnow_callbacks_register(config->battery_mode) == ESP_OK, ESP_FAIL, _zh_espnow_task_deinit(ctx); _zh_espnow_resources_deinit(ctx); _zh_espnow_wifi_deinit(),
+                   "ESP-NOW callbacks registration failed.");
+    ctx->stats.min_stack_size = config->stack_size;
+    ctx->stats.rx_min_stack_size = (config->battery_mode == false) ? config->rx_stack_size : 0;
+    ctx->is_initialized = true;
+    // Published last: from here on the Wi-Fi callbacks pass frames to the instance.
+    __atomic_store_n(&_contexts[slot], ctx, __ATOMIC_SEQ_CST);
+    return ESP_OK;
+}
+
+static void _zh_espnow_context_deinit(_context_t *ctx)
+{
+    _zh_espnow_context_remove(ctx);
+    _zh_espnow_task_deinit(ctx);
+    _zh_espnow_peer_cache_release(ctx);
+    _zh_espnow_resources_deinit(ctx);
+    _zh_espnow_wifi_deinit();
+    ctx->recv_handler = NULL;
+    ctx->recv_handler_arg = NULL;
+    ctx->bulk_sink = NULL;
+    ctx->bulk_sink_arg = NULL;
+    ctx->is_initialized = false;
+}
+
+static void _zh_espnow_context_remove(_context_t *ctx)
+{
+    for (uint8_t i = 0; i < ZH_ESPNOW_INSTANCES_MAX; ++i)
+    {
+        if (_contexts[i] == ctx)
+        {
+            __atomic_store_n(&_contexts[i], NULL, __ATOMIC_SEQ_CST);
+        }
+    }
+    // A Wi-Fi callback running on the other core may still hold the instance.
+    while (__atomic_load_n(&_callbacks_active, __ATOMIC_SEQ_CST) != 0)
+    {
+        vTaskDelay(1);
+    }
+}
+
+static _context_t *IRAM_ATTR _zh_espnow_context_find(wifi_interface_t ifidx)
+{
+    _context_t *found = NULL;
+    uint8_t count = 0;
+    for (uint8_t i = 0; i < ZH_ESPNOW_INSTANCES_MAX; ++i)
+    {
+        _context_t *ctx = __atomic_load_n(&_contexts[i], __ATOMIC_SEQ_CST);
+        if (ctx == NULL)
+        {
+            continue;
+        }
+        if (ctx->init_config.wifi_interface == ifidx)
+        {
+            return ctx;
+        }
+        found = ctx;
+        ++count;
+    }
+    // A single instance takes every frame, as before multiple instances were supported.
+    return (count == 1) ? found : NULL;
+}
+
+static uint8_t _zh_espnow_contexts_num(void)
+{
+    uint8_t count = 0;
+    for (uint8_t i = 0; i < ZH_ESPNOW_INSTANCES_MAX; ++i)
+    {
+        count += (_contexts[i] != NULL) ? 1 : 0;
+    }
+    return count;
+}
+
+static void _zh_espnow_config_defaults(zh_espnow_init_config_t *config)
+{
+    // Fields added after version 3.3.0 take their ZH_ESPNOW_INIT_CONFIG_DEFAULT() value when left 0, so zero-initialised configurations keep working.
+    const zh_espnow_init_config_t defaults = ZH_ESPNOW_INIT_CONFIG_DEFAULT();
+    config->rx_stack_size = (config->rx_stack_size == 0) ? defaults.rx_stack_size : config->rx_stack_size;
+    config->rx_task_priority = (config->rx_task_priority == 0) ? defaults.rx_task_priority : config->rx_task_priority;
+    config->rx_queue_size = (config->rx_queue_size == 0) ? defaults.rx_queue_size : config->rx_queue_size;
+    config->tx_window = (config->tx_window == 0) ? defaults.tx_window : config->tx_window;
+    if (config->small_block_count == 0 && config->large_block_count == 0)
+    {
+        config->small_block_count = defaults.small_block_count;
+        config->large_block_count = defaults.large_block_count;
+    }
+    config->small_block_size = (config->small_block_size == 0) ? defaults.small_block_size : config->small_block_size;
+    config->large_block_size = (config->large_block_size == 0) ? defaults.large_block_size : config->large_block_size;
+    config->peer_cache_size = (config->peer_cache_size == 0) ? defaults.peer_cache_size : config->peer_cache_size;
+    config->bulk_window = (config->bulk_window == 0) ? defaults.bulk_window : config->bulk_window;
+    if (config->bulk_fragment_size == 0)
+    {
+        // The default fragment shrinks to fit a smaller pool.
+        uint16_t block_size = (config->large_block_count != 0) ? config->large_block_size : config->small_block_size;
+        block_size = (block_size > _max_message_size) ? _max_message_size : block_size;
+        uint16_t fragment_size = (block_size > ZH_ESPNOW_BULK_OVERHEAD) ? block_size - ZH_ESPNOW_BULK_OVERHEAD : 0;
+        config->bulk_fragment_size = (fragment_size < defaults.bulk_fragment_size) ? fragment_size : defaults.bulk_fragment_size;
+    }
+    config->queue_writable_percent = (config->queue_writable_percent == 0) ? defaults.queue_writable_percent : config->queue_writable_percent;
+    if (config->config_version == 0)
+    {
+        // 0 is a valid value of these fields, so they fall back to the 3.3.0 behaviour only in configurations not made by ZH_ESPNOW_INIT_CONFIG_DEFAULT().
+        config->task_core_id = (config->task_core_id == 0) ? tskNO_AFFINITY : config->task_core_id;
+        config->rx_task_core_id = (config->rx_task_core_id == 0) ? tskNO_AFFINITY : config->rx_task_core_id;
+        config->queue_reserve_percent = (config->queue_reserve_percent == 0) ? defaults.queue_reserve_percent : config->queue_reserve_percent;
+    }
+}
+
+static esp_err_t _zh_espnow_validate_config(const zh_espnow_init_config_t *config)
+{
+    ZH_ERROR_CHECK(config->wifi_channel > 0 && config->wifi_channel < 15, ESP_ERR_INVALID_ARG, NULL, "Invalid WiFi channel.");
+    ZH_ERROR_CHECK(config->task_priority >= 1 && config->stack_size >= configMINIMAL_STACK_SIZE, ESP_ERR_INVALID_ARG, NULL, "Invalid task settings.");
+    ZH_ERROR_CHECK(config->queue_size >= 1, ESP_ERR_INVALID_ARG, NULL, "Invalid queue size.");
+    ZH_ERROR_CHECK(config->burst_size == 0 || config->battery_mode == true, ESP_ERR_INVALID_ARG, NULL, "Burst scheduling requires battery mode.");
+    ZH_ERROR_CHECK(config->queue_reserve_percent < 100 && config->queue_writable_percent > config->queue_reserve_percent && config->queue_writable_percent <= 100, ESP_ERR_INVALID_ARG, NULL, "Invalid queue thresholds.");
+    ZH_ERROR_CHECK(config->task_core_id == tskNO_AFFINITY || (config->task_core_id >= 0 && config->task_core_id < portNUM_PROCESSORS), ESP_ERR_INVALID_ARG, NULL, "Invalid task settings.");
+    if (config->battery_mode == false)
+    {
+        ZH_ERROR_CHECK(config->rx_task_priority >= 1 && config->rx_stack_size >= configMINIMAL_STACK_SIZE, ESP_ERR_INVALID_ARG, NULL, "Invalid receive task settings.");
+        ZH_ERROR_CHECK(config->rx_task_core_id == tskNO_AFFINITY || (config->rx_task_core_id >= 0 && config->rx_task_core_id < portNUM_PROCESSORS), ESP_ERR_INVALID_ARG, NULL, "Invalid receive task settings.");
+        ZH_ERROR_CHECK(config->rx_queue_size >= 1, ESP_ERR_INVALID_ARG, NULL, "Invalid receive queue size.");
+    }
+    ZH_ERROR_CHECK(config->attempts > 0, ESP_ERR_INVALID_ARG, NULL, "Invalid number of attempts.");
+    ZH_ERROR_CHECK(config->tx_window >= 1 && config->tx_window <= TX_WINDOW_MAX, ESP_ERR_INVALID_ARG, NULL, "Invalid transmission window.");
+    ZH_ERROR_CHECK((config->small_block_count > 0 && config->small_block_size > 0) || (config->large_block_count > 0 && config->large_block_size > 0), ESP_ERR_INVALID_ARG, NULL, "Invalid message pool settings.");
+    ZH_ERROR_CHECK(config->small_block_count == 0 || config->large_block_count == 0 || config->small_block_size <= config->large_block_size, ESP_ERR_INVALID_ARG, NULL, "Invalid message pool settings.");
+    ZH_ERROR_CHECK(config->dedup == false || config->frame_header == true, ESP_ERR_INVALID_ARG, NULL, "Duplicate suppression requires the frame header.");
+    ZH_ERROR_CHECK(config->coalesce_delay_ms == 0 || config->frame_header == true, ESP_ERR_INVALID_ARG, NULL, "Coalescing requires the frame header.");
+    ZH_ERROR_CHECK(config->relay_ttl == 0 || config->frame_header == true, ESP_ERR_INVALID_ARG, NULL, "Relay requires the frame header.");
+    ZH_ERROR_CHECK(config->compression == false || config->frame_header == true, ESP_ERR_INVALID_ARG, NULL, "Compression requires the frame header.");
+    ZH_ERROR_CHECK(config->rpc_pending_size == 0 || (config->frame_header == true && config->battery_mode == false), ESP_ERR_INVALID_ARG, NULL, "RPC calls require the frame header and receive.");
+    ZH_ERROR_CHECK((config->peer_rate == 0 && config->global_rate == 0) || config->fair_queue_size > 0, ESP_ERR_INVALID_ARG, NULL, "Rate limits require the fair scheduler.");
+    ZH_ERROR_CHECK(config->fair_queue_size < FAIR_NONE, ESP_ERR_INVALID_ARG, NULL, "Invalid fair scheduler queue size.");
+    ZH_ERROR_CHECK(config->peer_cache_size >= 1 && config->peer_cache_size <= ESP_NOW_MAX_TOTAL_PEER_NUM, ESP_ERR_INVALID_ARG, NULL, "Invalid peer cache size.");
+    ZH_ERROR_CHECK(config->pinned_peers_num <= config->peer_cache_size && (config->pinned_peers_num == 0 || config->pinned_peers != NULL), ESP_ERR_INVALID_ARG, NULL, "Invalid pinned peers.");
+    if (config->frame_header == true)
+    {
+        uint16_t block_size = (config->large_block_count != 0) ? config->large_block_size : config->small_block_size;
+        block_size = (block_size > _max_message_size) ? _max_message_size : block_size;
+        ZH_ERROR_CHECK(config->bulk_window >= 1 && config->bulk_window <= BULK_WINDOW_MAX, ESP_ERR_INVALID_ARG, NULL, "Invalid bulk transfer window.");
+        ZH_ERROR_CHECK(config->bulk_fragment_size > 0 && config->bulk_fragment_size + ZH_ESPNOW_BULK_OVERHEAD <= block_size, ESP_ERR_INVALID_ARG, NULL, "Invalid bulk fragment size.");
+    }
+    return ESP_OK;
+}
+
+static esp_err_t _zh_espnow_wifi_init(const zh_espnow_init_config_t *config, bool is_first)
+{
+    if (is_first == false)
+    {
+        uint8_t primary = 0;
+        wifi_second_chan_t secondary = WIFI_SECOND_CHAN_NONE;
+        ZH_ERROR_CHECK(esp_wifi_get_channel(&primary, &secondary) == ESP_OK && primary == config->wifi_channel, ESP_ERR_INVALID_STATE, NULL, "All instances must use the same WiFi channel.");
+    }
+    ZH_ERROR_CHECK(esp_wifi_set_channel(config->wifi_channel, WIFI_SECOND_CHAN_NONE) == ESP_OK, ESP_FAIL, NULL, "WiFi channel setup failed.");
+#if defined CONFIG_IDF_TARGET_ESP32C2
+    ZH_ERROR_CHECK(esp_wifi_set_protocol(config->wifi_interface, WIFI_PROTOCOL_11B | WIFI_PROTOCOL_11G | WIFI_PROTOCOL_11N) == ESP_OK, ESP_FAIL, NULL, "WiFi protocol setup failed.");
+#else
+    ZH_ERROR_CHECK(esp_wifi_set_protocol(config->wifi_interface, WIFI_PROTOCOL_11B | WIFI_PROTOCOL_11G | WIFI_PROTOCOL_11N | WIFI_PROTOCOL_LR) == ESP_OK, ESP_FAIL, NULL, "WiFi protocol setup failed.");
+#endif
+    if (is_first == true)
+    {
+        ZH_ERROR_CHECK(esp_now_init() == ESP_OK, ESP_FAIL, NULL, "ESP-NOW driver initialization failed.");
+    }
+    return ESP_OK;
+}
+
+static void _zh_espnow_wifi_deinit(void)
+{
+    if (_zh_espnow_contexts_num() != 0)
+    {
+        return;
+    }
+    esp_now_unregister_send_cb();
+    if (_recv_cb_registered == true)
+    {
+        esp_now_unregister_recv_cb();
+        _recv_cb_registered = false;
+    }
+    ZH_ERROR_CHECK_VOID(esp_now_deinit() == ESP_OK, NULL, "ESP-NOW driver remove failed.");
+    if (_peer_mutex != NULL)
+    {
+        vSemaphoreDelete(_peer_mutex);
+        _peer_mutex = NULL;
+    }
+    memset(_peer_cache, 0, sizeof(_peer_cache));
+    _peer_cache_size = 0;
+}
+
+static esp_err_t _zh_espnow_resources_init(_context_t *ctx, const zh_espnow_init_config_t *config)
+{
+    for (uint8_t i = 0; i < ZH_ESPNOW_PRIORITY_NUM; ++i)
+    {
+        uint8_t queue_size = _zh_espnow_tx_queue_size(ctx, i);
+        if (queue_size > 0)
+        {
+            ctx->tx_queues[i] = xQueueCreate(queue_size, sizeof(_queue_t));
+            ZH_ERROR_CHECK(ctx->tx_queues[i] != NULL, ESP_FAIL, _zh_espnow_resources_deinit(ctx), "Queue creation failed.");
+        }
+    }
+    ctx->tx_mutex = xSemaphoreCreateMutex();
+    ZH_ERROR_CHECK(ctx->tx_mutex != NULL, ESP_FAIL, _zh_espnow_resources_deinit(ctx), "Transmit mutex creation failed.");
+    ctx->tx_event_group = xEventGroupCreate();
+    ZH_ERROR_CHECK(ctx->tx_event_group != NULL, ESP_FAIL, _zh_espnow_resources_deinit(ctx), "Transmit event group creation failed.");
+    for (uint8_t i = 0; i < SEND_WAITERS_MAX; ++i)
+    {
+        ctx->send_waiters[i].wake = xSemaphoreCreateBinary();
+        ZH_ERROR_CHECK(ctx->send_waiters[i].wake != NULL, ESP_FAIL, _zh_espnow_resources_deinit(ctx), "Send waiter semaphore creation failed.");
+    }
+    if (config->battery_mode == false)
+    {
+        ctx->rx_queue_handle = xQueueCreate(config->rx_queue_size, sizeof(_queue_t));
+        ZH_ERROR_CHECK(ctx->rx_queue_handle != NULL, ESP_FAIL, _zh_espnow_resources_deinit(ctx), "Receive queue creation failed.");
+    }
+    ctx->confirm_queue_handle = xQueueCreate(config->tx_window * 2, sizeof(_confirm_t));
+    ZH_ERROR_CHECK(ctx->confirm_queue_handle != NULL, ESP_FAIL, _zh_espnow_resources_deinit(ctx), "Confirmation queue creation failed.");
+    ZH_ERROR_CHECK(_zh_espnow_pool_init(ctx, config) == ESP_OK, ESP_FAIL, _zh_espnow_resources_deinit(ctx), "Message pool creation failed.");
+    ZH_ERROR_CHECK(_zh_espnow_peer_cache_init(ctx, config) == ESP_OK, ESP_FAIL, _zh_espnow_resources_deinit(ctx), "Peer cache creation failed.");
+    if (config->battery_mode == false && config->filter_size > 0)
+    {
+        ctx->filter_capacity = 1;
+        while (ctx->filter_capacity < config->filter_size * 2)
+        {
+            ctx->filter_capacity <<= 1;
+        }
+        ctx->filter_table = heap_caps_calloc(ctx->filter_capacity, sizeof(_filter_entry_t), MALLOC_CAP_8BIT);
+        ZH_ERROR_CHECK(ctx->filter_table != NULL, ESP_FAIL, _zh_espnow_resources_deinit(ctx), "Receive filter allocation failed.");
+    }
+    if (config->rpc_pending_size > 0)
+    {
+        ctx->rpc_calls = heap_caps_calloc(config->rpc_pending_size, sizeof(_rpc_call_t), MALLOC_CAP_8BIT);
+        ctx->rpc_wake = heap_caps_calloc(config->rpc_pending_size, sizeof(SemaphoreHandle_t), MALLOC_CAP_8BIT);
+        ZH_ERROR_CHECK(ctx->rpc_calls != NULL && ctx->rpc_wake != NULL, ESP_FAIL, _zh_espnow_resources_deinit(ctx), "RPC call table allocation failed.");
+        for (uint8_t i = 0; i < config->rpc_pending_size; ++i)
+        {
+            ctx->rpc_wake[i] = xSemaphoreCreateBinary();
+            ZH_ERROR_CHECK(ctx->rpc_wake[i] != NULL, ESP_FAIL, _zh_espnow_resources_deinit(ctx), "RPC semaphore creation failed.");
+        }
+    }
+    if (config->fair_queue_size > 0)
+    {
+        ctx->fair_items = heap_caps_calloc(config->fair_queue_size, sizeof(_fair_item_t), MALLOC_CAP_8BIT);
+        ctx->fair_flows = heap_caps_calloc(config->fair_queue_size, sizeof(_fair_flow_t), MALLOC_CAP_8BIT);
+        ZH_ERROR_CHECK(ctx->fair_items != NULL && ctx->fair_flows != NULL, ESP_FAIL, _zh_espnow_resources_deinit(ctx), "Fair scheduler allocation failed.");
+        for (uint8_t i = 0; i < config->fair_queue_size; ++i)
+        {
+            ctx->fair_items[i].next = (i + 1 < config->fair_queue_size) ? i + 1 : FAIR_NONE;
+        }
+        ctx->fair_free = 0;
+        ctx->fair_is_new_visit = true;
+        ctx->fair_wait = portMAX_DELAY;
+    }
+    if (config->compression == true)
+    {
+        ctx->codec_table = heap_caps_calloc(1 << CODEC_HASH_BITS, sizeof(uint16_t), MALLOC_CAP_8BIT);
+        ctx->codec_scratch = heap_caps_malloc(_zh_espnow_pool_max_size(ctx), MALLOC_CAP_8BIT);
+        ZH_ERROR_CHECK(ctx->codec_table != NULL && ctx->codec_scratch != NULL, ESP_FAIL, _zh_espnow_resources_deinit(ctx), "Compression buffers allocation failed.");
+    }
+    if (config->trace_size > 0)
+    {
+        uint32_t trace_capacity = 1;
+        while (trace_capacity < config->trace_size)
+        {
+            trace_capacity <<= 1;
+        }
+        ctx->trace_ring = heap_caps_calloc(trace_capacity, sizeof(zh_espnow_trace_record_t), MALLOC_CAP_8BIT);
+        ZH_ERROR_CHECK(ctx->trace_ring != NULL, ESP_FAIL, _zh_espnow_resources_deinit(ctx), "Trace ring allocation failed.");
+        ctx->trace_mask = trace_capacity - 1;
+        ctx->trace_head = 0;
+        ctx->trace_start = 0;
+    }
+    // A random start keeps receivers from taking the first frames after a reboot for duplicates.
+    ctx->tx_seq = (uint16_t)esp_random();
+    ctx->relay_seq = (uint16_t)esp_random();
+    ZH_ERROR_CHECK(esp_wifi_get_mac(config->wifi_interface, ctx->own_mac) == ESP_OK, ESP_FAIL, _zh_espnow_resources_deinit(ctx), "Own MAC address receipt failed.");
+    if (config->battery_mode == false && config->frame_header == true && config->bulk_rx_buffer_size > 0)
+    {
+        ctx->bulk_rx_buffer = heap_caps_malloc(config->bulk_rx_buffer_size, MALLOC_CAP_8BIT);
+        ZH_ERROR_CHECK(ctx->bulk_rx_buffer != NULL, ESP_FAIL, _zh_espnow_resources_deinit(ctx), "Bulk reassembly buffer allocation failed.");
+    }
+    return ESP_OK;
+}
+
+static void _zh_espnow_resources_deinit(_context_t *ctx)
+{
+    for (uint8_t i = 0; i < ZH_ESPNOW_PRIORITY_NUM; ++i)
+    {
+        if (ctx->tx_queues[i] != NULL)
+        {
+            vQueueDelete(ctx->tx_queues[i]);
+            ctx->tx_queues[i] = NULL;
+        }
+    }
+    ctx->tx_normal_streak = 0;
+    if (ctx->tx_event_group != NULL)
+    {
+        vEventGroupDelete(ctx->tx_event_group);
+        ctx->tx_event_group = NULL;
+    }
+    memset((void *)ctx->tx_blocked, 0, sizeof(ctx->tx_blocked));
+    if (ctx->rx_queue_handle != NULL)
+    {
+        vQueueDelete(ctx->rx_queue_handle);
+        ctx->rx_queue_handle = NULL;
+    }
+    if (ctx->confirm_queue_handle != NULL)
+    {
+        vQueueDelete(ctx->confirm_queue_handle);
+        ctx->confirm_queue_handle = NULL;
+    }
+    memset(ctx->tx_slots, 0, sizeof(ctx->tx_slots));
+    ctx->tx_in_flight = 0;
+    ctx->tx_has_pending = false;
+    heap_caps_free(ctx->fair_items);
+    ctx->fair_items = NULL;
+    heap_caps_free(ctx->fair_flows);
+    ctx->fair_flows = NULL;
+    ctx->fair_free = FAIR_NONE;
+    ctx->fair_count = 0;
+    ctx->fair_current = 0;
+    ctx->fair_is_new_visit = true;
+    ctx->fair_clock = 0;
+    ctx->fair_tat_us = 0;
+    ctx->fair_is_throttled = false;
+    ctx->fair_wait = portMAX_DELAY;
+    ctx->burst = (_burst_t){0};
+    ctx->burst_flush_requested = false;
+    ctx->radio_on_at = 0;
+    ctx->radio_on_rest_us = 0;
+    memset(ctx->coalesce, 0, sizeof(ctx->coalesce));
+    ctx->coalesce_frame = NULL;
+    ctx->coalesce_open = COALESCE_NONE;
+    if (ctx->tx_mutex != NULL)
+    {
+        vSemaphoreDelete(ctx->tx_mutex);
+        ctx->tx_mutex = NULL;
+    }
+    heap_caps_free(ctx->bulk_rx_buffer);
+    ctx->bulk_rx_buffer = NULL;
+    ctx->bulk_rx_buffer_locked = false;
+    ctx->bulk_tx = (_bulk_tx_t){0};
+    ctx->bulk_tx_has_ack = false;
+    ctx->bulk_rx = (_bulk_rx_t){0};
+    ctx->bulk_rx_done = (_bulk_done_t){0};
+    memset(ctx->completions, 0, sizeof(ctx->completions));
+    for (uint8_t i = 0; i < SEND_WAITERS_MAX; ++i)
+    {
+        if (ctx->send_waiters[i].wake != NULL)
+        {
+            vSemaphoreDelete(ctx->send_waiters[i].wake);
+        }
+    }
+    memset(ctx->send_waiters, 0, sizeof(ctx->send_waiters));
+    ctx->completion_head = 0;
+    memset(ctx->dedup, 0, sizeof(ctx->dedup));
+    ctx->dedup_clock = 0;
+    heap_caps_free(ctx->filter_table);
+    ctx->filter_table = NULL;
+    heap_caps_free(ctx->codec_table);
+    ctx->codec_table = NULL;
+    heap_caps_free(ctx->codec_scratch);
+    ctx->codec_scratch = NULL;
+    for (uint8_t i = 0; ctx->rpc_wake != NULL && i < ctx->init_config.rpc_pending_size; ++i)
+    {
+        if (ctx->rpc_wake[i] != NULL)
+        {
+            vSemaphoreDelete(ctx->rpc_wake[i]);
+        }
+    }
+    heap_caps_free(ctx->rpc_wake);
+    ctx->rpc_wake = NULL;
+    heap_caps_free(ctx->rpc_calls);
+    ctx->rpc_calls = NULL;
+    memset(ctx->rpc_recent, 0, sizeof(ctx->rpc_recent));
+    ctx->rpc_recent_head = 0;
+    zh_espnow_trace_record_t *trace_ring = ctx->trace_ring;
+    ctx->trace_ring = NULL;
+    heap_caps_free(trace_ring);
+    ctx->filter_capacity = 0;
+    ctx->filter_count = 0;
+    memset(ctx->filter_prefixes, 0, sizeof(ctx->filter_prefixes));
+    ctx->filter_prefixes_num = 0;
+    ctx->filter_mode = ZH_ESPNOW_FILTER_OFF;
+    memset(ctx->relay_seen, 0, sizeof(ctx->relay_seen));
+    ctx->relay_seen_head = 0;
+    memset(ctx->relay_routes, 0, sizeof(ctx->relay_routes));
+    _zh_espnow_pool_deinit(ctx);
+}
+
+static esp_err_t _zh_espnow_task_init(_context_t *ctx, const zh_espnow_init_config_t *config)
+{
+    ZH_ERROR_CHECK(xTaskCreatePinnedToCore(&_zh_espnow_processing, "zh_espnow_processing", config->stack_size, ctx, config->task_priority, &ctx->task, config->task_core_id) == pdPASS, ESP_FAIL, NULL, "Task creation failed.");
+    if (config->battery_mode == false)
+    {
+        ZH_ERROR_CHECK(xTaskCreatePinnedToCore(&_zh_espnow_rx_processing, "zh_espnow_rx_processing", config->rx_stack_size, ctx, config->rx_task_priority, &ctx->rx_task, config->rx_task_core_id) == pdPASS, ESP_FAIL,
+                       _zh_espnow_task_deinit(ctx), "Receive task creation failed.");
+    }
+    return ESP_OK;
+}
+
+static void _zh_espnow_task_deinit(_context_t *ctx)
+{
+    // The peer cache mutex is shared with the other instances and must not be deleted along with a task holding it.
+    xSemaphoreTake(_peer_mutex, portMAX_DELAY);
+    if (ctx->task != NULL)
+    {
+        vTaskDelete(ctx->task);
+        ctx->task = NULL;
+    }
+    if (ctx->rx_task != NULL)
+    {
+        vTaskDelete(ctx->rx_task);
+        ctx->rx_task = NULL;
+    }
+    xSemaphoreGive(_peer_mutex);
+}
+
+static esp_err_t _zh_espnow_callbacks_register(bool battery_mode)
+{
+    ZH_ERROR_CHECK(esp_now_register_send_cb(_zh_espnow_send_cb) == ESP_OK, ESP_FAIL, NULL, "Send callback registration failed.");
+    if (battery_mode == false && _recv_cb_registered == false)
+    {
+        ZH_ERROR_CHECK(esp_now_register_recv_cb(_zh_espnow_recv_cb) == ESP_OK, ESP_FAIL, NULL, "Receive callback registration failed.");
+        _recv_cb_registered = true;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t _zh_espnow_pool_init(_context_t *ctx, const zh_espnow_init_config_t *config)
+{
+    const uint16_t block_size[POOL_CLASS_NUM] = {config->small_block_size, config->large_block_size};
+    const uint16_t block_count[POOL_CLASS_NUM] = {config->small_block_count, config->large_block_count};
+    for (uint8_t i = 0; i < POOL_CLASS_NUM; ++i)
+    {
+        _pool_class_t *pool = &ctx->pool[i];
+        *pool = (_pool_class_t){0};
+        if (block_count[i] == 0 || block_size[i] == 0)
+        {
+            continue;
+        }
+        pool->block_size = (block_size[i] > _max_message_size) ? _max_message_size : block_size[i];
+        pool->block_count = block_count[i];
+        // Free blocks hold the free list link, so every block is aligned for a pointer.
+        pool->stride = (sizeof(zh_espnow_event_on_recv_t) + pool->block_size + sizeof(void *) - 1) & ~(sizeof(void *) - 1);
+        pool->memory = heap_caps_calloc(pool->block_count, pool->stride, MALLOC_CAP_8BIT);
+        ZH_ERROR_CHECK(pool->memory != NULL, ESP_ERR_NO_MEM, _zh_espnow_pool_deinit(ctx), "Message pool memory allocation failed.");
+        for (uint16_t j = pool->block_count; j > 0; --j)
+        {
+            void **block = (void **)(pool->memory + (j - 1) * pool->stride);
+            *block = pool->free_list;
+            pool->free_list = block;
+        }
+    }
+    return ESP_OK;
+}
+
+static void _zh_espnow_pool_deinit(_context_t *ctx)
+{
+    for (uint8_t i = 0; i < POOL_CLASS_NUM; ++i)
+    {
+        heap_caps_free(ctx->pool[i].memory);
+        ctx->pool[i] = (_pool_class_t){0};
+    }
+}
+
+static uint16_t _zh_espnow_pool_max_size(_context_t *ctx)
+{
+    return (ctx->pool[POOL_LARGE].block_count != 0) ? ctx->pool[POOL_LARGE].block_size : ctx->pool[POOL_SMALL].block_size;
+}
+
+static uint16_t _zh_espnow_max_payload(_context_t *ctx)
+{
+    return _zh_espnow_pool_max_size(ctx) - ((ctx->init_config.frame_header == true) ? sizeof(_frame_header_t) : 0) - ((ctx->init_config.dedup == true) ? sizeof(uint16_t) : 0);
+}
+
+static zh_espnow_event_on_recv_t *IRAM_ATTR _zh_espnow_pool_alloc(_context_t *ctx, uint16_t size)
+{
+    void **block = NULL;
+    uint8_t fit_class = POOL_CLASS_NUM;
+    portENTER_CRITICAL_SAFE(&ctx->pool_lock);
+    for (uint8_t i = 0; i < POOL_CLASS_NUM; ++i)
+    {
+        _pool_class_t *pool = &ctx->pool[i];
+        if (pool->block_count == 0 || size > pool->block_size)
+        {
+            continue;
+        }
+        fit_class = (fit_class == POOL_CLASS_NUM) ? i : fit_class;
+        if (pool->free_list != NULL)
+        {
+            block = pool->free_list;
+            pool->free_list = *block;
+            break;
+        }
+    }
+    // A small request served by the large class is not a failure. Count only requests no class could serve, by the smallest class fitting them.
+    if (block == NULL && fit_class != POOL_CLASS_NUM)
+    {
+        _zh_espnow_stats_add(ctx, (fit_class == POOL_SMALL) ? &ctx->stats.pool_small_exhausted : &ctx->stats.pool_large_exhausted, 1);
+    }
+    portEXIT_CRITICAL_SAFE(&ctx->pool_lock);
+    return (zh_espnow_event_on_recv_t *)block;
+}
+
+static void IRAM_ATTR _zh_espnow_pool_free(_context_t *ctx, zh_espnow_event_on_recv_t *block)
+{
+    if (block == NULL)
+    {
+        return;
+    }
+    portENTER_CRITICAL_SAFE(&ctx->pool_lock);
+    for (uint8_t i = 0; i < POOL_CLASS_NUM; ++i)
+    {
+        _pool_class_t *pool = &ctx->pool[i];
+        if ((uint8_t *)block >= pool->memory && (uint8_t *)block < pool->memory + pool->block_count * pool->stride)
+        {
+            *(void **)block = pool->free_list;
+            pool->free_list = block;
+            break;
+        }
+    }
+    portEXIT_CRITICAL_SAFE(&ctx->pool_lock);
+}
+
+static esp_err_t _zh_espnow_peer_cache_init(_context_t *ctx, const zh_espnow_init_config_t *config)
+{
+    if (_peer_mutex == NULL)
+    {
+        memset(_peer_cache, 0, sizeof(_peer_cache));
+        _peer_clock = 0;
+        _peer_mutex = xSemaphoreCreateMutex();
+        ZH_ERROR_CHECK(_peer_mutex != NULL, ESP_FAIL, NULL, "Peer cache mutex creation failed.");
+    }
+    // The cache is shared by all instances and only grows while any of them is running.
+    _peer_cache_size = (config->peer_cache_size > _peer_cache_size) ? config->peer_cache_size : _peer_cache_size;
+    for (uint8_t i = 0; i < config->pinned_peers_num; ++i)
+    {
+        ZH_ERROR_CHECK(_zh_espnow_peer_acquire(ctx, config->pinned_peers + i * ESP_NOW_ETH_ALEN, true) == ESP_OK, ESP_FAIL, NULL, "Pinned peer registration failed.");
+    }
+    return ESP_OK;
+}
+
+static esp_err_t _zh_espnow_peer_acquire(_context_t *ctx, const uint8_t *mac_addr, bool pin)
+{
+    _peer_t *entry = NULL;
+    _peer_t *victim = NULL;
+    xSemaphoreTake(_peer_mutex, portMAX_DELAY);
+    for (uint8_t i = 0; i < _peer_cache_size; ++i)
+    {
+        _peer_t *peer = &_peer_cache[i];
+        if (peer->is_used == true && memcmp(peer->mac_addr, mac_addr, ESP_NOW_ETH_ALEN) == 0)
+        {
+            entry = peer;
+            break;
+        }
+        if (victim != NULL && victim->is_used == false)
+        {
+            continue;
+        }
+        if (peer->is_used == false || (peer->is_pinned == false && peer->in_flight == 0 && (victim == NULL || peer->last_used < victim->last_used)))
+        {
+            victim = peer;
+        }
+    }
+    esp_err_t err = ESP_OK;
+    if (entry != NULL)
+    {
+        _zh_espnow_stats_add(ctx, &ctx->stats.peer_cache_hit, 1);
+        err = (entry->ifidx == ctx->init_config.wifi_interface) ? ESP_OK : _zh_espnow_peer_rebind(ctx, entry);
+    }
+    else
+    {
+        err = _zh_espnow_peer_register(ctx, victim, mac_addr);
+    }
+    if (err == ESP_OK)
+    {
+        entry = (entry != NULL) ? entry : victim;
+        entry->last_used = ++_peer_clock;
+        if (pin == true)
+        {
+            entry->is_pinned = true;
+        }
+        else
+        {
+            ++entry->in_flight;
+        }
+    }
+    xSemaphoreGive(_peer_mutex);
+    return err;
+}
+
+static esp_err_t _zh_espnow_peer_register(_context_t *ctx, _peer_t *entry, const uint8_t *mac_addr)
+{
+    _zh_espnow_stats_add(ctx, &ctx->stats.peer_cache_miss, 1);
+    if (entry == NULL)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    if (entry->is_used == true)
+    {
+        _zh_espnow_stats_add(ctx, &ctx->stats.peer_cache_eviction, 1);
+        esp_now_del_peer(entry->mac_addr);
+        entry->is_used = false;
+    }
+    esp_now_peer_info_t peer = {0};
+    peer.ifidx = ctx->init_config.wifi_interface;
+    memcpy(peer.peer_addr, mac_addr, ESP_NOW_ETH_ALEN);
+    esp_err_t err = esp_now_add_peer(&peer);
+    if (err != ESP_OK && err != ESP_ERR_ESPNOW_EXIST)
+    {
+        _zh_espnow_stats_add(ctx, &ctx->stats.espnow_driver_error, 1);
+        return err;
+    }
+    *entry = (_peer_t){0};
+    memcpy(entry->mac_addr, mac_addr, ESP_NOW_ETH_ALEN);
+    entry->ifidx = ctx->init_config.wifi_interface;
+    entry->is_used = true;
+    entry->delivery_ratio = PEER_DELIVERY_SCALE;
+    return ESP_OK;
+}
+
+static esp_err_t _zh_espnow_peer_rebind(_context_t *ctx, _peer_t *entry)
+{
+    // The driver sends to a peer on the interface it was registered on. Confirmations of frames in flight are routed by
+    // that interface, so a peer moves to another instance only once all of them are confirmed.
+    if (entry->in_flight != 0)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    esp_now_peer_info_t peer = {0};
+    peer.ifidx = ctx->init_config.wifi_interface;
+    memcpy(peer.peer_addr, entry->mac_addr, ESP_NOW_ETH_ALEN);
+    esp_err_t err = esp_now_mod_peer(&peer);
+    if (err != ESP_OK)
+    {
+        _zh_espnow_stats_add(ctx, &ctx->stats.espnow_driver_error, 1);
+        return err;
+    }
+    entry->ifidx = ctx->init_config.wifi_interface;
+    return ESP_OK;
+}
+
+static void _zh_espnow_peer_release(const uint8_t *mac_addr, bool is_failed)
+{
+    xSemaphoreTake(_peer_mutex, portMAX_DELAY);
+    _peer_t *peer = _zh_espnow_peer_find(mac_addr);
+    if (peer != NULL)
+    {
+        if (peer->in_flight > 0)
+        {
+            --peer->in_flight;
+        }
+        ++*((is_failed == true) ? &peer->sent_fail : &peer->sent_success);
+        if (is_failed == true && peer->consecutive_failures < UINT8_MAX && ++peer->consecutive_failures >= PEER_UNREACHABLE_FAILURES && peer->is_unreachable == false)
+        {
+            peer->is_unreachable = true;
+            peer->probe_at = xTaskGetTickCount() + pdMS_TO_TICKS(PEER_PROBE_INTERVAL);
+        }
+    }
+    xSemaphoreGive(_peer_mutex);
+}
+
+static void _zh_espnow_peer_cache_release(_context_t *ctx)
+{
+    // Frames of the instance will never be confirmed, so its peers become evictable.
+    xSemaphoreTake(_peer_mutex, portMAX_DELAY);
+    for (uint8_t i = 0; i < _peer_cache_size; ++i)
+    {
+        if (_peer_cache[i].ifidx == ctx->init_config.wifi_interface)
+        {
+            _peer_cache[i].in_flight = 0;
+            _peer_cache[i].is_pinned = false;
+        }
+    }
+    xSemaphoreGive(_peer_mutex);
+}
+
+static _peer_t *_zh_espnow_peer_find(const uint8_t *mac_addr)
+{
+    for (uint8_t i = 0; i < _peer_cache_size; ++i)
+    {
+        _peer_t *peer = &_peer_cache[i];
+        if (peer->is_used == true && memcmp(peer->mac_addr, mac_addr, ESP_NOW_ETH_ALEN) == 0)
+        {
+            return peer;
+        }
+    }
+    return NULL;
+}
+
+static esp_err_t _zh_espnow_peer_admit(_context_t *ctx, const uint8_t *mac_addr, TickType_t *timeout, uint8_t *attempts)
+{
+    esp_err_t err = ESP_OK;
+    *timeout = pdMS_TO_TICKS(WAIT_CONFIRM_MAX_TIME);
+    *attempts = ctx->init_config.attempts;
+    xSemaphoreTake(_peer_mutex, portMAX_DELAY);
+    _peer_t *peer = _zh_espnow_peer_find(mac_addr);
+    if (peer != NULL)
+    {
+        *timeout = _zh_espnow_peer_timeout(peer);
+        if (peer->is_unreachable == true && (int32_t)(xTaskGetTickCount() - peer->probe_at) < 0)
+        {
+            err = ESP_ERR_INVALID_STATE;
+        }
+        else if (peer->is_unreachable == true)
+        {
+            // A single attempt probes whether the peer is back.
+            *attempts = 1;
+            peer->probe_at = xTaskGetTickCount() + pdMS_TO_TICKS(PEER_PROBE_INTERVAL);
+        }
+    }
+    xSemaphoreGive(_peer_mutex);
+    return err;
+}
+
+static void _zh_espnow_peer_report(const uint8_t *mac_addr, bool is_success, uint32_t latency_us)
+{
+    xSemaphoreTake(_peer_mutex, portMAX_DELAY);
+    _peer_t *peer = _zh_espnow_peer_find(mac_addr);
+    if (peer != NULL)
+    {
+        peer->delivery_ratio = peer->delivery_ratio - (peer->delivery_ratio >> 3) + (((is_success == true) ? PEER_DELIVERY_SCALE : 0) >> 3);
+        if (is_success == true)
+        {
+            peer->confirm_latency_us = (peer->confirm_latency_us == 0) ? latency_us : peer->confirm_latency_us - (peer->confirm_latency_us >> 3) + (latency_us >> 3);
+            peer->consecutive_failures = 0;
+            peer->is_unreachable = false;
+        }
+    }
+    xSemaphoreGive(_peer_mutex);
+}
+
+static void _zh_espnow_peer_update_recv(const uint8_t *mac_addr, int8_t rssi)
+{
+    xSemaphoreTake(_peer_mutex, portMAX_DELAY);
+    _peer_t *peer = _zh_espnow_peer_find(mac_addr);
+    if (peer != NULL)
+    {
+        ++peer->received;
+        if (rssi != 0)
+        {
+            peer->rssi = (peer->rssi == 0) ? rssi : (int8_t)((peer->rssi * 7 + rssi) / 8);
+        }
+    }
+    xSemaphoreGive(_peer_mutex);
+}
+
+static void _zh_espnow_peer_report_wait(const uint8_t *mac_addr, uint32_t wait_us)
+{
+    xSemaphoreTake(_peer_mutex, portMAX_DELAY);
+    _peer_t *peer = _zh_espnow_peer_find(mac_addr);
+    if (peer != NULL)
+    {
+        peer->queue_wait_us = (peer->queue_wait_us == 0) ? wait_us : peer->queue_wait_us - (peer->queue_wait_us >> 3) + (wait_us >> 3);
+        peer->queue_wait_max_us = (wait_us > peer->queue_wait_max_us) ? wait_us : peer->queue_wait_max_us;
+    }
+    xSemaphoreGive(_peer_mutex);
+}
+
+static void _zh_espnow_peer_report_throttled(const uint8_t *mac_addr)
+{
+    xSemaphoreTake(_peer_mutex, portMAX_DELAY);
+    _peer_t *peer = _zh_espnow_peer_find(mac_addr);
+    if (peer != NULL)
+    {
+        ++peer->throttled;
+    }
+    xSemaphoreGive(_peer_mutex);
+}
+
+static TickType_t _zh_espnow_peer_timeout(const _peer_t *peer)
+{
+    uint32_t timeout = WAIT_CONFIRM_MAX_TIME;
+    if (peer->confirm_latency_us != 0)
+    {
+        timeout = peer->confirm_latency_us * 3 / 1000 + WAIT_CONFIRM_MIN_TIME;
+        timeout = (timeout > WAIT_CONFIRM_MAX_TIME) ? WAIT_CONFIRM_MAX_TIME : timeout;
+    }
+    TickType_t ticks = pdMS_TO_TICKS(timeout);
+    return (ticks < 2) ? 2 : ticks;
+}
+
+static void _zh_espnow_peer_stats_fill(const _peer_t *peer, zh_espnow_peer_stats_t *peer_stats)
+{
+    memcpy(peer_stats->mac_addr, peer->mac_addr, ESP_NOW_ETH_ALEN);
+    peer_stats->sent_success = peer->sent_success;
+    peer_stats->sent_fail = peer->sent_fail;
+    peer_stats->received = peer->received;
+    peer_stats->delivery_ratio = peer->delivery_ratio;
+    peer_stats->confirm_latency_us = peer->confirm_latency_us;
+    peer_stats->confirm_timeout_ms = pdTICKS_TO_MS(_zh_espnow_peer_timeout(peer));
+    peer_stats->rssi = peer->rssi;
+    peer_stats->consecutive_failures = peer->consecutive_failures;
+    peer_stats->is_unreachable = peer->is_unreachable;
+    peer_stats->throttled = peer->throttled;
+    peer_stats->queue_wait_us = peer->queue_wait_us;
+    peer_stats->queue_wait_max_us = peer->queue_wait_max_us;
+}
+
+static void _zh_espnow_stats_add(_context_t *ctx, uint32_t *counter, uint32_t value)
+{
+    portENTER_CRITICAL_SAFE(&ctx->stats_lock);
+    *counter += value;
+    portEXIT_CRITICAL_SAFE(&ctx->stats_lock);
+}
+
+static void _zh_espnow_stats_max(_context_t *ctx, uint32_t *counter, uint32_t value)
+{
+    portENTER_CRITICAL_SAFE(&ctx->stats_lock);
+    if (value > *counter)
+    {
+        *counter = value;
+    }
+    portEXIT_CRITICAL_SAFE(&ctx->stats_lock);
+}
+
+static void _zh_espnow_stats_latency(_context_t *ctx, uint32_t *avg, uint32_t *max, uint32_t value)
+{
+    // Must be called with ctx->stats_lock held.
+    *avg = (*avg == 0) ? value : *avg - (*avg >> 3) + (value >> 3);
+    if (value > *max)
+    {
+        *max = value;
+    }
+}
+
+static uint8_t _zh_espnow_stats_bucket(uint32_t value_us)
+{
+    uint8_t bucket = 0;
+    for (uint32_t bound = ZH_ESPNOW_HISTOGRAM_BASE_US; bucket < ZH_ESPNOW_HISTOGRAM_SIZE - 1 && value_us >= bound; bound <<= 1)
+    {
+        ++bucket;
+    }
+    return bucket;
+}
+
+static void _zh_espnow_stats_dispatch(_context_t *ctx, const _queue_t *queue)
+{
+    if (queue->msg_id == 0)
+    {
+        return;
+    }
+    uint32_t latency = (uint32_t)(esp_timer_get_time() - queue->timestamp);
+    portENTER_CRITICAL(&ctx->stats_lock);
+    _zh_espnow_stats_latency(ctx, &ctx->stats.dispatch_latency_avg_us[queue->priority], &ctx->stats.dispatch_latency_max_us[queue->priority], latency);
+    portEXIT_CRITICAL(&ctx->stats_lock);
+}
+
+static bool _zh_espnow_export_put(uint8_t *buffer, uint16_t size, uint16_t *offset, const void *data, uint16_t data_len)
+{
+    if (size - *offset < data_len)
+    {
+        return false;
+    }
+    memcpy(buffer + *offset, data, data_len);
+    *offset += data_len;
+    return true;
+}
+
+static bool _zh_espnow_export_varint(uint8_t *buffer, uint16_t size, uint16_t *offset, uint32_t value)
+{
+    do
+    {
+        uint8_t byte = value & 0x7F;
+        value >>= 7;
+        byte |= (value != 0) ? 0x80 : 0;
+        if (_zh_espnow_export_put(buffer, size, offset, &byte, sizeof(byte)) == false)
+        {
+            return false;
+        }
+    } while (value != 0);
+    return true;
+}
+
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 5, 0)
+static void IRAM_ATTR _zh_espnow_send_cb(const esp_now_send_info_t *esp_now_info, esp_now_send_status_t status)
+{
+    ZH_ERROR_CHECK_VOID_HOT(esp_now_info != NULL, NULL, "Send callback received NULL MAC address.");
+    const uint8_t *mac_addr = esp_now_info->des_addr;
+    wifi_interface_t ifidx = esp_now_info->ifidx;
+#else
+static void IRAM_ATTR _zh_espnow_send_cb(const uint8_t *mac_addr, esp_now_send_status_t status)
+{
+    ZH_ERROR_CHECK_VOID_HOT(mac_addr != NULL, NULL, "Send callback received NULL MAC address.");
+    // The driver does not report the interface here. A peer with frames in flight is never evicted or rebound, so its
+    // cache entry tells the interface without taking the peer cache mutex.
+    const _peer_t *peer = _zh_espnow_peer_find(mac_addr);
+    wifi_interface_t ifidx = (peer != NULL) ? peer->ifidx : WIFI_IF_MAX;
+#endif
+    __atomic_fetch_add(&_callbacks_active, 1, __ATOMIC_SEQ_CST);
+    _context_t *ctx = _zh_espnow_context_find(ifidx);
+    if (ctx != NULL)
+    {
+        _zh_espnow_send_confirm(ctx, mac_addr, status);
+    }
+    __atomic_fetch_sub(&_callbacks_active, 1, __ATOMIC_SEQ_CST);
+}
+
+static void IRAM_ATTR _zh_espnow_send_confirm(_context_t *ctx, const uint8_t *mac_addr, esp_now_send_status_t status)
+{
+    _confirm_t confirm = {0};
+    memcpy(confirm.mac_addr, mac_addr, ESP_NOW_ETH_ALEN);
+    confirm.status = status;
+    BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+    ZH_ERROR_CHECK_VOID_HOT(xQueueSendFromISR(ctx->confirm_queue_handle, &confirm, &xHigherPriorityTaskWoken) == pdTRUE, NULL, "Failed to add ESP-NOW send confirmation to queue.");
+    vTaskNotifyGiveFromISR(ctx->task, &xHigherPriorityTaskWoken);
+    if (xHigherPriorityTaskWoken == pdTRUE)
+    {
+        portYIELD_FROM_ISR();
+    };
+}
+
+static void IRAM_ATTR _zh_espnow_recv_cb(const esp_now_recv_info_t *esp_now_info, const uint8_t *data, int data_len)
+{
+    ZH_ERROR_CHECK_VOID_HOT(esp_now_info != NULL && data != NULL && data_len > 0, NULL, "Receive callback received invalid arguments.");
+    __atomic_fetch_add(&_callbacks_active, 1, __ATOMIC_SEQ_CST);
+    // Unicast frames go to the instance of the addressed interface, broadcasts to every receiving instance.
+    bool is_broadcast = (esp_now_info->des_addr == NULL || memcmp(esp_now_info->des_addr, _broadcast_mac, ESP_NOW_ETH_ALEN) == 0);
+    uint8_t count = _zh_espnow_contexts_num();
+    for (uint8_t i = 0; i < ZH_ESPNOW_INSTANCES_MAX; ++i)
+    {
+        _context_t *ctx = __atomic_load_n(&_contexts[i], __ATOMIC_SEQ_CST);
+        if (ctx != NULL && ctx->rx_queue_handle != NULL && (is_broadcast == true || count == 1 || memcmp(esp_now_info->des_addr, ctx->own_mac, ESP_NOW_ETH_ALEN) == 0))
+        {
+            _zh_espnow_recv_frame(ctx, esp_now_info, data, data_len);
+        }
+    }
+    __atomic_fetch_sub(&_callbacks_active, 1, __ATOMIC_SEQ_CST);
+}
+
+static void IRAM_ATTR _zh_espnow_recv_frame(_context_t *ctx, const esp_now_recv_info_t *esp_now_info, const uint8_t *data, int data_len)
+{
+    if (_zh_espnow_filter_mac(ctx, esp_now_info->src_addr) == false)
+    {
+        _zh_espnow_stats_add(ctx, &ctx->stats.filter_dropped, 1);
+        _zh_espnow_trace(ctx, ZH_ESPNOW_TRACE_DROP, ZH_ESPNOW_TRACE_DROP_FILTER, 0, data_len);
+        return;
+    }
+    _queue_t queue = {0};
+    bool has_seq = false;
+    uint16_t seq = 0;
+    queue.id = ON_RECV;
+    queue.frame_type = FRAME_DATA;
+    if (ctx->init_config.frame_header == true)
+    {
+        const _frame_header_t *header = (const _frame_header_t *)data;
+        ZH_ERROR_CHECK_VOID_HOT(data_len > (int)sizeof(_frame_header_t) && header->type < FRAME_TYPE_NUM, _zh_espnow_stats_add(ctx, &ctx->stats.frame_error, 1);
+                                _zh_espnow_trace(ctx, ZH_ESPNOW_TRACE_DROP, ZH_ESPNOW_TRACE_DROP_FRAME_ERROR, 0, data_len), "Invalid frame header. Dropping incoming ESP-NOW data.");
+        queue.frame_type = header->type;
+        queue.frame_flags = header->flags;
+        data += sizeof(_frame_header_t);
+        data_len -= sizeof(_frame_header_t);
+        if ((queue.frame_flags & FRAME_FLAG_SEQUENCE) != 0)
+        {
+            ZH_ERROR_CHECK_VOID_HOT(data_len > (int)sizeof(uint16_t), _zh_espnow_stats_add(ctx, &ctx->stats.frame_error, 1);
+                                    _zh_espnow_trace(ctx, ZH_ESPNOW_TRACE_DROP, ZH_ESPNOW_TRACE_DROP_FRAME_ERROR, 0, data_len), "Invalid frame header. Dropping incoming ESP-NOW data.");
+            has_seq = true;
+            memcpy(&seq, data, sizeof(seq));
+            data += sizeof(uint16_t);
+            data_len -= sizeof(uint16_t);
+        }
+    }
+    // Payload prefixes of compressed frames are checked by the receive task once the payload is restored.
+    if (queue.frame_type == FRAME_DATA && (queue.frame_flags & FRAME_FLAG_COMPRESSED) == 0 && _zh_espnow_filter_payload(ctx, data, data_len) == false)
+    {
+        _zh_espnow_stats_add(ctx, &ctx->stats.filter_dropped, 1);
+        _zh_espnow_trace(ctx, ZH_ESPNOW_TRACE_DROP, ZH_ESPNOW_TRACE_DROP_FILTER, 0, data_len);
+        return;
+    }
+    if (has_seq == true && ctx->init_config.dedup == true && _zh_espnow_dedup_check(ctx, esp_now_info->src_addr, seq) == false)
+    {
+        _zh_espnow_stats_add(ctx, &ctx->stats.dedup_dropped, 1);
+        _zh_espnow_trace(ctx, ZH_ESPNOW_TRACE_DROP, ZH_ESPNOW_TRACE_DROP_DEDUP, seq, data_len);
+        return;
+    }
+    ZH_ERROR_CHECK_VOID_HOT(uxQueueSpacesAvailable(ctx->rx_queue_handle) > ctx->init_config.rx_queue_size / 10, _zh_espnow_stats_add(ctx, &ctx->stats.queue_overflow_error, 1);
+                            _zh_espnow_trace(ctx, ZH_ESPNOW_TRACE_DROP, ZH_ESPNOW_TRACE_DROP_QUEUE_FULL, 0, data_len), "Queue is almost full. Dropping incoming ESP-NOW data.");
+    queue.timestamp = esp_timer_get_time();
+    queue.rssi = (esp_now_info->rx_ctrl != NULL) ? esp_now_info->rx_ctrl->rssi : 0;
+    queue.message = _zh_espnow_pool_alloc(ctx, (uint16_t)data_len);
+    ZH_ERROR_CHECK_VOID_HOT(queue.message != NULL, _zh_espnow_trace(ctx, ZH_ESPNOW_TRACE_DROP, ZH_ESPNOW_TRACE_DROP_NO_MEMORY, 0, data_len), "No free block in the message pool for incoming ESP-NOW data.");
+    memcpy(queue.message->mac_addr, esp_now_info->src_addr, ESP_NOW_ETH_ALEN);
+    memcpy(queue.message->data, data, data_len);
+    queue.message->data_len = (uint16_t)data_len;
+    BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+    ZH_ERROR_CHECK_VOID_HOT(xQueueSendFromISR(ctx->rx_queue_handle, &queue, &xHigherPriorityTaskWoken) == pdTRUE, _zh_espnow_stats_add(ctx, &ctx->stats.queue_overflow_error, 1);
+                            _zh_espnow_trace(ctx, ZH_ESPNOW_TRACE_DROP, ZH_ESPNOW_TRACE_DROP_QUEUE_FULL, 0, data_len); _zh_espnow_pool_free(ctx, queue.message), "Failed to add incoming ESP-NOW data to queue.");
+    if (has_seq == true && ctx->init_config.dedup == true)
+    {
+        _zh_espnow_dedup_record(ctx, esp_now_info->src_addr, seq);
+    }
+    _zh_espnow_trace(ctx, ZH_ESPNOW_TRACE_RECV, queue.frame_type, (has_seq == true) ? seq : 0, data_len);
+    UBaseType_t depth = uxQueueMessagesWaitingFromISR(ctx->rx_queue_handle);
+    _zh_espnow_stats_max(ctx, &ctx->stats.rx_queue_high_water, depth);
+    if (xHigherPriorityTaskWoken == pdTRUE)
+    {
+        portYIELD_FROM_ISR();
+    };
+}
+
+static _dedup_entry_t *_zh_espnow_dedup_find(_context_t *ctx, const uint8_t *mac_addr)
+{
+    for (uint8_t i = 0; i < DEDUP_SOURCES_MAX; ++i)
+    {
+        if (ctx->dedup[i].is_used == true && memcmp(ctx->dedup[i].mac_addr, mac_addr, ESP_NOW_ETH_ALEN) == 0)
+        {
+            return &ctx->dedup[i];
+        }
+    }
+    return NULL;
+}
+
+static bool _zh_espnow_dedup_check(_context_t *ctx, const uint8_t *mac_addr, uint16_t seq)
+{
+    // Runs only in the receive callback, so the table needs no lock.
+    const _dedup_entry_t *entry = _zh_espnow_dedup_find(ctx, mac_addr);
+    if (entry == NULL)
+    {
+        return true;
+    }
+    int16_t diff = (int16_t)(seq - entry->last_seq);
+    if (diff > 0 || -diff >= DEDUP_WINDOW)
+    {
+        return true;
+    }
+    return (entry->window & (1UL << -diff)) == 0;
+}
+
+static void _zh_espnow_dedup_record(_context_t *ctx, const uint8_t *mac_addr, uint16_t seq)
+{
+    // Called once the frame is queued: a frame dropped before has to be accepted when the sender retransmits it.
+    _dedup_entry_t *entry = _zh_espnow_dedup_find(ctx, mac_addr);
+    if (entry == NULL)
+    {
+        entry = &ctx->dedup[0];
+        for (uint8_t i = 1; i < DEDUP_SOURCES_MAX && entry->is_used == true; ++i)
+        {
+            if (ctx->dedup[i].is_used == false || ctx->dedup[i].last_used < entry->last_used)
+            {
+                entry = &ctx->dedup[i];
+            }
+        }
+        memcpy(entry->mac_addr, mac_addr, ESP_NOW_ETH_ALEN);
+        entry->is_used = true;
+        entry->last_seq = seq;
+        entry->window = 1;
+        entry->last_used = ++ctx->dedup_clock;
+        return;
+    }
+    entry->last_used = ++ctx->dedup_clock;
+    int16_t diff = (int16_t)(seq - entry->last_seq);
+    if (diff > 0)
+    {
+        entry->window = (diff < DEDUP_WINDOW) ? (entry->window << diff) | 1 : 1;
+        entry->last_seq = seq;
+    }
+    else if (-diff >= DEDUP_WINDOW)
+    {
+        // Far behind the window: the sender has restarted.
+        entry->window = 1;
+        entry->last_seq = seq;
+    }
+    else
+    {
+        entry->window |= 1UL << -diff;
+    }
+}
+
+static bool _zh_espnow_filter_mac(_context_t *ctx, const uint8_t *mac_addr)
+{
+    zh_espnow_filter_mode_t mode = ctx->filter_mode;
+    if (mode == ZH_ESPNOW_FILTER_OFF)
+    {
+        return true;
+    }
+    // Optimistic read: retried if a writer changed the filter meanwhile, the frame passes if the writer keeps it busy.
+    for (uint8_t i = 0; i < FILTER_READ_ATTEMPTS; ++i)
+    {
+        uint32_t seq = __atomic_load_n(&ctx->filter_seq, __ATOMIC_ACQUIRE);
+        if ((seq & 1) != 0)
+        {
+            continue;
+        }
+        _filter_entry_t *entry = _zh_espnow_filter_find(ctx, mac_addr, false);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&ctx->filter_seq, __ATOMIC_RELAXED) != seq)
+        {
+            continue;
+        }
+        if (entry != NULL)
+        {
+            ++entry->hits;
+        }
+        return (entry != NULL) == (mode == ZH_ESPNOW_FILTER_ALLOW);
+    }
+    return true;
+}
+
+static bool _zh_espnow_filter_payload(_context_t *ctx, const uint8_t *data, int data_len)
+{
+    if (ctx->filter_prefixes_num == 0)
+    {
+        return true;
+    }
+    for (uint8_t i = 0; i < FILTER_READ_ATTEMPTS; ++i)
+    {
+        uint32_t seq = __atomic_load_n(&ctx->filter_seq, __ATOMIC_ACQUIRE);
+        if ((seq & 1) != 0)
+        {
+            continue;
+        }
+        _filter_prefix_t *match = NULL;
+        for (uint8_t j = 0; j < ZH_ESPNOW_FILTER_PREFIX_RULES && match == NULL; ++j)
+        {
+            _filter_prefix_t *rule = &ctx->filter_prefixes[j];
+            if (rule->len != 0 && rule->len <= data_len && memcmp(rule->value, data, rule->len) == 0)
+            {
+                match = rule;
+            }
+        }
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&ctx->filter_seq, __ATOMIC_RELAXED) != seq)
+        {
+            continue;
+        }
+        if (match != NULL)
+        {
+            ++match->hits;
+        }
+        return match != NULL;
+    }
+    return true;
+}
+
+static _filter_entry_t *_zh_espnow_filter_find(_context_t *ctx, const uint8_t *mac_addr, bool for_insert)
+{
+    if (ctx->filter_table == NULL)
+    {
+        return NULL;
+    }
+    uint32_t hash = 2166136261UL;
+    for (uint8_t i = 0; i < ESP_NOW_ETH_ALEN; ++i)
+    {
+        hash = (hash ^ mac_addr[i]) * 16777619UL;
+    }
+    _filter_entry_t *free_slot = NULL;
+    for (uint16_t i = 0; i < ctx->filter_capacity; ++i)
+    {
+        _filter_entry_t *entry = &ctx->filter_table[(hash + i) & (ctx->filter_capacity - 1)];
+        if (entry->state == FILTER_SLOT_USED && memcmp(entry->mac_addr, mac_addr, ESP_NOW_ETH_ALEN) == 0)
+        {
+            return entry;
+        }
+        if (entry->state != FILTER_SLOT_USED && free_slot == NULL)
+        {
+            free_slot = entry;
+        }
+        if (entry->state == FILTER_SLOT_EMPTY)
+        {
+            break;
+        }
+    }
+    return (for_insert == true) ? free_slot : NULL;
+}
+
+static void _zh_espnow_filter_write_begin(_context_t *ctx)
+{
+    portENTER_CRITICAL(&ctx->filter_lock);
+    __atomic_fetch_add(&ctx->filter_seq, 1, __ATOMIC_SEQ_CST);
+}
+
+static void _zh_espnow_filter_write_end(_context_t *ctx)
+{
+    __atomic_fetch_add(&ctx->filter_seq, 1, __ATOMIC_SEQ_CST);
+    portEXIT_CRITICAL(&ctx->filter_lock);
+}
+
+static esp_err_t _zh_espnow_send(_context_t *ctx, const uint8_t *target, const uint8_t *data, uint16_t data_len, const zh_espnow_send_options_t *options, uint32_t *msg_id)
+{
+    ZH_LOGI_HOT("Adding to queue outgoing ESP-NOW data started.");
+    ZH_ERROR_CHECK(ctx != NULL && ctx->is_initialized == true, ESP_ERR_NOT_FOUND, NULL, "Adding to queue outgoing ESP-NOW data failed. ESP-NOW is not initialized.");
+    ZH_ERROR_CHECK(data != NULL && data_len > 0 && data_len <= _zh_espnow_max_payload(ctx), ESP_ERR_INVALID_ARG, NULL, "Adding to queue outgoing ESP-NOW data failed. Invalid argument.");
+    const zh_espnow_iovec_t iov = {.data = data, .data_len = data_len};
+    uint8_t priority = _zh_espnow_tx_class(ctx, (options != NULL) ? options->priority : ZH_ESPNOW_PRIORITY_NORMAL);
+    bool has_space = _zh_espnow_tx_wait_space(ctx, priority, (options != NULL) ? options->timeout : 0);
+    esp_err_t err = (has_space == true) ? _zh_espnow_tx_enqueue(ctx, target, FRAME_DATA, 0, priority, &iov, 1, 0, msg_id) : ESP_ERR_INVALID_STATE;
+    xSemaphoreGive(ctx->tx_mutex);
+    ZH_ERROR_CHECK_HOT(has_space == true, ESP_ERR_INVALID_STATE, _zh_espnow_stats_add(ctx, &ctx->stats.queue_overflow_error, 1); _zh_espnow_stats_add(ctx, &ctx->stats.priority_dropped[priority], 1);
+                       _zh_espnow_trace(ctx, ZH_ESPNOW_TRACE_DROP, ZH_ESPNOW_TRACE_DROP_QUEUE_FULL, 0, data_len), "Adding to queue outgoing ESP-NOW data failed. Queue is almost full.");
+    ZH_ERROR_CHECK_HOT(err == ESP_OK, err, NULL, "Adding to queue outgoing ESP-NOW data failed.");
+    xTaskNotifyGive(ctx->task);
+    ZH_LOGI_HOT("Adding to queue outgoing ESP-NOW data completed successfully.");
+    return ESP_OK;
+}
+
+static uint32_t _zh_espnow_iov_len(const zh_espnow_iovec_t *iov, uint8_t iov_count)
+{
+    if (iov == NULL || iov_count == 0)
+    {
+        return 0;
+    }
+    uint32_t data_len = 0;
+    for (uint8_t i = 0; i < iov_count; ++i)
+    {
+        if (iov[i].data == NULL && iov[i].data_len > 0)
+        {
+            return 0;
+        }
+        data_len += iov[i].data_len;
+    }
+    return data_len;
+}
+
+static esp_err_t _zh_espnow_tx_enqueue(_context_t *ctx, const uint8_t *target, uint8_t frame_type, uint8_t frame_flags, uint8_t priority, const zh_espnow_iovec_t *iov, uint8_t iov_count, TickType_t timeout, uint32_t *msg_id)
+{
+    bool has_seq = (ctx->init_config.dedup == true && frame_type == FRAME_DATA);
+    const uint16_t header_len = ((ctx->init_config.frame_header == true) ? sizeof(_frame_header_t) : 0) + ((has_seq == true) ? sizeof(uint16_t) : 0);
+    uint16_t offset = header_len;
+    uint16_t data_len = header_len + (uint16_t)_zh_espnow_iov_len(iov, iov_count);
+    _queue_t queue = {0};
+    queue.id = TO_SEND;
+    queue.frame_type = frame_type;
+    queue.priority = _zh_espnow_tx_class(ctx, priority);
+    queue.timestamp = esp_timer_get_time();
+    queue.message = _zh_espnow_pool_alloc(ctx, data_len);
+    ZH_ERROR_CHECK_HOT(queue.message != NULL, ESP_ERR_NO_MEM, _zh_espnow_trace(ctx, ZH_ESPNOW_TRACE_DROP, ZH_ESPNOW_TRACE_DROP_NO_MEMORY, 0, data_len), "Adding to queue outgoing ESP-NOW data failed. No free block in the message pool.");
+    memcpy(queue.message->mac_addr, (target == NULL) ? _broadcast_mac : target, ESP_NOW_ETH_ALEN);
+    if (header_len != 0)
+    {
+        _frame_header_t *header = (_frame_header_t *)queue.message->data;
+        header->type = frame_type;
+        header->flags = frame_flags;
+        if (has_seq == true)
+        {
+            header->flags |= FRAME_FLAG_SEQUENCE;
+            uint16_t seq = ++ctx->tx_seq;
+            memcpy(queue.message->data + sizeof(_frame_header_t), &seq, sizeof(seq));
+        }
+    }
+    for (uint8_t i = 0; i < iov_count; ++i)
+    {
+        memcpy(queue.message->data + offset, iov[i].data, iov[i].data_len);
+        offset += iov[i].data_len;
+    }
+    queue.message->data_len = data_len;
+    if (ctx->codec_table != NULL && frame_type == FRAME_DATA && data_len - header_len >= CODEC_MIN_SIZE)
+    {
+        _zh_espnow_compress(ctx, queue.message, header_len);
+    }
+    if (frame_type == FRAME_DATA || msg_id != NULL)
+    {
+        queue.msg_id = (++ctx->msg_id != 0) ? ctx->msg_id : ++ctx->msg_id;
+    }
+    ZH_ERROR_CHECK_HOT(xQueueSend(ctx->tx_queues[queue.priority], &queue, timeout) == pdTRUE, ESP_FAIL, _zh_espnow_stats_add(ctx, &ctx->stats.queue_overflow_error, 1); _zh_espnow_stats_add(ctx, &ctx->stats.priority_dropped[queue.priority], 1);
+                       _zh_espnow_trace(ctx, ZH_ESPNOW_TRACE_DROP, ZH_ESPNOW_TRACE_DROP_QUEUE_FULL, queue.msg_id, data_len); _zh_espnow_pool_free(ctx, queue.message), "Adding to queue outgoing ESP-NOW data failed. Failed to add data to queue.");
+    _zh_espnow_trace(ctx, ZH_ESPNOW_TRACE_ENQUEUE, queue.priority, queue.msg_id, queue.message->data_len);
+    UBaseType_t depth = uxQueueMessagesWaiting(ctx->tx_queues[queue.priority]);
+    _zh_espnow_stats_max(ctx, &ctx->stats.tx_queue_high_water, depth);
+    if (msg_id != NULL)
+    {
+        *msg_id = queue.msg_id;
+    }
+    return ESP_OK;
+}
+
+static uint8_t _zh_espnow_tx_class(_context_t *ctx, uint8_t priority)
+{
+    return (priority < ZH_ESPNOW_PRIORITY_NUM && ctx->tx_queues[priority] != NULL) ? priority : ZH_ESPNOW_PRIORITY_NORMAL;
+}
+
+static uint8_t _zh_espnow_tx_queue_size(_context_t *ctx, uint8_t priority)
+{
+    switch (priority)
+    {
+    case ZH_ESPNOW_PRIORITY_CONTROL:
+        return ctx->init_config.control_queue_size;
+    case ZH_ESPNOW_PRIORITY_BULK:
+        return ctx->init_config.bulk_queue_size;
+    default:
+        return ctx->init_config.queue_size;
+    }
+}
+
+static UBaseType_t _zh_espnow_tx_reserve(_context_t *ctx, uint8_t priority)
+{
+    return (UBaseType_t)_zh_espnow_tx_queue_size(ctx, priority) * ctx->init_config.queue_reserve_percent / 100;
+}
+
+static bool _zh_espnow_tx_has_space(_context_t *ctx, uint8_t priority)
+{
+    return (uxQueueSpacesAvailable(ctx->tx_queues[priority]) > _zh_espnow_tx_reserve(ctx, priority));
+}
+
+static bool _zh_espnow_tx_wait_space(_context_t *ctx, uint8_t priority, TickType_t timeout)
+{
+    // Returns with the transmit mutex taken in any case. The bit is cleared before the check, so room made by the
+    // transmit task between the check and the wait is not missed.
+    TickType_t start = xTaskGetTickCount();
+    for (;;)
+    {
+        xEventGroupClearBits(ctx->tx_event_group, (BIT0 << priority));
+        xSemaphoreTake(ctx->tx_mutex, portMAX_DELAY);
+        if (_zh_espnow_tx_has_space(ctx, priority) == true)
+        {
+            return true;
+        }
+        ctx->tx_blocked[priority] = true;
+        TickType_t elapsed = xTaskGetTickCount() - start;
+        if (timeout != portMAX_DELAY && elapsed >= timeout)
+        {
+            return false;
+        }
+        xSemaphoreGive(ctx->tx_mutex);
+        xEventGroupWaitBits(ctx->tx_event_group, (BIT0 << priority), pdFALSE, pdTRUE, (timeout == portMAX_DELAY) ? portMAX_DELAY : timeout - elapsed);
+    }
+}
+
+static void _zh_espnow_tx_space_notify(_context_t *ctx)
+{
+    for (uint8_t i = 0; i < ZH_ESPNOW_PRIORITY_NUM; ++i)
+    {
+        if (ctx->tx_queues[i] == NULL)
+        {
+            continue;
+        }
+        UBaseType_t spaces = uxQueueSpacesAvailable(ctx->tx_queues[i]);
+        if (spaces > _zh_espnow_tx_reserve(ctx, i))
+        {
+            xEventGroupSetBits(ctx->tx_event_group, (BIT0 << i));
+        }
+        // The event is posted only once the queue has drained to the writable mark, not right above the reserve.
+        if (ctx->tx_blocked[i] == true && (uint32_t)spaces * 100 >= (uint32_t)_zh_espnow_tx_queue_size(ctx, i) * ctx->init_config.queue_writable_percent)
+        {
+            ctx->tx_blocked[i] = false;
+            const zh_espnow_event_on_queue_t on_queue = {.priority = i, .free = (uint8_t)spaces};
+            ZH_ERROR_CHECK_CONT(esp_event_post(ctx->event_base, ZH_ESPNOW_ON_QUEUE_WRITABLE_EVENT, &on_queue, sizeof(zh_espnow_event_on_queue_t), 0) == ESP_OK,
+                                _zh_espnow_stats_add(ctx, &ctx->stats.event_post_error, 1), "Transmit queue processing failed. Failed to post queue writable event.");
+        }
+    }
+}
+
+static bool _zh_espnow_tx_is_idle(_context_t *ctx)
+{
+    if (ctx->tx_in_flight != 0 || ctx->tx_has_pending == true || ctx->fair_count != 0 || ctx->coalesce_open != COALESCE_NONE)
+    {
+        return false;
+    }
+    for (uint8_t i = 0; i < ZH_ESPNOW_PRIORITY_NUM; ++i)
+    {
+        if (ctx->tx_queues[i] != NULL && uxQueueMessagesWaiting(ctx->tx_queues[i]) != 0)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static TickType_t _zh_espnow_burst_check(_context_t *ctx)
+{
+    if (ctx->burst.is_active == true || (ctx->init_config.burst_size == 0 && ctx->burst_flush_requested == false))
+    {
+        return portMAX_DELAY;
+    }
+    // The request is taken before the queues are looked at, so the messages queued before zh_espnow_flush() are seen.
+    bool is_requested = __atomic_exchange_n(&ctx->burst_flush_requested, false, __ATOMIC_SEQ_CST);
+    uint16_t waiting = 0;
+    int64_t oldest = INT64_MAX;
+    for (uint8_t i = 0; i < ZH_ESPNOW_PRIORITY_NUM; ++i)
+    {
+        _queue_t head = {0};
+        if (ctx->tx_queues[i] != NULL && xQueuePeek(ctx->tx_queues[i], &head, 0) == pdTRUE)
+        {
+            waiting += uxQueueMessagesWaiting(ctx->tx_queues[i]);
+            oldest = (head.timestamp < oldest) ? head.timestamp : oldest;
+        }
+    }
+    if (is_requested == true && waiting == 0 && _zh_espnow_tx_is_idle(ctx) == true)
+    {
+        xEventGroupSetBits(ctx->tx_event_group, TX_EVENT_BURST_DONE);
+        return portMAX_DELAY;
+    }
+    int64_t remaining_us = INT64_MAX;
+    if (ctx->init_config.burst_size > 0 && waiting > 0 && ctx->init_config.burst_delay_ms > 0)
+    {
+        remaining_us = oldest + (int64_t)ctx->init_config.burst_delay_ms * 1000 - esp_timer_get_time();
+    }
+    bool is_due = (is_requested == true || (ctx->init_config.burst_size > 0 && waiting >= ctx->init_config.burst_size) || remaining_us <= 0);
+    if (is_due == false)
+    {
+        return (remaining_us == INT64_MAX) ? portMAX_DELAY : pdMS_TO_TICKS(remaining_us / 1000) + 1;
+    }
+    ctx->burst = (_burst_t){.is_active = true, .started_at = esp_timer_get_time()};
+    return portMAX_DELAY;
+}
+
+static void _zh_espnow_burst_finish(_context_t *ctx)
+{
+    if (ctx->burst.is_active == false || _zh_espnow_tx_is_idle(ctx) == false)
+    {
+        return;
+    }
+    ctx->burst.is_active = false;
+    const zh_espnow_event_on_burst_t on_burst = {.sent_success = ctx->burst.sent_success, .sent_fail = ctx->burst.sent_fail, .duration_us = (uint32_t)(esp_timer_get_time() - ctx->burst.started_at)};
+    portENTER_CRITICAL(&ctx->stats_lock);
+    ++ctx->stats.bursts;
+    ctx->stats.burst_messages += on_burst.sent_success + on_burst.sent_fail;
+    _zh_espnow_stats_latency(ctx, &ctx->stats.burst_duration_avg_us, &ctx->stats.burst_duration_max_us, on_burst.duration_us);
+    portEXIT_CRITICAL(&ctx->stats_lock);
+    // The event is posted before the flush waiters are released, so it is already queued when the node goes to sleep.
+    esp_err_t err = esp_event_post(ctx->event_base, ZH_ESPNOW_ON_BURST_COMPLETE_EVENT, &on_burst, sizeof(zh_espnow_event_on_burst_t), 1000 / portTICK_PERIOD_MS);
+    xEventGroupSetBits(ctx->tx_event_group, TX_EVENT_BURST_DONE);
+    ZH_ERROR_CHECK_VOID(err == ESP_OK, _zh_espnow_stats_add(ctx, &ctx->stats.event_post_error, 1), "Outgoing ESP-NOW burst processing failed. Failed to post burst event.");
+}
+
+static void _zh_espnow_radio_off(_context_t *ctx)
+{
+    // Kept in microseconds between calls, so short bursts are not lost to rounding.
+    ctx->radio_on_rest_us += (uint32_t)(esp_timer_get_time() - ctx->radio_on_at);
+    _zh_espnow_stats_add(ctx, &ctx->stats.radio_on_time_ms, ctx->radio_on_rest_us / 1000);
+    ctx->radio_on_rest_us %= 1000;
+}
+
+static uint8_t _zh_espnow_tx_limit(_context_t *ctx, uint8_t priority)
+{
+    // The last window slot is kept for control messages, so they never wait for the retries of other traffic.
+    bool is_reserved = (priority != ZH_ESPNOW_PRIORITY_CONTROL && ctx->tx_queues[ZH_ESPNOW_PRIORITY_CONTROL] != NULL && ctx->init_config.tx_window > 1);
+    return (is_reserved == true) ? ctx->init_config.tx_window - 1 : ctx->init_config.tx_window;
+}
+
+static bool _zh_espnow_tx_next(_context_t *ctx, _queue_t *queue)
+{
+    QueueHandle_t control = ctx->tx_queues[ZH_ESPNOW_PRIORITY_CONTROL];
+    ctx->fair_wait = portMAX_DELAY;
+    // In battery scheduling mode messages stay in their queues until a burst is flushed.
+    if (ctx->tx_in_flight >= ctx->init_config.tx_window || (ctx->init_config.burst_size > 0 && ctx->burst.is_active == false))
+    {
+        return false;
+    }
+    if (control != NULL && xQueueReceive(control, queue, 0) == pdTRUE)
+    {
+        return true;
+    }
+    if (ctx->tx_in_flight >= _zh_espnow_tx_limit(ctx, ZH_ESPNOW_PRIORITY_NORMAL))
+    {
+        return false;
+    }
+    if (ctx->tx_has_pending == true)
+    {
+        *queue = ctx->tx_pending;
+        ctx->tx_has_pending = false;
+        return true;
+    }
+    if (ctx->fair_items == NULL)
+    {
+        return _zh_espnow_tx_dequeue(ctx, queue);
+    }
+    _zh_espnow_fair_fill(ctx);
+    return _zh_espnow_fair_next(ctx, queue);
+}
+
+static bool _zh_espnow_tx_dequeue(_context_t *ctx, _queue_t *queue)
+{
+    QueueHandle_t bulk = ctx->tx_queues[ZH_ESPNOW_PRIORITY_BULK];
+    // Normal messages are preferred, but every PRIORITY_BULK_SHARE-th turn goes to bulk messages so they are not starved.
+    bool is_bulk_turn = (ctx->tx_normal_streak >= PRIORITY_BULK_SHARE);
+    if (bulk != NULL && is_bulk_turn == true && xQueueReceive(bulk, queue, 0) == pdTRUE)
+    {
+        ctx->tx_normal_streak = 0;
+        return true;
+    }
+    if (xQueueReceive(ctx->tx_queues[ZH_ESPNOW_PRIORITY_NORMAL], queue, 0) == pdTRUE)
+    {
+        ctx->tx_normal_streak += (is_bulk_turn == false) ? 1 : 0;
+        return true;
+    }
+    if (bulk != NULL && xQueueReceive(bulk, queue, 0) == pdTRUE)
+    {
+        ctx->tx_normal_streak = 0;
+        return true;
+    }
+    return false;
+}
+
+static void _zh_espnow_fair_fill(_context_t *ctx)
+{
+    // The staged messages extend the transmit queues, so their space is handed back to the producers right away.
+    _queue_t queue = {0};
+    while (ctx->fair_free != FAIR_NONE && _zh_espnow_tx_dequeue(ctx, &queue) == true)
+    {
+        _fair_flow_t *flow = _zh_espnow_fair_flow(ctx, queue.message->mac_addr);
+        uint8_t index = ctx->fair_free;
+        _fair_item_t *item = &ctx->fair_items[index];
+        ctx->fair_free = item->next;
+        item->queue = queue;
+        item->next = FAIR_NONE;
+        if (flow->count == 0)
+        {
+            flow->head = index;
+        }
+        else
+        {
+            ctx->fair_items[flow->tail].next = index;
+        }
+        flow->tail = index;
+        ++flow->count;
+        ++ctx->fair_count;
+        flow->last_used = ++ctx->fair_clock;
+    }
+}
+
+static _fair_flow_t *_zh_espnow_fair_flow(_context_t *ctx, const uint8_t *mac_addr)
+{
+    // There are as many destinations as items, so while an item is free an idle destination is left to reuse.
+    _fair_flow_t *victim = NULL;
+    for (uint8_t i = 0; i < ctx->init_config.fair_queue_size; ++i)
+    {
+        _fair_flow_t *flow = &ctx->fair_flows[i];
+        if (flow->is_used == true && memcmp(flow->mac_addr, mac_addr, ESP_NOW_ETH_ALEN) == 0)
+        {
+            return flow;
+        }
+        if (flow->count == 0 && (victim == NULL || (victim->is_used == true && (flow->is_used == false || flow->last_used < victim->last_used))))
+        {
+            victim = flow;
+        }
+    }
+    *victim = (_fair_flow_t){.is_used = true, .head = FAIR_NONE, .tail = FAIR_NONE};
+    memcpy(victim->mac_addr, mac_addr, ESP_NOW_ETH_ALEN);
+    return victim;
+}
+
+static bool _zh_espnow_fair_next(_context_t *ctx, _queue_t *queue)
+{
+    if (ctx->fair_count == 0)
+    {
+        return false;
+    }
+    const zh_espnow_init_config_t *config = &ctx->init_config;
+    int64_t now = esp_timer_get_time();
+    int64_t wait_us = _zh_espnow_fair_bucket_wait(config->global_rate, config->global_burst, ctx->fair_tat_us, now);
+    if (wait_us > 0)
+    {
+        if (ctx->fair_is_throttled == false)
+        {
+            ctx->fair_is_throttled = true;
+            _zh_espnow_stats_add(ctx, &ctx->stats.throttled_global, 1);
+        }
+        ctx->fair_wait = pdMS_TO_TICKS(wait_us / 1000) + 1;
+        return false;
+    }
+    // A destination may hold no more than its share of the window, so its retries do not lock the others out.
+    uint8_t active = 0;
+    for (uint8_t i = 0; i < config->fair_queue_size; ++i)
+    {
+        active += (ctx->fair_flows[i].count != 0) ? 1 : 0;
+    }
+    uint8_t share = _zh_espnow_tx_limit(ctx, ZH_ESPNOW_PRIORITY_NORMAL) / active;
+    share = (share == 0) ? 1 : share;
+    uint16_t quantum = _zh_espnow_pool_max_size(ctx);
+    int64_t peer_wait_us = INT64_MAX;
+    // Deficit round-robin: every visit adds a quantum of one full frame, so each destination with a conforming message is
+    // served at least once per round. The loop ends back at the first destination with a fresh quantum.
+    for (uint16_t n = 0; n <= config->fair_queue_size; ++n)
+    {
+        _fair_flow_t *flow = &ctx->fair_flows[ctx->fair_current];
+        if (flow->count != 0)
+        {
+            wait_us = _zh_espnow_fair_bucket_wait(config->peer_rate, config->peer_burst, flow->tat_us, now);
+            if (wait_us > 0)
+            {
+                peer_wait_us = (wait_us < peer_wait_us) ? wait_us : peer_wait_us;
+                if (flow->is_throttled == false)
+                {
+                    flow->is_throttled = true;
+                    _zh_espnow_stats_add(ctx, &ctx->stats.throttled_peer, 1);
+                    _zh_espnow_peer_report_throttled(flow->mac_addr);
+                }
+            }
+            else if (_zh_espnow_fair_in_flight(ctx, flow->mac_addr) < share)
+            {
+                if (ctx->fair_is_new_visit == true)
+                {
+                    ctx->fair_is_new_visit = false;
+                    flow->deficit += quantum;
+                }
+                _fair_item_t *item = &ctx->fair_items[flow->head];
+                if (item->queue.message->data_len <= flow->deficit)
+                {
+                    flow->deficit -= item->queue.message->data_len;
+                    *queue = item->queue;
+                    uint8_t index = flow->head;
+                    flow->head = item->next;
+                    item->next = ctx->fair_free;
+                    ctx->fair_free = index;
+                    --ctx->fair_count;
+                    // An idle destination does not save up credit for the next round.
+                    if (--flow->count == 0)
+                    {
+                        flow->deficit = 0;
+                    }
+                    flow->is_throttled = false;
+                    ctx->fair_is_throttled = false;
+                    _zh_espnow_fair_bucket_take(config->peer_rate, &flow->tat_us, now);
+                    _zh_espnow_fair_bucket_take(config->global_rate, &ctx->fair_tat_us, now);
+                    return true;
+                }
+            }
+        }
+        ctx->fair_current = (ctx->fair_current + 1 < config->fair_queue_size) ? ctx->fair_current + 1 : 0;
+        ctx->fair_is_new_visit = true;
+    }
+    if (peer_wait_us != INT64_MAX)
+    {
+        ctx->fair_wait = pdMS_TO_TICKS(peer_wait_us / 1000) + 1;
+    }
+    return false;
+}
+
+static int64_t _zh_espnow_fair_bucket_wait(uint16_t rate, uint8_t burst, int64_t tat_us, int64_t now)
+{
+    if (rate == 0)
+    {
+        return 0;
+    }
+    int64_t interval_us = 1000000 / rate;
+    int64_t tolerance_us = interval_us * ((burst > 1) ? burst - 1 : 0);
+    return tat_us - tolerance_us - now;
+}
+
+static void _zh_espnow_fair_bucket_take(uint16_t rate, int64_t *tat_us, int64_t now)
+{
+    if (rate == 0)
+    {
+        return;
+    }
+    // A bucket in debt (retransmissions) keeps its arrival time in the future instead of restarting from now.
+    *tat_us = ((*tat_us > now) ? *tat_us : now) + 1000000 / rate;
+}
+
+static uint8_t _zh_espnow_fair_in_flight(_context_t *ctx, const uint8_t *mac_addr)
+{
+    uint8_t in_flight = 0;
+    for (uint8_t i = 0; i < ctx->init_config.tx_window; ++i)
+    {
+        const _tx_slot_t *slot = &ctx->tx_slots[i];
+        in_flight += (slot->message != NULL && memcmp(slot->message->mac_addr, mac_addr, ESP_NOW_ETH_ALEN) == 0) ? 1 : 0;
+    }
+    return in_flight;
+}
+
+static void _zh_espnow_fair_charge(_context_t *ctx, const uint8_t *mac_addr)
+{
+    if (ctx->fair_flows == NULL)
+    {
+        return;
+    }
+    int64_t now = esp_timer_get_time();
+    for (uint8_t i = 0; i < ctx->init_config.fair_queue_size; ++i)
+    {
+        _fair_flow_t *flow = &ctx->fair_flows[i];
+        if (flow->is_used == true && memcmp(flow->mac_addr, mac_addr, ESP_NOW_ETH_ALEN) == 0)
+        {
+            _zh_espnow_fair_bucket_take(ctx->init_config.peer_rate, &flow->tat_us, now);
+            _zh_espnow_fair_bucket_take(ctx->init_config.global_rate, &ctx->fair_tat_us, now);
+            return;
+        }
+    }
+}
+
+static void _zh_espnow_process_send(_context_t *ctx, _queue_t *queue)
+{
+    _zh_espnow_trace(ctx, ZH_ESPNOW_TRACE_DEQUEUE, queue->priority, queue->msg_id, ctx->tx_in_flight);
+    bool is_control = (queue->priority == ZH_ESPNOW_PRIORITY_CONTROL);
+    if (is_control == false && _zh_espnow_coalesce_add(ctx, queue) == true)
+    {
+        _zh_espnow_stats_dispatch(ctx, queue);
+        return;
+    }
+    // Messages must not overtake the ones already packed, so the open frame goes first. Control messages may.
+    if (is_control == false)
+    {
+        _zh_espnow_coalesce_flush(ctx);
+    }
+    if (ctx->tx_in_flight >= _zh_espnow_tx_limit(ctx, queue->priority))
+    {
+        ctx->tx_pending = *queue;
+        ctx->tx_has_pending = true;
+        return;
+    }
+    _zh_espnow_stats_dispatch(ctx, queue);
+    _zh_espnow_tx_start(ctx, queue->message, queue->frame_type, queue->msg_id, queue->timestamp, COALESCE_NONE);
+}
+
+static esp_err_t _zh_espnow_tx_start(_context_t *ctx, zh_espnow_event_on_recv_t *message, uint8_t frame_type, uint32_t msg_id, int64_t enqueued_at, uint8_t coalesce)
+{
+    _tx_slot_t *slot = NULL;
+    for (uint8_t i = 0; i < ctx->init_config.tx_window; ++i)
+    {
+        if (ctx->tx_slots[i].message == NULL)
+        {
+            slot = &ctx->tx_slots[i];
+            break;
+        }
+    }
+    ZH_ERROR_CHECK(slot != NULL, ESP_ERR_INVALID_STATE, _zh_espnow_tx_drop(ctx, message, frame_type, msg_id, enqueued_at, coalesce), "Outgoing ESP-NOW data processed failed. Transmission window is full.");
+    ZH_ERROR_CHECK(_zh_espnow_peer_acquire(ctx, message->mac_addr, false) == ESP_OK, ESP_ERR_NO_MEM, _zh_espnow_tx_drop(ctx, message, frame_type, msg_id, enqueued_at, coalesce), "Outgoing ESP-NOW data processed failed. Failed to add peer.");
+    *slot = (_tx_slot_t){0};
+    slot->message = message;
+    slot->frame_type = frame_type;
+    slot->msg_id = msg_id;
+    slot->enqueued_at = enqueued_at;
+    slot->coalesce = coalesce;
+    ++ctx->tx_in_flight;
+    int64_t now = esp_timer_get_time();
+    if (ctx->tx_in_flight == 1)
+    {
+        ctx->radio_on_at = now;
+    }
+    if (frame_type == FRAME_DATA)
+    {
+        uint32_t wait_us = (uint32_t)(now - enqueued_at);
+        _zh_espnow_stats_add(ctx, &ctx->stats.queue_wait_hist[_zh_espnow_stats_bucket(wait_us)], 1);
+        _zh_espnow_peer_report_wait(message->mac_addr, wait_us);
+    }
+    for (uint8_t i = 0; coalesce != COALESCE_NONE && i < ctx->coalesce[coalesce].count; ++i)
+    {
+        uint32_t wait_us = (uint32_t)(now - ctx->coalesce[coalesce].enqueued_at[i]);
+        _zh_espnow_stats_add(ctx, &ctx->stats.queue_wait_hist[_zh_espnow_stats_bucket(wait_us)], 1);
+        _zh_espnow_peer_report_wait(message->mac_addr, wait_us);
+    }
+    ZH_ERROR_CHECK(_zh_espnow_peer_admit(ctx, message->mac_addr, &slot->timeout, &slot->max_attempts) == ESP_OK, ESP_ERR_INVALID_STATE, _zh_espnow_stats_add(ctx, &ctx->stats.peer_fast_fail, 1);
+                   _zh_espnow_tx_complete(ctx, slot, ZH_ESPNOW_SEND_FAIL), "Outgoing ESP-NOW data processed failed. Peer is unreachable.");
+    _zh_espnow_tx_transmit(ctx, slot);
+    return ESP_OK;
+}
+
+static bool _zh_espnow_coalesce_add(_context_t *ctx, const _queue_t *queue)
+{
+    if (ctx->init_config.coalesce_delay_ms == 0 || queue->frame_type != FRAME_DATA)
+    {
+        return false;
+    }
+    const zh_espnow_event_on_recv_t *message = queue->message;
+    // Coalesced records carry no flags of their own, so compressed messages are sent in their own frame.
+    if ((((const _frame_header_t *)message->data)->flags & FRAME_FLAG_COMPRESSED) != 0)
+    {
+        return false;
+    }
+    uint16_t offset = sizeof(_frame_header_t) + ((ctx->init_config.dedup == true) ? sizeof(uint16_t) : 0);
+    uint16_t data_len = message->data_len - offset;
+    uint16_t frame_size = _zh_espnow_pool_max_size(ctx);
+    frame_size = (frame_size > _max_message_size) ? _max_message_size : frame_size;
+    if (data_len > UINT8_MAX || offset + 1 + data_len > frame_size)
+    {
+        return false;
+    }
+    if (ctx->coalesce_open != COALESCE_NONE)
+    {
+        bool is_fit = (memcmp(ctx->coalesce_frame->mac_addr, message->mac_addr, ESP_NOW_ETH_ALEN) == 0 && ctx->coalesce[ctx->coalesce_open].count < COALESCE_MESSAGES_MAX &&
+                       ctx->coalesce_frame->data_len + 1 + data_len <= frame_size);
+        if (is_fit == false)
+        {
+            _zh_espnow_coalesce_flush(ctx);
+        }
+    }
+    if (ctx->coalesce_open == COALESCE_NONE && _zh_espnow_coalesce_begin(ctx, message) == false)
+    {
+        return false;
+    }
+    _coalesce_t *entry = &ctx->coalesce[ctx->coalesce_open];
+    ctx->coalesce_frame->data[ctx->coalesce_frame->data_len] = (uint8_t)data_len;
+    memcpy(ctx->coalesce_frame->data + ctx->coalesce_frame->data_len + 1, message->data + offset, data_len);
+    ctx->coalesce_frame->data_len += 1 + data_len;
+    entry->msg_id[entry->count] = queue->msg_id;
+    entry->enqueued_at[entry->count] = queue->timestamp;
+    ++entry->count;
+    _zh_espnow_pool_free(ctx, queue->message);
+    return true;
+}
+
+static bool _zh_espnow_coalesce_begin(_context_t *ctx, const zh_espnow_event_on_recv_t *first)
+{
+    uint8_t coalesce = COALESCE_NONE;
+    for (uint8_t i = 0; i < COALESCE_SLOTS && coalesce == COALESCE_NONE; ++i)
+    {
+        if (ctx->coalesce[i].is_used == false)
+        {
+            coalesce = i;
+        }
+    }
+    if (coalesce == COALESCE_NONE)
+    {
+        return false;
+    }
+    uint16_t frame_size = _zh_espnow_pool_max_size(ctx);
+    ctx->coalesce_frame = _zh_espnow_pool_alloc(ctx, (frame_size > _max_message_size) ? _max_message_size : frame_size);
+    if (ctx->coalesce_frame == NULL)
+    {
+        return false;
+    }
+    // The frame takes over the header and the sequence number of its first message.
+    uint16_t header_len = sizeof(_frame_header_t) + ((ctx->init_config.dedup == true) ? sizeof(uint16_t) : 0);
+    memcpy(ctx->coalesce_frame->mac_addr, first->mac_addr, ESP_NOW_ETH_ALEN);
+    memcpy(ctx->coalesce_frame->data, first->data, header_len);
+    ((_frame_header_t *)ctx->coalesce_frame->data)->type = FRAME_COALESCED;
+    ctx->coalesce_frame->data_len = header_len;
+    ctx->coalesce[coalesce] = (_coalesce_t){.is_used = true};
+    ctx->coalesce_open = coalesce;
+    ctx->coalesce_deadline = xTaskGetTickCount() + pdMS_TO_TICKS(ctx->init_config.coalesce_delay_ms);
+    return true;
+}
+
+static void _zh_espnow_coalesce_flush(_context_t *ctx)
+{
+    if (ctx->coalesce_open == COALESCE_NONE)
+    {
+        return;
+    }
+    uint8_t coalesce = ctx->coalesce_open;
+    zh_espnow_event_on_recv_t *frame = ctx->coalesce_frame;
+    ctx->coalesce_open = COALESCE_NONE;
+    ctx->coalesce_frame = NULL;
+    _zh_espnow_stats_add(ctx, &ctx->stats.coalesced_frames, 1);
+    _zh_espnow_stats_add(ctx, &ctx->stats.coalesced_messages, ctx->coalesce[coalesce].count);
+    _zh_espnow_tx_start(ctx, frame, FRAME_COALESCED, 0, ctx->coalesce[coalesce].enqueued_at[0], coalesce);
+}
+
+static void _zh_espnow_coalesce_release(_context_t *ctx, uint8_t coalesce)
+{
+    if (coalesce != COALESCE_NONE)
+    {
+        ctx->coalesce[coalesce].is_used = false;
+    }
+}
+
+static TickType_t _zh_espnow_coalesce_process(_context_t *ctx)
+{
+    if (ctx->coalesce_open == COALESCE_NONE)
+    {
+        return portMAX_DELAY;
+    }
+    // A flushed burst must not wait for more messages, the queues have already been drained into the frame.
+    int32_t remaining = (int32_t)(ctx->coalesce_deadline - xTaskGetTickCount());
+    if (remaining > 0 && ctx->burst.is_active == false)
+    {
+        return (TickType_t)remaining;
+    }
+    // With a full window the frame goes out as soon as a confirmation frees a slot and wakes the task.
+    if (ctx->tx_in_flight < _zh_espnow_tx_limit(ctx, ZH_ESPNOW_PRIORITY_NORMAL))
+    {
+        _zh_espnow_coalesce_flush(ctx);
+    }
+    return portMAX_DELAY;
+}
+
+static void _zh_espnow_tx_transmit(_context_t *ctx, _tx_slot_t *slot)
+{
+    zh_espnow_event_on_recv_t *message = slot->message;
+    // First transmissions take their tokens when they leave the fair scheduler, retransmissions are charged here.
+    if (++slot->attempt > 1)
+    {
+        _zh_espnow_fair_charge(ctx, message->mac_addr);
+    }
+    slot->deadline = xTaskGetTickCount() + slot->timeout;
+    slot->order = ++ctx->tx_order;
+    slot->sent_at = esp_timer_get_time();
+    _zh_espnow_trace(ctx, ZH_ESPNOW_TRACE_SEND, slot->attempt, slot->msg_id, message->data_len);
+    slot->is_waiting = (esp_now_send(message->mac_addr, message->data, message->data_len) == ESP_OK);
+    ZH_ERROR_CHECK_VOID(slot->is_waiting == true, _zh_espnow_stats_add(ctx, &ctx->stats.espnow_driver_error, 1); _zh_espnow_tx_retry(ctx, slot), "Outgoing ESP-NOW data processed failed. ESP-NOW driver error.");
+}
+
+static void _zh_espnow_tx_complete(_context_t *ctx, _tx_slot_t *slot, zh_espnow_on_send_event_type_t status)
+{
+    uint8_t mac_addr[ESP_NOW_ETH_ALEN] = {0};
+    memcpy(mac_addr, slot->message->mac_addr, ESP_NOW_ETH_ALEN);
+    uint8_t frame_type = slot->frame_type;
+    uint8_t coalesce = slot->coalesce;
+    uint32_t msg_id = slot->msg_id;
+    int64_t enqueued_at = slot->enqueued_at;
+    uint8_t retries = (slot->attempt > 1) ? slot->attempt - 1 : 0;
+    _zh_espnow_peer_release(mac_addr, status == ZH_ESPNOW_SEND_FAIL);
+    _zh_espnow_pool_free(ctx, slot->message);
+    *slot = (_tx_slot_t){0};
+    if (--ctx->tx_in_flight == 0)
+    {
+        _zh_espnow_radio_off(ctx);
+    }
+    _zh_espnow_tx_finish(ctx, mac_addr, status, frame_type, msg_id, enqueued_at, coalesce, retries);
+}
+
+static void _zh_espnow_tx_drop(_context_t *ctx, zh_espnow_event_on_recv_t *message, uint8_t frame_type, uint32_t msg_id, int64_t enqueued_at, uint8_t coalesce)
+{
+    // A message that never got a window slot or a peer entry still completes exactly once, as a failure.
+    uint8_t mac_addr[ESP_NOW_ETH_ALEN] = {0};
+    memcpy(mac_addr, message->mac_addr, ESP_NOW_ETH_ALEN);
+    _zh_espnow_pool_free(ctx, message);
+    _zh_espnow_tx_finish(ctx, mac_addr, ZH_ESPNOW_SEND_FAIL, frame_type, msg_id, enqueued_at, coalesce, 0);
+}
+
+static void _zh_espnow_tx_finish(_context_t *ctx, const uint8_t *mac_addr, zh_espnow_on_send_event_type_t status, uint8_t frame_type, uint32_t msg_id, int64_t enqueued_at, uint8_t coalesce, uint8_t retries)
+{
+    if (frame_type == FRAME_RELAY && status == ZH_ESPNOW_SEND_FAIL)
+    {
+        _zh_espnow_relay_forget(ctx, mac_addr);
+    }
+    if (frame_type == FRAME_RPC_REQUEST && status == ZH_ESPNOW_SEND_FAIL)
+    {
+        _zh_espnow_rpc_fail(ctx, msg_id);
+    }
+    if (frame_type == FRAME_COALESCED)
+    {
+        for (uint8_t i = 0; i < ctx->coalesce[coalesce].count; ++i)
+        {
+            _zh_espnow_tx_report(ctx, mac_addr, status, ctx->coalesce[coalesce].msg_id[i], ctx->coalesce[coalesce].enqueued_at[i], retries);
+        }
+        _zh_espnow_coalesce_release(ctx, coalesce);
+    }
+    else if (msg_id != 0)
+    {
+        _zh_espnow_tx_report(ctx, mac_addr, status, msg_id, enqueued_at, retries);
+    }
+}
+
+static void _zh_espnow_tx_report(_context_t *ctx, const uint8_t *mac_addr, zh_espnow_on_send_event_type_t status, uint32_t msg_id, int64_t enqueued_at, uint8_t retries)
+{
+    zh_espnow_event_on_send_t on_send = {0};
+    memcpy(on_send.mac_addr, mac_addr, ESP_NOW_ETH_ALEN);
+    on_send.status = status;
+    on_send.msg_id = msg_id;
+    on_send.latency_us = (uint32_t)(esp_timer_get_time() - enqueued_at);
+    portENTER_CRITICAL(&ctx->stats_lock);
+    if (status == ZH_ESPNOW_SEND_SUCCESS)
+    {
+        ++ctx->stats.sent_success;
+    }
+    else
+    {
+        ++ctx->stats.sent_fail;
+    }
+    _zh_espnow_stats_latency(ctx, &ctx->stats.send_latency_avg_us, &ctx->stats.send_latency_max_us, on_send.latency_us);
+    ++ctx->stats.send_latency_hist[_zh_espnow_stats_bucket(on_send.latency_us)];
+    ++ctx->stats.send_retries_hist[(retries < ZH_ESPNOW_HISTOGRAM_SIZE) ? retries : ZH_ESPNOW_HISTOGRAM_SIZE - 1];
+    portEXIT_CRITICAL(&ctx->stats_lock);
+    if (ctx->burst.is_active == true && status == ZH_ESPNOW_SEND_SUCCESS)
+    {
+        ++ctx->burst.sent_success;
+    }
+    else if (ctx->burst.is_active == true)
+    {
+        ++ctx->burst.sent_fail;
+    }
+    const zh_espnow_send_result_t result = {.msg_id = on_send.msg_id, .status = status, .latency_us = on_send.latency_us};
+    _zh_espnow_completion_record(ctx, &result);
+    _zh_espnow_trace(ctx, ZH_ESPNOW_TRACE_POST, ZH_ESPNOW_ON_SEND_EVENT, msg_id, status);
+    ZH_ERROR_CHECK_VOID(esp_event_post(ctx->event_base, ZH_ESPNOW_ON_SEND_EVENT, &on_send, sizeof(zh_espnow_event_on_send_t), 1000 / portTICK_PERIOD_MS) == ESP_OK,
+                        _zh_espnow_stats_add(ctx, &ctx->stats.event_post_error, 1), "Outgoing ESP-NOW data processed failed. Failed to post send event.");
+}
+
+static void _zh_espnow_completion_record(_context_t *ctx, const zh_espnow_send_result_t *result)
+{
+    SemaphoreHandle_t wake = NULL;
+    portENTER_CRITICAL(&ctx->completion_lock);
+    ctx->completions[ctx->completion_head] = *result;
+    ctx->completion_head = (ctx->completion_head + 1) % COMPLETION_RING_SIZE;
+    for (uint8_t i = 0; i < SEND_WAITERS_MAX; ++i)
+    {
+        _send_waiter_t *waiter = &ctx->send_waiters[i];
+        if (waiter->is_used == true && waiter->is_done == false && waiter->msg_id == result->msg_id)
+        {
+            waiter->result = *result;
+            waiter->is_done = true;
+            wake = waiter->wake;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&ctx->completion_lock);
+    if (wake != NULL)
+    {
+        xSemaphoreGive(wake);
+    }
+}
+
+static void _zh_espnow_tx_retry(_context_t *ctx, _tx_slot_t *slot)
+{
+    if (slot->attempt >= slot->max_attempts)
+    {
+        _zh_espnow_tx_complete(ctx, slot, ZH_ESPNOW_SEND_FAIL);
+        return;
+    }
+    uint8_t shift = (slot->attempt > 8) ? 8 : slot->attempt - 1;
+    uint32_t backoff = RETRY_BACKOFF_BASE << shift;
+    backoff = (backoff > RETRY_BACKOFF_MAX) ? RETRY_BACKOFF_MAX : backoff;
+    backoff += esp_random() % (backoff / 2 + 1);
+    slot->is_waiting = false;
+    slot->deadline = xTaskGetTickCount() + pdMS_TO_TICKS(backoff);
+}
+
+static void _zh_espnow_process_confirm(_context_t *ctx, const _confirm_t *confirm)
+{
+    _tx_slot_t *slot = NULL;
+    for (uint8_t i = 0; i < ctx->init_config.tx_window; ++i)
+    {
+        _tx_slot_t *candidate = &ctx->tx_slots[i];
+        if (candidate->message == NULL || candidate->is_waiting == false || memcmp(candidate->message->mac_addr, confirm->mac_addr, ESP_NOW_ETH_ALEN) != 0)
+        {
+            continue;
+        }
+        if (slot == NULL || (int32_t)(candidate->order - slot->order) < 0)
+        {
+            slot = candidate;
+        }
+    }
+    if (slot == NULL)
+    {
+        return;
+    }
+    slot->is_waiting = false;
+    bool is_success = (confirm->status == ESP_NOW_SEND_SUCCESS);
+    _zh_espnow_trace(ctx, ZH_ESPNOW_TRACE_CONFIRM, (is_success == true) ? ZH_ESPNOW_SEND_SUCCESS : ZH_ESPNOW_SEND_FAIL, slot->msg_id, slot->attempt);
+    _zh_espnow_peer_report(slot->message->mac_addr, is_success, (uint32_t)(esp_timer_get_time() - slot->sent_at));
+    if (is_success == true)
+    {
+        _zh_espnow_tx_complete(ctx, slot, ZH_ESPNOW_SEND_SUCCESS);
+    }
+    else
+    {
+        _zh_espnow_tx_retry(ctx, slot);
+    }
+}
+
+static TickType_t _zh_espnow_process_timeouts(_context_t *ctx)
+{
+    TickType_t wait = portMAX_DELAY;
+    for (uint8_t i = 0; i < ctx->init_config.tx_window; ++i)
+    {
+        _tx_slot_t *slot = &ctx->tx_slots[i];
+        if (slot->message == NULL)
+        {
+            continue;
+        }
+        int32_t remaining = (int32_t)(slot->deadline - xTaskGetTickCount());
+        if (remaining <= 0)
+        {
+            if (slot->is_waiting == true)
+            {
+                _zh_espnow_peer_report(slot->message->mac_addr, false, 0);
+                _zh_espnow_tx_retry(ctx, slot);
+            }
+            else
+            {
+                _zh_espnow_tx_transmit(ctx, slot);
+            }
+            if (slot->message == NULL)
+            {
+                continue;
+            }
+            remaining = (int32_t)(slot->deadline - xTaskGetTickCount());
+            remaining = (remaining > 0) ? remaining : 0;
+        }
+        if ((TickType_t)remaining < wait)
+        {
+            wait = (TickType_t)remaining;
+        }
+    }
+    return wait;
+}
+
+static void _zh_espnow_process_recv(_context_t *ctx, _queue_t *queue)
+{
+    zh_espnow_event_on_recv_t *message = queue->message;
+    _zh_espnow_peer_update_recv(message->mac_addr, queue->rssi);
+    switch (queue->frame_type)
+    {
+    case FRAME_BULK_DATA:
+        _zh_espnow_bulk_rx_data(ctx, message, queue->frame_flags);
+        break;
+    case FRAME_BULK_ACK:
+        _zh_espnow_bulk_rx_ack(ctx, message);
+        break;
+    case FRAME_COALESCED:
+        _zh_espnow_recv_split(ctx, queue);
+        _zh_espnow_pool_free(ctx, message);
+        break;
+    case FRAME_RELAY:
+        _zh_espnow_relay_rx(ctx, queue);
+        break;
+    case FRAME_RPC_REQUEST:
+        _zh_espnow_rpc_rx_request(ctx, message);
+        break;
+    case FRAME_RPC_REPLY:
+        _zh_espnow_rpc_rx_reply(ctx, message);
+        break;
+    default:
+        if ((queue->frame_flags & FRAME_FLAG_COMPRESSED) != 0)
+        {
+            message = _zh_espnow_decompress(ctx, message);
+            if (message == NULL)
+            {
+                break;
+            }
+        }
+        _zh_espnow_recv_deliver(ctx, message, queue->rssi, queue->timestamp);
+        break;
+    }
+}
+
+static void _zh_espnow_recv_split(_context_t *ctx, const _queue_t *queue)
+{
+    const zh_espnow_event_on_recv_t *frame = queue->message;
+    uint16_t offset = 0;
+    while (offset < frame->data_len)
+    {
+        uint8_t data_len = frame->data[offset++];
+        if (data_len == 0 || offset + data_len > frame->data_len)
+        {
+            _zh_espnow_stats_add(ctx, &ctx->stats.frame_error, 1);
+            ZH_LOGE("Invalid coalesced frame. Dropping the rest of incoming ESP-NOW data.", ESP_FAIL);
+            break;
+        }
+        const uint8_t *data = frame->data + offset;
+        offset += data_len;
+        if (_zh_espnow_filter_payload(ctx, data, data_len) == false)
+        {
+            _zh_espnow_stats_add(ctx, &ctx->stats.filter_dropped, 1);
+            continue;
+        }
+        zh_espnow_event_on_recv_t *message = _zh_espnow_pool_alloc(ctx, data_len);
+        ZH_ERROR_CHECK_CONT(message != NULL, NULL, "No free block in the message pool for incoming ESP-NOW data.");
+        memcpy(message->mac_addr, frame->mac_addr, ESP_NOW_ETH_ALEN);
+        memcpy(message->data, data, data_len);
+        message->data_len = data_len;
+        _zh_espnow_recv_deliver(ctx, message, queue->rssi, queue->timestamp);
+    }
+}
+
+static void _zh_espnow_recv_deliver(_context_t *ctx, zh_espnow_event_on_recv_t *message, int8_t rssi, int64_t timestamp)
+{
+    _zh_espnow_stats_add(ctx, &ctx->stats.received, 1);
+    portENTER_CRITICAL(&ctx->recv_handler_lock);
+    zh_espnow_recv_handler_t handler = ctx->recv_handler;
+    void *arg = ctx->recv_handler_arg;
+    portEXIT_CRITICAL(&ctx->recv_handler_lock);
+    if (handler != NULL)
+    {
+        zh_espnow_recv_view_t view = {.mac_addr = message->mac_addr, .data = message->data, .data_len = message->data_len, .rssi = rssi};
+        if (handler(&view, arg) == false)
+        {
+            _zh_espnow_pool_free(ctx, message);
+        }
+        _zh_espnow_update_rx_latency(ctx, timestamp);
+        return;
+    }
+    _zh_espnow_trace(ctx, ZH_ESPNOW_TRACE_POST, ZH_ESPNOW_ON_RECV_EVENT, 0, message->data_len);
+    // clang-format off
+    ZH_ERROR_CHECK_VOID(esp_event_post(ctx->event_base, ZH_ESPNOW_ON_RECV_EVENT, message, (sizeof(zh_espnow_event_on_recv_t) + message->data_len), 1000 / portTICK_PERIOD_MS) == ESP_OK,
+                        _zh_espnow_stats_add(ctx, &ctx->stats.event_post_error, 1); _zh_espnow_pool_free(ctx, message), "Incoming ESP-NOW data processing failed. Failed to post event.");
+    // clang-format on
+    _zh_espnow_pool_free(ctx, message);
+    _zh_espnow_update_rx_latency(ctx, timestamp);
+}
+
+static void _zh_espnow_relay_rx(_context_t *ctx, const _queue_t *queue)
+{
+    zh_espnow_event_on_recv_t *message = queue->message;
+    _relay_header_t header = {0};
+    ZH_ERROR_CHECK_VOID(ctx->init_config.relay_ttl > 0, _zh_espnow_pool_free(ctx, message), "Incoming ESP-NOW relay message processing failed. Relay is disabled.");
+    ZH_ERROR_CHECK_VOID(message->data_len > sizeof(_relay_header_t), _zh_espnow_stats_add(ctx, &ctx->stats.frame_error, 1); _zh_espnow_pool_free(ctx, message), "Invalid relay message. Dropping incoming ESP-NOW data.");
+    memcpy(&header, message->data, sizeof(_relay_header_t));
+    if (memcmp(header.origin, ctx->own_mac, ESP_NOW_ETH_ALEN) == 0 || _zh_espnow_relay_seen(ctx, header.origin, header.seq) == true)
+    {
+        _zh_espnow_stats_add(ctx, &ctx->stats.relay_seen_dropped, 1);
+        _zh_espnow_pool_free(ctx, message);
+        return;
+    }
+    _zh_espnow_relay_learn(ctx, header.origin, message->mac_addr, header.hops + 1);
+    const uint8_t *data = message->data + sizeof(_relay_header_t);
+    uint16_t data_len = message->data_len - sizeof(_relay_header_t);
+    bool is_broadcast = (memcmp(header.destination, _broadcast_mac, ESP_NOW_ETH_ALEN) == 0);
+    bool is_own = (memcmp(header.destination, ctx->own_mac, ESP_NOW_ETH_ALEN) == 0);
+    if (is_own == false && header.ttl > 1)
+    {
+        _zh_espnow_relay_forward(ctx, &header, message->mac_addr, data, data_len);
+    }
+    else if (is_own == false && is_broadcast == false)
+    {
+        _zh_espnow_stats_add(ctx, &ctx->stats.relay_ttl_expired, 1);
+    }
+    if (is_own == false && is_broadcast == false)
+    {
+        _zh_espnow_pool_free(ctx, message);
+        return;
+    }
+    if (_zh_espnow_filter_payload(ctx, data, data_len) == false)
+    {
+        _zh_espnow_stats_add(ctx, &ctx->stats.filter_dropped, 1);
+        _zh_espnow_pool_free(ctx, message);
+        return;
+    }
+    _zh_espnow_stats_add(ctx, &ctx->stats.relay_hops_hist[(header.hops < ZH_ESPNOW_HISTOGRAM_SIZE) ? header.hops : ZH_ESPNOW_HISTOGRAM_SIZE - 1], 1);
+    memmove(message->data, data, data_len);
+    memcpy(message->mac_addr, header.origin, ESP_NOW_ETH_ALEN);
+    message->data_len = data_len;
+    _zh_espnow_recv_deliver(ctx, message, queue->rssi, queue->timestamp);
+}
+
+static void _zh_espnow_relay_forward(_context_t *ctx, const _relay_header_t *header, const uint8_t *neighbour, const uint8_t *data, uint16_t data_len)
+{
+    _relay_header_t forward = *header;
+    --forward.ttl;
+    ++forward.hops;
+    uint8_t next_hop[ESP_NOW_ETH_ALEN] = {0};
+    _zh_espnow_relay_next_hop(ctx, forward.destination, next_hop);
+    // Sending a message back to the neighbour it came from only makes sense as part of a flood.
+    if (memcmp(next_hop, neighbour, ESP_NOW_ETH_ALEN) == 0)
+    {
+        memcpy(next_hop, _broadcast_mac, ESP_NOW_ETH_ALEN);
+    }
+    const zh_espnow_iovec_t iov[] = {{.data = &forward, .data_len = sizeof(_relay_header_t)}, {.data = data, .data_len = data_len}};
+    xSemaphoreTake(ctx->tx_mutex, portMAX_DELAY);
+    bool has_space = _zh_espnow_tx_has_space(ctx, ZH_ESPNOW_PRIORITY_NORMAL);
+    esp_err_t err = (has_space == true) ? _zh_espnow_tx_enqueue(ctx, next_hop, FRAME_RELAY, 0, ZH_ESPNOW_PRIORITY_NORMAL, iov, 2, 0, NULL) : ESP_ERR_INVALID_STATE;
+    xSemaphoreGive(ctx->tx_mutex);
+    ZH_ERROR_CHECK_VOID(has_space == true, _zh_espnow_stats_add(ctx, &ctx->stats.queue_overflow_error, 1), "Incoming ESP-NOW relay message processing failed. Queue is almost full.");
+    ZH_ERROR_CHECK_VOID(err == ESP_OK, NULL, "Incoming ESP-NOW relay message processing failed. Failed to queue forwarded message.");
+    _zh_espnow_stats_add(ctx, &ctx->stats.relay_forwarded, 1);
+    xTaskNotifyGive(ctx->task);
+}
+
+static bool _zh_espnow_relay_seen(_context_t *ctx, const uint8_t *origin, uint16_t seq)
+{
+    for (uint8_t i = 0; i < RELAY_SEEN_SIZE; ++i)
+    {
+        const _relay_seen_t *entry = &ctx->relay_seen[i];
+        if (entry->is_used == true && entry->seq == seq && memcmp(entry->origin, origin, ESP_NOW_ETH_ALEN) == 0)
+        {
+            return true;
+        }
+    }
+    _relay_seen_t *entry = &ctx->relay_seen[ctx->relay_seen_head];
+    memcpy(entry->origin, origin, ESP_NOW_ETH_ALEN);
+    entry->seq = seq;
+    entry->is_used = true;
+    ctx->relay_seen_head = (ctx->relay_seen_head + 1) % RELAY_SEEN_SIZE;
+    return false;
+}
+
+static void _zh_espnow_relay_learn(_context_t *ctx, const uint8_t *destination, const uint8_t *neighbour, uint8_t hops)
+{
+    TickType_t now = xTaskGetTickCount();
+    portENTER_CRITICAL(&ctx->relay_lock);
+    _relay_route_t *route = NULL;
+    _relay_route_t *victim = NULL;
+    for (uint8_t i = 0; i < RELAY_ROUTES_MAX && route == NULL; ++i)
+    {
+        _relay_route_t *candidate = &ctx->relay_routes[i];
+        if (candidate->is_used == false)
+        {
+            victim = (victim != NULL && victim->is_used == false) ? victim : candidate;
+        }
+        else if (memcmp(candidate->destination, destination, ESP_NOW_ETH_ALEN) == 0)
+        {
+            route = candidate;
+        }
+        else if (victim == NULL || (victim->is_used == true && (int32_t)(candidate->updated_at - victim->updated_at) < 0))
+        {
+            victim = candidate;
+        }
+    }
+    // A longer path replaces the known one only once the known one has not been confirmed for a while.
+    bool is_stale = (route != NULL && now - route->updated_at >= pdMS_TO_TICKS(RELAY_ROUTE_TIMEOUT));
+    if (route == NULL || is_stale == true || hops <= route->hops || memcmp(route->next_hop, neighbour, ESP_NOW_ETH_ALEN) == 0)
+    {
+        route = (route != NULL) ? route : victim;
+        memcpy(route->destination, destination, ESP_NOW_ETH_ALEN);
+        memcpy(route->next_hop, neighbour, ESP_NOW_ETH_ALEN);
+        route->hops = hops;
+        route->is_used = true;
+        route->updated_at = now;
+    }
+    portEXIT_CRITICAL(&ctx->relay_lock);
+}
+
+static void _zh_espnow_relay_forget(_context_t *ctx, const uint8_t *next_hop)
+{
+    portENTER_CRITICAL(&ctx->relay_lock);
+    for (uint8_t i = 0; i < RELAY_ROUTES_MAX; ++i)
+    {
+        if (ctx->relay_routes[i].is_used == true && memcmp(ctx->relay_routes[i].next_hop, next_hop, ESP_NOW_ETH_ALEN) == 0)
+        {
+            ctx->relay_routes[i].is_used = false;
+        }
+    }
+    portEXIT_CRITICAL(&ctx->relay_lock);
+}
+
+static void _zh_espnow_relay_next_hop(_context_t *ctx, const uint8_t *destination, uint8_t *next_hop)
+{
+    memcpy(next_hop, _broadcast_mac, ESP_NOW_ETH_ALEN);
+    TickType_t now = xTaskGetTickCount();
+    portENTER_CRITICAL(&ctx->relay_lock);
+    for (uint8_t i = 0; i < RELAY_ROUTES_MAX; ++i)
+    {
+        const _relay_route_t *route = &ctx->relay_routes[i];
+        if (route->is_used == true && memcmp(route->destination, destination, ESP_NOW_ETH_ALEN) == 0 && now - route->updated_at < pdMS_TO_TICKS(RELAY_ROUTE_TIMEOUT))
+        {
+            memcpy(next_hop, route->next_hop, ESP_NOW_ETH_ALEN);
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&ctx->relay_lock);
+}
+
+static esp_err_t _zh_espnow_rpc_start(_context_t *ctx, const uint8_t *target, const uint8_t *data, uint16_t data_len, TickType_t timeout, zh_espnow_rpc_callback_t callback, void *arg, _rpc_call_t **call, uint16_t *call_id)
+{
+    ZH_ERROR_CHECK(ctx->is_initialized == true, ESP_ERR_NOT_FOUND, NULL, "RPC call start failed. ESP-NOW is not initialized.");
+    ZH_ERROR_CHECK(ctx->rpc_calls != NULL, ESP_ERR_NOT_SUPPORTED, NULL, "RPC call start failed. RPC calls are disabled.");
+    ZH_ERROR_CHECK(data != NULL && data_len > 0 && data_len + sizeof(_rpc_header_t) <= _zh_espnow_max_payload(ctx) && timeout > 0 && timeout != portMAX_DELAY, ESP_ERR_INVALID_ARG, NULL, "RPC call start failed. Invalid argument.");
+    target = (target == NULL) ? _broadcast_mac : target;
+    _rpc_call_t *entry = NULL;
+    uint16_t id = 0;
+    portENTER_CRITICAL(&ctx->rpc_lock);
+    for (uint8_t i = 0; i < ctx->init_config.rpc_pending_size && entry == NULL; ++i)
+    {
+        entry = (ctx->rpc_calls[i].state == RPC_FREE) ? &ctx->rpc_calls[i] : NULL;
+    }
+    if (entry != NULL)
+    {
+        do
+        {
+            id = ++ctx->rpc_id;
+        } while (id == 0 || _zh_espnow_rpc_find(ctx, id, NULL, 0) != NULL);
+        *entry = (_rpc_call_t){.state = RPC_PENDING, .call_id = id, .deadline = xTaskGetTickCount() + timeout, .sent_at = esp_timer_get_time(), .callback = callback, .arg = arg};
+        entry->is_blocking = (callback == NULL);
+        memcpy(entry->mac_addr, target, ESP_NOW_ETH_ALEN);
+    }
+    portEXIT_CRITICAL(&ctx->rpc_lock);
+    ZH_ERROR_CHECK(entry != NULL, ESP_ERR_NO_MEM, NULL, "RPC call start failed. Too many pending calls.");
+    uint32_t msg_id = 0;
+    esp_err_t err = _zh_espnow_rpc_send(ctx, target, FRAME_RPC_REQUEST, id, data, data_len, &msg_id);
+    portENTER_CRITICAL(&ctx->rpc_lock);
+    // A failure confirmation arriving before the identifier is stored leaves the call to its deadline.
+    if (entry->state == RPC_PENDING && entry->call_id == id)
+    {
+        if (err == ESP_OK)
+        {
+            entry->msg_id = msg_id;
+        }
+        else
+        {
+            *entry = (_rpc_call_t){0};
+        }
+    }
+    portEXIT_CRITICAL(&ctx->rpc_lock);
+    ZH_ERROR_CHECK(err == ESP_OK, err, NULL, "RPC call start failed. Failed to queue the request.");
+    _zh_espnow_stats_add(ctx, &ctx->stats.rpc_calls, 1);
+    if (call != NULL)
+    {
+        *call = entry;
+    }
+    if (call_id != NULL)
+    {
+        *call_id = id;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t _zh_espnow_rpc_send(_context_t *ctx, const uint8_t *target, uint8_t frame_type, uint16_t call_id, const uint8_t *data, uint16_t data_len, uint32_t *msg_id)
+{
+    const _rpc_header_t header = {.call_id = call_id};
+    const zh_espnow_iovec_t iov[] = {{.data = &header, .data_len = sizeof(_rpc_header_t)}, {.data = data, .data_len = data_len}};
+    // Returns with the transmit mutex taken.
+    bool has_space = _zh_espnow_tx_wait_space(ctx, ZH_ESPNOW_PRIORITY_NORMAL, 0);
+    esp_err_t err = (has_space == true) ? _zh_espnow_tx_enqueue(ctx, target, frame_type, 0, ZH_ESPNOW_PRIORITY_NORMAL, iov, (data_len > 0) ? 2 : 1, 0, msg_id) : ESP_ERR_INVALID_STATE;
+    xSemaphoreGive(ctx->tx_mutex);
+    if (has_space == false)
+    {
+        _zh_espnow_stats_add(ctx, &ctx->stats.queue_overflow_error, 1);
+    }
+    if (err == ESP_OK)
+    {
+        xTaskNotifyGive(ctx->task);
+    }
+    return err;
+}
+
+static _rpc_call_t *_zh_espnow_rpc_find(_context_t *ctx, uint16_t call_id, const uint8_t *mac_addr, uint32_t msg_id)
+{
+    for (uint8_t i = 0; i < ctx->init_config.rpc_pending_size; ++i)
+    {
+        _rpc_call_t *call = &ctx->rpc_calls[i];
+        if (call->state == RPC_FREE)
+        {
+            continue;
+        }
+        if (msg_id != 0)
+        {
+            if (call->msg_id == msg_id)
+            {
+                return call;
+            }
+            continue;
+        }
+        if (call->call_id == call_id && (mac_addr == NULL || memcmp(call->mac_addr, _broadcast_mac, ESP_NOW_ETH_ALEN) == 0 || memcmp(call->mac_addr, mac_addr, ESP_NOW_ETH_ALEN) == 0))
+        {
+            return call;
+        }
+    }
+    return NULL;
+}
+
+static void _zh_espnow_rpc_recent_add(_context_t *ctx, uint16_t call_id, bool is_replied)
+{
+    ctx->rpc_recent[ctx->rpc_recent_head] = (_rpc_recent_t){.call_id = call_id, .is_replied = is_replied};
+    ctx->rpc_recent_head = (ctx->rpc_recent_head + 1) % RPC_RECENT_SIZE;
+}
+
+static bool _zh_espnow_rpc_recent_replied(_context_t *ctx, uint16_t call_id)
+{
+    for (uint8_t i = 0; i < RPC_RECENT_SIZE; ++i)
+    {
+        if (ctx->rpc_recent[i].call_id == call_id)
+        {
+            return ctx->rpc_recent[i].is_replied;
+        }
+    }
+    return false;
+}
+
+static void _zh_espnow_rpc_rx_request(_context_t *ctx, zh_espnow_event_on_recv_t *message)
+{
+    ZH_ERROR_CHECK_VOID(message->data_len >= sizeof(_rpc_header_t), _zh_espnow_stats_add(ctx, &ctx->stats.frame_error, 1); _zh_espnow_pool_free(ctx, message), "Invalid RPC request. Dropping incoming ESP-NOW data.");
+    _zh_espnow_stats_add(ctx, &ctx->stats.rpc_requests, 1);
+    // The call header sits where the event data keeps `call_id`, so the block is posted as it is.
+    zh_espnow_event_on_rpc_request_t *request = (zh_espnow_event_on_rpc_request_t *)message;
+    request->data_len = message->data_len - sizeof(_rpc_header_t);
+    _zh_espnow_trace(ctx, ZH_ESPNOW_TRACE_POST, ZH_ESPNOW_ON_RPC_REQUEST_EVENT, 0, request->data_len);
+    // clang-format off
+    ZH_ERROR_CHECK_VOID(esp_event_post(ctx->event_base, ZH_ESPNOW_ON_RPC_REQUEST_EVENT, request, sizeof(zh_espnow_event_on_rpc_request_t) + request->data_len, 1000 / portTICK_PERIOD_MS) == ESP_OK,
+                        _zh_espnow_stats_add(ctx, &ctx->stats.event_post_error, 1); _zh_espnow_pool_free(ctx, message), "Incoming ESP-NOW RPC request processing failed. Failed to post event.");
+    // clang-format on
+    _zh_espnow_pool_free(ctx, message);
+}
+
+static void _zh_espnow_rpc_rx_reply(_context_t *ctx, zh_espnow_event_on_recv_t *message)
+{
+    ZH_ERROR_CHECK_VOID(message->data_len >= sizeof(_rpc_header_t), _zh_espnow_stats_add(ctx, &ctx->stats.frame_error, 1); _zh_espnow_pool_free(ctx, message), "Invalid RPC reply. Dropping incoming ESP-NOW data.");
+    _rpc_header_t header = {0};
+    memcpy(&header, message->data, sizeof(_rpc_header_t));
+    message->data_len -= sizeof(_rpc_header_t);
+    memmove(message->data, message->data + sizeof(_rpc_header_t), message->data_len);
+    bool is_matched = false;
+    bool is_duplicate = false;
+    uint32_t latency_us = 0;
+    SemaphoreHandle_t wake = NULL;
+    _rpc_call_t done = {0};
+    portENTER_CRITICAL(&ctx->rpc_lock);
+    _rpc_call_t *call = (ctx->rpc_calls != NULL) ? _zh_espnow_rpc_find(ctx, header.call_id, message->mac_addr, 0) : NULL;
+    if (call != NULL && call->state == RPC_PENDING)
+    {
+        is_matched = true;
+        latency_us = (uint32_t)(esp_timer_get_time() - call->sent_at);
+        _zh_espnow_rpc_recent_add(ctx, call->call_id, true);
+        if (call->is_blocking == true)
+        {
+            call->state = RPC_DONE;
+            call->status = ESP_OK;
+            call->reply = message;
+            call->latency_us = latency_us;
+            wake = ctx->rpc_wake[call - ctx->rpc_calls];
+        }
+        else
+        {
+            done = *call;
+            *call = (_rpc_call_t){0};
+        }
+    }
+    else
+    {
+        is_duplicate = (call != NULL || _zh_espnow_rpc_recent_replied(ctx, header.call_id) == true);
+    }
+    portEXIT_CRITICAL(&ctx->rpc_lock);
+    if (is_matched == false)
+    {
+        _zh_espnow_stats_add(ctx, (is_duplicate == true) ? &ctx->stats.rpc_duplicate_replies : &ctx->stats.rpc_late_replies, 1);
+        _zh_espnow_pool_free(ctx, message);
+        return;
+    }
+    _zh_espnow_stats_add(ctx, &ctx->stats.rpc_replies, 1);
+    _zh_espnow_stats_add(ctx, &ctx->stats.rpc_latency_hist[_zh_espnow_stats_bucket(latency_us)], 1);
+    if (wake != NULL)
+    {
+        xSemaphoreGive(wake);
+        return;
+    }
+    zh_espnow_rpc_result_t result = {.call_id = done.call_id, .status = ESP_OK, .data = message->data, .data_len = message->data_len, .latency_us = latency_us};
+    memcpy(result.mac_addr, message->mac_addr, ESP_NOW_ETH_ALEN);
+    done.callback(&result, done.arg);
+    _zh_espnow_pool_free(ctx, message);
+}
+
+static void _zh_espnow_rpc_fail(_context_t *ctx, uint32_t msg_id)
+{
+    if (ctx->rpc_calls == NULL || msg_id == 0)
+    {
+        return;
+    }
+    bool is_found = false;
+    SemaphoreHandle_t wake = NULL;
+    _rpc_call_t done = {0};
+    portENTER_CRITICAL(&ctx->rpc_lock);
+    _rpc_call_t *call = _zh_espnow_rpc_find(ctx, 0, NULL, msg_id);
+    if (call != NULL && call->state == RPC_PENDING)
+    {
+        is_found = true;
+        _zh_espnow_rpc_recent_add(ctx, call->call_id, false);
+        if (call->is_blocking == true)
+        {
+            call->state = RPC_DONE;
+            call->status = ESP_FAIL;
+            wake = ctx->rpc_wake[call - ctx->rpc_calls];
+        }
+        else
+        {
+            done = *call;
+            *call = (_rpc_call_t){0};
+        }
+    }
+    portEXIT_CRITICAL(&ctx->rpc_lock);
+    if (is_found == false)
+    {
+        return;
+    }
+    _zh_espnow_stats_add(ctx, &ctx->stats.rpc_failed, 1);
+    if (wake != NULL)
+    {
+        xSemaphoreGive(wake);
+        return;
+    }
+    zh_espnow_rpc_result_t result = {.call_id = done.call_id, .status = ESP_FAIL, .latency_us = (uint32_t)(esp_timer_get_time() - done.sent_at)};
+    memcpy(result.mac_addr, done.mac_addr, ESP_NOW_ETH_ALEN);
+    done.callback(&result, done.arg);
+}
+
+static TickType_t _zh_espnow_rpc_expire(_context_t *ctx)
+{
+    TickType_t wait = portMAX_DELAY;
+    for (uint8_t i = 0; ctx->rpc_calls != NULL && i < ctx->init_config.rpc_pending_size; ++i)
+    {
+        _rpc_call_t done = {0};
+        portENTER_CRITICAL(&ctx->rpc_lock);
+        _rpc_call_t *call = &ctx->rpc_calls[i];
+        // Blocking calls time out in the waiting task.
+        if (call->state == RPC_PENDING && call->is_blocking == false)
+        {
+            int32_t remaining = (int32_t)(call->deadline - xTaskGetTickCount());
+            if (remaining <= 0)
+            {
+                done = *call;
+                _zh_espnow_rpc_recent_add(ctx, call->call_id, false);
+                *call = (_rpc_call_t){0};
+            }
+            else if ((TickType_t)remaining < wait)
+            {
+                wait = (TickType_t)remaining;
+            }
+        }
+        portEXIT_CRITICAL(&ctx->rpc_lock);
+        if (done.callback != NULL)
+        {
+            _zh_espnow_stats_add(ctx, &ctx->stats.rpc_timeouts, 1);
+            zh_espnow_rpc_result_t result = {.call_id = done.call_id, .status = ESP_ERR_TIMEOUT, .latency_us = (uint32_t)(esp_timer_get_time() - done.sent_at)};
+            memcpy(result.mac_addr, done.mac_addr, ESP_NOW_ETH_ALEN);
+            done.callback(&result, done.arg);
+        }
+    }
+    return wait;
+}
+
+static void _zh_espnow_update_rx_latency(_context_t *ctx, int64_t timestamp)
+{
+    uint32_t latency = (uint32_t)(esp_timer_get_time() - timestamp);
+    portENTER_CRITICAL(&ctx->stats_lock);
+    _zh_espnow_stats_latency(ctx, &ctx->stats.rx_latency_avg_us, &ctx->stats.rx_latency_max_us, latency);
+    portEXIT_CRITICAL(&ctx->stats_lock);
+}
+
+static esp_err_t _zh_espnow_bulk_start(_context_t *ctx, const uint8_t *target, uint32_t data_len, zh_espnow_bulk_source_t source, void *arg, uint16_t *transfer_id)
+{
+    ZH_ERROR_CHECK(ctx->is_initialized == true, ESP_ERR_NOT_FOUND, NULL, "Bulk transfer start failed. ESP-NOW is not initialized.");
+    ZH_ERROR_CHECK(ctx->init_config.frame_header == true && ctx->init_config.battery_mode == false, ESP_ERR_NOT_SUPPORTED, NULL, "Bulk transfer start failed. Frame header is disabled or battery mode is enabled.");
+    ZH_ERROR_CHECK(target != NULL && memcmp(target, _broadcast_mac, ESP_NOW_ETH_ALEN) != 0 && source != NULL && data_len > 0 && (data_len - 1) / ctx->init_config.bulk_fragment_size < UINT16_MAX,
+                   ESP_ERR_INVALID_ARG, NULL, "Bulk transfer start failed. Invalid argument.");
+    bool is_busy = false;
+    uint16_t id = 0;
+    portENTER_CRITICAL(&ctx->bulk_lock);
+    is_busy = ctx->bulk_tx.is_active;
+    if (is_busy == false)
+    {
+        ctx->bulk_tx = (_bulk_tx_t){0};
+        memcpy(ctx->bulk_tx.mac_addr, target, ESP_NOW_ETH_ALEN);
+        ctx->bulk_tx.transfer_id = id = ++ctx->bulk_tx_id;
+        ctx->bulk_tx.total_len = data_len;
+        ctx->bulk_tx.fragment_num = (uint16_t)((data_len - 1) / ctx->init_config.bulk_fragment_size + 1);
+        ctx->bulk_tx.source = source;
+        ctx->bulk_tx.arg = arg;
+        ctx->bulk_tx.start_time = esp_timer_get_time();
+        ctx->bulk_tx.deadline = _zh_espnow_bulk_deadline(ctx);
+        ctx->bulk_tx_has_ack = false;
+        ctx->bulk_tx.is_active = true;
+    }
+    portEXIT_CRITICAL(&ctx->bulk_lock);
+    ZH_ERROR_CHECK(is_busy == false, ESP_ERR_INVALID_STATE, NULL, "Bulk transfer start failed. Another transfer is in progress.");
+    if (transfer_id != NULL)
+    {
+        *transfer_id = id;
+    }
+    xTaskNotifyGive(ctx->task);
+    return ESP_OK;
+}
+
+static esp_err_t _zh_espnow_bulk_buffer_source(uint32_t offset, uint8_t *buffer, uint16_t length, void *arg)
+{
+    memcpy(buffer, (const uint8_t *)arg + offset, length);
+    return ESP_OK;
+}
+
+static TickType_t _zh_espnow_bulk_tx_process(_context_t *ctx)
+{
+    _bulk_tx_t *bulk = &ctx->bulk_tx;
+    portENTER_CRITICAL(&ctx->bulk_lock);
+    bool is_active = bulk->is_active;
+    bool has_ack = ctx->bulk_tx_has_ack;
+    _bulk_ack_t ack = ctx->bulk_tx_ack;
+    ctx->bulk_tx_has_ack = false;
+    portEXIT_CRITICAL(&ctx->bulk_lock);
+    if (is_active == false)
+    {
+        return portMAX_DELAY;
+    }
+    if (has_ack == true)
+    {
+        _zh_espnow_bulk_tx_apply_ack(ctx, &ack);
+        if (bulk->is_active == false)
+        {
+            return portMAX_DELAY;
+        }
+    }
+    if ((int32_t)(bulk->deadline - xTaskGetTickCount()) <= 0)
+    {
+        if (++bulk->timeouts > BULK_MAX_TIMEOUTS)
+        {
+            ZH_LOGE("Outgoing ESP-NOW bulk transfer failed. No acknowledgement from the peer.", ESP_ERR_TIMEOUT);
+            _zh_espnow_bulk_tx_complete(ctx, ZH_ESPNOW_BULK_FAIL);
+            return portMAX_DELAY;
+        }
+        bulk->sent = bulk->acked;
+        bulk->deadline = _zh_espnow_bulk_deadline(ctx);
+    }
+    for (uint8_t i = 0; i < ctx->init_config.bulk_window && bulk->base + i < bulk->fragment_num && ctx->tx_in_flight < _zh_espnow_tx_limit(ctx, ZH_ESPNOW_PRIORITY_BULK); ++i)
+    {
+        uint32_t bit = 1UL << i;
+        if (((bulk->acked | bulk->sent) & bit) != 0)
+        {
+            continue;
+        }
+        esp_err_t err = _zh_espnow_bulk_tx_fragment(ctx, bulk->base + i);
+        if (err == ESP_ERR_NO_MEM)
+        {
+            break;
+        }
+        if (err != ESP_OK)
+        {
+            _zh_espnow_bulk_tx_complete(ctx, ZH_ESPNOW_BULK_FAIL);
+            return portMAX_DELAY;
+        }
+        bulk->sent |= bit;
+    }
+    if ((bulk->sent & ~bulk->acked) == 0)
+    {
+        return pdMS_TO_TICKS(WAIT_CONFIRM_MAX_TIME);
+    }
+    int32_t remaining = (int32_t)(bulk->deadline - xTaskGetTickCount());
+    return (remaining > 0) ? (TickType_t)remaining : 0;
+}
+
+static esp_err_t _zh_espnow_bulk_tx_fragment(_context_t *ctx, uint16_t index)
+{
+    _bulk_tx_t *bulk = &ctx->bulk_tx;
+    uint32_t offset = (uint32_t)index * ctx->init_config.bulk_fragment_size;
+    uint16_t length = (bulk->total_len - offset < ctx->init_config.bulk_fragment_size) ? (uint16_t)(bulk->total_len - offset) : ctx->init_config.bulk_fragment_size;
+    bool is_retransmit = (index < bulk->next);
+    zh_espnow_event_on_recv_t *message = _zh_espnow_pool_alloc(ctx, ZH_ESPNOW_BULK_OVERHEAD + length);
+    if (message == NULL)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    memcpy(message->mac_addr, bulk->mac_addr, ESP_NOW_ETH_ALEN);
+    message->data_len = ZH_ESPNOW_BULK_OVERHEAD + length;
+    _frame_header_t *header = (_frame_header_t *)message->data;
+    header->type = FRAME_BULK_DATA;
+    header->flags = (is_retransmit == true || index == bulk->base + ctx->init_config.bulk_window - 1 || index == bulk->fragment_num - 1) ? FRAME_FLAG_ACK_REQUEST : 0;
+    _bulk_data_t *fragment = (_bulk_data_t *)(message->data + sizeof(_frame_header_t));
+    fragment->transfer_id = bulk->transfer_id;
+    fragment->index = index;
+    fragment->fragment_size = ctx->init_config.bulk_fragment_size;
+    fragment->total_len = bulk->total_len;
+    ZH_ERROR_CHECK(bulk->source(offset, message->data + ZH_ESPNOW_BULK_OVERHEAD, length, bulk->arg) == ESP_OK, ESP_FAIL, _zh_espnow_pool_free(ctx, message), "Outgoing ESP-NOW bulk transfer failed. Data source error.");
+    if (_zh_espnow_tx_start(ctx, message, FRAME_BULK_DATA, 0, esp_timer_get_time(), COALESCE_NONE) != ESP_OK)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    if (is_retransmit == true)
+    {
+        _zh_espnow_stats_add(ctx, &ctx->stats.bulk_retransmits, 1);
+    }
+    else
+    {
+        bulk->next = index + 1;
+    }
+    bulk->deadline = _zh_espnow_bulk_deadline(ctx);
+    return ESP_OK;
+}
+
+static void _zh_espnow_bulk_tx_apply_ack(_context_t *ctx, const _bulk_ack_t *ack)
+{
+    _bulk_tx_t *bulk = &ctx->bulk_tx;
+    if (ack->status != BULK_ACK_OK)
+    {
+        ZH_LOGE("Outgoing ESP-NOW bulk transfer failed. Transfer refused by the peer.", ESP_ERR_INVALID_RESPONSE);
+        _zh_espnow_bulk_tx_complete(ctx, ZH_ESPNOW_BULK_FAIL);
+        return;
+    }
+    if (ack->base < bulk->base || ack->base > bulk->fragment_num)
+    {
+        return;
+    }
+    uint16_t shift = ack->base - bulk->base;
+    if (shift > 0)
+    {
+        bulk->acked = (shift < BULK_WINDOW_MAX) ? bulk->acked >> shift : 0;
+        bulk->sent = (shift < BULK_WINDOW_MAX) ? bulk->sent >> shift : 0;
+        bulk->base = ack->base;
+        bulk->timeouts = 0;
+    }
+    bulk->acked |= ack->bitmap;
+    bulk->sent |= ack->bitmap;
+    if (bulk->acked != 0)
+    {
+        // Frames to a peer are delivered in order, so a gap below the highest acknowledged fragment means a loss.
+        uint32_t below = (1UL << (31 - __builtin_clz(bulk->acked))) - 1;
+        bulk->sent &= ~(below & ~bulk->acked);
+    }
+    bulk->deadline = _zh_espnow_bulk_deadline(ctx);
+    if (bulk->base == bulk->fragment_num)
+    {
+        _zh_espnow_bulk_tx_complete(ctx, ZH_ESPNOW_BULK_SUCCESS);
+    }
+    else if (shift > 0)
+    {
+        _zh_espnow_bulk_tx_event(ctx, ZH_ESPNOW_BULK_IN_PROGRESS);
+    }
+}
+
+static void _zh_espnow_bulk_tx_complete(_context_t *ctx, zh_espnow_bulk_status_t status)
+{
+    if (status == ZH_ESPNOW_BULK_SUCCESS)
+    {
+        uint32_t throughput = _zh_espnow_bulk_throughput(ctx->bulk_tx.total_len, ctx->bulk_tx.start_time);
+        portENTER_CRITICAL(&ctx->stats_lock);
+        ctx->stats.bulk_tx_bytes += ctx->bulk_tx.total_len;
+        ctx->stats.bulk_tx_throughput = throughput;
+        portEXIT_CRITICAL(&ctx->stats_lock);
+    }
+    portENTER_CRITICAL(&ctx->bulk_lock);
+    ctx->bulk_tx.is_active = false;
+    ctx->bulk_tx_has_ack = false;
+    portEXIT_CRITICAL(&ctx->bulk_lock);
+    _zh_espnow_bulk_tx_event(ctx, status);
+}
+
+static void _zh_espnow_bulk_tx_event(_context_t *ctx, zh_espnow_bulk_status_t status)
+{
+    zh_espnow_event_on_bulk_t on_bulk = {0};
+    memcpy(on_bulk.mac_addr, ctx->bulk_tx.mac_addr, ESP_NOW_ETH_ALEN);
+    on_bulk.transfer_id = ctx->bulk_tx.transfer_id;
+    on_bulk.direction = ZH_ESPNOW_BULK_TX;
+    on_bulk.status = status;
+    on_bulk.total_len = ctx->bulk_tx.total_len;
+    uint32_t done_len = (uint32_t)ctx->bulk_tx.base * ctx->init_config.bulk_fragment_size;
+    on_bulk.done_len = (done_len < ctx->bulk_tx.total_len) ? done_len : ctx->bulk_tx.total_len;
+    bool is_progress = (status == ZH_ESPNOW_BULK_IN_PROGRESS);
+    ZH_ERROR_CHECK_VOID(esp_event_post(ctx->event_base, (is_progress == true) ? ZH_ESPNOW_ON_BULK_PROGRESS_EVENT : ZH_ESPNOW_ON_BULK_COMPLETE_EVENT, &on_bulk, sizeof(zh_espnow_event_on_bulk_t), (is_progress == true) ? 0 : 1000 / portTICK_PERIOD_MS) == ESP_OK,
+                        _zh_espnow_stats_add(ctx, &ctx->stats.event_post_error, 1), "Outgoing ESP-NOW bulk transfer processing failed. Failed to post bulk event.");
+}
+
+static void _zh_espnow_bulk_rx_ack(_context_t *ctx, zh_espnow_event_on_recv_t *message)
+{
+    ZH_ERROR_CHECK_VOID(message->data_len == sizeof(_bulk_ack_t), _zh_espnow_stats_add(ctx, &ctx->stats.frame_error, 1); _zh_espnow_pool_free(ctx, message), "Incoming ESP-NOW bulk acknowledgement processing failed. Invalid length.");
+    _bulk_ack_t ack = {0};
+    memcpy(&ack, message->data, sizeof(_bulk_ack_t));
+    portENTER_CRITICAL(&ctx->bulk_lock);
+    bool is_match = (ctx->bulk_tx.is_active == true && ctx->bulk_tx.transfer_id == ack.transfer_id && memcmp(ctx->bulk_tx.mac_addr, message->mac_addr, ESP_NOW_ETH_ALEN) == 0);
+    if (is_match == true && (ctx->bulk_tx_has_ack == false || ctx->bulk_tx_ack.status == BULK_ACK_OK))
+    {
+        if (ctx->bulk_tx_has_ack == true && ack.status == BULK_ACK_OK && ack.base == ctx->bulk_tx_ack.base)
+        {
+            ack.bitmap |= ctx->bulk_tx_ack.bitmap;
+        }
+        if (ctx->bulk_tx_has_ack == false || ack.status != BULK_ACK_OK || ack.base >= ctx->bulk_tx_ack.base)
+        {
+            ctx->bulk_tx_ack = ack;
+            ctx->bulk_tx_has_ack = true;
+        }
+    }
+    portEXIT_CRITICAL(&ctx->bulk_lock);
+    _zh_espnow_pool_free(ctx, message);
+    if (is_match == true)
+    {
+        xTaskNotifyGive(ctx->task);
+    }
+}
+
+static void _zh_espnow_bulk_rx_data(_context_t *ctx, zh_espnow_event_on_recv_t *message, uint8_t flags)
+{
+    _bulk_rx_t *bulk = &ctx->bulk_rx;
+    ZH_ERROR_CHECK_VOID(message->data_len > sizeof(_bulk_data_t), _zh_espnow_stats_add(ctx, &ctx->stats.frame_error, 1); _zh_espnow_pool_free(ctx, message), "Incoming ESP-NOW bulk fragment processing failed. Invalid length.");
+    _bulk_data_t fragment = {0};
+    memcpy(&fragment, message->data, sizeof(_bulk_data_t));
+    uint16_t length = message->data_len - sizeof(_bulk_data_t);
+    bool is_current = (bulk->is_active == true && bulk->transfer_id == fragment.transfer_id && memcmp(bulk->mac_addr, message->mac_addr, ESP_NOW_ETH_ALEN) == 0);
+    if (is_current == false && _zh_espnow_bulk_rx_start(ctx, message->mac_addr, &fragment) == false)
+    {
+        _zh_espnow_pool_free(ctx, message);
+        return;
+    }
+    uint32_t offset = (uint32_t)fragment.index * bulk->fragment_size;
+    bool is_valid = (fragment.index < bulk->fragment_num && fragment.total_len == bulk->total_len && fragment.fragment_size == bulk->fragment_size &&
+                     length == ((bulk->total_len - offset < bulk->fragment_size) ? bulk->total_len - offset : bulk->fragment_size));
+    ZH_ERROR_CHECK_VOID(is_valid == true, _zh_espnow_stats_add(ctx, &ctx->stats.frame_error, 1); _zh_espnow_pool_free(ctx, message), "Incoming ESP-NOW bulk fragment processing failed. Invalid fragment.");
+    bulk->last_activity = esp_timer_get_time();
+    uint16_t rel = fragment.index - bulk->base;
+    if (fragment.index < bulk->base || rel >= BULK_WINDOW_MAX || (bulk->received & (1UL << rel)) != 0)
+    {
+        // Duplicate, the sender missed an acknowledgement.
+        _zh_espnow_pool_free(ctx, message);
+        _zh_espnow_bulk_reply(ctx, bulk->mac_addr, bulk->transfer_id, bulk->base, bulk->received, BULK_ACK_OK);
+        bulk->unacked = 0;
+        return;
+    }
+    bool is_first_gap = (rel > 0 && bulk->received == 0);
+    bulk->received |= 1UL << rel;
+    if (bulk->sink == NULL)
+    {
+        memcpy(ctx->bulk_rx_buffer + offset, message->data + sizeof(_bulk_data_t), length);
+        _zh_espnow_pool_free(ctx, message);
+    }
+    else
+    {
+        bulk->pending[fragment.index % BULK_WINDOW_MAX] = message;
+    }
+    if (_zh_espnow_bulk_rx_advance(ctx) != ESP_OK)
+    {
+        _zh_espnow_bulk_reply(ctx, bulk->mac_addr, bulk->transfer_id, bulk->base, bulk->received, BULK_ACK_REJECT);
+        _zh_espnow_bulk_rx_abort(ctx);
+        return;
+    }
+    if (bulk->base == bulk->fragment_num)
+    {
+        _zh_espnow_bulk_rx_complete(ctx);
+        return;
+    }
+    if ((flags & FRAME_FLAG_ACK_REQUEST) != 0 || is_first_gap == true || ++bulk->unacked >= BULK_ACK_INTERVAL)
+    {
+        _zh_espnow_bulk_reply(ctx, bulk->mac_addr, bulk->transfer_id, bulk->base, bulk->received, BULK_ACK_OK);
+        bulk->unacked = 0;
+        _zh_espnow_bulk_rx_event(ctx, ZH_ESPNOW_BULK_IN_PROGRESS, NULL);
+    }
+}
+
+static bool _zh_espnow_bulk_rx_start(_context_t *ctx, const uint8_t *mac_addr, const _bulk_data_t *fragment)
+{
+    _bulk_rx_t *bulk = &ctx->bulk_rx;
+    if (ctx->bulk_rx_done.is_valid == true && ctx->bulk_rx_done.transfer_id == fragment->transfer_id && memcmp(ctx->bulk_rx_done.mac_addr, mac_addr, ESP_NOW_ETH_ALEN) == 0)
+    {
+        _zh_espnow_bulk_reply(ctx, mac_addr, fragment->transfer_id, ctx->bulk_rx_done.fragment_num, 0, BULK_ACK_OK);
+        return false;
+    }
+    if (bulk->is_active == true && (memcmp(bulk->mac_addr, mac_addr, ESP_NOW_ETH_ALEN) == 0 || esp_timer_get_time() - bulk->last_activity > BULK_RX_IDLE_TIMEOUT * 1000LL))
+    {
+        _zh_espnow_bulk_rx_abort(ctx);
+    }
+    portENTER_CRITICAL(&ctx->bulk_lock);
+    zh_espnow_bulk_sink_t sink = ctx->bulk_sink;
+    void *sink_arg = ctx->bulk_sink_arg;
+    bool is_locked = (sink == NULL && ctx->bulk_rx_buffer_locked == true);
+    portEXIT_CRITICAL(&ctx->bulk_lock);
+    uint32_t fragment_num = (fragment->fragment_size == 0 || fragment->total_len == 0) ? 0 : (fragment->total_len - 1) / fragment->fragment_size + 1;
+    uint8_t status = BULK_ACK_OK;
+    if (bulk->is_active == true || is_locked == true)
+    {
+        status = BULK_ACK_BUSY;
+    }
+    else if (fragment_num == 0 || fragment_num > UINT16_MAX || (sink == NULL && (ctx->bulk_rx_buffer == NULL || fragment->total_len > ctx->init_config.bulk_rx_buffer_size)))
+    {
+        status = BULK_ACK_REJECT;
+    }
+    if (status != BULK_ACK_OK)
+    {
+        _zh_espnow_bulk_reply(ctx, mac_addr, fragment->transfer_id, 0, 0, status);
+        return false;
+    }
+    *bulk = (_bulk_rx_t){0};
+    memcpy(bulk->mac_addr, mac_addr, ESP_NOW_ETH_ALEN);
+    bulk->transfer_id = fragment->transfer_id;
+    bulk->total_len = fragment->total_len;
+    bulk->fragment_size = fragment->fragment_size;
+    bulk->fragment_num = (uint16_t)fragment_num;
+    bulk->sink = sink;
+    bulk->sink_arg = sink_arg;
+    bulk->start_time = bulk->last_activity = esp_timer_get_time();
+    bulk->is_active = true;
+    return true;
+}
+
+static esp_err_t _zh_espnow_bulk_rx_advance(_context_t *ctx)
+{
+    _bulk_rx_t *bulk = &ctx->bulk_rx;
+    while ((bulk->received & 1) != 0)
+    {
+        if (bulk->sink != NULL)
+        {
+            zh_espnow_event_on_recv_t **pending = &bulk->pending[bulk->base % BULK_WINDOW_MAX];
+            esp_err_t err = bulk->sink(bulk->mac_addr, bulk->transfer_id, (uint32_t)bulk->base * bulk->fragment_size, (*pending)->data + sizeof(_bulk_data_t), (*pending)->data_len - sizeof(_bulk_data_t), bulk->total_len, bulk->sink_arg);
+            _zh_espnow_pool_free(ctx, *pending);
+            *pending = NULL;
+            ZH_ERROR_CHECK(err == ESP_OK, err, NULL, "Incoming ESP-NOW bulk transfer failed. Sink error.");
+        }
+        ++bulk->base;
+        bulk->received >>= 1;
+    }
+    return ESP_OK;
+}
+
+static void _zh_espnow_bulk_rx_complete(_context_t *ctx)
+{
+    _bulk_rx_t *bulk = &ctx->bulk_rx;
+    _zh_espnow_bulk_reply(ctx, bulk->mac_addr, bulk->transfer_id, bulk->base, 0, BULK_ACK_OK);
+    uint32_t throughput = _zh_espnow_bulk_throughput(bulk->total_len, bulk->start_time);
+    portENTER_CRITICAL(&ctx->stats_lock);
+    ctx->stats.bulk_rx_bytes += bulk->total_len;
+    ctx->stats.bulk_rx_throughput = throughput;
+    portEXIT_CRITICAL(&ctx->stats_lock);
+    ctx->bulk_rx_done.is_valid = true;
+    memcpy(ctx->bulk_rx_done.mac_addr, bulk->mac_addr, ESP_NOW_ETH_ALEN);
+    ctx->bulk_rx_done.transfer_id = bulk->transfer_id;
+    ctx->bulk_rx_done.fragment_num = bulk->fragment_num;
+    if (bulk->sink == NULL)
+    {
+        portENTER_CRITICAL(&ctx->bulk_lock);
+        ctx->bulk_rx_buffer_locked = true;
+        portEXIT_CRITICAL(&ctx->bulk_lock);
+    }
+    bulk->is_active = false;
+    _zh_espnow_bulk_rx_event(ctx, ZH_ESPNOW_BULK_SUCCESS, (bulk->sink == NULL) ? ctx->bulk_rx_buffer : NULL);
+}
+
+static void _zh_espnow_bulk_rx_abort(_context_t *ctx)
+{
+    _bulk_rx_t *bulk = &ctx->bulk_rx;
+    for (uint8_t i = 0; i < BULK_WINDOW_MAX; ++i)
+    {
+        _zh_espnow_pool_free(ctx, bulk->pending[i]);
+        bulk->pending[i] = NULL;
+    }
+    bulk->is_active = false;
+    _zh_espnow_bulk_rx_event(ctx, ZH_ESPNOW_BULK_FAIL, NULL);
+}
+
+static void _zh_espnow_bulk_rx_event(_context_t *ctx, zh_espnow_bulk_status_t status, const uint8_t *data)
+{
+    zh_espnow_event_on_bulk_t on_bulk = {0};
+    memcpy(on_bulk.mac_addr, ctx->bulk_rx.mac_addr, ESP_NOW_ETH_ALEN);
+    on_bulk.transfer_id = ctx->bulk_rx.transfer_id;
+    on_bulk.direction = ZH_ESPNOW_BULK_RX;
+    on_bulk.status = status;
+    on_bulk.total_len = ctx->bulk_rx.total_len;
+    uint32_t done_len = (uint32_t)ctx->bulk_rx.base * ctx->bulk_rx.fragment_size;
+    on_bulk.done_len = (done_len < ctx->bulk_rx.total_len) ? done_len : ctx->bulk_rx.total_len;
+    on_bulk.data = data;
+    bool is_progress = (status == ZH_ESPNOW_BULK_IN_PROGRESS);
+    ZH_ERROR_CHECK_VOID(esp_event_post(ctx->event_base, (is_progress == true) ? ZH_ESPNOW_ON_BULK_PROGRESS_EVENT : ZH_ESPNOW_ON_BULK_COMPLETE_EVENT, &on_bulk, sizeof(zh_espnow_event_on_bulk_t), (is_progress == true) ? 0 : 1000 / portTICK_PERIOD_MS) == ESP_OK,
+                        _zh_espnow_stats_add(ctx, &ctx->stats.event_post_error, 1), "Incoming ESP-NOW bulk transfer processing failed. Failed to post bulk event.");
+}
+
+static void _zh_espnow_bulk_reply(_context_t *ctx, const uint8_t *mac_addr, uint16_t transfer_id, uint16_t base, uint32_t bitmap, uint8_t status)
+{
+    const _bulk_ack_t ack = {.transfer_id = transfer_id, .base = base, .bitmap = bitmap, .status = status};
+    const zh_espnow_iovec_t iov = {.data = &ack, .data_len = sizeof(_bulk_ack_t)};
+    xSemaphoreTake(ctx->tx_mutex, portMAX_DELAY);
+    esp_err_t err = _zh_espnow_tx_enqueue(ctx, mac_addr, FRAME_BULK_ACK, 0, ZH_ESPNOW_PRIORITY_CONTROL, &iov, 1, 0, NULL);
+    xSemaphoreGive(ctx->tx_mutex);
+    ZH_ERROR_CHECK_VOID(err == ESP_OK, NULL, "Incoming ESP-NOW bulk transfer processing failed. Failed to queue acknowledgement.");
+    xTaskNotifyGive(ctx->task);
+}
+
+static TickType_t _zh_espnow_bulk_deadline(_context_t *ctx)
+{
+    // Leave time for the retries of the fragments still in the transmission window.
+    return xTaskGetTickCount() + pdMS_TO_TICKS(BULK_ACK_TIMEOUT + (WAIT_CONFIRM_MAX_TIME + RETRY_BACKOFF_MAX) * ctx->init_config.attempts);
+}
+
+static uint32_t _zh_espnow_bulk_throughput(uint32_t total_len, int64_t start_time)
+{
+    int64_t elapsed = esp_timer_get_time() - start_time;
+    return (elapsed > 0) ? (uint32_t)((uint64_t)total_len * 1000000 / (uint64_t)elapsed) : 0;
+}
+
+static uint16_t _zh_espnow_codec_encode(_context_t *ctx, const uint8_t *src, uint16_t src_len, uint8_t *dst, uint16_t dst_size)
+{
+    // LZ77 over the dictionary followed by the payload, with one candidate per hash. Output: the payload length
+    // (2 bytes), then tokens. 0LLLLLLL: L + 1 literal bytes follow. 1LLLOOOO OOOOOOOO [E]: copy L + 3 bytes (L = 7 adds
+    // the extra byte E) from O + 1 bytes back. Returns 0 if the result does not fit into dst_size.
+    const uint16_t dict_len = sizeof(_codec_dict) - 1;
+    const uint16_t end = dict_len + src_len;
+    uint16_t out = sizeof(uint16_t);
+    if (dst_size <= out)
+    {
+        return 0;
+    }
+    memcpy(dst, &src_len, sizeof(uint16_t));
+    memset(ctx->codec_table, 0, sizeof(uint16_t) << CODEC_HASH_BITS);
+    for (uint16_t pos = 0; pos + CODEC_MATCH_MIN <= dict_len; ++pos)
+    {
+        ctx->codec_table[_zh_espnow_codec_hash(src, pos)] = pos + 1;
+    }
+    uint16_t pos = dict_len;
+    uint16_t literal = dict_len;
+    while (pos + CODEC_MATCH_MIN <= end)
+    {
+        uint8_t hash = _zh_espnow_codec_hash(src, pos);
+        uint16_t candidate = ctx->codec_table[hash];
+        ctx->codec_table[hash] = pos + 1;
+        if (candidate == 0 || pos - (candidate - 1) > CODEC_WINDOW)
+        {
+            ++pos;
+            continue;
+        }
+        --candidate;
+        uint16_t match_len = 0;
+        while (pos + match_len < end && match_len < CODEC_MATCH_MAX && _zh_espnow_codec_byte(src, candidate + match_len) == _zh_espnow_codec_byte(src, pos + match_len))
+        {
+            ++match_len;
+        }
+        if (match_len < CODEC_MATCH_MIN)
+        {
+            ++pos;
+            continue;
+        }
+        if (_zh_espnow_codec_emit(src, literal, pos, dst, dst_size, &out) == false || out + 3 > dst_size)
+        {
+            return 0;
+        }
+        uint16_t distance = pos - candidate - 1;
+        uint8_t length = (match_len - CODEC_MATCH_MIN > 7) ? 7 : match_len - CODEC_MATCH_MIN;
+        dst[out++] = 0x80 | (length << 4) | (distance >> 8);
+        dst[out++] = distance & 0xFF;
+        if (length == 7)
+        {
+            dst[out++] = match_len - CODEC_MATCH_MIN - 7;
+        }
+        for (uint16_t i = pos + 1; i < pos + match_len && i + CODEC_MATCH_MIN <= end; ++i)
+        {
+            ctx->codec_table[_zh_espnow_codec_hash(src, i)] = i + 1;
+        }
+        pos += match_len;
+        literal = pos;
+    }
+    return (_zh_espnow_codec_emit(src, literal, end, dst, dst_size, &out) == true) ? out : 0;
+}
+
+static uint16_t _zh_espnow_codec_decode(const uint8_t *src, uint16_t src_len, uint8_t *dst, uint16_t dst_size)
+{
+    const uint16_t dict_len = sizeof(_codec_dict) - 1;
+    uint16_t data_len = 0;
+    if (src_len <= sizeof(uint16_t))
+    {
+        return 0;
+    }
+    memcpy(&data_len, src, sizeof(uint16_t));
+    if (data_len == 0 || data_len > dst_size)
+    {
+        return 0;
+    }
+    uint16_t in = sizeof(uint16_t);
+    uint16_t out = 0;
+    while (in < src_len)
+    {
+        uint8_t token = src[in++];
+        if ((token & 0x80) == 0)
+        {
+            uint16_t count = (token & 0x7F) + 1;
+            if (in + count > src_len || out + count > data_len)
+            {
+                return 0;
+            }
+            memcpy(dst + out, src + in, count);
+            in += count;
+            out += count;
+            continue;
+        }
+        if (in >= src_len)
+        {
+            return 0;
+        }
+        uint16_t distance = (((token & 0x0F) << 8) | src[in++]) + 1;
+        uint16_t match_len = ((token >> 4) & 0x07) + CODEC_MATCH_MIN;
+        if (match_len == CODEC_MATCH_MIN + 7)
+        {
+            if (in >= src_len)
+            {
+                return 0;
+            }
+            match_len += src[in++];
+        }
+        if (distance > dict_len + out || out + match_len > data_len)
+        {
+            return 0;
+        }
+        // Byte by byte, a match may overlap the bytes it produces.
+        for (uint16_t from = dict_len + out - distance; match_len > 0; --match_len, ++from)
+        {
+            dst[out++] = (from < dict_len) ? _codec_dict[from] : dst[from - dict_len];
+        }
+    }
+    return (out == data_len) ? out : 0;
+}
+
+static bool _zh_espnow_codec_emit(const uint8_t *src, uint16_t from, uint16_t to, uint8_t *dst, uint16_t dst_size, uint16_t *out)
+{
+    const uint16_t dict_len = sizeof(_codec_dict) - 1;
+    while (from < to)
+    {
+        uint16_t count = (to - from > CODEC_LITERALS_MAX) ? CODEC_LITERALS_MAX : to - from;
+        if (*out + 1 + count > dst_size)
+        {
+            return false;
+        }
+        dst[(*out)++] = count - 1;
+        memcpy(dst + *out, src + from - dict_len, count);
+        *out += count;
+        from += count;
+    }
+    return true;
+}
+
+static uint8_t _zh_espnow_codec_byte(const uint8_t *data, uint16_t pos)
+{
+    const uint16_t dict_len = sizeof(_codec_dict) - 1;
+    return (pos < dict_len) ? _codec_dict[pos] : data[pos - dict_len];
+}
+
+static uint8_t _zh_espnow_codec_hash(const uint8_t *data, uint16_t pos)
+{
+    uint32_t value = ((uint32_t)_zh_espnow_codec_byte(data, pos) << 16) | ((uint32_t)_zh_espnow_codec_byte(data, pos + 1) << 8) | _zh_espnow_codec_byte(data, pos + 2);
+    return (uint8_t)((value * 2654435761UL) >> (32 - CODEC_HASH_BITS));
+}
+
+static void _zh_espnow_compress(_context_t *ctx, zh_espnow_event_on_recv_t *message, uint16_t offset)
+{
+    // Must be called with ctx->tx_mutex held, the hash table and the scratch buffer are shared.
+    uint16_t data_len = message->data_len - offset;
+    esp_cpu_cycle_count_t start = esp_cpu_get_cycle_count();
+    uint16_t packed_len = _zh_espnow_codec_encode(ctx, message->data + offset, data_len, ctx->codec_scratch, data_len - 1);
+    uint32_t cycles = esp_cpu_get_cycle_count() - start;
+    if (packed_len > 0)
+    {
+        memcpy(message->data + offset, ctx->codec_scratch, packed_len);
+        message->data_len = offset + packed_len;
+        ((_frame_header_t *)message->data)->flags |= FRAME_FLAG_COMPRESSED;
+    }
+    portENTER_CRITICAL(&ctx->stats_lock);
+    if (packed_len > 0)
+    {
+        ++ctx->stats.compressed_frames;
+        ctx->stats.compress_bytes_in += data_len;
+        ctx->stats.compress_bytes_out += packed_len;
+    }
+    else
+    {
+        ++ctx->stats.compress_skipped;
+    }
+    _zh_espnow_stats_latency(ctx, &ctx->stats.encode_cycles_per_byte_avg, &ctx->stats.encode_cycles_per_byte_max, cycles / data_len);
+    portEXIT_CRITICAL(&ctx->stats_lock);
+}
+
+static zh_espnow_event_on_recv_t *_zh_espnow_decompress(_context_t *ctx, zh_espnow_event_on_recv_t *message)
+{
+    uint16_t data_len = 0;
+    if (message->data_len > sizeof(uint16_t))
+    {
+        memcpy(&data_len, message->data, sizeof(uint16_t));
+    }
+    zh_espnow_event_on_recv_t *unpacked = (data_len > 0) ? _zh_espnow_pool_alloc(ctx, data_len) : NULL;
+    if (unpacked == NULL)
+    {
+        _zh_espnow_stats_add(ctx, &ctx->stats.frame_error, 1);
+        _zh_espnow_pool_free(ctx, message);
+        ZH_LOGE("Invalid compressed frame or no free block in the message pool. Dropping incoming ESP-NOW data.", ESP_FAIL);
+        return NULL;
+    }
+    esp_cpu_cycle_count_t start = esp_cpu_get_cycle_count();
+    uint16_t unpacked_len = _zh_espnow_codec_decode(message->data, message->data_len, unpacked->data, data_len);
+    uint32_t cycles = esp_cpu_get_cycle_count() - start;
+    memcpy(unpacked->mac_addr, message->mac_addr, ESP_NOW_ETH_ALEN);
+    unpacked->data_len = unpacked_len;
+    _zh_espnow_pool_free(ctx, message);
+    if (unpacked_len == 0)
+    {
+        _zh_espnow_stats_add(ctx, &ctx->stats.frame_error, 1);
+        _zh_espnow_pool_free(ctx, unpacked);
+        ZH_LOGE("Invalid compressed frame. Dropping incoming ESP-NOW data.", ESP_FAIL);
+        return NULL;
+    }
+    portENTER_CRITICAL(&ctx->stats_lock);
+    ++ctx->stats.decompressed_frames;
+    _zh_espnow_stats_latency(ctx, &ctx->stats.decode_cycles_per_byte_avg, &ctx->stats.decode_cycles_per_byte_max, cycles / unpacked_len);
+    portEXIT_CRITICAL(&ctx->stats_lock);
+    if (_zh_espnow_filter_payload(ctx, unpacked->data, unpacked_len) == false)
+    {
+        _zh_espnow_stats_add(ctx, &ctx->stats.filter_dropped, 1);
+        _zh_espnow_pool_free(ctx, unpacked);
+        return NULL;
+    }
+    return unpacked;
+}
+
+static void IRAM_ATTR _zh_espnow_trace(_context_t *ctx, uint8_t event, uint8_t arg, uint32_t msg_id, uint16_t value)
+{
+    // Lock-free: every writer claims its own record. A record written during a dump may be read half updated.
+    zh_espnow_trace_record_t *ring = ctx->trace_ring;
+    if (ring == NULL)
+    {
+        return;
+    }
+    uint32_t index = __atomic_fetch_add(&ctx->trace_head, 1, __ATOMIC_RELAXED) & ctx->trace_mask;
+    ring[index] = (zh_espnow_trace_record_t){.cycles = esp_cpu_get_cycle_count(), .msg_id = msg_id, .value = value, .event = event | ((xPortGetCoreID() != 0) ? ZH_ESPNOW_TRACE_CORE_BIT : 0), .arg = arg};
+}
+
+static uint16_t _zh_espnow_trace_collect(_context_t *ctx, zh_espnow_trace_record_t *records, uint16_t count)
+{
+    uint32_t head = ctx->trace_head;
+    uint32_t available = head - ctx->trace_start;
+    available = (available > ctx->trace_mask + 1) ? ctx->trace_mask + 1 : available;
+    available = (available > count) ? count : available;
+    for (uint32_t i = 0; i < available; ++i)
+    {
+        records[i] = ctx->trace_ring[(head - available + i) & ctx->trace_mask];
+    }
+    return (uint16_t)available;
+}
+
+static void IRAM_ATTR _zh_espnow_processing(void *pvParameter)
+{
+    _context_t *ctx = pvParameter;
+    _queue_t queue = {0};
+    _confirm_t confirm = {0};
+    TickType_t wait = portMAX_DELAY;
+    for (;;)
+    {
+        ulTaskNotifyTake(pdTRUE, wait);
+        while (xQueueReceive(ctx->confirm_queue_handle, &confirm, 0) == pdTRUE)
+        {
+            _zh_espnow_process_confirm(ctx, &confirm);
+        }
+        TickType_t burst_wait = _zh_espnow_burst_check(ctx);
+        while (_zh_espnow_tx_next(ctx, &queue) == true)
+        {
+            switch (queue.id)
+            {
+            case TO_SEND:
+                _zh_espnow_process_send(ctx, &queue);
+                break;
+            default:
+                break;
+            }
+        }
+        TickType_t fair_wait = ctx->fair_wait;
+        _zh_espnow_tx_space_notify(ctx);
+        TickType_t bulk_wait = _zh_espnow_bulk_tx_process(ctx);
+        wait = _zh_espnow_process_timeouts(ctx);
+        wait = (bulk_wait < wait) ? bulk_wait : wait;
+        wait = (fair_wait < wait) ? fair_wait : wait;
+        TickType_t coalesce_wait = _zh_espnow_coalesce_process(ctx);
+        wait = (coalesce_wait < wait) ? coalesce_wait : wait;
+        _zh_espnow_burst_finish(ctx);
+        wait = (burst_wait < wait) ? burst_wait : wait;
+        ctx->stats.min_stack_size = (uint32_t)uxTaskGetStackHighWaterMark(NULL);
+    }
+    vTaskDelete(NULL);
+}
+
+static void IRAM_ATTR _zh_espnow_rx_processing(void *pvParameter)
+{
+    _context_t *ctx = pvParameter;
+    _queue_t queue = {0};
+    for (;;)
+    {
+        // Without pending RPC callbacks the wait is portMAX_DELAY.
+        if (xQueueReceive(ctx->rx_queue_handle, &queue, _zh_espnow_rpc_expire(ctx)) != pdTRUE)
+        {
+            continue;
+        }
+        switch (queue.id)
+        {
+        case ON_RECV:
+            _zh_espnow_process_recv(ctx, &queue);
+            break;
+        default:
+            break;
+        }
+        ctx->stats.rx_min_stack_size = (uint32_t)uxTaskGetStackHighWaterMark(NULL);
+    }
+}